@@ -0,0 +1,864 @@
+#ifdef _WIN32
+#define _CRT_RAND_S // rand_s: криптографический генератор CRT
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "stats.h"
+#include "aead.h"
+
+#define AEAD_CHUNK 4096 // шифртекст обрабатывается порциями, которые остаются в кэше L1 между ChaCha20 и Poly1305
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define AEAD_KEY_CACHE 64 // выведенных ключей в кеше процесса (вытесняются по кругу)
+
+static char *globalPassphrase; // глобальный --passphrase-file (NULL - сообщения не шифруются)
+
+// Кеш ключей PBKDF2: повторное дешифрование сообщения (одного файла или из кеша результатов
+// пакета) не выводит ключ заново. Запись находится по SHA-256 соли и пароля.
+typedef struct
+{
+    unsigned char id[32];
+    unsigned char key[AEAD_KEY];
+    int used;
+} AEAD_CACHED_KEY;
+
+static AEAD_CACHED_KEY keyCache[AEAD_KEY_CACHE];
+static int keyCacheNext;
+static pthread_mutex_t keyCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int load32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static void store32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void store64(unsigned char *p, unsigned long long v)
+{
+    store32(p, (unsigned int)v);
+    store32(p + 4, (unsigned int)(v >> 32));
+}
+
+/* ---------------- SHA-256, HMAC, PBKDF2 ---------------- */
+
+typedef struct
+{
+    unsigned int h[8];
+    unsigned long long total;
+    unsigned char buffer[64];
+    int buffered;
+} SHA256_STATE;
+
+static const unsigned int sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR32(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha256_compress(unsigned int *h, const unsigned char *block)
+{
+    unsigned int w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (unsigned int)block[4 * i] << 24 | (unsigned int)block[4 * i + 1] << 16 |
+               (unsigned int)block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        unsigned int s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    unsigned int a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned int t1 = k + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        unsigned int t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+static void sha256_init(SHA256_STATE *s)
+{
+    static const unsigned int iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(s->h, iv, sizeof(iv));
+    s->total = 0;
+    s->buffered = 0;
+}
+
+static void sha256_update(SHA256_STATE *s, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    s->total += size;
+    while (size > 0)
+    {
+        if (s->buffered == 0 && size >= 64)
+        {
+            sha256_compress(s->h, p);
+            p += 64;
+            size -= 64;
+            continue;
+        }
+        size_t n = (size_t)(64 - s->buffered) < size ? (size_t)(64 - s->buffered) : size;
+        memcpy(s->buffer + s->buffered, p, n);
+        s->buffered += (int)n;
+        p += n;
+        size -= n;
+        if (s->buffered == 64)
+        {
+            sha256_compress(s->h, s->buffer);
+            s->buffered = 0;
+        }
+    }
+}
+
+static void sha256_final(SHA256_STATE *s, unsigned char digest[32])
+{
+    unsigned long long bits = s->total * 8;
+    unsigned char pad[72] = {0x80};
+    size_t padLen = (s->buffered < 56 ? 56 : 120) - s->buffered;
+    for (int i = 0; i < 8; i++)
+        pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256_update(s, pad, padLen + 8);
+    for (int i = 0; i < 8; i++)
+    {
+        digest[4 * i] = (unsigned char)(s->h[i] >> 24);
+        digest[4 * i + 1] = (unsigned char)(s->h[i] >> 16);
+        digest[4 * i + 2] = (unsigned char)(s->h[i] >> 8);
+        digest[4 * i + 3] = (unsigned char)s->h[i];
+    }
+}
+
+void sha256(const void *data, size_t size, unsigned char digest[32])
+{
+    SHA256_STATE s;
+    sha256_init(&s);
+    sha256_update(&s, data, size);
+    sha256_final(&s, digest);
+}
+
+/**
+ * @brief PBKDF2-HMAC-SHA256 (RFC 8018).
+ *
+ * Состояния HMAC после внутреннего и внешнего блока ключа вычисляются один раз, поэтому
+ * итерация стоит двух сжатий SHA-256.
+ */
+void pbkdf2_sha256(const char *passphrase, size_t passLen, const unsigned char *salt, size_t saltLen,
+                   unsigned int iterations, unsigned char *out, size_t outLen)
+{
+    unsigned char key[64] = {0}, pad[64];
+    if (passLen > 64)
+        sha256(passphrase, passLen, key);
+    else
+        memcpy(key, passphrase, passLen);
+
+    SHA256_STATE inner, outer;
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x36;
+    sha256_init(&inner);
+    sha256_update(&inner, pad, 64);
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x5c;
+    sha256_init(&outer);
+    sha256_update(&outer, pad, 64);
+
+    for (unsigned int block = 1; outLen > 0; block++)
+    {
+        unsigned char counter[4] = {(unsigned char)(block >> 24), (unsigned char)(block >> 16),
+                                    (unsigned char)(block >> 8), (unsigned char)block};
+        unsigned char u[32], t[32];
+        SHA256_STATE s = inner;
+        sha256_update(&s, salt, saltLen);
+        sha256_update(&s, counter, 4);
+        sha256_final(&s, u);
+        s = outer;
+        sha256_update(&s, u, 32);
+        sha256_final(&s, u);
+        memcpy(t, u, 32);
+
+        for (unsigned int i = 1; i < iterations; i++)
+        {
+            s = inner;
+            sha256_update(&s, u, 32);
+            sha256_final(&s, u);
+            s = outer;
+            sha256_update(&s, u, 32);
+            sha256_final(&s, u);
+            for (int j = 0; j < 32; j++)
+                t[j] ^= u[j];
+        }
+
+        size_t n = outLen < 32 ? outLen : 32;
+        memcpy(out, t, n);
+        out += n;
+        outLen -= n;
+    }
+}
+
+/* ---------------- ChaCha20 ---------------- */
+
+#define ROL32(x, n) ((x) << (n) | (x) >> (32 - (n)))
+#define QUARTER(a, b, c, d)                                                                                            \
+    a += b, d ^= a, d = ROL32(d, 16), c += d, b ^= c, b = ROL32(b, 12), a += b, d ^= a, d = ROL32(d, 8), c += d,       \
+                                                                         b ^= c, b = ROL32(b, 7)
+
+static void chacha20_init(unsigned int *state, const unsigned char key[32], const unsigned char nonce[12],
+                          unsigned int counter)
+{
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++)
+        state[4 + i] = load32(key + 4 * i);
+    state[12] = counter;
+    for (int i = 0; i < 3; i++)
+        state[13 + i] = load32(nonce + 4 * i);
+}
+
+/**
+ * @brief Один блок ключевого потока ChaCha20 (64 байта).
+ */
+void chacha20_block(const unsigned char key[32], const unsigned char nonce[12], unsigned int counter,
+                    unsigned char block[64])
+{
+    unsigned int s[16], x[16];
+    chacha20_init(s, key, nonce, counter);
+    memcpy(x, s, sizeof(s));
+    for (int i = 0; i < 10; i++)
+    {
+        QUARTER(x[0], x[4], x[8], x[12]);
+        QUARTER(x[1], x[5], x[9], x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8], x[13]);
+        QUARTER(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++)
+        store32(block + 4 * i, x[i] + s[i]);
+}
+
+#ifdef __SSE2__
+#define VROL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define VQUARTER(a, b, c, d)                                                                                           \
+    a = _mm_add_epi32(a, b), d = VROL(_mm_xor_si128(d, a), 16), c = _mm_add_epi32(c, d),                               \
+    b = VROL(_mm_xor_si128(b, c), 12), a = _mm_add_epi32(a, b), d = VROL(_mm_xor_si128(d, a), 8),                      \
+    c = _mm_add_epi32(c, d), b = VROL(_mm_xor_si128(b, c), 7)
+
+/**
+ * @brief Четыре блока ключевого потока одновременно: регистр x[i] содержит слово i всех четырех
+ * блоков, поэтому раунды идут без перестановок; в конце блоки транспонируются и сразу
+ * складываются с данными.
+ */
+static void chacha20_xor4(const unsigned int *state, unsigned int counter, const unsigned char *in,
+                          unsigned char *out)
+{
+    __m128i s[16], x[16];
+    for (int i = 0; i < 16; i++)
+        s[i] = _mm_set1_epi32((int)state[i]);
+    s[12] = _mm_add_epi32(_mm_set1_epi32((int)counter), _mm_set_epi32(3, 2, 1, 0));
+    for (int i = 0; i < 16; i++)
+        x[i] = s[i];
+
+    for (int i = 0; i < 10; i++)
+    {
+        VQUARTER(x[0], x[4], x[8], x[12]);
+        VQUARTER(x[1], x[5], x[9], x[13]);
+        VQUARTER(x[2], x[6], x[10], x[14]);
+        VQUARTER(x[3], x[7], x[11], x[15]);
+        VQUARTER(x[0], x[5], x[10], x[15]);
+        VQUARTER(x[1], x[6], x[11], x[12]);
+        VQUARTER(x[2], x[7], x[8], x[13]);
+        VQUARTER(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i += 4)
+    {
+        // слова i..i+3 блоков 0..3: транспонирование 4x4
+        __m128i a = _mm_add_epi32(x[i], s[i]), b = _mm_add_epi32(x[i + 1], s[i + 1]);
+        __m128i c = _mm_add_epi32(x[i + 2], s[i + 2]), d = _mm_add_epi32(x[i + 3], s[i + 3]);
+        __m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+        __m128i cd0 = _mm_unpacklo_epi32(c, d), cd1 = _mm_unpackhi_epi32(c, d);
+        __m128i rows[4] = {_mm_unpacklo_epi64(ab0, cd0), _mm_unpackhi_epi64(ab0, cd0), _mm_unpacklo_epi64(ab1, cd1),
+                           _mm_unpackhi_epi64(ab1, cd1)};
+        for (int block = 0; block < 4; block++)
+        {
+            const __m128i *src = (const __m128i *)(in + 64 * block + 4 * i);
+            _mm_storeu_si128((__m128i *)(out + 64 * block + 4 * i), _mm_xor_si128(_mm_loadu_si128(src), rows[block]));
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Складывает данные с ключевым потоком ChaCha20, начиная с блока counter.
+ *
+ * С SSE2 по 256 байт (четыре блока) за итерацию, остаток - поблочно.
+ * in и out могут совпадать.
+ */
+void chacha20_xor(const unsigned char key[32], const unsigned char nonce[12], unsigned int counter,
+                  const unsigned char *in, unsigned char *out, size_t size)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    unsigned int state[16];
+    chacha20_init(state, key, nonce, counter);
+    for (; i + 256 <= size; i += 256, counter += 4)
+        chacha20_xor4(state, counter, in + i, out + i);
+#endif
+    for (; i < size; i += 64, counter++)
+    {
+        unsigned char block[64];
+        chacha20_block(key, nonce, counter, block);
+        size_t n = size - i < 64 ? size - i : 64;
+        for (size_t j = 0; j < n; j++)
+            out[i + j] = in[i + j] ^ block[j];
+    }
+}
+
+/* ---------------- Poly1305 ---------------- */
+
+// Накопитель по модулю 2^130 - 5 в пяти 26-битных частях
+typedef struct
+{
+    unsigned int r[5], h[5], pad[4];
+    unsigned char buffer[16];
+    int buffered;
+} POLY1305_STATE;
+
+static void poly1305_init(POLY1305_STATE *p, const unsigned char key[32])
+{
+    p->r[0] = load32(key) & 0x3ffffff;
+    p->r[1] = (load32(key + 3) >> 2) & 0x3ffff03;
+    p->r[2] = (load32(key + 6) >> 4) & 0x3ffc0ff;
+    p->r[3] = (load32(key + 9) >> 6) & 0x3f03fff;
+    p->r[4] = (load32(key + 12) >> 8) & 0x00fffff;
+    memset(p->h, 0, sizeof(p->h));
+    for (int i = 0; i < 4; i++)
+        p->pad[i] = load32(key + 16 + 4 * i);
+    p->buffered = 0;
+}
+
+static void poly1305_blocks(POLY1305_STATE *p, const unsigned char *m, size_t size)
+{
+    unsigned int r0 = p->r[0], r1 = p->r[1], r2 = p->r[2], r3 = p->r[3], r4 = p->r[4];
+    unsigned int s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    unsigned int h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+
+    for (; size >= 16; m += 16, size -= 16)
+    {
+        h0 += load32(m) & 0x3ffffff;
+        h1 += (load32(m + 3) >> 2) & 0x3ffffff;
+        h2 += (load32(m + 6) >> 4) & 0x3ffffff;
+        h3 += (load32(m + 9) >> 6) & 0x3ffffff;
+        h4 += (load32(m + 12) >> 8) | (1 << 24);
+
+        unsigned long long d0 = (unsigned long long)h0 * r0 + (unsigned long long)h1 * s4 +
+                                (unsigned long long)h2 * s3 + (unsigned long long)h3 * s2 + (unsigned long long)h4 * s1;
+        unsigned long long d1 = (unsigned long long)h0 * r1 + (unsigned long long)h1 * r0 +
+                                (unsigned long long)h2 * s4 + (unsigned long long)h3 * s3 + (unsigned long long)h4 * s2;
+        unsigned long long d2 = (unsigned long long)h0 * r2 + (unsigned long long)h1 * r1 +
+                                (unsigned long long)h2 * r0 + (unsigned long long)h3 * s4 + (unsigned long long)h4 * s3;
+        unsigned long long d3 = (unsigned long long)h0 * r3 + (unsigned long long)h1 * r2 +
+                                (unsigned long long)h2 * r1 + (unsigned long long)h3 * r0 + (unsigned long long)h4 * s4;
+        unsigned long long d4 = (unsigned long long)h0 * r4 + (unsigned long long)h1 * r3 +
+                                (unsigned long long)h2 * r2 + (unsigned long long)h3 * r1 + (unsigned long long)h4 * r0;
+
+        unsigned int c = (unsigned int)(d0 >> 26);
+        h0 = (unsigned int)d0 & 0x3ffffff;
+        d1 += c;
+        c = (unsigned int)(d1 >> 26);
+        h1 = (unsigned int)d1 & 0x3ffffff;
+        d2 += c;
+        c = (unsigned int)(d2 >> 26);
+        h2 = (unsigned int)d2 & 0x3ffffff;
+        d3 += c;
+        c = (unsigned int)(d3 >> 26);
+        h3 = (unsigned int)d3 & 0x3ffffff;
+        d4 += c;
+        c = (unsigned int)(d4 >> 26);
+        h4 = (unsigned int)d4 & 0x3ffffff;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= 0x3ffffff;
+        h1 += c;
+    }
+
+    p->h[0] = h0;
+    p->h[1] = h1;
+    p->h[2] = h2;
+    p->h[3] = h3;
+    p->h[4] = h4;
+}
+
+static void poly1305_update(POLY1305_STATE *p, const unsigned char *data, size_t size)
+{
+    if (p->buffered)
+    {
+        size_t n = (size_t)(16 - p->buffered) < size ? (size_t)(16 - p->buffered) : size;
+        memcpy(p->buffer + p->buffered, data, n);
+        p->buffered += (int)n;
+        data += n;
+        size -= n;
+        if (p->buffered < 16)
+            return;
+        poly1305_blocks(p, p->buffer, 16);
+        p->buffered = 0;
+    }
+    poly1305_blocks(p, data, size & ~(size_t)15);
+    memcpy(p->buffer, data + (size & ~(size_t)15), size & 15);
+    p->buffered = (int)(size & 15);
+}
+
+/**
+ * @brief Дополняет неполный блок нулями (как требует RFC 8439 после AAD и шифртекста).
+ */
+static void poly1305_pad(POLY1305_STATE *p)
+{
+    if (p->buffered)
+    {
+        memset(p->buffer + p->buffered, 0, 16 - p->buffered);
+        poly1305_blocks(p, p->buffer, 16);
+        p->buffered = 0;
+    }
+}
+
+static void poly1305_final(POLY1305_STATE *p, unsigned char tag[16])
+{
+    unsigned int h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4], c;
+    c = h1 >> 26;
+    h1 &= 0x3ffffff;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= 0x3ffffff;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= 0x3ffffff;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= 0x3ffffff;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= 0x3ffffff;
+    h1 += c;
+
+    // h - p = h + 5 - 2^130: выбирается без ветвлений
+    unsigned int g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= 0x3ffffff;
+    unsigned int g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= 0x3ffffff;
+    unsigned int g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= 0x3ffffff;
+    unsigned int g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= 0x3ffffff;
+    unsigned int g4 = h4 + c - (1u << 26);
+
+    unsigned int mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    unsigned int w0 = h0 | h1 << 26, w1 = h1 >> 6 | h2 << 20, w2 = h2 >> 12 | h3 << 14, w3 = h3 >> 18 | h4 << 8;
+    unsigned long long f = (unsigned long long)w0 + p->pad[0];
+    store32(tag, (unsigned int)f);
+    f = (unsigned long long)w1 + p->pad[1] + (f >> 32);
+    store32(tag + 4, (unsigned int)f);
+    f = (unsigned long long)w2 + p->pad[2] + (f >> 32);
+    store32(tag + 8, (unsigned int)f);
+    f = (unsigned long long)w3 + p->pad[3] + (f >> 32);
+    store32(tag + 12, (unsigned int)f);
+}
+
+/* ---------------- ChaCha20-Poly1305 ---------------- */
+
+static void aead_poly_start(POLY1305_STATE *p, const unsigned char key[AEAD_KEY], const unsigned char *aad,
+                            size_t aadLen)
+{
+    unsigned char block[64];
+    chacha20_block(key, key + 32, 0, block);
+    poly1305_init(p, block);
+    poly1305_update(p, aad, aadLen);
+    poly1305_pad(p);
+}
+
+static void aead_poly_finish(POLY1305_STATE *p, size_t aadLen, size_t size, unsigned char tag[AEAD_TAG])
+{
+    unsigned char lengths[16];
+    poly1305_pad(p);
+    store64(lengths, aadLen);
+    store64(lengths + 8, size);
+    poly1305_update(p, lengths, 16);
+    poly1305_final(p, tag);
+}
+
+/**
+ * @brief Шифрует ChaCha20-Poly1305 (RFC 8439) с ключом и nonce из key.
+ *
+ * Шифртекст вычисляется порциями AEAD_CHUNK байт, и каждая порция сразу поступает в Poly1305,
+ * пока находится в кэше.
+ */
+void aead_encrypt(const unsigned char key[AEAD_KEY], const unsigned char *aad, size_t aadLen,
+                  const unsigned char *plain, size_t size, unsigned char *cipher, unsigned char tag[AEAD_TAG])
+{
+    POLY1305_STATE p;
+    aead_poly_start(&p, key, aad, aadLen);
+    for (size_t i = 0; i < size; i += AEAD_CHUNK)
+    {
+        size_t n = size - i < AEAD_CHUNK ? size - i : AEAD_CHUNK;
+        chacha20_xor(key, key + 32, 1 + (unsigned int)(i / 64), plain + i, cipher + i, n);
+        poly1305_update(&p, cipher + i, n);
+    }
+    aead_poly_finish(&p, aadLen, size, tag);
+}
+
+/**
+ * @brief Проверяет тег и расшифровывает ChaCha20-Poly1305.
+ *
+ * @return 1 если тег совпал (plain заполнен), 0 если данные или пароль неверны (plain обнулен).
+ */
+int aead_decrypt(const unsigned char key[AEAD_KEY], const unsigned char *aad, size_t aadLen,
+                 const unsigned char *cipher, size_t size, const unsigned char tag[AEAD_TAG], unsigned char *plain)
+{
+    POLY1305_STATE p;
+    unsigned char expected[AEAD_TAG];
+    aead_poly_start(&p, key, aad, aadLen);
+    for (size_t i = 0; i < size; i += AEAD_CHUNK)
+    {
+        size_t n = size - i < AEAD_CHUNK ? size - i : AEAD_CHUNK;
+        poly1305_update(&p, cipher + i, n);
+        chacha20_xor(key, key + 32, 1 + (unsigned int)(i / 64), cipher + i, plain + i, n);
+    }
+    aead_poly_finish(&p, aadLen, size, expected);
+
+    unsigned char diff = 0;
+    for (int i = 0; i < AEAD_TAG; i++)
+        diff |= expected[i] ^ tag[i];
+    if (diff)
+        memset(plain, 0, size);
+    return diff == 0;
+}
+
+/**
+ * @brief Заполняет буфер криптографически стойкими случайными байтами.
+ *
+ * @return 1 при успехе, 0 если источник недоступен.
+ */
+int aead_random(unsigned char *buf, size_t size)
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned int v;
+        if (rand_s(&v) != 0)
+            return 0;
+        buf[i] = (unsigned char)v;
+    }
+    return 1;
+#else
+    FILE *f = fopen("/dev/urandom", "rb");
+    if (!f)
+        return 0;
+    size_t n = fread(buf, 1, size, f);
+    fclose(f);
+    return n == size;
+#endif
+}
+
+/**
+ * @brief Выводит ключ и nonce из пароля и соли (PBKDF2, AEAD_ITERATIONS итераций) или берет их из кеша.
+ *
+ * Вывод занимает сотни миллисекунд и выполняется без блокировки, поэтому задания пакета
+ * выводят ключи параллельно.
+ */
+static void aead_derive_key(const char *passphrase, const unsigned char salt[AEAD_SALT], unsigned char key[AEAD_KEY])
+{
+    size_t passLen = strlen(passphrase);
+    unsigned char *idData = malloc(AEAD_SALT + passLen);
+    unsigned char id[32];
+    if (idData)
+    {
+        memcpy(idData, salt, AEAD_SALT);
+        memcpy(idData + AEAD_SALT, passphrase, passLen);
+        sha256(idData, AEAD_SALT + passLen, id);
+        memset(idData, 0, AEAD_SALT + passLen);
+        free(idData);
+
+        pthread_mutex_lock(&keyCacheLock);
+        for (int i = 0; i < AEAD_KEY_CACHE; i++)
+            if (keyCache[i].used && memcmp(keyCache[i].id, id, sizeof(id)) == 0)
+            {
+                memcpy(key, keyCache[i].key, AEAD_KEY);
+                pthread_mutex_unlock(&keyCacheLock);
+                return;
+            }
+        pthread_mutex_unlock(&keyCacheLock);
+    }
+
+    pbkdf2_sha256(passphrase, passLen, salt, AEAD_SALT, AEAD_ITERATIONS, key, AEAD_KEY);
+    if (!idData)
+        return; // без памяти для идентификатора ключ не кешируется
+
+    pthread_mutex_lock(&keyCacheLock);
+    AEAD_CACHED_KEY *entry = &keyCache[keyCacheNext];
+    keyCacheNext = (keyCacheNext + 1) % AEAD_KEY_CACHE;
+    memcpy(entry->id, id, sizeof(id));
+    memcpy(entry->key, key, AEAD_KEY);
+    entry->used = 1;
+    pthread_mutex_unlock(&keyCacheLock);
+}
+
+/**
+ * @brief Шифрует сообщение паролем: соль, шифртекст и тег (AEAD_OVERHEAD байт сверх сообщения).
+ *
+ * @return Зашифрованное сообщение (необходимо освободить) или NULL при ошибке.
+ */
+unsigned char *aead_seal(const char *passphrase, const unsigned char *plain, size_t size, size_t *sealedSize)
+{
+    unsigned char *sealed = malloc(size + AEAD_OVERHEAD);
+    if (!sealed)
+    {
+        fprintf(stderr, "Error: Not enough memory to encrypt the message\n");
+        stats_error(STAT_ERR_MEMORY);
+        return NULL;
+    }
+    if (!aead_random(sealed, AEAD_SALT))
+    {
+        fprintf(stderr, "Error: No random source for the encryption salt\n");
+        stats_error(STAT_ERR_OTHER);
+        free(sealed);
+        return NULL;
+    }
+
+    unsigned char key[AEAD_KEY];
+    aead_derive_key(passphrase, sealed, key);
+    aead_encrypt(key, NULL, 0, plain, size, sealed + AEAD_SALT, sealed + AEAD_SALT + size);
+    memset(key, 0, sizeof(key));
+    *sealedSize = size + AEAD_OVERHEAD;
+    return sealed;
+}
+
+/**
+ * @brief Проверяет и расшифровывает сообщение, зашифрованное aead_seal.
+ *
+ * @return Сообщение с завершающим нулем (необходимо освободить) или NULL, если пароль неверен
+ * или сообщение повреждено.
+ */
+unsigned char *aead_open(const char *passphrase, const unsigned char *sealed, size_t size, size_t *plainSize)
+{
+    if (size < AEAD_OVERHEAD)
+    {
+        fprintf(stderr, "Error: Encrypted message is too short\n");
+        stats_error(STAT_ERR_PAYLOAD);
+        return NULL;
+    }
+    size_t n = size - AEAD_OVERHEAD;
+    unsigned char *plain = malloc(n + 1);
+    if (!plain)
+    {
+        fprintf(stderr, "Error: Not enough memory to decrypt the message\n");
+        stats_error(STAT_ERR_MEMORY);
+        return NULL;
+    }
+
+    unsigned char key[AEAD_KEY];
+    aead_derive_key(passphrase, sealed, key);
+    int ok = aead_decrypt(key, NULL, 0, sealed + AEAD_SALT, n, sealed + AEAD_SALT + n, plain);
+    memset(key, 0, sizeof(key));
+    if (!ok)
+    {
+        fprintf(stderr, "Error: Wrong passphrase or the encrypted message is damaged\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        free(plain);
+        return NULL;
+    }
+    plain[n] = '\0';
+    *plainSize = n;
+    return plain;
+}
+
+/**
+ * @brief Читает пароль из первой строки файла (без перевода строки).
+ *
+ * @return Пароль (необходимо освободить) или NULL при ошибке.
+ */
+char *aead_read_passphrase(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    char *passphrase = malloc(AEAD_MAX_PASSPHRASE + 2);
+    if (!f || !passphrase || !fgets(passphrase, AEAD_MAX_PASSPHRASE + 2, f))
+    {
+        fprintf(stderr, "Error: Cannot read passphrase file %s\n", filename);
+        stats_error(STAT_ERR_KEY_MISSING);
+        if (f)
+            fclose(f);
+        free(passphrase);
+        return NULL;
+    }
+    fclose(f);
+    passphrase[strcspn(passphrase, "\r\n")] = '\0';
+    if (passphrase[0] == '\0' || strlen(passphrase) > AEAD_MAX_PASSPHRASE)
+    {
+        fprintf(stderr, "Error: Passphrase in %s must be 1 to %d bytes long\n", filename, AEAD_MAX_PASSPHRASE);
+        stats_error(STAT_ERR_KEY_INVALID);
+        free(passphrase);
+        return NULL;
+    }
+    return passphrase;
+}
+
+/**
+ * @brief Шифрует текстовое сообщение паролем для методов, которые встраивают строку.
+ *
+ * Результат aead_seal (соль, шифртекст и тег) записывается в Base64: в нем нет нулевых
+ * байтов, поэтому его встраивают и извлекают все методы и задания пакета без изменений,
+ * а длина ключа - это длина строки. Base64 увеличивает сообщение на треть.
+ *
+ * @return Строка Base64 (необходимо освободить) или NULL при ошибке.
+ */
+char *aead_seal_text(const char *passphrase, const char *text)
+{
+    size_t size;
+    unsigned char *sealed = aead_seal(passphrase, (const unsigned char *)text, strlen(text), &size);
+    if (!sealed)
+        return NULL;
+
+    char *out = malloc((size + 2) / 3 * 4 + 1);
+    if (!out)
+    {
+        fprintf(stderr, "Error: Not enough memory to encrypt the message\n");
+        stats_error(STAT_ERR_MEMORY);
+        free(sealed);
+        return NULL;
+    }
+    char *p = out;
+    for (size_t i = 0; i < size; i += 3)
+    {
+        unsigned int v = (unsigned int)sealed[i] << 16 | (i + 1 < size ? (unsigned int)sealed[i + 1] << 8 : 0) |
+                         (i + 2 < size ? sealed[i + 2] : 0);
+        *p++ = base64Alphabet[v >> 18];
+        *p++ = base64Alphabet[v >> 12 & 63];
+        *p++ = i + 1 < size ? base64Alphabet[v >> 6 & 63] : '=';
+        *p++ = i + 2 < size ? base64Alphabet[v & 63] : '=';
+    }
+    *p = '\0';
+    free(sealed);
+    return out;
+}
+
+/**
+ * @brief Проверяет и расшифровывает сообщение, зашифрованное aead_seal_text.
+ *
+ * @return Сообщение (необходимо освободить) или NULL, если строка не Base64, пароль неверен
+ * или сообщение повреждено.
+ */
+char *aead_open_text(const char *passphrase, const char *sealed)
+{
+    size_t len = strlen(sealed), size = 0;
+    unsigned char *bytes = len % 4 == 0 ? malloc(len / 4 * 3 + 1) : NULL;
+    int valid = bytes != NULL;
+    for (size_t i = 0; valid && i < len; i += 4)
+    {
+        unsigned int v = 0;
+        int pad = 0;
+        for (int k = 0; k < 4 && valid; k++)
+        {
+            const char *c = sealed[i + k] ? strchr(base64Alphabet, sealed[i + k]) : NULL;
+            if (sealed[i + k] == '=' && i + 4 == len && k >= 2 && (k == 3 || sealed[i + 3] == '='))
+                pad++;
+            else
+                valid = c && !pad;
+            v = v << 6 | (c ? (unsigned int)(c - base64Alphabet) : 0);
+        }
+        bytes[size++] = (unsigned char)(v >> 16);
+        if (pad < 2)
+            bytes[size++] = (unsigned char)(v >> 8);
+        if (pad < 1)
+            bytes[size++] = (unsigned char)v;
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "Error: Message is not encrypted with a passphrase\n");
+        stats_error(STAT_ERR_PAYLOAD);
+        free(bytes);
+        return NULL;
+    }
+
+    size_t plainSize;
+    char *plain = (char *)aead_open(passphrase, bytes, size, &plainSize);
+    free(bytes);
+    return plain;
+}
+
+/**
+ * @brief Расшифровывает извлеченное сообщение, если задан пароль (иначе возвращает его без изменений).
+ *
+ * @param message Сообщение, извлеченное декодером (освобождается), или NULL.
+ * @return Расшифрованное сообщение (необходимо освободить) или NULL при ошибке.
+ */
+char *aead_open_message(char *message, const char *passphrase)
+{
+    if (!message || !passphrase)
+        return message;
+    char *plain = aead_open_text(passphrase, message);
+    free(message);
+    return plain;
+}
+
+/**
+ * @brief Задает пароль глобального параметра --passphrase-file (владение строкой передается).
+ */
+void aead_set_passphrase(char *passphrase)
+{
+    free(globalPassphrase);
+    globalPassphrase = passphrase;
+}
+
+/**
+ * @brief Пароль глобального параметра --passphrase-file или NULL, если он не задан.
+ */
+const char *aead_passphrase()
+{
+    return globalPassphrase;
+}
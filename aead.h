@@ -0,0 +1,36 @@
+#ifndef AEAD_H
+#define AEAD_H
+
+#include <stddef.h>
+
+// Зашифрованное сообщение: соль PBKDF2 (16 байт), шифртекст ChaCha20 и тег Poly1305 (16 байт).
+// Ключ и nonce ChaCha20-Poly1305 (RFC 8439) выводятся из пароля и соли PBKDF2-HMAC-SHA256
+#define AEAD_SALT 16
+#define AEAD_TAG 16
+#define AEAD_OVERHEAD (AEAD_SALT + AEAD_TAG)
+#define AEAD_KEY 44 // ключ (32 байта) и nonce (12 байт)
+#define AEAD_ITERATIONS 100000
+#define AEAD_MAX_PASSPHRASE 1024
+
+void sha256(const void *data, size_t size, unsigned char digest[32]);
+void pbkdf2_sha256(const char *passphrase, size_t passLen, const unsigned char *salt, size_t saltLen,
+                   unsigned int iterations, unsigned char *out, size_t outLen);
+void chacha20_xor(const unsigned char key[32], const unsigned char nonce[12], unsigned int counter,
+                  const unsigned char *in, unsigned char *out, size_t size);
+void chacha20_block(const unsigned char key[32], const unsigned char nonce[12], unsigned int counter,
+                    unsigned char block[64]);
+void aead_encrypt(const unsigned char key[AEAD_KEY], const unsigned char *aad, size_t aadLen,
+                  const unsigned char *plain, size_t size, unsigned char *cipher, unsigned char tag[AEAD_TAG]);
+int aead_decrypt(const unsigned char key[AEAD_KEY], const unsigned char *aad, size_t aadLen,
+                 const unsigned char *cipher, size_t size, const unsigned char tag[AEAD_TAG], unsigned char *plain);
+int aead_random(unsigned char *buf, size_t size);
+unsigned char *aead_seal(const char *passphrase, const unsigned char *plain, size_t size, size_t *sealedSize);
+unsigned char *aead_open(const char *passphrase, const unsigned char *sealed, size_t size, size_t *plainSize);
+char *aead_read_passphrase(const char *filename);
+char *aead_seal_text(const char *passphrase, const char *text);
+char *aead_open_text(const char *passphrase, const char *sealed);
+char *aead_open_message(char *message, const char *passphrase);
+void aead_set_passphrase(char *passphrase);
+const char *aead_passphrase();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bmpinfo.h"
+#include "walk.h"
+#include "analysis.h"
+
+#define TILE_BYTES (256 * 1024)
+#define SPA_LANES 48 // 3 вектора по 16 байт: период, кратный 3 каналам
+
+// Пороги, начиная с которых изображение считается подозрительным
+#define CHI_SUSPICIOUS 0.95
+#define SPA_SUSPICIOUS 0.3
+
+typedef struct
+{
+    unsigned long long hist[3][256];   // гистограммы каналов B, G, R
+    unsigned long long x[3], y[3], k[3]; // счетчики пар соседних пикселей для SPA
+    unsigned long long pairs[3];
+    double tileMaxP[3]; // максимум p-value хи-квадрат по тайлам
+} ANALYSIS_STATS;
+
+typedef struct
+{
+    long long files, suspicious, skipped;
+    pthread_mutex_t lock;
+} ANALYSIS_CTX;
+
+/**
+ * @brief Верхняя регуляризованная неполная гамма-функция Q(a, x).
+ *
+ * Для x < a + 1 используется ряд, иначе цепная дробь.
+ */
+static double gamma_q(double a, double x)
+{
+    if (x <= 0)
+        return 1.0;
+
+    double lg = lgamma(a);
+
+    if (x < a + 1)
+    {
+        double sum = 1.0 / a, term = sum;
+        for (int n = 1; n < 1000; n++)
+        {
+            term *= x / (a + n);
+            sum += term;
+            if (fabs(term) < fabs(sum) * 1e-12)
+                break;
+        }
+        return 1.0 - sum * exp(-x + a * log(x) - lg);
+    }
+
+    double b = x + 1 - a, c = 1e300, d = 1 / b, h = d;
+    for (int n = 1; n < 1000; n++)
+    {
+        double an = -n * (n - a);
+        b += 2;
+        d = an * d + b;
+        if (fabs(d) < 1e-300)
+            d = 1e-300;
+        c = b + an / c;
+        if (fabs(c) < 1e-300)
+            c = 1e-300;
+        d = 1 / d;
+        double delta = d * c;
+        h *= delta;
+        if (fabs(delta - 1) < 1e-12)
+            break;
+    }
+    return exp(-x + a * log(x) - lg) * h;
+}
+
+/**
+ * @brief Атака хи-квадрат (Вестфельд-Пфитцманн) по гистограмме канала.
+ *
+ * Встраивание в младший бит выравнивает частоты значений в парах (2k, 2k+1).
+ * Возвращает вероятность того, что частоты в парах равны: близкое к 1
+ * значение говорит о заполненной сообщением плоскости младших бит.
+ *
+ * @param hist Гистограмма из 256 значений.
+ * @return p-value в диапазоне [0, 1].
+ */
+static double chi_square_p(const unsigned long long *hist)
+{
+    double chi = 0;
+    int df = -1;
+
+    for (int v = 0; v < 256; v += 2)
+    {
+        double expected = (hist[v] + hist[v + 1]) / 2.0;
+        if (expected <= 4) // слишком мало наблюдений в паре
+            continue;
+
+        double d = hist[v] - expected;
+        chi += d * d / expected;
+        df++;
+    }
+
+    if (df < 1)
+        return 0;
+
+    return gamma_q(df / 2.0, chi / 2.0);
+}
+
+/**
+ * @brief Анализ пар отсчетов (SPA, Dumitrescu-Wu-Wang): оценка доли измененных младших бит.
+ *
+ * Решается квадратное уравнение относительно доли измененных младших бит q;
+ * доля отсчетов, несущих сообщение, равна 2q (половина встроенных бит совпадает
+ * с исходными). При отрицательном дискриминанте берется вершина параболы.
+ *
+ * @return Оценка доли отсчетов канала, несущих сообщение (0 - встраивания нет, 1 - заполнен весь канал).
+ */
+static double spa_estimate(unsigned long long x, unsigned long long y, unsigned long long k,
+                           unsigned long long pairs)
+{
+    if (k == 0)
+        return 0;
+
+    double a = 2.0 * k;
+    double b = 2.0 * (2.0 * x - (double)pairs);
+    double c = (double)y - (double)x;
+    double disc = b * b - 4 * a * c;
+    double q = disc < 0 ? -b / (2 * a) : (-b - sqrt(disc)) / (2 * a);
+
+    if (q <= 0)
+        return 0;
+    return q >= 0.5 ? 1.0 : 2 * q;
+}
+
+/**
+ * @brief Гистограммы каналов строки BGR.
+ *
+ * Используются 4 независимые копии гистограмм, чтобы соседние пиксели с одинаковым
+ * значением не создавали зависимость по памяти между итерациями.
+ */
+static void histogram_row(const unsigned char *row, int width, unsigned int sub[4][3][256])
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4, row += 12)
+    {
+        sub[0][0][row[0]]++;
+        sub[0][1][row[1]]++;
+        sub[0][2][row[2]]++;
+        sub[1][0][row[3]]++;
+        sub[1][1][row[4]]++;
+        sub[1][2][row[5]]++;
+        sub[2][0][row[6]]++;
+        sub[2][1][row[7]]++;
+        sub[2][2][row[8]]++;
+        sub[3][0][row[9]]++;
+        sub[3][1][row[10]]++;
+        sub[3][2][row[11]]++;
+    }
+    for (; x < width; x++, row += 3)
+    {
+        sub[0][0][row[0]]++;
+        sub[0][1][row[1]]++;
+        sub[0][2][row[2]]++;
+    }
+}
+
+/**
+ * @brief Подсчет пар SPA для байтов строки начиная с позиции from (скалярная версия).
+ *
+ * Пара - это один и тот же канал двух соседних пикселей: байты j и j + 3.
+ */
+static void spa_row_scalar(const unsigned char *row, int from, int rowBytes, ANALYSIS_STATS *st)
+{
+    for (int j = from; j + 3 < rowBytes; j++)
+    {
+        int r = row[j], s = row[j + 3], c = j % 3;
+        int lt = r < s, gt = r > s, odd = s & 1;
+
+        st->x[c] += odd ? gt : lt;
+        st->y[c] += odd ? lt : gt;
+        st->k[c] += (r >> 1) == (s >> 1);
+    }
+}
+
+#ifdef __SSE2__
+typedef struct
+{
+    __m128i x[3], y[3], k[3]; // 8-битные счетчики по полосам
+    int iterations;
+    unsigned long long lx[SPA_LANES], ly[SPA_LANES], lk[SPA_LANES];
+} SPA_ACC;
+
+/**
+ * @brief Переносит 8-битные счетчики SSE2 в 64-битные счетчики полос.
+ */
+static void spa_flush(SPA_ACC *acc)
+{
+    unsigned char tmp[16];
+    for (int v = 0; v < 3; v++)
+    {
+        _mm_storeu_si128((__m128i *)tmp, acc->x[v]);
+        for (int l = 0; l < 16; l++)
+            acc->lx[v * 16 + l] += tmp[l];
+        _mm_storeu_si128((__m128i *)tmp, acc->y[v]);
+        for (int l = 0; l < 16; l++)
+            acc->ly[v * 16 + l] += tmp[l];
+        _mm_storeu_si128((__m128i *)tmp, acc->k[v]);
+        for (int l = 0; l < 16; l++)
+            acc->lk[v * 16 + l] += tmp[l];
+
+        acc->x[v] = acc->y[v] = acc->k[v] = _mm_setzero_si128();
+    }
+    acc->iterations = 0;
+}
+
+/**
+ * @brief Подсчет пар SPA для строки с помощью SSE2, по 48 байт за итерацию.
+ *
+ * 48 байт - три вектора, поэтому полоса l вектора v всегда относится к каналу
+ * (16 * v + l) % 3. Результат для хвоста строки досчитывается скалярно.
+ */
+static void spa_row_sse2(const unsigned char *row, int rowBytes, SPA_ACC *acc, ANALYSIS_STATS *st)
+{
+    const __m128i sign = _mm_set1_epi8((char)0x80);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i high = _mm_set1_epi8((char)0xFE);
+
+    int j = 0;
+    for (; j + SPA_LANES + 3 <= rowBytes; j += SPA_LANES)
+    {
+        for (int v = 0; v < 3; v++)
+        {
+            __m128i r = _mm_loadu_si128((const __m128i *)(row + j + v * 16));
+            __m128i s = _mm_loadu_si128((const __m128i *)(row + j + v * 16 + 3));
+
+            __m128i rs = _mm_xor_si128(r, sign), ss = _mm_xor_si128(s, sign);
+            __m128i lt = _mm_cmpgt_epi8(ss, rs);
+            __m128i gt = _mm_cmpgt_epi8(rs, ss);
+            __m128i odd = _mm_cmpeq_epi8(_mm_and_si128(s, one), one);
+
+            __m128i x = _mm_or_si128(_mm_and_si128(odd, gt), _mm_andnot_si128(odd, lt));
+            __m128i y = _mm_or_si128(_mm_and_si128(odd, lt), _mm_andnot_si128(odd, gt));
+            __m128i k = _mm_cmpeq_epi8(_mm_and_si128(r, high), _mm_and_si128(s, high));
+
+            // маска равна -1, поэтому вычитание увеличивает счетчик на 1
+            acc->x[v] = _mm_sub_epi8(acc->x[v], x);
+            acc->y[v] = _mm_sub_epi8(acc->y[v], y);
+            acc->k[v] = _mm_sub_epi8(acc->k[v], k);
+        }
+
+        if (++acc->iterations == 255)
+            spa_flush(acc);
+    }
+
+    spa_row_scalar(row, j, rowBytes, st);
+}
+#endif
+
+/**
+ * @brief Потоково анализирует пиксели BMP-файла тайлами из нескольких строк.
+ *
+ * Изображение целиком в память не загружается: за раз читается не больше TILE_BYTES.
+ *
+ * @return 1 при успехе, 0 при ошибке чтения или неподдерживаемом формате.
+ */
+static int analyze_file(const char *path, ANALYSIS_STATS *st)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+
+    BMP_HEADER header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || !check_bmp_header(&header) ||
+        fseek(f, header.bfOffBits, SEEK_SET) != 0)
+    {
+        fclose(f);
+        return 0;
+    }
+    setvbuf(f, NULL, _IONBF, 0); // тайлы читаются напрямую в свой буфер
+
+    int width = header.biWidth;
+    int height = abs(header.biHeight);
+    long long rowSize = bmp_row_size(&header);
+    int rowBytes = width * 3;
+
+    long long tileRows = TILE_BYTES / rowSize;
+    if (tileRows < 1)
+        tileRows = 1;
+
+    unsigned char *tile = malloc(tileRows * rowSize);
+    unsigned int(*sub)[3][256] = calloc(4, sizeof(*sub));
+    if (!tile || !sub)
+    {
+        free(tile);
+        free(sub);
+        fclose(f);
+        return 0;
+    }
+
+    memset(st, 0, sizeof(*st));
+#ifdef __SSE2__
+    SPA_ACC acc;
+    memset(&acc, 0, sizeof(acc));
+#endif
+
+    int ok = 1;
+    for (int y = 0; y < height; y += tileRows)
+    {
+        int rows = height - y < tileRows ? height - y : (int)tileRows;
+        if (fread(tile, rowSize, rows, f) != (size_t)rows)
+        {
+            ok = 0;
+            break;
+        }
+
+        memset(sub, 0, 4 * sizeof(*sub));
+        for (int r = 0; r < rows; r++)
+        {
+            const unsigned char *row = tile + r * rowSize;
+            histogram_row(row, width, sub);
+#ifdef __SSE2__
+            spa_row_sse2(row, rowBytes, &acc, st);
+#else
+            spa_row_scalar(row, 0, rowBytes, st);
+#endif
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned long long tileHist[256];
+            for (int v = 0; v < 256; v++)
+            {
+                tileHist[v] = (unsigned long long)sub[0][c][v] + sub[1][c][v] + sub[2][c][v] + sub[3][c][v];
+                st->hist[c][v] += tileHist[v];
+            }
+
+            double p = chi_square_p(tileHist);
+            if (p > st->tileMaxP[c])
+                st->tileMaxP[c] = p;
+
+            st->pairs[c] += (unsigned long long)rows * (width - 1);
+        }
+    }
+
+#ifdef __SSE2__
+    spa_flush(&acc);
+    for (int l = 0; l < SPA_LANES; l++)
+    {
+        st->x[l % 3] += acc.lx[l];
+        st->y[l % 3] += acc.ly[l];
+        st->k[l % 3] += acc.lk[l];
+    }
+#endif
+
+    free(tile);
+    free(sub);
+    fclose(f);
+    return ok;
+}
+
+/**
+ * @brief Обработчик одного файла: выводит статистики и вердикт.
+ */
+static void analyze_visit(const char *path, void *arg)
+{
+    ANALYSIS_CTX *ctx = arg;
+    ANALYSIS_STATS *st = malloc(sizeof(ANALYSIS_STATS));
+
+    if (!st || !analyze_file(path, st))
+    {
+        free(st);
+        pthread_mutex_lock(&ctx->lock);
+        ctx->files++;
+        ctx->skipped++;
+        pthread_mutex_unlock(&ctx->lock);
+        return;
+    }
+
+    double chi[3], spa[3], tileMax = 0;
+    int suspicious = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        chi[c] = chi_square_p(st->hist[c]);
+        spa[c] = spa_estimate(st->x[c], st->y[c], st->k[c], st->pairs[c]);
+        if (st->tileMaxP[c] > tileMax)
+            tileMax = st->tileMaxP[c];
+        if (chi[c] > CHI_SUSPICIOUS || spa[c] > SPA_SUSPICIOUS)
+            suspicious = 1;
+    }
+    free(st);
+
+    pthread_mutex_lock(&ctx->lock);
+    printf("%s\t%.3f %.3f %.3f\t%.3f\t%.4f %.4f %.4f\t%s\n", path, chi[0], chi[1], chi[2], tileMax,
+           spa[0], spa[1], spa[2], suspicious ? "SUSPICIOUS" : "clean");
+    ctx->files++;
+    ctx->suspicious += suspicious;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief Команда analyze: статистический стегоанализ плоскости младших бит.
+ *
+ * Использование: analyze <файл|каталог> [потоки]
+ *
+ * В каталоге перебираются только файлы .bmp (PNG analyze не читает и не считает их пропущенными).
+ * Для каждого 24-битного BMP вычисляются p-value атаки хи-квадрат по каналам B, G, R
+ * (по всему изображению и максимум по тайлам) и оценка доли встраивания методом SPA.
+ * Позволяет находить сообщения методов color и stegano, у которых нет префикса длины.
+ * Максимум по тайлам выводится для поиска локальных вставок, но в вердикте не
+ * учитывается: на шумных участках обычных фотографий он тоже бывает близок к 1.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int analyze(int argc, char *argv[])
+{
+    if (argc < 1)
+    {
+        printf("Usage: analyze <file|directory> [threads]\n");
+        return 1;
+    }
+
+    int threads = argc > 1 ? atoi(argv[1]) : 0;
+
+    ANALYSIS_CTX ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    printf("# file\tchi-square p (B G R)\ttile max p\tSPA rate (B G R)\tverdict\n");
+    int found = walk_tree(argv[0], threads, WALK_BMP, analyze_visit, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+
+    if (found < 0)
+        return 1;
+
+    printf("\nFiles: %lld, suspicious: %lld, skipped (not 24-bit BMP): %lld\n",
+           ctx.files, ctx.suspicious, ctx.skipped);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+int analyze(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
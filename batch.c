@@ -0,0 +1,846 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "pool.h"
+#include "prom.h"
+#include "json.h"
+#include "metrics.h"
+#include "stats.h"
+#include "simple.h"
+#include "simple_dec.h"
+#include "color.h"
+#include "color_dec.h"
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "cache.h"
+#include "ecc.h"
+#include "aead.h"
+#include "numa.h"
+#include "stream.h"
+#include "batch.h"
+
+#define BATCH_METHODS 6
+
+static const char *const batchMethods[BATCH_METHODS] = {"simple",     "color",     "stegano",
+                                                        "simple_dec", "color_dec", "stegano_dec"};
+
+// Результаты поиска в кеше дешифрования по значениям CACHE_MISS, CACHE_HIT_STAT, CACHE_HIT_CONTENT
+static const char *const cacheResults[3] = {"miss", "hit", "content_hit"};
+
+typedef struct
+{
+    int withMetrics, withStats;
+    FILE *out; // строки JSON с результатами заданий (исходный stdout)
+    long long jobs, failed;
+    STATS total;                            // сумма статистики всех заданий
+    STATS_HIST *methodLatency;              // BATCH_METHODS гистограмм задержки заданий по методам
+    STATS_HIST *phaseLatency;               // STAT_PHASES гистограмм длительности фаз
+    long long methodJobs[BATCH_METHODS][2]; // успешные и неудачные задания по методам
+    long long errors[STAT_ERRORS];          // неудачные задания по причинам
+    DECODE_CACHE *cache;                    // кеш результатов дешифрования или NULL
+    long long cacheLookups[3];              // задания дешифрования по результату поиска в кеше (CACHE_MISS...)
+    int queued, running;                    // задания в очереди пула и выполняющиеся
+    long long lastRender, lastJobs, lastBytes;
+    double jobRate, byteRate;               // скорости за период между последними выводами метрик
+    long long nodeJobs[NUMA_MAX_NODES];     // задания по узлам NUMA выполнявших их потоков
+    long long nodeBytes[NUMA_MAX_NODES];    // прочитанные и записанные этими заданиями байты
+    long long nodeNs[NUMA_MAX_NODES];       // суммарная задержка этих заданий
+    pthread_mutex_t lock;
+} BATCH_CTX;
+
+/**
+ * @brief Добавляет статистику задания к сводной статистике пакета (под блокировкой ctx->lock).
+ */
+static void batch_record_stats(BATCH_CTX *ctx, int method, const STATS *st, long long latency)
+{
+    if (method >= 0)
+        stats_hist_record(&ctx->methodLatency[method], latency);
+
+    for (int p = 0; p < STAT_PHASES; p++)
+    {
+        if (st->phaseNs[p])
+            stats_hist_record(&ctx->phaseLatency[p], st->phaseNs[p]);
+        ctx->total.phaseNs[p] += st->phaseNs[p];
+    }
+    for (int c = 0; c < STAT_COUNTERS; c++)
+        ctx->total.counters[c] += st->counters[c];
+    for (int e = 0; e < PERF_EVENTS; e++)
+        ctx->total.perf[e] += st->perf[e];
+    ctx->total.perfMask |= st->perfMask;
+}
+
+/**
+ * @brief Выводит метрики пакета в текстовом формате Prometheus.
+ */
+static void batch_render(FILE *out, void *arg)
+{
+    BATCH_CTX *ctx = arg;
+    long long now = stats_now();
+
+    pthread_mutex_lock(&ctx->lock);
+    long long bytes = ctx->total.counters[STAT_BYTES_READ] + ctx->total.counters[STAT_BYTES_WRITTEN];
+    if (now - ctx->lastRender >= 1000000)
+    {
+        double seconds = (now - ctx->lastRender) / 1e9;
+        ctx->jobRate = (ctx->jobs - ctx->lastJobs) / seconds;
+        ctx->byteRate = (bytes - ctx->lastBytes) / seconds;
+        ctx->lastRender = now;
+        ctx->lastJobs = ctx->jobs;
+        ctx->lastBytes = bytes;
+    }
+
+    prom_family(out, "cipher_jobs_total", "counter", "Finished batch jobs by method and status.");
+    for (int m = 0; m < BATCH_METHODS; m++)
+    {
+        fprintf(out, "cipher_jobs_total{method=\"%s\",status=\"ok\"} %lld\n", batchMethods[m],
+                ctx->methodJobs[m][0]);
+        fprintf(out, "cipher_jobs_total{method=\"%s\",status=\"error\"} %lld\n", batchMethods[m],
+                ctx->methodJobs[m][1]);
+    }
+
+    prom_family(out, "cipher_job_errors_total", "counter", "Failed batch jobs by cause.");
+    for (int e = STAT_ERR_NONE + 1; e < STAT_ERRORS; e++)
+        fprintf(out, "cipher_job_errors_total{cause=\"%s\"} %lld\n", statErrorNames[e], ctx->errors[e]);
+
+    if (ctx->cache)
+    {
+        prom_family(out, "cipher_decode_cache_lookups_total", "counter", "Decode jobs by decode cache result.");
+        for (int r = CACHE_MISS; r <= CACHE_HIT_CONTENT; r++)
+            fprintf(out, "cipher_decode_cache_lookups_total{result=\"%s\"} %lld\n", cacheResults[r],
+                    ctx->cacheLookups[r]);
+    }
+
+    prom_family(out, "cipher_bytes_read_total", "counter", "Bytes read from images and keys.");
+    fprintf(out, "cipher_bytes_read_total %llu\n", ctx->total.counters[STAT_BYTES_READ]);
+    prom_family(out, "cipher_bytes_written_total", "counter", "Bytes written to images and keys.");
+    fprintf(out, "cipher_bytes_written_total %llu\n", ctx->total.counters[STAT_BYTES_WRITTEN]);
+    prom_family(out, "cipher_ecc_corrected_bytes_total", "counter", "Payload bytes repaired by Reed-Solomon decoding.");
+    fprintf(out, "cipher_ecc_corrected_bytes_total %llu\n", ctx->total.counters[STAT_ECC_CORRECTED]);
+
+    prom_family(out, "cipher_node_jobs_total", "counter", "Finished batch jobs by NUMA node of the worker.");
+    for (int i = 0; i < NUMA_MAX_NODES; i++)
+        if (ctx->nodeJobs[i])
+            fprintf(out, "cipher_node_jobs_total{node=\"%d\"} %lld\n", i, ctx->nodeJobs[i]);
+    prom_family(out, "cipher_node_bytes_total", "counter", "Bytes read and written by jobs by NUMA node.");
+    for (int i = 0; i < NUMA_MAX_NODES; i++)
+        if (ctx->nodeJobs[i])
+            fprintf(out, "cipher_node_bytes_total{node=\"%d\"} %lld\n", i, ctx->nodeBytes[i]);
+    prom_family(out, "cipher_node_busy_seconds_total", "counter", "Time spent executing jobs by NUMA node.");
+    for (int i = 0; i < NUMA_MAX_NODES; i++)
+        if (ctx->nodeJobs[i])
+            fprintf(out, "cipher_node_busy_seconds_total{node=\"%d\"} %.9f\n", i, ctx->nodeNs[i] / 1e9);
+
+    prom_family(out, "cipher_jobs_per_second", "gauge", "Jobs finished per second since the previous scrape.");
+    fprintf(out, "cipher_jobs_per_second %.3f\n", ctx->jobRate);
+    prom_family(out, "cipher_bytes_per_second", "gauge", "Bytes read and written per second since the previous scrape.");
+    fprintf(out, "cipher_bytes_per_second %.3f\n", ctx->byteRate);
+
+    prom_family(out, "cipher_queue_depth", "gauge", "Jobs waiting in the worker pool queue.");
+    fprintf(out, "cipher_queue_depth %d\n", __atomic_load_n(&ctx->queued, __ATOMIC_RELAXED));
+    prom_family(out, "cipher_inflight_jobs", "gauge", "Jobs being executed.");
+    fprintf(out, "cipher_inflight_jobs %d\n", __atomic_load_n(&ctx->running, __ATOMIC_RELAXED));
+    prom_family(out, "cipher_inflight_memory_bytes", "gauge", "Image and message memory held by running jobs.");
+    fprintf(out, "cipher_inflight_memory_bytes %lld\n", stats_inflight_bytes());
+
+    prom_family(out, "cipher_job_duration_seconds", "histogram", "Batch job latency by method.");
+    for (int m = 0; m < BATCH_METHODS; m++)
+        prom_histogram(out, "cipher_job_duration_seconds", "method", batchMethods[m], &ctx->methodLatency[m]);
+    prom_family(out, "cipher_phase_duration_seconds", "histogram", "Duration of job phases.");
+    for (int p = 0; p < STAT_PHASES; p++)
+        prom_histogram(out, "cipher_phase_duration_seconds", "phase", statPhaseNames[p], &ctx->phaseLatency[p]);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// Параметры заданий пакета (см. batch_options)
+#define BATCH_OPT_DEPTH 1    // --depth K
+#define BATCH_OPT_ECC 2      // --ecc P
+#define BATCH_OPT_MASK 4     // --mask BGR
+#define BATCH_OPT_ECC_FLAG 8    // --ecc без значения (simple_dec)
+#define BATCH_OPT_PASSPHRASE 16 // --passphrase-file файл (все методы)
+
+typedef struct
+{
+    int depth, parity, mask, ecc;
+    char arg[300];            // позиционный аргумент: шаг стеганографии или ключ
+    char passphraseFile[300]; // файл пароля задания ("" - глобальный --passphrase-file)
+} BATCH_OPTIONS;
+
+/**
+ * @brief Выделяет очередное слово строки задания.
+ *
+ * @return 1 если слово прочитано, 0 в конце строки, -1 если слово длиннее size - 1 символов.
+ */
+static int batch_token(const char **p, char *out, size_t size)
+{
+    while (**p == ' ' || **p == '\t')
+        (*p)++;
+    size_t len = strcspn(*p, " \t");
+    if (len == 0)
+        return 0;
+    if (len >= size)
+        return -1;
+    memcpy(out, *p, len);
+    out[len] = '\0';
+    *p += len;
+    return 1;
+}
+
+/**
+ * @brief Разбирает параметры задания, которые могут идти в любом порядке.
+ *
+ * Разрешены параметры из allowed (BATCH_OPT_*), --passphrase-file и, если positional, один позиционный
+ * аргумент (шаг стеганографии или ключ); "--" завершает параметры. У заданий
+ * шифрования (text не NULL) остаток строки после них - текст сообщения, у заданий
+ * дешифрования лишнее слово - ошибка, как и неизвестный параметр.
+ *
+ * @return 1 при успехе, 0 при ошибке (сообщение выводится с номером задания).
+ */
+static int batch_options(const char *rest, int job, int allowed, int positional, BATCH_OPTIONS *o,
+                         const char **text)
+{
+    char token[300], value[300];
+    int havePositional = !positional;
+    for (;;)
+    {
+        rest += strspn(rest, " \t");
+        if (text && havePositional && strncmp(rest, "--", 2) != 0)
+        {
+            *text = rest; // текст начинается с первого слова, не являющегося параметром
+            return 1;
+        }
+        int r = batch_token(&rest, token, sizeof(token));
+        if (r == 0)
+        {
+            if (havePositional)
+                return 1;
+            fprintf(stderr, "Error: Missing %s in job %d\n", text ? "step" : "key file", job);
+            break;
+        }
+        if (r < 0)
+        {
+            fprintf(stderr, "Error: Argument too long in job %d\n", job);
+            break;
+        }
+        if (strcmp(token, "--") == 0 && text && havePositional)
+        {
+            *text = rest + strspn(rest, " \t");
+            return 1;
+        }
+        if (strncmp(token, "--", 2) != 0)
+        {
+            if (havePositional)
+            {
+                fprintf(stderr, "Error: Unexpected argument '%s' in job %d\n", token, job);
+                break;
+            }
+            strcpy(o->arg, token);
+            havePositional = 1;
+            continue;
+        }
+
+        int option = strcmp(token, "--depth") == 0             ? BATCH_OPT_DEPTH
+                     : strcmp(token, "--mask") == 0            ? BATCH_OPT_MASK
+                     : strcmp(token, "--passphrase-file") == 0 ? BATCH_OPT_PASSPHRASE
+                     : strcmp(token, "--ecc") != 0             ? 0
+                     : allowed & BATCH_OPT_ECC_FLAG            ? BATCH_OPT_ECC_FLAG
+                                                               : BATCH_OPT_ECC;
+        if (!(option & (allowed | BATCH_OPT_PASSPHRASE)))
+        {
+            fprintf(stderr, "Error: Unknown option '%s' in job %d\n", token, job);
+            break;
+        }
+        if (option == BATCH_OPT_ECC_FLAG)
+        {
+            o->ecc = 1;
+            continue;
+        }
+        if (batch_token(&rest, value, sizeof(value)) != 1)
+        {
+            fprintf(stderr, "Error: Option %s needs a value in job %d\n", token, job);
+            break;
+        }
+        if (option == BATCH_OPT_PASSPHRASE)
+        {
+            strcpy(o->passphraseFile, value);
+            continue;
+        }
+
+        char *end;
+        long number = strtol(value, &end, 10);
+        int valid = *end == '\0';
+        if (option == BATCH_OPT_DEPTH)
+            valid = valid && number >= 1 && number <= SIMPLE_MAX_DEPTH && (o->depth = (int)number);
+        else if (option == BATCH_OPT_ECC)
+            valid = valid && ecc_valid_parity((int)number) && (o->parity = (int)number);
+        else
+            valid = (o->mask = stegano_parse_mask(value)) != 0;
+        if (!valid)
+        {
+            fprintf(stderr, "Error: Invalid value '%s' for %s in job %d\n", value, token, job);
+            break;
+        }
+    }
+    stats_error(STAT_ERR_JOB);
+    return 0;
+}
+
+/**
+ * @brief Пароль задания: из его --passphrase-file, иначе глобальный (NULL - сообщение не шифруется).
+ *
+ * @param owned Указатель для пароля, прочитанного из файла задания (освобождается вызывающей стороной).
+ * @return 1 при успехе, 0 если файл пароля не прочитан.
+ */
+static int batch_passphrase(const BATCH_OPTIONS *o, char **owned, const char **passphrase)
+{
+    *owned = NULL;
+    *passphrase = aead_passphrase();
+    if (o->passphraseFile[0])
+        *passphrase = *owned = aead_read_passphrase(o->passphraseFile);
+    return *passphrase || !o->passphraseFile[0];
+}
+
+/**
+ * @brief Шифрует текст задания шифрования паролем, если он задан (см. aead_seal_text).
+ *
+ * @param text Указатель на текст; при шифровании заменяется строкой sealed.
+ * @param sealed Указатель для зашифрованного текста (освобождается вызывающей стороной).
+ * @return 1 при успехе, 0 при ошибке.
+ */
+static int batch_seal(const BATCH_OPTIONS *o, const char **text, char **sealed)
+{
+    char *owned;
+    const char *passphrase;
+    *sealed = NULL;
+    if (!batch_passphrase(o, &owned, &passphrase))
+        return 0;
+    if (passphrase && (*sealed = aead_seal_text(passphrase, *text)))
+        *text = *sealed;
+    free(owned);
+    return !passphrase || *sealed;
+}
+
+/**
+ * @brief Расшифровывает сообщение задания дешифрования паролем, если он задан (см. aead_open_message).
+ */
+static char *batch_open(const BATCH_OPTIONS *o, char *message)
+{
+    char *owned;
+    const char *passphrase;
+    if (!message || !batch_passphrase(o, &owned, &passphrase))
+    {
+        free(message);
+        return NULL;
+    }
+    message = aead_open_message(message, passphrase);
+    free(owned);
+    return message;
+}
+
+/**
+ * @brief Выполняет одно задание пакета и выводит результат строкой JSON.
+ *
+ * Элемент очереди имеет вид "<номер>\t<строка задания>".
+ */
+static void batch_job(const char *item, void *arg)
+{
+    BATCH_CTX *ctx = arg;
+    char method[32] = "", input[256] = "", output[256] = "", keyFile[300] = "";
+    char *message = NULL;
+    int job = 0, step = 0, ok = 0, hit = -1;
+    DISTORTION dist;
+    DISTORTION *d = ctx->withMetrics ? &dist : NULL;
+    STATS st;
+
+    __atomic_sub_fetch(&ctx->queued, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx->running, 1, __ATOMIC_RELAXED);
+    distortion_init(&dist);
+    // статистика собирается всегда: из нее берутся причина ошибки и объем памяти задания
+    memset(&st, 0, sizeof(st));
+    stats_attach(&st);
+    long long start = stats_now();
+
+    const char *rest = item;
+    BATCH_OPTIONS o = {1, 0, STEGANO_DEFAULT_MASK, 0, "", ""};
+    const char *text = NULL;
+    char *sealed = NULL;
+    job = (int)strtol(item, (char **)&rest, 10);
+    int parsed = batch_token(&rest, method, sizeof(method)) == 1 && batch_token(&rest, input, sizeof(input)) == 1;
+    if (parsed && (strcmp(method, "simple") == 0 || strcmp(method, "color") == 0 || strcmp(method, "stegano") == 0))
+    {
+        parsed = batch_token(&rest, output, sizeof(output)) == 1;
+        if (parsed)
+            snprintf(keyFile, sizeof(keyFile), "%s.key", output);
+        else
+            output[0] = '\0';
+    }
+
+    if (!parsed)
+    {
+        fprintf(stderr, "Error: Incomplete or too long arguments in job %d\n", job);
+        stats_error(STAT_ERR_JOB);
+    }
+    else if (strcmp(method, "simple") == 0)
+    {
+        if (batch_options(rest, job, BATCH_OPT_DEPTH | BATCH_OPT_ECC, 0, &o, &text) && batch_seal(&o, &text, &sealed))
+        {
+            size_t len = strlen(text);
+            unsigned char *coded =
+                o.parity ? ecc_encode_simple((const unsigned char *)text, len, o.parity, o.depth, &len) : NULL;
+            int imageSize = 0;
+            if (!o.parity || coded)
+                imageSize = simple_encode_bytes(input, output, coded ? coded : (const unsigned char *)text, (int)len,
+                                                o.depth, d);
+            ok = imageSize && saveSimpleKey(keyFile, (int)len, imageSize);
+            free(coded);
+        }
+    }
+    else if (strcmp(method, "color") == 0)
+    {
+        int startX, startY;
+        ok = batch_options(rest, job, 0, 0, &o, &text) && batch_seal(&o, &text, &sealed) &&
+             color_encode(input, output, text, &startX, &startY, d) &&
+             saveColorKey(keyFile, startX, startY, (int)strlen(text));
+    }
+    else if (strcmp(method, "stegano") == 0)
+    {
+        char *end;
+        if (batch_options(rest, job, BATCH_OPT_MASK | BATCH_OPT_ECC, 1, &o, &text) &&
+            ((step = (int)strtol(o.arg, &end, 10)) <= 0 || *end != '\0'))
+        {
+            fprintf(stderr, "Error: Invalid step '%s' in job %d\n", o.arg, job);
+            stats_error(STAT_ERR_JOB);
+        }
+        else if (text && batch_seal(&o, &text, &sealed))
+        {
+            size_t len = strlen(text);
+            unsigned char *coded = o.parity ? ecc_encode((const unsigned char *)text, len, o.parity, &len) : NULL;
+            ok = (!o.parity || coded) &&
+                 stegano_encode_bytes(input, output, coded ? (char *)coded : text, len, step, o.mask, d) &&
+                 save_stegano_key_ecc(keyFile, step, len, o.mask, o.parity);
+            free(coded);
+        }
+    }
+    else if (strcmp(method, "simple_dec") == 0)
+    {
+        if (batch_options(rest, job, BATCH_OPT_ECC_FLAG, 0, &o, NULL))
+        {
+            if (ctx->cache)
+                message = cache_decode(ctx->cache, o.ecc ? CACHE_SIMPLE_ECC : CACHE_SIMPLE, input, NULL, &hit);
+            else
+                message = o.ecc ? ecc_simple_decode(input, NULL) : simple_decode(input);
+            ok = (message = batch_open(&o, message)) != NULL;
+        }
+    }
+    else if (strcmp(method, "color_dec") == 0 || strcmp(method, "stegano_dec") == 0)
+    {
+        if (batch_options(rest, job, 0, 1, &o, NULL))
+        {
+            strcpy(keyFile, o.arg);
+            if (ctx->cache)
+                message = cache_decode(ctx->cache, method[0] == 'c' ? CACHE_COLOR : CACHE_STEGANO, input, keyFile,
+                                       &hit);
+            else
+                message = method[0] == 'c' ? color_decode(input, keyFile) : stegano_decode(input, keyFile);
+            ok = (message = batch_open(&o, message)) != NULL;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Error: Unknown batch method '%s' in job %d\n", method, job);
+        stats_error(STAT_ERR_JOB);
+    }
+
+    int encode = output[0] != '\0';
+    long long latency = stats_now() - start;
+    stats_attach(NULL);
+    int node = numa_node();
+
+    int m = BATCH_METHODS - 1;
+    while (m >= 0 && strcmp(method, batchMethods[m]) != 0)
+        m--;
+    STAT_ERROR cause = ok ? STAT_ERR_NONE : st.error ? st.error : STAT_ERR_OTHER;
+
+    pthread_mutex_lock(&ctx->lock);
+    fprintf(ctx->out, "{\"job\":%d,\"method\":", job);
+    json_print_string(ctx->out, method);
+    fprintf(ctx->out, ",\"input\":");
+    json_print_string(ctx->out, input);
+    if (encode)
+    {
+        fprintf(ctx->out, ",\"output\":");
+        json_print_string(ctx->out, output);
+        fprintf(ctx->out, ",\"key\":");
+        json_print_string(ctx->out, keyFile);
+    }
+    fprintf(ctx->out, ",\"status\":\"%s\"", ok ? "ok" : "error");
+    if (!ok)
+        fprintf(ctx->out, ",\"error\":\"%s\"", statErrorNames[cause]);
+    if (ok && message)
+    {
+        fprintf(ctx->out, ",\"message\":");
+        json_print_string(ctx->out, message);
+    }
+    if (ok && st.counters[STAT_ECC_CORRECTED])
+        fprintf(ctx->out, ",\"ecc_corrected\":%llu", st.counters[STAT_ECC_CORRECTED]);
+    if (hit >= 0)
+        fprintf(ctx->out, ",\"cache\":\"%s\"", cacheResults[hit]);
+    if (ok && encode && d && d->samples) // метрики считаются только для 24-битных изображений
+    {
+        fprintf(ctx->out, ",\"metrics\":");
+        distortion_print_json(ctx->out, d);
+    }
+    if (ctx->withStats)
+    {
+        if (node >= 0)
+            fprintf(ctx->out, ",\"node\":%d", node);
+        fprintf(ctx->out, ",\"latency_ns\":%lld,\"stats\":", latency);
+        stats_print_json(ctx->out, &st);
+    }
+    fprintf(ctx->out, "}\n");
+    fflush(ctx->out);
+
+    if (ctx->methodLatency)
+        batch_record_stats(ctx, m, &st, latency);
+    if (m >= 0)
+        ctx->methodJobs[m][!ok]++;
+    if (hit >= 0)
+        ctx->cacheLookups[hit]++;
+    ctx->errors[cause]++;
+    if (node >= 0 && node < NUMA_MAX_NODES)
+    {
+        ctx->nodeJobs[node]++;
+        ctx->nodeBytes[node] += st.counters[STAT_BYTES_READ] + st.counters[STAT_BYTES_WRITTEN];
+        ctx->nodeNs[node] += latency;
+    }
+    ctx->jobs++;
+    ctx->failed += !ok;
+    pthread_mutex_unlock(&ctx->lock);
+
+    free(message);
+    free(sealed);
+    stats_release(st.counters[STAT_ALLOC_BYTES]);
+    __atomic_sub_fetch(&ctx->running, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Читает строку файла заданий любой длины, увеличивая буфер.
+ *
+ * @return Длина строки (перевод строки отбрасывается), -1 в конце файла, -2 если не хватило памяти.
+ */
+static long long batch_read_line(FILE *f, char **line, size_t *size)
+{
+    size_t len = 0;
+    for (;;)
+    {
+        if (*size - len < 2)
+        {
+            size_t grown = *size ? *size * 2 : 1024;
+            char *p = realloc(*line, grown);
+            if (!p)
+                return -2;
+            *line = p;
+            *size = grown;
+        }
+        if (!fgets(*line + len, (int)(*size - len < INT_MAX ? *size - len : INT_MAX), f))
+        {
+            if (!len)
+                return -1;
+            break;
+        }
+        len += strlen(*line + len);
+        if (len && (*line)[len - 1] == '\n')
+            break;
+    }
+    (*line)[strcspn(*line, "\r\n")] = '\0';
+    return (long long)strlen(*line);
+}
+
+/**
+ * @brief Возвращает stdout на место после выполнения заданий (см. batch).
+ */
+static void batch_restore_stdout(BATCH_CTX *ctx)
+{
+    if (ctx->out == stdout)
+        return;
+    fflush(stdout);
+    fflush(ctx->out);
+    dup2(fileno(ctx->out), fileno(stdout));
+    fclose(ctx->out);
+    ctx->out = stdout;
+}
+
+static void batch_usage(void)
+{
+    printf("Usage: batch <jobfile|-> [--metrics] [--stats] [--perf] [--threads N]\n"
+           "             [--prom-listen addr] [--prom-file path [--prom-interval sec]]\n"
+           "             [--cache file [--cache-entries N]]\n");
+}
+
+/**
+ * @brief Команда batch: выполняет пакет заданий шифрования и дешифрования.
+ *
+ * Использование: batch <файл_заданий|-> [--metrics] [--stats] [--perf] [--threads N]
+ *                     [--prom-listen адрес] [--prom-file файл [--prom-interval с]]
+ *                     [--cache файл [--cache-entries N]]
+ *
+ * Каждая строка файла заданий описывает одно задание (пустые строки и строки,
+ * начинающиеся с '#', пропускаются):
+ *   simple <вход.bmp> <выход.bmp> [--depth K] [--ecc P] <текст>
+ *   color <вход.bmp> <выход.bmp> <текст>
+ *   stegano <вход.bmp> <выход.bmp> <шаг> [--mask BGR] [--ecc P] <текст>
+ *   simple_dec <вход.bmp> [--ecc]
+ *   color_dec <вход.bmp> <ключ>
+ *   stegano_dec <вход.bmp> <ключ>
+ * Ключ задания шифрования сохраняется в файл "<выход.bmp>.key". Параметры и шаг идут в
+ * любом порядке перед текстом, "--" завершает параметры; неизвестный параметр или
+ * лишнее слово в задании дешифрования - ошибка задания. Длина строки не ограничена.
+ * Параметр --passphrase-file файл разрешен у заданий всех методов: сообщение шифруется
+ * паролем перед встраиванием или расшифровывается после извлечения (см. aead_seal_text);
+ * без него используется глобальный --passphrase-file.
+ * --ecc P встраивает сообщение с кодом Рида-Соломона RS(255,255-P) (см. ecc_encode, у simple
+ * код защищает и префикс длины - ecc_encode_simple); stegano_dec узнает о коде из ключа,
+ * simple_dec - из флага --ecc, а без него - по заголовку кода, если префикс длины не поврежден
+ * (см. simple_decode). Если код исправил байты, результат задания получает поле
+ * "ecc_corrected". Задания color параметр --ecc не принимают: сообщение подстановки цветов
+ * заканчивается первым нулевым байтом, а закодированное сообщение содержит любые байты.
+ * Задания выполняются параллельно, результат каждого выводится строкой JSON;
+ * с флагом --metrics для заданий шифрования добавляются метрики искажения.
+ * stdout содержит только строки JSON: на время выполнения заданий он перенаправляется
+ * в stderr, и сообщения об ошибках рабочих потоков попадают туда.
+ * Порядок выполнения и вывода заданий не определен, поэтому задания пакета должны быть
+ * независимыми: дешифрование файла, который записывает задание шифрования того же
+ * пакета, может начаться раньше записи - его нужно выполнять следующим пакетом.
+ * С флагом --stats к результату добавляются узел NUMA рабочего потока, задержка и
+ * статистика фаз задания, в итоговую строку - пропускная способность по узлам NUMA,
+ * а перед ней выводятся процентили задержки по методам и по фазам; --perf включает
+ * --stats и добавляет аппаратные счетчики ядер встраивания и извлечения.
+ * Неудачное задание получает поле "error" с причиной ошибки. Неизвестный параметр команды
+ * или параметр без значения, как и в строке задания, - ошибка: пакет не запускается.
+ *
+ * --prom-listen ("[адрес]:порт" или "unix:/путь") отдает по HTTP метрики пакета в
+ * текстовом формате Prometheus: задания по методам и статусам, ошибки по причинам,
+ * байты и скорости, задания и байты по узлам NUMA, глубину очереди, память
+ * выполняющихся заданий и гистограммы задержки. --prom-file раз в --prom-interval секунд (по умолчанию 5) перезаписывает
+ * файл с теми же метриками для textfile collector node_exporter. С файлом заданий "-"
+ * пакет работает как служба, пока не закроется стандартный ввод.
+ *
+ * --cache сохраняет результаты заданий дешифрования в отображенном в память файле
+ * (по умолчанию на 4096 записей с вытеснением давно не использованных, см. cache_decode):
+ * повторное дешифрование неизменившегося файла с тем же ключом не читает изображение.
+ * Результат поиска выводится в поле "cache" задания.
+ *
+ * С глобальным пределом памяти (--max-memory) он делится между рабочими потоками:
+ * каждое задание обрабатывает изображение окнами строк в своей доле.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 если все задания выполнены успешно, иначе 1.
+ */
+int batch(int argc, char *argv[])
+{
+    if (argc < 1)
+    {
+        batch_usage();
+        return 1;
+    }
+
+    BATCH_CTX ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int threads = 0, promInterval = 5;
+    const char *promListen = NULL, *promFile = NULL, *cacheFile = NULL;
+    int cacheEntries = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--metrics") == 0)
+            ctx.withMetrics = 1;
+        else if (strcmp(argv[i], "--stats") == 0)
+            ctx.withStats = 1;
+        else if (strcmp(argv[i], "--perf") == 0)
+        {
+            ctx.withStats = 1;
+            stats_enable_perf();
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--prom-listen") == 0 && i + 1 < argc)
+            promListen = argv[++i];
+        else if (strcmp(argv[i], "--prom-file") == 0 && i + 1 < argc)
+            promFile = argv[++i];
+        else if (strcmp(argv[i], "--prom-interval") == 0 && i + 1 < argc)
+            promInterval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cacheFile = argv[++i];
+        else if (strcmp(argv[i], "--cache-entries") == 0 && i + 1 < argc)
+            cacheEntries = atoi(argv[++i]);
+        else
+        {
+            printf("Error: Unknown batch option or missing value: %s\n", argv[i]);
+            batch_usage();
+            return 1;
+        }
+    }
+    int withProm = promListen || promFile;
+
+    FILE *jobs = strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "r");
+    if (!jobs)
+    {
+        printf("Error: Cannot open job file %s\n", argv[0]);
+        return 1;
+    }
+
+    if (ctx.withStats || withProm)
+    {
+        ctx.methodLatency = calloc(BATCH_METHODS + STAT_PHASES, sizeof(STATS_HIST));
+        if (!ctx.methodLatency)
+        {
+            printf("Error: Not enough memory for statistics\n");
+            if (jobs != stdin)
+                fclose(jobs);
+            return 1;
+        }
+        ctx.phaseLatency = ctx.methodLatency + BATCH_METHODS;
+    }
+
+    srand(time(NULL));
+    pthread_mutex_init(&ctx.lock, NULL);
+    ctx.lastRender = stats_now();
+
+    PROM *prom = NULL;
+    if (withProm)
+    {
+        prom = prom_start(promListen, promFile, promInterval, batch_render, &ctx);
+        if (!prom)
+        {
+            pthread_mutex_destroy(&ctx.lock);
+            if (jobs != stdin)
+                fclose(jobs);
+            free(ctx.methodLatency);
+            return 1;
+        }
+    }
+
+    if (cacheFile && !(ctx.cache = cache_open(cacheFile, cacheEntries)))
+    {
+        prom_stop(prom);
+        pthread_mutex_destroy(&ctx.lock);
+        if (jobs != stdin)
+            fclose(jobs);
+        free(ctx.methodLatency);
+        return 1;
+    }
+
+    if (threads <= 0)
+        threads = pool_threads();
+    stream_set_workers(threads);
+    // строки JSON выводятся в исходный stdout, а stdout на время выполнения заданий
+    // перенаправляется в stderr: сообщения об ошибках, которые методы печатают из рабочих
+    // потоков, не должны попадать между строками JSON
+    fflush(stdout);
+    int resultFd = dup(fileno(stdout));
+    ctx.out = resultFd >= 0 ? fdopen(resultFd, "w") : NULL;
+    if (ctx.out)
+        dup2(fileno(stderr), fileno(stdout));
+    else
+    {
+        if (resultFd >= 0)
+            close(resultFd);
+        ctx.out = stdout;
+    }
+
+    POOL *pool = pool_start(threads, batch_job, &ctx);
+    if (!pool)
+    {
+        batch_restore_stdout(&ctx);
+        cache_close(ctx.cache);
+        prom_stop(prom);
+        pthread_mutex_destroy(&ctx.lock);
+        if (jobs != stdin)
+            fclose(jobs);
+        free(ctx.methodLatency);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t lineSize = 0;
+    int number = 0;
+    long long lineLen;
+    while ((lineLen = batch_read_line(jobs, &line, &lineSize)) != -1)
+    {
+        number++;
+        if (lineLen == -2)
+        {
+            printf("Error: Not enough memory for job line %d\n", number);
+            break;
+        }
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        char *item = malloc(strlen(line) + 16);
+        if (!item)
+            break;
+        sprintf(item, "%d\t%s", number, line);
+        __atomic_add_fetch(&ctx.queued, 1, __ATOMIC_RELAXED);
+        pool_push(pool, item);
+    }
+    free(line);
+
+    pool_finish(pool);
+    batch_restore_stdout(&ctx);
+    prom_stop(prom);
+    cache_close(ctx.cache);
+    pthread_mutex_destroy(&ctx.lock);
+    if (jobs != stdin)
+        fclose(jobs);
+
+    if (ctx.withStats)
+    {
+        for (int m = 0; m < BATCH_METHODS; m++)
+        {
+            if (!ctx.methodLatency[m].count)
+                continue;
+            printf("{\"latency\":{\"method\":\"%s\",\"histogram\":", batchMethods[m]);
+            stats_hist_print_json(stdout, &ctx.methodLatency[m]);
+            printf("}}\n");
+        }
+        for (int p = 0; p < STAT_PHASES; p++)
+        {
+            if (!ctx.phaseLatency[p].count)
+                continue;
+            printf("{\"phase_latency\":{\"phase\":\"%s\",\"histogram\":", statPhaseNames[p]);
+            stats_hist_print_json(stdout, &ctx.phaseLatency[p]);
+            printf("}}\n");
+        }
+    }
+
+    printf("{\"summary\":{\"jobs\":%lld,\"failed\":%lld", ctx.jobs, ctx.failed);
+    if (ctx.withStats)
+    {
+        printf(",\"stats\":");
+        stats_print_json(stdout, &ctx.total);
+        // пропускная способность узла: байты заданий его потоков за время их выполнения
+        printf(",\"nodes\":[");
+        for (int i = 0, first = 1; i < NUMA_MAX_NODES; i++)
+        {
+            if (!ctx.nodeJobs[i])
+                continue;
+            printf("%s{\"node\":%d,\"jobs\":%lld,\"bytes\":%lld,\"busy_ns\":%lld,\"mb_per_s\":%.2f}",
+                   first ? "" : ",", i, ctx.nodeJobs[i], ctx.nodeBytes[i], ctx.nodeNs[i],
+                   ctx.nodeNs[i] ? ctx.nodeBytes[i] / (ctx.nodeNs[i] * 1e-9) / 1e6 : 0.0);
+            first = 0;
+        }
+        printf("]");
+    }
+    printf("}}\n");
+
+    free(ctx.methodLatency);
+    return ctx.failed ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+int batch(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
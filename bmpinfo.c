@@ -0,0 +1,606 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "stats.h"
+#include "png.h"
+#include "bmpinfo.h"
+
+#define BI_RGB 0
+#define BI_BITFIELDS 3
+#define BI_ALPHABITFIELDS 6
+
+/**
+ * @brief Проверяет, что заголовок описывает поддерживаемый 24-битный BMP.
+ *
+ * @param header Указатель на заголовок BMP.
+ * @return 1 если формат поддерживается, иначе 0.
+ */
+int check_bmp_header(const BMP_HEADER *header)
+{
+    if (header->bfType != 0x4D42) // 'BM'
+        return 0;
+
+    if (header->biBitCount != 24 || header->biWidth <= 0 || header->biHeight == 0)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Читает только заголовок BMP-файла, не затрагивая пиксельные данные.
+ *
+ * Файл открывается без буферизации stdio, поэтому с диска читаются только
+ * 54 байта заголовка и маски каналов, а не целая страница данных. Для PNG
+ * заголовок BMP заполняется по блоку IHDR (см. png_read_header).
+ *
+ * @param filename Имя файла BMP или PNG.
+ * @param header Указатель на структуру BMP_HEADER для сохранения заголовка.
+ * @return 1 если формат пикселей поддерживается (см. bmp_parse_format), 0 при ошибке.
+ */
+int read_bmp_header(const char *filename, BMP_HEADER *header)
+{
+    unsigned char prefix[sizeof(BMP_HEADER) + 16];
+    BMP_FORMAT format;
+
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return 0;
+
+    setvbuf(f, NULL, _IONBF, 0);
+    size_t n = fread(prefix, 1, sizeof(prefix), f);
+    fclose(f);
+
+    if (png_signature(prefix, n))
+        return png_read_header(prefix, n, header);
+    if (n < sizeof(BMP_HEADER))
+        return 0;
+    memcpy(header, prefix, sizeof(BMP_HEADER));
+    return bmp_parse_format(prefix, n, &format);
+}
+
+/**
+ * @brief Возвращает количество пикселей изображения.
+ *
+ * @param header Указатель на заголовок BMP.
+ * @return Ширина, умноженная на модуль высоты.
+ */
+long long bmp_pixel_count(const BMP_HEADER *header)
+{
+    return (long long)header->biWidth * llabs((long long)header->biHeight);
+}
+
+/**
+ * @brief Возвращает размер строки пикселей в файле с учетом выравнивания до 4 байт.
+ *
+ * @param header Указатель на заголовок BMP.
+ * @return Размер строки в байтах.
+ */
+long long bmp_row_size(const BMP_HEADER *header)
+{
+    return ((long long)header->biWidth * 3 + 3) & ~3LL;
+}
+
+/**
+ * @brief Возвращает количество каналов, в которые встраиваются данные.
+ *
+ * @param header Указатель на заголовок BMP.
+ * @return 1 для 8-битных изображений (индекс палитры), 3 для 24- и 32-битных (R, G, B).
+ */
+int bmp_channels(const BMP_HEADER *header)
+{
+    return header->biBitCount == 8 ? 1 : 3;
+}
+
+/**
+ * @brief Смещение байта канала по маске BI_BITFIELDS.
+ *
+ * @return Номер байта пикселя (0..3) или -1, если маска не занимает ровно один байт.
+ */
+static int mask_offset(unsigned int mask)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (mask == 0xFFu << (8 * i))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Разбирает заголовки BMP и определяет формат пикселей.
+ *
+ * Поддерживаются 24-битные изображения, 32-битные (BI_RGB - BGRX, BI_BITFIELDS и
+ * BI_ALPHABITFIELDS с масками по целому байту на канал) и 8-битные с палитрой без
+ * сжатия; строки могут храниться снизу вверх или сверху вниз (biHeight < 0).
+ * Заголовки BITMAPV4HEADER и BITMAPV5HEADER допускаются: маски в них лежат там же,
+ * где после BITMAPINFOHEADER.
+ *
+ * @param prefix Начало файла: заголовки и, для BI_BITFIELDS, маски каналов.
+ * @param size Количество байт в prefix.
+ * @param format Указатель для сохранения формата.
+ * @return 1 если формат поддерживается, иначе 0.
+ */
+int bmp_parse_format(const unsigned char *prefix, size_t size, BMP_FORMAT *format)
+{
+    BMP_HEADER header;
+    if (size < sizeof(BMP_HEADER))
+        return 0;
+    memcpy(&header, prefix, sizeof(header));
+
+    if (header.bfType != 0x4D42 || header.biSize < 40 || header.biWidth <= 0 || header.biHeight == 0 ||
+        header.biHeight == INT_MIN || header.bfOffBits < 14 + header.biSize)
+        return 0;
+
+    memset(format, 0, sizeof(*format));
+    format->width = header.biWidth;
+    format->height = header.biHeight < 0 ? -header.biHeight : header.biHeight;
+    format->topDown = header.biHeight < 0;
+    format->bitCount = header.biBitCount;
+    format->dataOffset = header.bfOffBits;
+
+    switch (header.biBitCount)
+    {
+    case 8:
+        if (header.biCompression != BI_RGB)
+            return 0;
+        format->bytesPerPixel = 1;
+        format->channels = 1;
+        break;
+    case 24:
+    case 32:
+        format->bytesPerPixel = header.biBitCount / 8;
+        format->channels = 3;
+        format->offset[0] = 2; // BGR(X)
+        format->offset[1] = 1;
+        format->offset[2] = 0;
+        if (header.biCompression == BI_RGB)
+            break;
+        if (header.biBitCount != 32 ||
+            (header.biCompression != BI_BITFIELDS && header.biCompression != BI_ALPHABITFIELDS))
+            return 0;
+
+        unsigned int masks[3];
+        if (size < sizeof(BMP_HEADER) + sizeof(masks) || header.bfOffBits < sizeof(BMP_HEADER) + sizeof(masks))
+            return 0;
+        memcpy(masks, prefix + sizeof(BMP_HEADER), sizeof(masks));
+        for (int c = 0; c < 3; c++)
+        {
+            format->offset[c] = mask_offset(masks[c]);
+            if (format->offset[c] < 0)
+                return 0;
+        }
+        if (format->offset[0] == format->offset[1] || format->offset[0] == format->offset[2] ||
+            format->offset[1] == format->offset[2])
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    format->rowSize = ((long long)format->width * format->bitCount + 31) / 32 * 4;
+    // ядра методов адресуют пиксельные данные значениями int
+    return format->rowSize * format->height <= INT_MAX;
+}
+
+/**
+ * @brief Заполняет формат 24-битного изображения, записанного снизу вверх.
+ *
+ * @param format Указатель на формат.
+ * @param width Ширина изображения.
+ * @param height Высота изображения.
+ */
+void bmp_format_bgr24(BMP_FORMAT *format, int width, int height)
+{
+    memset(format, 0, sizeof(*format));
+    format->width = width;
+    format->height = height;
+    format->bitCount = 24;
+    format->bytesPerPixel = 3;
+    format->channels = 3;
+    format->offset[0] = 2;
+    format->offset[1] = 1;
+    format->rowSize = ((long long)width * 3 + 3) & ~3LL;
+    format->dataOffset = sizeof(BMP_HEADER);
+}
+
+/**
+ * @brief Размер заголовков BMP вместе с масками или палитрой.
+ */
+static size_t bmp_prefix_size(int bitCount)
+{
+    return sizeof(BMP_HEADER) + (bitCount == 32 ? 3 * sizeof(unsigned int) : bitCount == 8 ? 256 * 4 : 0);
+}
+
+/**
+ * @brief Записывает заголовки BMP: 32-битные изображения описываются с BI_BITFIELDS
+ * и масками BGRA, 8-битные - с палитрой оттенков серого.
+ *
+ * @param prefix Буфер размером bmp_prefix_size(bitCount).
+ */
+static void bmp_fill_prefix(unsigned char *prefix, int width, int height, int bitCount)
+{
+    int rows = height < 0 ? -height : height;
+    size_t rowSize = ((size_t)width * bitCount + 31) / 32 * 4;
+    size_t offset = bmp_prefix_size(bitCount);
+
+    memset(prefix, 0, offset);
+    BMP_HEADER *header = (BMP_HEADER *)prefix;
+    header->bfType = 0x4D42;
+    header->bfSize = (unsigned int)(offset + rowSize * rows);
+    header->bfOffBits = (unsigned int)offset;
+    header->biSize = 40;
+    header->biWidth = width;
+    header->biHeight = height;
+    header->biPlanes = 1;
+    header->biBitCount = (unsigned short)bitCount;
+    header->biSizeImage = (unsigned int)(rowSize * rows);
+    header->biXPelsPerMeter = header->biYPelsPerMeter = 2834;
+
+    if (bitCount == 32)
+    {
+        static const unsigned int masks[3] = {0x00FF0000, 0x0000FF00, 0x000000FF};
+        header->biCompression = BI_BITFIELDS;
+        memcpy(prefix + sizeof(BMP_HEADER), masks, sizeof(masks));
+    }
+    else if (bitCount == 8)
+    {
+        header->biClrUsed = 256;
+        for (int i = 0; i < 256; i++)
+            memset(prefix + sizeof(BMP_HEADER) + 4 * i, i, 3);
+    }
+}
+
+/**
+ * @brief Создает заголовки BMP нового изображения; пиксельные данные не выделяются.
+ *
+ * @param bmp Указатель на структуру изображения.
+ * @param width Ширина изображения.
+ * @param height Высота изображения; отрицательная - строки сверху вниз.
+ * @param bitCount Битность: 8, 24 или 32.
+ * @return 1 при успехе, 0 при нехватке памяти или неподдерживаемых размерах.
+ */
+int bmp_create(BMP_FILE *bmp, int width, int height, int bitCount)
+{
+    memset(bmp, 0, sizeof(*bmp));
+    size_t size = bmp_prefix_size(bitCount);
+    bmp->prefix = malloc(size);
+    if (!bmp->prefix)
+        return 0;
+
+    bmp_fill_prefix(bmp->prefix, width, height, bitCount);
+    if (!bmp_parse_format(bmp->prefix, size, &bmp->format))
+    {
+        bmp_free(bmp);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Возвращает расстояние между строками пикселей загруженного файла в байтах.
+ */
+long long bmp_stride(const BMP_FILE *bmp)
+{
+    return bmp->packed ? (long long)bmp->format.width * bmp->format.bytesPerPixel : bmp->format.rowSize;
+}
+
+/**
+ * @brief Читает заголовки BMP из открытого файла и определяет формат пикселей.
+ *
+ * Используется командами, которые читают или изменяют только часть пиксельных
+ * данных: заголовки, маски и палитра не сохраняются.
+ *
+ * @param file Файл, открытый в двоичном режиме; позиция - начало файла.
+ * @param filename Имя файла для сообщений об ошибках.
+ * @param format Указатель для сохранения формата.
+ * @return 1 при успехе, -1 если файл - PNG (сообщение не выводится), 0 при ошибке.
+ */
+int bmp_read_format(FILE *file, const char *filename, BMP_FORMAT *format)
+{
+    BMP_HEADER header;
+    size_t n = fread(&header, 1, sizeof(header), file);
+    if (png_signature((const unsigned char *)&header, n))
+        return -1;
+
+    if (n != sizeof(header) || header.bfType != 0x4D42 || header.bfOffBits < sizeof(header) ||
+        header.bfOffBits > BMP_MAX_PREFIX)
+    {
+        printf("Error: %s is not a BMP or PNG file\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+
+    unsigned char *prefix = malloc(header.bfOffBits);
+    if (!prefix)
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+    memcpy(prefix, &header, sizeof(header));
+
+    size_t rest = header.bfOffBits - sizeof(header);
+    int ok = fread(prefix + sizeof(header), 1, rest, file) == rest &&
+             bmp_parse_format(prefix, header.bfOffBits, format);
+    free(prefix);
+    if (!ok)
+    {
+        printf("Error: Unsupported BMP format in %s (%d-bit, compression %u); "
+               "8-bit, 24-bit and 32-bit uncompressed BMPs are supported\n",
+               filename, header.biBitCount, header.biCompression);
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+    stats_add(STAT_BYTES_READ, header.bfOffBits);
+    return 1;
+}
+
+/**
+ * @brief Загружает BMP-файл поддерживаемого формата или PNG (см. png_load).
+ *
+ * Заголовки, маски и палитра сохраняются как есть, чтобы bmp_save записал их
+ * без изменений. Недостающие в конце файла пиксельные данные заполняются нулями.
+ * Время, прочитанные байты и причины ошибок учитываются в статистике.
+ *
+ * @param filename Имя файла BMP или PNG.
+ * @param bmp Указатель на структуру для загруженного файла.
+ * @param packed 1 - хранить строки без выравнивания, 0 - как в файле.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int bmp_load(const char *filename, BMP_FILE *bmp, int packed)
+{
+    memset(bmp, 0, sizeof(*bmp));
+    bmp->packed = packed;
+
+    long long t = stats_start();
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Error: Cannot open image file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    BMP_HEADER header;
+    size_t n = fread(&header, 1, sizeof(header), file);
+    if (png_signature((const unsigned char *)&header, n))
+    {
+        fseek(file, 8, SEEK_SET);
+        int ok = png_load(file, filename, bmp, packed, t);
+        fclose(file);
+        return ok;
+    }
+
+    if (n != sizeof(header) || header.bfType != 0x4D42 || header.bfOffBits < sizeof(header) ||
+        header.bfOffBits > BMP_MAX_PREFIX)
+    {
+        printf("Error: %s is not a BMP or PNG file\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+        fclose(file);
+        return 0;
+    }
+
+    bmp->prefix = malloc(header.bfOffBits);
+    if (!bmp->prefix)
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        fclose(file);
+        return 0;
+    }
+    memcpy(bmp->prefix, &header, sizeof(header));
+
+    size_t rest = header.bfOffBits - sizeof(header);
+    if (fread(bmp->prefix + sizeof(header), 1, rest, file) != rest ||
+        !bmp_parse_format(bmp->prefix, header.bfOffBits, &bmp->format))
+    {
+        printf("Error: Unsupported BMP format in %s (%d-bit, compression %u); "
+               "8-bit, 24-bit and 32-bit uncompressed BMPs are supported\n",
+               filename, header.biBitCount, header.biCompression);
+        stats_error(STAT_ERR_FORMAT);
+        bmp_free(bmp);
+        fclose(file);
+        return 0;
+    }
+    stats_add(STAT_BYTES_READ, header.bfOffBits);
+    stats_stop(STAT_HEADER, t);
+
+    t = stats_start();
+    const BMP_FORMAT *format = &bmp->format;
+    long long stride = bmp_stride(bmp);
+    size_t size = (size_t)(stride * format->height);
+
+    bmp->pixels = malloc(size);
+    if (!bmp->pixels)
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        bmp_free(bmp);
+        fclose(file);
+        return 0;
+    }
+    stats_alloc(size);
+
+    n = 0;
+    if (stride == format->rowSize)
+        n = fread(bmp->pixels, 1, size, file);
+    else
+    {
+        for (int y = 0; y < format->height; y++)
+        {
+            n += fread(bmp->pixels + stride * y, 1, stride, file);
+            fseek(file, format->rowSize - stride, SEEK_CUR);
+        }
+    }
+    if (n < size)
+        memset(bmp->pixels + n, 0, size - n);
+    stats_add(STAT_BYTES_READ, n);
+
+    fclose(file);
+    stats_stop(STAT_READ, t);
+    return 1;
+}
+
+/**
+ * @brief Приводит загруженное изображение к формату файла, в который оно будет сохранено.
+ *
+ * Вызывается до встраивания сообщения: при смене BMP на PNG (по расширению ".png")
+ * или обратно строки переупорядочиваются сверху вниз и выравниваются так, как
+ * они будут лежать в выходном файле, поэтому методы, обходящие байты подряд,
+ * встраивают сообщение ровно в те байты, которые затем прочитает декодер.
+ *
+ * @param bmp Изображение, загруженное bmp_load.
+ * @param filename Имя выходного файла.
+ * @return 1 при успехе, 0 при ошибке (8-битное изображение в PNG, нехватка памяти).
+ */
+int bmp_prepare_output(BMP_FILE *bmp, const char *filename)
+{
+    BMP_FORMAT *format = &bmp->format;
+    int png = png_filename(filename);
+    if (png == format->png)
+        return 1;
+
+    if (png && format->bytesPerPixel == 1)
+    {
+        printf("Error: PNG output supports only 24-bit and 32-bit images\n");
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+
+    long long rowBytes = (long long)format->width * format->bytesPerPixel;
+    long long rowSize = png ? rowBytes : ((long long)format->width * format->bitCount + 31) / 32 * 4;
+    long long oldStride = bmp_stride(bmp), stride = bmp->packed ? rowBytes : rowSize;
+    int flip = png && !format->topDown; // строки PNG всегда идут сверху вниз
+
+    if (stride != oldStride || flip)
+    {
+        unsigned char *pixels = calloc((size_t)(stride * format->height), 1);
+        if (!pixels)
+        {
+            printf("Error: Not enough memory to convert the image to %s\n", filename);
+            stats_error(STAT_ERR_MEMORY);
+            return 0;
+        }
+        stats_alloc(stride * format->height);
+
+        for (int y = 0; y < format->height; y++)
+            memcpy(pixels + stride * y, bmp->pixels + oldStride * (flip ? format->height - 1 - y : y), rowBytes);
+        free(bmp->pixels);
+        bmp->pixels = pixels;
+    }
+
+    if (flip)
+    {
+        int height = -format->height;
+        memcpy(bmp->prefix + offsetof(BMP_HEADER, biHeight), &height, sizeof(height));
+        format->topDown = 1;
+    }
+    format->rowSize = rowSize;
+    format->png = png;
+    return 1;
+}
+
+/**
+ * @brief Сохраняет изображение: BMP - с заголовками, масками и палитрой без изменений,
+ * PNG - если изображение было загружено из PNG или подготовлено bmp_prepare_output.
+ *
+ * @param filename Имя файла для сохранения.
+ * @param bmp Файл, загруженный bmp_load.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int bmp_save(const char *filename, const BMP_FILE *bmp)
+{
+    if (bmp->format.png)
+        return png_save(filename, bmp);
+
+    long long t = stats_start();
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        printf("Error: Cannot create output file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    const BMP_FORMAT *format = &bmp->format;
+    long long stride = bmp_stride(bmp);
+
+    fwrite(bmp->prefix, 1, format->dataOffset, file);
+    if (stride == format->rowSize)
+        fwrite(bmp->pixels, 1, (size_t)(stride * format->height), file);
+    else
+    {
+        static const unsigned char padding[3] = {0, 0, 0};
+        for (int y = 0; y < format->height; y++)
+        {
+            fwrite(bmp->pixels + stride * y, 1, stride, file);
+            fwrite(padding, 1, format->rowSize - stride, file);
+        }
+    }
+
+    stats_add(STAT_BYTES_WRITTEN, ftell(file));
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed)
+    {
+        printf("Error: Cannot write output file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
+
+/**
+ * @brief Освобождает память загруженного файла.
+ */
+void bmp_free(BMP_FILE *bmp)
+{
+    free(bmp->prefix);
+    free(bmp->pixels);
+    bmp->prefix = NULL;
+    bmp->pixels = NULL;
+}
+
+/**
+ * @brief Создает синтетическое BMP-изображение, заполненное шумом.
+ *
+ * Используется для замеров и самопроверки. Строки выравниваются до 4 байт,
+ * байты выравнивания равны нулю. 32-битные изображения записываются с
+ * BI_BITFIELDS и масками BGRA, 8-битные - с палитрой оттенков серого.
+ *
+ * @param width Ширина изображения.
+ * @param height Высота изображения; отрицательная - строки сверху вниз.
+ * @param bitCount Битность: 8, 24 или 32.
+ * @param seed Начальное значение генератора шума.
+ * @param fileSize Указатель для сохранения размера файла.
+ * @return Буфер с содержимым BMP-файла или NULL при нехватке памяти.
+ */
+unsigned char *bmp_synthetic(int width, int height, int bitCount, unsigned int seed, size_t *fileSize)
+{
+    int rows = height < 0 ? -height : height;
+    size_t rowSize = ((size_t)width * bitCount + 31) / 32 * 4;
+    size_t offset = bmp_prefix_size(bitCount);
+    size_t size = offset + rowSize * rows;
+
+    unsigned char *file = calloc(size, 1);
+    if (!file)
+        return NULL;
+    bmp_fill_prefix(file, width, height, bitCount);
+
+    unsigned int state = seed ? seed : 1; // xorshift32
+    for (int y = 0; y < rows; y++)
+    {
+        unsigned char *row = file + offset + rowSize * y;
+        for (int x = 0; x < width * bitCount / 8; x++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (unsigned char)(state >> 24);
+        }
+    }
+
+    *fileSize = size;
+    return file;
+}
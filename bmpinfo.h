@@ -0,0 +1,78 @@
+#ifndef BMPINFO_H
+#define BMPINFO_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define BMP_MAX_PREFIX 65536 // предел размера заголовков с масками и палитрой
+
+// Заголовок BMP (BITMAPFILEHEADER + BITMAPINFOHEADER), 54 байта
+#pragma pack(push, 1)
+typedef struct
+{
+    unsigned short bfType;
+    unsigned int bfSize;
+    unsigned short bfReserved1;
+    unsigned short bfReserved2;
+    unsigned int bfOffBits;
+
+    unsigned int biSize;
+    int biWidth;
+    int biHeight;
+    unsigned short biPlanes;
+    unsigned short biBitCount;
+    unsigned int biCompression;
+    unsigned int biSizeImage;
+    int biXPelsPerMeter;
+    int biYPelsPerMeter;
+    unsigned int biClrUsed;
+    unsigned int biClrImportant;
+} BMP_HEADER;
+#pragma pack(pop)
+
+// Пиксель 24-битного изображения
+typedef struct
+{
+    unsigned char b, g, r;
+} PIXEL;
+
+// Формат пикселей поддерживаемого BMP (8, 24 или 32 бита, BI_RGB или BI_BITFIELDS) или PNG (RGB, RGBA)
+typedef struct
+{
+    int width, height;       // высота всегда положительна
+    int topDown;             // строки записаны сверху вниз (biHeight < 0)
+    int bitCount;            // 8, 24 или 32
+    int bytesPerPixel;       // 1, 3 или 4
+    int channels;            // каналы, в младшие биты которых встраиваются данные: 3 (R, G, B) или 1
+    int offset[3];           // смещения байтов R, G, B внутри пикселя (у 8-битных - индекс палитры)
+    long long rowSize;       // размер строки в файле: у BMP с выравниванием до 4 байт, у PNG без выравнивания
+    unsigned int dataOffset; // смещение пиксельных данных от начала файла
+    int png;                 // изображение читается из PNG или будет сохранено в PNG
+} BMP_FORMAT;
+
+// Изображение BMP или PNG, загруженное в память
+typedef struct
+{
+    unsigned char *prefix; // заголовки, маски и палитра (dataOffset байт), сохраняются без изменений
+    unsigned char *pixels; // строки пикселей в порядке хранения
+    int packed;            // строки без выравнивания: width * bytesPerPixel байт
+    BMP_FORMAT format;
+} BMP_FILE;
+
+int check_bmp_header(const BMP_HEADER *header);
+int read_bmp_header(const char *filename, BMP_HEADER *header);
+long long bmp_pixel_count(const BMP_HEADER *header);
+long long bmp_row_size(const BMP_HEADER *header);
+int bmp_channels(const BMP_HEADER *header);
+int bmp_parse_format(const unsigned char *prefix, size_t size, BMP_FORMAT *format);
+void bmp_format_bgr24(BMP_FORMAT *format, int width, int height);
+long long bmp_stride(const BMP_FILE *bmp);
+int bmp_create(BMP_FILE *bmp, int width, int height, int bitCount);
+int bmp_read_format(FILE *file, const char *filename, BMP_FORMAT *format);
+int bmp_load(const char *filename, BMP_FILE *bmp, int packed);
+int bmp_prepare_output(BMP_FILE *bmp, const char *filename);
+int bmp_save(const char *filename, const BMP_FILE *bmp);
+void bmp_free(BMP_FILE *bmp);
+unsigned char *bmp_synthetic(int width, int height, int bitCount, unsigned int seed, size_t *fileSize);
+
+#endif
\ No newline at end of file
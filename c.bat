@@ -1 +1,2 @@
-gcc main.c stegano.c stegano_dec.c color.c color_dec.c simple.c simple_dec.c -o cipher_app
+gcc main.c stegano.c stegano_dec.c color.c color_dec.c simple.c simple_dec.c bmpinfo.c png.c deflate.c pool.c numa.c walk.c json.c capacity.c probe.c analysis.c metrics.c batch.c selfcheck.c stats.c perf.c prom.c stream.c slots.c update.c hash.c patch.c cache.c plane.c recover.c shard.c aead.c ecc.c -o cipher_app -O2 -lpthread -lm
+gcc bench.c stegano.c stegano_dec.c color.c color_dec.c simple.c simple_dec.c bmpinfo.c png.c deflate.c metrics.c stats.c perf.c plane.c aead.c ecc.c stream.c -o cipher_bench -O2 -lm
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#endif
+#include "hash.h"
+#include "stats.h"
+#include "simple_dec.h"
+#include "color_dec.h"
+#include "stegano_dec.h"
+#include "ecc.h"
+#include "cache.h"
+
+#define CACHE_MAGIC "DCC1"
+#define CACHE_TILE (256 * 1024) // размер буфера чтения при хешировании изображения, байт
+#define CACHE_MAX_KEY 4096      // ключи длиннее не кешируются
+#define CACHE_PROBE (64 * 1024) // начало файла (заголовок и первые строки), входящее в ключ первого уровня
+
+// Заголовок файла кеша; за ним идут entries записей индекса и entries областей сообщений
+typedef struct
+{
+    char magic[4];
+    unsigned int entries;
+    unsigned int payloadSize;
+    unsigned int reserved;
+    unsigned long long tick; // счетчик обращений для LRU
+} CACHE_HEADER;
+
+// Запись индекса: индекс хранится отдельно от сообщений, чтобы поиск просматривал непрерывный массив
+typedef struct
+{
+    unsigned long long statKey;     // хеш пути, метаданных и начала файла
+    unsigned long long contentHash; // XXH64 содержимого файла
+    unsigned long long paramsHash;  // хеш метода и содержимого ключа
+    unsigned long long lastUsed;    // значение tick при последнем обращении, 0 - запись свободна
+    unsigned int length;            // длина сообщения
+    unsigned int reserved;
+} CACHE_INDEX;
+
+struct DECODE_CACHE
+{
+    unsigned char *map;
+    size_t size;
+    CACHE_HEADER *header;
+    CACHE_INDEX *index;
+    char *payload;
+    unsigned int entries; // количество записей в отображении этого процесса
+    pthread_mutex_t lock; // задания пакета обращаются к кешу из нескольких потоков
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int fd;
+#endif
+};
+
+/**
+ * @brief Отображает файл кеша размера size в память, при необходимости создавая или увеличивая его.
+ */
+static int cache_map(DECODE_CACHE *c, const char *filename, size_t size)
+{
+#ifdef _WIN32
+    c->file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL);
+    if (c->file == INVALID_HANDLE_VALUE)
+        return 0;
+    c->mapping = CreateFileMappingA(c->file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32),
+                                    (DWORD)size, NULL);
+    c->map = c->mapping ? MapViewOfFile(c->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+    if (!c->map)
+    {
+        if (c->mapping)
+            CloseHandle(c->mapping);
+        CloseHandle(c->file);
+        return 0;
+    }
+#else
+    c->fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (c->fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(c->fd, &st) != 0 || ((size_t)st.st_size < size && ftruncate(c->fd, (off_t)size) != 0))
+    {
+        close(c->fd);
+        return 0;
+    }
+    c->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if (c->map == MAP_FAILED)
+    {
+        close(c->fd);
+        return 0;
+    }
+#endif
+    c->size = size;
+    return 1;
+}
+
+/**
+ * @brief Захватывает кеш: мьютекс исключает потоки этого процесса, блокировка файла - другие процессы.
+ *
+ * @return 1, если разметка файла совпадает с отображением процесса; 0, если другой
+ *         процесс пересоздал кеш с другим количеством записей (кеш не используется).
+ */
+static int cache_lock(DECODE_CACHE *c)
+{
+    pthread_mutex_lock(&c->lock);
+#ifdef _WIN32
+    OVERLAPPED overlapped = {0};
+    LockFileEx(c->file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+    while (flock(c->fd, LOCK_EX) != 0 && errno == EINTR)
+        ;
+#endif
+    return memcmp(c->header->magic, CACHE_MAGIC, 4) == 0 && c->header->entries == c->entries &&
+           c->header->payloadSize == CACHE_PAYLOAD;
+}
+
+/**
+ * @brief Освобождает кеш, захваченный cache_lock.
+ */
+static void cache_unlock(DECODE_CACHE *c)
+{
+#ifdef _WIN32
+    OVERLAPPED overlapped = {0};
+    UnlockFileEx(c->file, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+    flock(c->fd, LOCK_UN);
+#endif
+    pthread_mutex_unlock(&c->lock);
+}
+
+/**
+ * @brief Открывает кеш результатов дешифрования, отображенный в память из файла.
+ *
+ * Если файл не существует или создан с другим количеством записей, кеш
+ * создается пустым. Файл могут одновременно использовать несколько процессов:
+ * индекс изменяется под блокировкой файла (flock, в Windows - LockFileEx).
+ *
+ * @param filename Файл кеша.
+ * @param entries Количество записей; при вытеснении освобождается давно не использованная.
+ * @return Кеш или NULL при ошибке.
+ */
+DECODE_CACHE *cache_open(const char *filename, int entries)
+{
+    if (entries <= 0)
+        entries = CACHE_DEFAULT_ENTRIES;
+
+    DECODE_CACHE *c = calloc(1, sizeof(DECODE_CACHE));
+    size_t size = sizeof(CACHE_HEADER) + (size_t)entries * (sizeof(CACHE_INDEX) + CACHE_PAYLOAD);
+    if (!c || !cache_map(c, filename, size))
+    {
+        printf("Error: Cannot open decode cache %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        free(c);
+        return NULL;
+    }
+
+    c->header = (CACHE_HEADER *)c->map;
+    c->index = (CACHE_INDEX *)(c->map + sizeof(CACHE_HEADER));
+    c->payload = (char *)(c->index + entries);
+    c->entries = entries;
+    pthread_mutex_init(&c->lock, NULL);
+    if (!cache_lock(c))
+    {
+        memset(c->map, 0, size);
+        memcpy(c->header->magic, CACHE_MAGIC, 4);
+        c->header->entries = entries;
+        c->header->payloadSize = CACHE_PAYLOAD;
+    }
+    cache_unlock(c);
+    return c;
+}
+
+/**
+ * @brief Закрывает кеш; изменения записываются в файл системой при снятии отображения.
+ */
+void cache_close(DECODE_CACHE *c)
+{
+    if (!c)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(c->map);
+    CloseHandle(c->mapping);
+    CloseHandle(c->file);
+#else
+    munmap(c->map, c->size);
+    close(c->fd);
+#endif
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+/**
+ * @brief Ключ первого уровня: путь, метаданные и первые CACHE_PROBE байт файла без чтения остального.
+ *
+ * Путь входит в ключ, так как stat в Windows не заполняет inode; там вместо
+ * него берутся индекс файла и время изменения с точностью 100 нс из
+ * GetFileInformationByHandle. Начало файла (заголовок и первые строки
+ * пикселей) входит в ключ, чтобы перезапись файла того же размера в пределах
+ * разрешения времени изменения не возвращала старое сообщение.
+ */
+static int cache_stat_key(const char *filename, unsigned long long *key)
+{
+    FILE *f = fopen(filename, "rb");
+    unsigned char *buffer = f ? malloc(CACHE_PROBE) : NULL;
+    struct stat st;
+    if (!buffer || fstat(fileno(f), &st) != 0)
+    {
+        if (f)
+            fclose(f);
+        free(buffer);
+        return 0;
+    }
+
+    long long meta[5] = {(long long)st.st_dev, (long long)st.st_ino, (long long)st.st_size,
+                         (long long)st.st_mtime, 0};
+#ifdef __linux__
+    meta[4] = st.st_mtim.tv_nsec;
+#elif defined(_WIN32)
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle((HANDLE)_get_osfhandle(fileno(f)), &info))
+    {
+        meta[0] = info.dwVolumeSerialNumber;
+        meta[1] = (long long)info.nFileIndexHigh << 32 | info.nFileIndexLow;
+        meta[4] = (long long)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime;
+    }
+#endif
+    size_t n = fread(buffer, 1, CACHE_PROBE, f);
+    int ok = !ferror(f);
+    fclose(f);
+    stats_add(STAT_BYTES_READ, n);
+
+    HASH_STATE h;
+    hash_init(&h);
+    hash_update(&h, meta, sizeof(meta));
+    hash_update(&h, filename, strlen(filename));
+    hash_update(&h, buffer, n);
+    free(buffer);
+    *key = hash_digest(&h);
+    return ok;
+}
+
+/**
+ * @brief Хеш метода и содержимого ключа: другой ключ к тому же изображению дает другое сообщение.
+ */
+static int cache_params_key(int method, const char *keyFilename, unsigned long long *key)
+{
+    HASH_STATE h;
+    hash_init(&h);
+    hash_update(&h, &method, sizeof(method));
+    if (keyFilename)
+    {
+        FILE *f = fopen(keyFilename, "rb");
+        if (!f)
+            return 0;
+        char buffer[CACHE_MAX_KEY];
+        size_t n = fread(buffer, 1, sizeof(buffer), f);
+        int whole = feof(f);
+        fclose(f);
+        if (!whole)
+            return 0;
+        stats_add(STAT_BYTES_READ, n);
+        hash_update(&h, buffer, n);
+    }
+    *key = hash_digest(&h);
+    return 1;
+}
+
+/**
+ * @brief Ключ второго уровня: XXH64 содержимого файла, вычисляемый при потоковом чтении.
+ */
+static int cache_content_key(const char *filename, unsigned long long *key)
+{
+    FILE *f = fopen(filename, "rb");
+    unsigned char *buffer = f ? malloc(CACHE_TILE) : NULL;
+    if (!buffer)
+    {
+        if (f)
+            fclose(f);
+        return 0;
+    }
+
+    long long t = stats_start();
+    HASH_STATE h;
+    hash_init(&h);
+    size_t n;
+    while ((n = fread(buffer, 1, CACHE_TILE, f)) > 0)
+    {
+        hash_update(&h, buffer, n);
+        stats_add(STAT_BYTES_READ, n);
+    }
+    int ok = !ferror(f);
+    fclose(f);
+    free(buffer);
+    stats_stop(STAT_READ, t);
+    *key = hash_digest(&h);
+    return ok;
+}
+
+/**
+ * @brief Ищет запись по ключу первого (contentHash == 0) или второго уровня; вызывается под блокировкой.
+ */
+static CACHE_INDEX *cache_find(DECODE_CACHE *c, unsigned long long statKey, unsigned long long contentHash,
+                               unsigned long long paramsHash)
+{
+    for (unsigned int i = 0; i < c->entries; i++)
+    {
+        CACHE_INDEX *e = &c->index[i];
+        if (e->lastUsed && e->paramsHash == paramsHash &&
+            (contentHash ? e->contentHash == contentHash : e->statKey == statKey))
+            return e;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Копирует сообщение записи и отмечает обращение к ней; вызывается под блокировкой.
+ */
+static char *cache_take(DECODE_CACHE *c, CACHE_INDEX *e)
+{
+    char *message = malloc(e->length + 1);
+    if (!message)
+        return NULL;
+    memcpy(message, c->payload + (size_t)(e - c->index) * CACHE_PAYLOAD, e->length + 1);
+    e->lastUsed = ++c->header->tick;
+    stats_add(STAT_PAYLOAD, e->length);
+    return message;
+}
+
+/**
+ * @brief Сохраняет сообщение на месте записи с тем же содержимым, свободной или давно не использованной.
+ */
+static void cache_store(DECODE_CACHE *c, unsigned long long statKey, unsigned long long contentHash,
+                        unsigned long long paramsHash, const char *message)
+{
+    size_t length = strlen(message);
+    if (length >= CACHE_PAYLOAD)
+        return;
+
+    if (!cache_lock(c))
+    {
+        cache_unlock(c);
+        return;
+    }
+    CACHE_INDEX *victim = cache_find(c, 0, contentHash, paramsHash);
+    if (!victim)
+    {
+        victim = c->index;
+        for (unsigned int i = 1; i < c->entries && victim->lastUsed; i++)
+            if (c->index[i].lastUsed < victim->lastUsed)
+                victim = &c->index[i];
+    }
+
+    victim->statKey = statKey;
+    victim->contentHash = contentHash;
+    victim->paramsHash = paramsHash;
+    victim->length = (unsigned int)length;
+    memcpy(c->payload + (size_t)(victim - c->index) * CACHE_PAYLOAD, message, length + 1);
+    victim->lastUsed = ++c->header->tick;
+    cache_unlock(c);
+}
+
+/**
+ * @brief Дешифрует изображение, используя кеш результатов.
+ *
+ * Сначала запись ищется по пути, метаданным и началу файла вместе с методом и
+ * содержимым ключа: при совпадении сообщение возвращается без чтения остального
+ * изображения. Иначе
+ * файл хешируется потоковым чтением, и запись ищется по хешу содержимого
+ * (например, для копии или файла, время изменения которого обновилось без
+ * изменения данных). Только если и она не найдена, изображение дешифруется
+ * обычным декодером, а успешный результат сохраняется в кеш.
+ *
+ * @param cache Кеш, открытый cache_open.
+ * @param method CACHE_SIMPLE, CACHE_COLOR, CACHE_STEGANO или CACHE_SIMPLE_ECC.
+ * @param filename Изображение.
+ * @param keyFilename Файл ключа (для CACHE_SIMPLE и CACHE_SIMPLE_ECC не используется).
+ * @param hit Указатель для результата поиска: CACHE_MISS, CACHE_HIT_STAT или CACHE_HIT_CONTENT.
+ * @return Сообщение (освобождается вызывающей стороной) или NULL при ошибке.
+ */
+char *cache_decode(DECODE_CACHE *cache, int method, const char *filename, const char *keyFilename, int *hit)
+{
+    unsigned long long statKey = 0, contentHash = 0, paramsHash = 0;
+    int keyed = cache_stat_key(filename, &statKey) &&
+                cache_params_key(method, method == CACHE_SIMPLE || method == CACHE_SIMPLE_ECC ? NULL : keyFilename,
+                                 &paramsHash);
+    char *message = NULL;
+    *hit = CACHE_MISS;
+
+    if (keyed)
+    {
+        long long t = stats_start();
+        CACHE_INDEX *e = cache_lock(cache) ? cache_find(cache, statKey, 0, paramsHash) : NULL;
+        if (e)
+            message = cache_take(cache, e);
+        cache_unlock(cache);
+        stats_stop(STAT_HEADER, t);
+        if (message)
+        {
+            *hit = CACHE_HIT_STAT;
+            return message;
+        }
+
+        keyed = cache_content_key(filename, &contentHash);
+    }
+
+    if (keyed)
+    {
+        CACHE_INDEX *e = cache_lock(cache) ? cache_find(cache, 0, contentHash, paramsHash) : NULL;
+        if (e)
+        {
+            message = cache_take(cache, e);
+            e->statKey = statKey; // следующее обращение по этому пути не хеширует весь файл
+        }
+        cache_unlock(cache);
+        if (message)
+        {
+            *hit = CACHE_HIT_CONTENT;
+            return message;
+        }
+    }
+
+    message = method == CACHE_SIMPLE       ? simple_decode(filename)
+              : method == CACHE_SIMPLE_ECC ? ecc_simple_decode(filename, NULL)
+              : method == CACHE_COLOR      ? color_decode(filename, keyFilename)
+                                           : stegano_decode(filename, keyFilename);
+    if (message && keyed)
+        cache_store(cache, statKey, contentHash, paramsHash, message);
+    return message;
+}
@@ -0,0 +1,24 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+// Методы, результат дешифрования которых кешируется
+#define CACHE_SIMPLE 0
+#define CACHE_COLOR 1
+#define CACHE_STEGANO 2
+#define CACHE_SIMPLE_ECC 3 // прямое шифрование с кодом Рида-Соломона (ecc_simple_decode)
+
+#define CACHE_DEFAULT_ENTRIES 4096
+#define CACHE_PAYLOAD 2048 // место под сообщение в записи, байт (с завершающим нулем)
+
+// Результат поиска в кеше
+#define CACHE_MISS 0
+#define CACHE_HIT_STAT 1    // совпали путь, метаданные и начало файла: остальное изображение не читается
+#define CACHE_HIT_CONTENT 2 // совпал хеш содержимого: изображение прочитано, но не декодировано
+
+typedef struct DECODE_CACHE DECODE_CACHE;
+
+DECODE_CACHE *cache_open(const char *filename, int entries);
+void cache_close(DECODE_CACHE *cache);
+char *cache_decode(DECODE_CACHE *cache, int method, const char *filename, const char *keyFilename, int *hit);
+
+#endif
\ No newline at end of file
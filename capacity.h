@@ -0,0 +1,11 @@
+#ifndef CAPACITY_H
+#define CAPACITY_H
+
+#include "bmpinfo.h"
+
+long long capacity_simple(const BMP_HEADER *header, int depth, int parity);
+long long capacity_color(const BMP_HEADER *header);
+long long capacity_stegano(const BMP_HEADER *header, int step, int mask, int parity);
+int capacity(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
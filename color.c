@@ -1,320 +1,302 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-#pragma pack(push, 1)
-typedef struct
-{
-    unsigned short bfType;
-    unsigned int bfSize;
-    unsigned short bfReserved1;
-    unsigned short bfReserved2;
-    unsigned int bfOffBits;
-} BITMAPFILEHEADER;
-
-typedef struct
-{
-    unsigned int biSize;
-    int biWidth;
-    int biHeight;
-    unsigned short biPlanes;
-    unsigned short biBitCount;
-    unsigned int biCompression;
-    unsigned int biSizeImage;
-    int biXPelsPerMeter;
-    int biYPelsPerMeter;
-    unsigned int biClrUsed;
-    unsigned int biClrImportant;
-} BITMAPINFOHEADER;
-#pragma pack(pop)
-
-typedef struct
-{
-    unsigned char b, g, r;
-} PIXEL;
-
-typedef struct
-{
-    BITMAPFILEHEADER fileHeader;
-    BITMAPINFOHEADER infoHeader;
-    PIXEL *pixels;
-} BMP_IMAGE;
-
-/**
- * @brief Загружает BMP-изображение из файла.
- *
- * Эта функция открывает указанный BMP-файл, считывает заголовки файла и изображения,
- * а также загружает пиксели изображения в динамически выделенную память.
- *
- * @param filename Путь к файлу BMP, который необходимо загрузить.
- * @return Указатель на структуру BMP_IMAGE, содержащую загруженное изображение,
- *         или NULL в случае ошибки.
- */
-BMP_IMAGE *load__bmp(const char *filename)
-{
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-    {
-        printf("Error: Cannot open file %s\n", filename);
-        return NULL;
-    }
-
-    BMP_IMAGE *img = malloc(sizeof(BMP_IMAGE));
-    if (!img)
-    {
-        fclose(file);
-        return NULL;
-    }
-
-    fread(&img->fileHeader, sizeof(BITMAPFILEHEADER), 1, file);
-    fread(&img->infoHeader, sizeof(BITMAPINFOHEADER), 1, file);
-
-    if (img->fileHeader.bfType != 0x4D42 || img->infoHeader.biBitCount != 24)
-    {
-        printf("Error: Only 24-bit BMP files are supported\n");
-        free(img);
-        fclose(file);
-        return NULL;
-    }
-
-    int imageSize = img->infoHeader.biWidth * img->infoHeader.biHeight;
-    img->pixels = malloc(imageSize * sizeof(PIXEL));
-
-    fseek(file, img->fileHeader.bfOffBits, SEEK_SET);
-
-    int padding = (4 - (img->infoHeader.biWidth * 3) % 4) % 4;
-    for (int y = 0; y < img->infoHeader.biHeight; y++)
-    {
-        fread(&img->pixels[y * img->infoHeader.biWidth], sizeof(PIXEL), img->infoHeader.biWidth, file);
-        fseek(file, padding, SEEK_CUR);
-    }
-
-    fclose(file);
-    return img;
-}
-
-/**
- * @brief Сохраняет BMP-изображение в файл.
- *
- * Эта функция создает новый BMP-файл и записывает в него заголовки и пиксели,
- * представляющие изображение.
- *
- * @param filename Путь к файлу, в который необходимо сохранить изображение.
- * @param img Указатель на структуру BMP_IMAGE, содержащую изображение для сохранения.
- * @return 1 в случае успешного сохранения, 0 в случае ошибки.
- */
-int save__bmp(const char *filename, BMP_IMAGE *img)
-{
-    FILE *file = fopen(filename, "wb");
-    if (!file)
-    {
-        printf("Error: Cannot create file %s\n", filename);
-        return 0;
-    }
-
-    fwrite(&img->fileHeader, sizeof(BITMAPFILEHEADER), 1, file);
-    fwrite(&img->infoHeader, sizeof(BITMAPINFOHEADER), 1, file);
-
-    int padding = (4 - (img->infoHeader.biWidth * 3) % 4) % 4;
-    unsigned char paddingBytes[3] = {0, 0, 0};
-
-    for (int y = 0; y < img->infoHeader.biHeight; y++)
-    {
-        fwrite(&img->pixels[y * img->infoHeader.biWidth], sizeof(PIXEL), img->infoHeader.biWidth, file);
-        if (padding > 0)
-        {
-            fwrite(paddingBytes, 1, padding, file);
-        }
-    }
-
-    fclose(file);
-    return 1;
-}
-
-/**
- * @brief Устанавливает значение бита в байте.
- *
- * Эта функция устанавливает указанный бит в байте в заданное значение (0 или 1).
- *
- * @param byte Указатель на байт, в котором нужно установить бит.
- * @param bit Индекс бита, который нужно установить (0 - младший бит).
- * @param value Значение, которым нужно установить бит (0 или 1).
- */
-void set__bit(unsigned char *byte, int bit, int value)
-{
-    if (value)
-    {
-        *byte |= (1 << bit);
-    }
-    else
-    {
-        *byte &= ~(1 << bit);
-    }
-}
-
-/**
- * @brief Получает значение бита из байта.
- *
- * Эта функция возвращает значение указанного бита в байте.
- *
- * @param byte Байтовое значение, из которого нужно получить бит.
- * @param bit Индекс бита, который нужно получить (0 - младший бит).
- * @return Значение бита (0 или 1).
- */
-int get__bit(unsigned char byte, int bit)
-{
-    return (byte >> bit) & 1;
-}
-
-/**
- * @brief Скрывает сообщение в изображении BMP.
- *
- * Эта функция встраивает заданное сообщение в пиксели изображения, изменяя
- * младший бит каждого цветового канала пикселей для кодирования символов
- * сообщения. Сообщение представляет собой строку символов и заканчивается
- * нулевым символом.
- *
- * @param img Указатель на структуру BMP_IMAGE, в которую будет встроено сообщение.
- * @param message Указатель на строку символов, содержащую сообщение для скрытия.
- * @param startX Координата X начала встраивания сообщения в изображение.
- * @param startY Координата Y начала встраивания сообщения в изображение.
- *
- * @note Если сообщение слишком длинное для изображения, начиная с указанной позиции,
- * функция выведет сообщение об ошибке и завершит выполнение.
- */
-void hideMessage(BMP_IMAGE *img, const char *message, int startX, int startY)
-{
-    int messageLen = strlen(message);
-    int totalBits = (messageLen + 1) * 8; // +1 for null terminator
-    int imageSize = img->infoHeader.biWidth * img->infoHeader.biHeight;
-    int startIndex = startY * img->infoHeader.biWidth + startX;
-
-    if (startIndex + (totalBits / 3) >= imageSize)
-    {
-        printf("Error: Message too long for image starting at this position\n");
-        return;
-    }
-
-    int bitIndex = 0;
-    for (int i = 0; i < messageLen + 1; i++)
-    {
-        char ch = (i < messageLen) ? message[i] : '\0';
-
-        for (int bit = 0; bit < 8; bit++)
-        {
-            int pixelIndex = startIndex + (bitIndex / 3);
-            int colorChannel = bitIndex % 3;
-
-            unsigned char *color;
-            switch (colorChannel)
-            {
-            case 0:
-                color = &img->pixels[pixelIndex].r;
-                break;
-            case 1:
-                color = &img->pixels[pixelIndex].g;
-                break;
-            case 2:
-                color = &img->pixels[pixelIndex].b;
-                break;
-            }
-
-            set__bit(color, 0, (ch >> bit) & 1);
-            bitIndex++;
-        }
-    }
-}
-
-/**
- * @brief Сохраняет координаты и длину скрытого сообщения в файл "color_key".
- *
- * Эта функция записывает информацию о позиции начала скрытого сообщения и его длине,
- * чтобы позже можно было восстановить сообщение из изображения.
- *
- * @param x Координата X начальной точки скрытия сообщения.
- * @param y Координата Y начальной точки скрытия сообщения.
- * @param messageLen Длина скрытого сообщения в символах.
- */
-void saveColorKey(int x, int y, int messageLen)
-{
-    FILE *file = fopen("color_key", "w");
-    if (!file)
-    {
-        printf("Error: Cannot create color_key file\n");
-        return;
-    }
-
-    fprintf(file, "%d %d %d\n", x, y, messageLen);
-    fclose(file);
-}
-
-/**
- * @brief Выполняет процесс шифрования сообщения в BMP-изображение с сохранением ключа.
- *
- * Эта функция запрашивает у пользователя исходное BMP-изображение, сообщение для скрытия,
- * генерирует случайную стартовую позицию для вставки сообщения, шифрует сообщение,
- * сохраняет ключ (координаты и длину сообщения) в файл "color_key",
- * сохраняет полученное изображение с внедренным сообщением в указанный файл.
- *
- * @return Возвращает 0 при успешном выполнении, или 1 при возникновении ошибок.
- */
-int color()
-{
-    char filename[256], message[1000], outputFileName[256];
-
-    printf("\nBMP Image Text Encryption\n");
-    printf("=========================\n\n");
-
-    printf("Enter BMP filename: ");
-    scanf("%s", filename);
-
-    BMP_IMAGE *img = load__bmp(filename);
-    if (!img)
-        return 1; // Ошибка при загрузке изображения
-
-    printf("\nImage loaded successfully!\n");
-    printf("Enter message to hide: ");
-    getchar(); // consume leftover newline
-    fgets(message, sizeof(message), stdin);
-    message[strcspn(message, "\n")] = '\0'; // удаление символа новой строки
-
-    srand(time(NULL));
-    int maxX = img->infoHeader.biWidth - 1;
-    int maxY = img->infoHeader.biHeight - 1;
-    int startX = rand() % maxX;
-    int startY = rand() % maxY;
-
-    int messageLen = strlen(message);
-    int requiredPixels = ((messageLen + 1) * 8 + 2) / 3;
-
-    // Проверка, чтобы сообщение поместилось в изображение
-    if (startY * img->infoHeader.biWidth + startX + requiredPixels >=
-        img->infoHeader.biWidth * img->infoHeader.biHeight)
-    {
-        startX = 0;
-        startY = 0;
-    }
-
-    hideMessage(img, message, startX, startY);
-    saveColorKey(startX, startY, messageLen);
-
-    printf("Enter output filename: ");
-    scanf("%s", outputFileName);
-
-    if (save__bmp(outputFileName, img))
-    {
-        printf("\nImage saved as %s\n", outputFileName);
-        printf("Key information saved to 'color_key' file.\n");
-        free(img->pixels);
-        free(img);
-        return 0; // Успешное завершение
-    }
-    else
-    {
-        printf("Failed to save the image.\n");
-        free(img->pixels);
-        free(img);
-        return 1; // Ошибка при сохранении файла
-    }
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+#include "stats.h"
+#include "stream.h"
+#include "aead.h"
+#include "color.h"
+
+/**
+ * @brief Устанавливает значение бита в байте.
+ *
+ * Эта функция устанавливает указанный бит в байте в заданное значение (0 или 1).
+ *
+ * @param byte Указатель на байт, в котором нужно установить бит.
+ * @param bit Индекс бита, который нужно установить (0 - младший бит).
+ * @param value Значение, которым нужно установить бит (0 или 1).
+ */
+void set__bit(unsigned char *byte, int bit, int value)
+{
+    if (value)
+    {
+        *byte |= (1 << bit);
+    }
+    else
+    {
+        *byte &= ~(1 << bit);
+    }
+}
+
+/**
+ * @brief Получает значение бита из байта.
+ *
+ * Эта функция возвращает значение указанного бита в байте.
+ *
+ * @param byte Байтовое значение, из которого нужно получить бит.
+ * @param bit Индекс бита, который нужно получить (0 - младший бит).
+ * @return Значение бита (0 или 1).
+ */
+int get__bit(unsigned char byte, int bit)
+{
+    return (byte >> bit) & 1;
+}
+
+/**
+ * @brief Записывает биты сообщения с завершающим нулем в младшие биты каналов
+ * последовательных пикселей, начиная с пикселя startIndex.
+ *
+ * Вызывается с константными bytesPerPixel и channels, поэтому для каждого формата
+ * пикселей компилятор строит отдельное ядро без ветвлений по формату в цикле.
+ */
+static inline void hide_bits(unsigned char *pixels, int bytesPerPixel, int channels, const int *offset,
+                             int startIndex, const char *message, int messageLen)
+{
+    int bitIndex = 0;
+    for (int i = 0; i < messageLen + 1; i++)
+    {
+        char ch = (i < messageLen) ? message[i] : '\0';
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            int pixelIndex = startIndex + (bitIndex / channels);
+            unsigned char *color = &pixels[pixelIndex * bytesPerPixel + offset[bitIndex % channels]];
+
+            set__bit(color, 0, (ch >> bit) & 1);
+            bitIndex++;
+        }
+    }
+}
+
+/**
+ * @brief Скрывает сообщение в изображении BMP.
+ *
+ * Эта функция встраивает заданное сообщение в пиксели изображения, изменяя
+ * младший бит каждого цветового канала пикселей (R, G, B; у 8-битных изображений -
+ * индекса палитры) для кодирования символов сообщения. Сообщение представляет
+ * собой строку символов и заканчивается нулевым символом. Координаты считаются
+ * по строкам в порядке хранения в файле.
+ *
+ * @param img Указатель на изображение, загруженное bmp_load со строками без выравнивания.
+ * @param message Указатель на строку символов, содержащую сообщение для скрытия.
+ * @param startX Координата X начала встраивания сообщения в изображение.
+ * @param startY Координата Y начала встраивания сообщения в изображение.
+ *
+ * @note Если сообщение слишком длинное для изображения, начиная с указанной позиции,
+ * функция выведет сообщение об ошибке и завершит выполнение.
+ */
+void hideMessage(BMP_FILE *img, const char *message, int startX, int startY)
+{
+    static const int bgr24[3] = {2, 1, 0}, gray8[1] = {0};
+    const BMP_FORMAT *format = &img->format;
+    int messageLen = strlen(message);
+    int totalBits = (messageLen + 1) * 8; // +1 for null terminator
+    int imageSize = format->width * format->height;
+    int startIndex = startY * format->width + startX;
+
+    if (startIndex + (totalBits / format->channels) >= imageSize)
+    {
+        printf("Error: Message too long for image starting at this position\n");
+        return;
+    }
+
+    switch (format->bytesPerPixel)
+    {
+    case 3:
+        hide_bits(img->pixels, 3, 3, bgr24, startIndex, message, messageLen);
+        break;
+    case 4:
+        hide_bits(img->pixels, 4, 3, format->offset, startIndex, message, messageLen);
+        break;
+    default:
+        hide_bits(img->pixels, 1, 1, gray8, startIndex, message, messageLen);
+        break;
+    }
+}
+
+/**
+ * @brief Сохраняет координаты и длину скрытого сообщения в файл ключа.
+ *
+ * Эта функция записывает информацию о позиции начала скрытого сообщения и его длине,
+ * чтобы позже можно было восстановить сообщение из изображения.
+ *
+ * @param keyFilename Имя файла ключа (в диалоговом режиме - "color_key").
+ * @param x Координата X начальной точки скрытия сообщения.
+ * @param y Координата Y начальной точки скрытия сообщения.
+ * @param messageLen Длина скрытого сообщения в символах.
+ * @return 1 в случае успешного сохранения, 0 в случае ошибки.
+ */
+int saveColorKey(const char *keyFilename, int x, int y, int messageLen)
+{
+    long long t = stats_start();
+    FILE *file = fopen(keyFilename, "w");
+    if (!file)
+    {
+        printf("Error: Cannot create %s file\n", keyFilename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    fprintf(file, "%d %d %d\n", x, y, messageLen);
+    stats_add(STAT_BYTES_WRITTEN, ftell(file));
+    fclose(file);
+    stats_stop(STAT_KEY, t);
+    return 1;
+}
+
+/**
+ * @brief Встраивает сообщение в загруженное изображение со случайной стартовой позицией.
+ *
+ * Генератор rand() должен быть проинициализирован вызывающей стороной.
+ *
+ * @param img Изображение, загруженное bmp_load со строками без выравнивания.
+ * @param message Сообщение для скрытия.
+ * @param startX Указатель для сохранения координаты X начала сообщения.
+ * @param startY Указатель для сохранения координаты Y начала сообщения.
+ * @param dist Накопитель метрик искажения или NULL, если метрики не нужны.
+ * @return 1 в случае успеха, 0 если сообщение не помещается в изображение.
+ */
+int color_embed_image(BMP_FILE *img, const char *message, int *startX, int *startY, DISTORTION *dist)
+{
+    const BMP_FORMAT *format = &img->format;
+    int width = format->width;
+    int imageSize = width * format->height;
+    int channels = format->channels;
+    int messageLen = strlen(message);
+    int requiredPixels = ((messageLen + 1) * 8 + channels - 1) / channels;
+
+    if ((messageLen + 1) * 8 / channels >= imageSize)
+    {
+        printf("Error: Message too long for image\n");
+        stats_error(STAT_ERR_CAPACITY);
+        return 0;
+    }
+
+    int maxX = width - 1;
+    int maxY = format->height - 1;
+    *startX = maxX > 0 ? rand() % maxX : 0;
+    *startY = maxY > 0 ? rand() % maxY : 0;
+
+    // Проверка, чтобы сообщение поместилось в изображение
+    if (*startY * width + *startX + requiredPixels >= imageSize)
+    {
+        *startX = 0;
+        *startY = 0;
+    }
+
+    // Для метрик копируются только строки, в которые попадает сообщение;
+    // метрики считаются только для 24-битных изображений
+    int firstPixel = *startY * width;
+    int copyPixels = *startX + requiredPixels;
+    PIXEL *original = dist && format->bytesPerPixel == 3 ? malloc(copyPixels * sizeof(PIXEL)) : NULL;
+    if (original)
+        memcpy(original, img->pixels + firstPixel * 3LL, copyPixels * sizeof(PIXEL));
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    hideMessage(img, message, *startX, *startY);
+    stats_kernel_stop(STAT_EMBED, &span);
+    stats_add(STAT_PIXELS, requiredPixels);
+    stats_add(STAT_PAYLOAD, messageLen);
+
+    if (original)
+    {
+        distortion_rows(dist, (unsigned char *)original, img->pixels + firstPixel * 3LL, copyPixels * 3LL,
+                        width * 3LL, width, *startY);
+        dist->samples = imageSize * 3ULL;
+        free(original);
+    }
+    return 1;
+}
+
+/**
+ * @brief Встраивает сообщение в BMP-изображение со случайной стартовой позицией и сохраняет результат.
+ *
+ * Функция не взаимодействует с пользователем. Генератор rand() должен быть
+ * проинициализирован вызывающей стороной. С пределом памяти (--max-memory)
+ * изображение обрабатывается окнами строк (stream_color_encode_file).
+ *
+ * @param filename Путь к исходному BMP-файлу.
+ * @param outputFileName Путь к файлу для сохранения результата.
+ * @param message Сообщение для скрытия.
+ * @param startX Указатель для сохранения координаты X начала сообщения.
+ * @param startY Указатель для сохранения координаты Y начала сообщения.
+ * @param dist Накопитель метрик искажения или NULL, если метрики не нужны.
+ * @return 1 в случае успеха, 0 в случае ошибки.
+ */
+int color_encode(const char *filename, const char *outputFileName, const char *message,
+                 int *startX, int *startY, DISTORTION *dist)
+{
+    if (stream_max_memory())
+        return stream_color_encode_file(filename, outputFileName, message, startX, startY, dist);
+
+    BMP_FILE img;
+    if (!bmp_load(filename, &img, 1))
+        return 0; // Ошибка при загрузке изображения
+
+    int saved = bmp_prepare_output(&img, outputFileName) && color_embed_image(&img, message, startX, startY, dist) &&
+                bmp_save(outputFileName, &img);
+    bmp_free(&img);
+    return saved;
+}
+
+/**
+ * @brief Выполняет процесс шифрования сообщения в BMP-изображение с сохранением ключа.
+ *
+ * Эта функция запрашивает у пользователя исходное BMP-изображение, сообщение для скрытия
+ * и имя выходного файла, встраивает сообщение со случайной стартовой позиции,
+ * сохраняет полученное изображение и ключ (координаты и длину сообщения) в файл "color_key".
+ *
+ * @return Возвращает 0 при успешном выполнении, или 1 при возникновении ошибок.
+ */
+int color()
+{
+    char filename[256], message[1000], outputFileName[256];
+    BMP_HEADER header;
+    int startX, startY;
+
+    printf("\nBMP Image Text Encryption\n");
+    printf("=========================\n\n");
+
+    printf("Enter BMP filename: ");
+    scanf("%s", filename);
+
+    if (!read_bmp_header(filename, &header))
+    {
+        printf("Error: Cannot open file %s or its BMP format is not supported\n", filename);
+        return 1; // Ошибка при загрузке изображения
+    }
+
+    printf("\nImage loaded successfully!\n");
+    printf("Enter message to hide: ");
+    getchar(); // consume leftover newline
+    fgets(message, sizeof(message), stdin);
+    message[strcspn(message, "\n")] = '\0'; // удаление символа новой строки
+
+    // с глобальным --passphrase-file встраивается зашифрованное сообщение
+    const char *passphrase = aead_passphrase();
+    char *sealed = passphrase ? aead_seal_text(passphrase, message) : NULL;
+    if (passphrase && !sealed)
+        return 1;
+    const char *payload = sealed ? sealed : message;
+
+    printf("Enter output filename: ");
+    scanf("%s", outputFileName);
+
+    srand(time(NULL));
+    int ok = color_encode(filename, outputFileName, payload, &startX, &startY, NULL);
+    int messageLen = (int)strlen(payload);
+    free(sealed);
+    if (!ok)
+    {
+        printf("Failed to save the image.\n");
+        return 1; // Ошибка при сохранении файла
+    }
+
+    printf("\nImage saved as %s\n", outputFileName);
+    if (saveColorKey("color_key", startX, startY, messageLen))
+        printf("Key information saved to 'color_key' file.\n");
+    return 0; // Успешное завершение
+}
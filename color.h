@@ -1,6 +1,14 @@
-#ifndef COLOR_H
-#define COLOR_H
-
-int color();
-
+#ifndef COLOR_H
+#define COLOR_H
+
+#include "bmpinfo.h"
+#include "metrics.h"
+
+void hideMessage(BMP_FILE *img, const char *message, int startX, int startY);
+int color_embed_image(BMP_FILE *img, const char *message, int *startX, int *startY, DISTORTION *dist);
+int saveColorKey(const char *keyFilename, int x, int y, int messageLen);
+int color_encode(const char *filename, const char *outputFileName, const char *message,
+                 int *startX, int *startY, DISTORTION *dist);
+int color();
+
 #endif
\ No newline at end of file
@@ -1,6 +1,11 @@
-#ifndef COLOR_DEC_H
-#define COLOR_DEC_H
-
-int color_dec();
-
+#ifndef COLOR_DEC_H
+#define COLOR_DEC_H
+
+#include "bmpinfo.h"
+
+char *extract_Message(const BMP_FILE *img, int startX, int startY, int messageLen);
+int load_color_key(const char *keyFilename, int *x, int *y, int *messageLen);
+char *color_decode(const char *filename, const char *keyFilename);
+int color_dec();
+
 #endif
\ No newline at end of file
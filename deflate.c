@@ -0,0 +1,918 @@
+#include <stdlib.h>
+#include <string.h>
+#include "deflate.h"
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_MIN_MATCH 4  // совпадения ищутся по хешу 4 байт
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_BLOCK_SYMBOLS 32768 // символов в одном блоке с собственными кодами Хаффмана
+#define DEFLATE_MAX_BITS 15
+#define DEFLATE_STORED_MAX 65535
+
+#define INFLATE_FAST_BITS 10
+
+// Основания и дополнительные биты кодов длины (257..285) и расстояния (0..29), RFC 1951
+static const unsigned short lengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                              31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                              2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short distBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+                                            33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+                                            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Порядок длин кодов алфавита длин кодов в заголовке динамического блока
+static const unsigned char codeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/**
+ * @brief Обновляет контрольную сумму Adler-32 (RFC 1950).
+ *
+ * @param adler Текущее значение (1 для начала потока).
+ * @param data Данные.
+ * @param size Размер данных.
+ * @return Новое значение контрольной суммы.
+ */
+static unsigned int adler32(unsigned int adler, const unsigned char *data, size_t size)
+{
+    unsigned int a = adler & 0xFFFF, b = adler >> 16;
+
+    while (size > 0)
+    {
+        // 5552 - наибольшее число шагов, после которого b еще не переполняет 32 бита
+        size_t n = size < 5552 ? size : 5552;
+        size -= n;
+        while (n--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/**
+ * @brief Переворачивает порядок младших bits бит: коды Хаффмана записываются
+ * старшим битом вперед, а поток битов DEFLATE заполняется с младших.
+ */
+static unsigned int reverse_bits(unsigned int code, int bits)
+{
+    unsigned int result = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Сжатие
+// ---------------------------------------------------------------------------
+
+typedef struct
+{
+    unsigned short value; // литерал (0..255) или длина совпадения (3..258)
+    unsigned short dist;  // расстояние совпадения, 0 - литерал
+} LZ_SYMBOL;
+
+typedef struct
+{
+    unsigned char *data;
+    size_t size, capacity;
+    unsigned long long bits; // еще не записанные биты, младшие - первые
+    int count;
+    int failed; // не хватило памяти
+} BIT_WRITER;
+
+typedef struct
+{
+    unsigned char lengthCode[256]; // код длины - 257 для длины 3..258
+    unsigned char distCode[512];   // код расстояния: [d - 1] для d <= 256, [256 + ((d - 1) >> 7)] иначе
+} DEFLATE_TABLES;
+
+typedef struct
+{
+    unsigned char litLengths[288], distLengths[30]; // фиксированные коды определены для 288 литералов
+    unsigned short litCodes[288], distCodes[30];    // коды с переставленными битами
+} DEFLATE_CODES;
+
+/**
+ * @brief Заполняет таблицы кодов длины и расстояния.
+ */
+static void deflate_tables(DEFLATE_TABLES *t)
+{
+    for (int code = 0; code < 29; code++)
+    {
+        int count = code == 28 ? 1 : 1 << lengthExtra[code];
+        for (int i = 0; i < count; i++)
+            t->lengthCode[lengthBase[code] - 3 + i] = (unsigned char)code;
+    }
+    for (int code = 0; code < 30; code++)
+    {
+        int count = 1 << distExtra[code];
+        for (int i = 0; i < count; i++)
+        {
+            int d = distBase[code] + i;
+            if (d <= 256)
+                t->distCode[d - 1] = (unsigned char)code;
+            else
+                t->distCode[256 + ((d - 1) >> 7)] = (unsigned char)code;
+        }
+    }
+}
+
+static int dist_code(const DEFLATE_TABLES *t, int dist)
+{
+    return dist <= 256 ? t->distCode[dist - 1] : t->distCode[256 + ((dist - 1) >> 7)];
+}
+
+/**
+ * @brief Гарантирует, что в буфере есть место еще для extra байт.
+ */
+static void writer_reserve(BIT_WRITER *w, size_t extra)
+{
+    if (w->failed || w->size + extra <= w->capacity)
+        return;
+
+    size_t capacity = w->capacity * 2;
+    if (capacity < w->size + extra)
+        capacity = w->size + extra;
+    unsigned char *data = realloc(w->data, capacity);
+    if (!data)
+    {
+        w->failed = 1;
+        return;
+    }
+    w->data = data;
+    w->capacity = capacity;
+}
+
+/**
+ * @brief Добавляет в поток n бит (n <= 32); место должно быть зарезервировано заранее.
+ */
+static void put_bits(BIT_WRITER *w, unsigned int value, int n)
+{
+    w->bits |= (unsigned long long)value << w->count;
+    w->count += n;
+    while (w->count >= 8)
+    {
+        w->data[w->size++] = (unsigned char)w->bits;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+/**
+ * @brief Дописывает неполный байт нулевыми битами.
+ */
+static void align_byte(BIT_WRITER *w)
+{
+    if (w->count > 0)
+        put_bits(w, 0, 8 - w->count);
+}
+
+/**
+ * @brief Строит длины кодов Хаффмана не длиннее maxBits для заданных частот.
+ *
+ * Дерево строится двумя очередями по отсортированным частотам; если оно
+ * глубже maxBits, длины укорачиваются с сохранением неравенства Крафта,
+ * и самые частые символы получают самые короткие коды.
+ */
+static void huffman_lengths(const unsigned int *freq, int n, int maxBits, unsigned char *lengths)
+{
+    unsigned int weight[2 * 286];
+    unsigned short symbol[286];
+    int parent[2 * 286], depth[2 * 286];
+    int count = 0;
+
+    memset(lengths, 0, n);
+    for (int s = 0; s < n; s++)
+    {
+        if (freq[s])
+            symbol[count++] = (unsigned short)s;
+    }
+
+    // коду из одного символа нужна ненулевая длина, а декодерам - хотя бы два кода
+    if (count < 2)
+    {
+        int s = count ? symbol[0] : 0;
+        lengths[s] = 1;
+        lengths[s == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    // сортировка вставками по возрастанию частоты: символов не больше 286
+    for (int i = 1; i < count; i++)
+    {
+        unsigned short s = symbol[i];
+        int j = i;
+        while (j > 0 && freq[symbol[j - 1]] > freq[s])
+        {
+            symbol[j] = symbol[j - 1];
+            j--;
+        }
+        symbol[j] = s;
+    }
+    for (int i = 0; i < count; i++)
+        weight[i] = freq[symbol[i]];
+
+    // листья 0..count-1, внутренние узлы создаются по возрастанию веса
+    int leaf = 0, node = count;
+    for (int next = count; next < 2 * count - 1; next++)
+    {
+        int pick[2];
+        for (int k = 0; k < 2; k++)
+        {
+            if (leaf < count && (node >= next || weight[leaf] <= weight[node]))
+                pick[k] = leaf++;
+            else
+                pick[k] = node++;
+        }
+        weight[next] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = next;
+    }
+
+    // родитель всегда создан позже потомка
+    depth[2 * count - 2] = 0;
+    for (int i = 2 * count - 3; i >= 0; i--)
+        depth[i] = depth[parent[i]] + 1;
+
+    int blCount[DEFLATE_MAX_BITS + 1] = {0};
+    for (int i = 0; i < count; i++)
+        blCount[depth[i] > maxBits ? maxBits : depth[i]]++;
+
+    unsigned int total = 0;
+    for (int b = 1; b <= maxBits; b++)
+        total += (unsigned int)blCount[b] << (maxBits - b);
+    while (total != 1u << maxBits)
+    {
+        // убираем один код длины maxBits и расщепляем самый длинный из более коротких
+        blCount[maxBits]--;
+        for (int b = maxBits - 1; b > 0; b--)
+        {
+            if (blCount[b])
+            {
+                blCount[b]--;
+                blCount[b + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    int i = 0;
+    for (int b = maxBits; b >= 1; b--)
+    {
+        for (int k = 0; k < blCount[b]; k++)
+            lengths[symbol[i++]] = (unsigned char)b;
+    }
+}
+
+/**
+ * @brief Назначает канонические коды по длинам (RFC 1951, 3.2.2).
+ */
+static void huffman_codes(const unsigned char *lengths, int n, unsigned short *codes)
+{
+    int blCount[DEFLATE_MAX_BITS + 1] = {0};
+    unsigned int next[DEFLATE_MAX_BITS + 1];
+
+    for (int s = 0; s < n; s++)
+        blCount[lengths[s]]++;
+    blCount[0] = 0;
+
+    unsigned int code = 0;
+    for (int b = 1; b <= DEFLATE_MAX_BITS; b++)
+    {
+        code = (code + blCount[b - 1]) << 1;
+        next[b] = code;
+    }
+    for (int s = 0; s < n; s++)
+        codes[s] = lengths[s] ? (unsigned short)reverse_bits(next[lengths[s]]++, lengths[s]) : 0;
+}
+
+/**
+ * @brief Кодирует длины кодов литералов и расстояний повторами 16, 17 и 18.
+ *
+ * @param lengths Подряд идущие длины кодов литералов и расстояний.
+ * @param n Количество длин.
+ * @param out Символы алфавита длин кодов: (символ | дополнительные биты << 8).
+ * @return Количество символов.
+ */
+static int rle_lengths(const unsigned char *lengths, int n, unsigned short *out)
+{
+    int count = 0;
+    for (int i = 0; i < n;)
+    {
+        int run = 1;
+        while (i + run < n && lengths[i + run] == lengths[i])
+            run++;
+
+        if (lengths[i] == 0 && run >= 3)
+        {
+            int r = run > 138 ? 138 : run;
+            out[count++] = r >= 11 ? (unsigned short)(18 | (r - 11) << 8) : (unsigned short)(17 | (r - 3) << 8);
+            i += r;
+        }
+        else if (lengths[i] != 0 && run >= 4)
+        {
+            out[count++] = lengths[i];
+            int r = run - 1 > 6 ? 6 : run - 1;
+            out[count++] = (unsigned short)(16 | (r - 3) << 8);
+            i += 1 + r;
+        }
+        else
+        {
+            out[count++] = lengths[i];
+            i++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Записывает символы блока кодами Хаффмана.
+ */
+static void write_symbols(BIT_WRITER *w, const DEFLATE_TABLES *t, const DEFLATE_CODES *c, const LZ_SYMBOL *symbols,
+                          int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const LZ_SYMBOL *s = &symbols[i];
+        if (s->dist == 0)
+        {
+            put_bits(w, c->litCodes[s->value], c->litLengths[s->value]);
+            continue;
+        }
+
+        int lc = t->lengthCode[s->value - 3];
+        put_bits(w, c->litCodes[257 + lc], c->litLengths[257 + lc]);
+        put_bits(w, s->value - lengthBase[lc], lengthExtra[lc]);
+
+        int dc = dist_code(t, s->dist);
+        put_bits(w, c->distCodes[dc], c->distLengths[dc]);
+        put_bits(w, s->dist - distBase[dc], distExtra[dc]);
+    }
+    put_bits(w, c->litCodes[256], c->litLengths[256]);
+}
+
+/**
+ * @brief Размер символов блока в битах при заданных длинах кодов.
+ */
+static unsigned long long symbols_cost(const unsigned int *litFreq, const unsigned int *distFreq,
+                                       const unsigned char *litLengths, const unsigned char *distLengths)
+{
+    unsigned long long bits = 0;
+    for (int s = 0; s < 286; s++)
+        bits += (unsigned long long)litFreq[s] * (litLengths[s] + (s >= 257 ? lengthExtra[s - 257] : 0));
+    for (int s = 0; s < 30; s++)
+        bits += (unsigned long long)distFreq[s] * (distLengths[s] + distExtra[s]);
+    return bits;
+}
+
+/**
+ * @brief Записывает блок: с динамическими кодами, с фиксированными или без сжатия,
+ * в зависимости от того, что короче.
+ *
+ * @param raw Исходные байты, которые покрывает блок (для блока без сжатия).
+ * @param rawSize Их количество.
+ */
+static void write_block(BIT_WRITER *w, const DEFLATE_TABLES *t, const LZ_SYMBOL *symbols, int count,
+                        const unsigned char *raw, size_t rawSize, int final)
+{
+    unsigned int litFreq[286] = {0}, distFreq[30] = {0};
+    for (int i = 0; i < count; i++)
+    {
+        if (symbols[i].dist == 0)
+            litFreq[symbols[i].value]++;
+        else
+        {
+            litFreq[257 + t->lengthCode[symbols[i].value - 3]]++;
+            distFreq[dist_code(t, symbols[i].dist)]++;
+        }
+    }
+    litFreq[256] = 1;
+
+    DEFLATE_CODES dynamic, fixed;
+    huffman_lengths(litFreq, 286, DEFLATE_MAX_BITS, dynamic.litLengths);
+    huffman_lengths(distFreq, 30, DEFLATE_MAX_BITS, dynamic.distLengths);
+
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && dynamic.litLengths[hlit - 1] == 0)
+        hlit--;
+    while (hdist > 1 && dynamic.distLengths[hdist - 1] == 0)
+        hdist--;
+
+    unsigned char allLengths[286 + 30];
+    unsigned short rle[286 + 30];
+    memcpy(allLengths, dynamic.litLengths, hlit);
+    memcpy(allLengths + hlit, dynamic.distLengths, hdist);
+    int rleCount = rle_lengths(allLengths, hlit + hdist, rle);
+
+    unsigned int clFreq[19] = {0};
+    unsigned char clLengths[19];
+    unsigned short clCodes[19];
+    for (int i = 0; i < rleCount; i++)
+        clFreq[rle[i] & 0xFF]++;
+    huffman_lengths(clFreq, 19, 7, clLengths);
+    huffman_codes(clLengths, 19, clCodes);
+
+    int hclen = 19;
+    while (hclen > 4 && clLengths[codeLengthOrder[hclen - 1]] == 0)
+        hclen--;
+
+    unsigned long long dynamicBits = 3 + 5 + 5 + 4 + 3ULL * hclen;
+    for (int i = 0; i < rleCount; i++)
+    {
+        int sym = rle[i] & 0xFF;
+        dynamicBits += clLengths[sym] + (sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0);
+    }
+    dynamicBits += symbols_cost(litFreq, distFreq, dynamic.litLengths, dynamic.distLengths);
+
+    for (int s = 0; s < 288; s++)
+        fixed.litLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+    memset(fixed.distLengths, 5, sizeof(fixed.distLengths));
+    unsigned long long fixedBits = 3 + symbols_cost(litFreq, distFreq, fixed.litLengths, fixed.distLengths);
+
+    size_t storedChunks = rawSize / DEFLATE_STORED_MAX + 1;
+    unsigned long long storedBits = (rawSize + storedChunks * 5 + 1) * 8ULL;
+
+    writer_reserve(w, (size_t)((dynamicBits < storedBits ? storedBits : dynamicBits) / 8) + 16);
+    if (w->failed)
+        return;
+
+    if (storedBits <= dynamicBits && storedBits <= fixedBits)
+    {
+        for (size_t offset = 0, i = 0; i < storedChunks; i++)
+        {
+            size_t n = rawSize - offset < DEFLATE_STORED_MAX ? rawSize - offset : DEFLATE_STORED_MAX;
+            put_bits(w, final && i == storedChunks - 1, 1);
+            put_bits(w, 0, 2);
+            align_byte(w);
+            put_bits(w, (unsigned int)n, 16);
+            put_bits(w, (unsigned int)n ^ 0xFFFF, 16);
+            memcpy(w->data + w->size, raw + offset, n);
+            w->size += n;
+            offset += n;
+        }
+        return;
+    }
+
+    put_bits(w, final, 1);
+    if (fixedBits <= dynamicBits)
+    {
+        put_bits(w, 1, 2);
+        huffman_codes(fixed.litLengths, 288, fixed.litCodes);
+        huffman_codes(fixed.distLengths, 30, fixed.distCodes);
+        write_symbols(w, t, &fixed, symbols, count);
+        return;
+    }
+
+    put_bits(w, 2, 2);
+    put_bits(w, hlit - 257, 5);
+    put_bits(w, hdist - 1, 5);
+    put_bits(w, hclen - 4, 4);
+    for (int i = 0; i < hclen; i++)
+        put_bits(w, clLengths[codeLengthOrder[i]], 3);
+    for (int i = 0; i < rleCount; i++)
+    {
+        int sym = rle[i] & 0xFF, extra = rle[i] >> 8;
+        put_bits(w, clCodes[sym], clLengths[sym]);
+        if (sym >= 16)
+            put_bits(w, extra, sym == 16 ? 2 : sym == 17 ? 3 : 7);
+    }
+    huffman_codes(dynamic.litLengths, 286, dynamic.litCodes);
+    huffman_codes(dynamic.distLengths, 30, dynamic.distCodes);
+    write_symbols(w, t, &dynamic, symbols, count);
+}
+
+static unsigned int load32(const unsigned char *p)
+{
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Сжимает данные в поток zlib (RFC 1950) быстрым уровнем DEFLATE.
+ *
+ * Совпадения ищутся жадно по хеш-таблице без цепочек: на каждую позицию
+ * проверяется один кандидат, как на самом быстром уровне zlib. Блоки по
+ * DEFLATE_BLOCK_SYMBOLS символов получают собственные коды Хаффмана;
+ * несжимаемые блоки записываются без сжатия.
+ *
+ * @param data Исходные данные.
+ * @param size Размер данных.
+ * @param compressedSize Указатель для сохранения размера результата.
+ * @return Буфер со сжатыми данными (освобождается вызывающей стороной) или NULL при нехватке памяти.
+ */
+unsigned char *zlib_compress(const unsigned char *data, size_t size, size_t *compressedSize)
+{
+    DEFLATE_TABLES tables;
+    deflate_tables(&tables);
+
+    BIT_WRITER w;
+    memset(&w, 0, sizeof(w));
+    w.capacity = size / 2 + 1024;
+    w.data = malloc(w.capacity);
+    unsigned int *head = calloc(1u << DEFLATE_HASH_BITS, sizeof(unsigned int)); // позиция + 1, 0 - пусто
+    LZ_SYMBOL *symbols = malloc(DEFLATE_BLOCK_SYMBOLS * sizeof(LZ_SYMBOL));
+    if (!w.data || !head || !symbols)
+    {
+        free(w.data);
+        free(head);
+        free(symbols);
+        return NULL;
+    }
+
+    put_bits(&w, 0x78, 8); // CM = 8 (deflate), окно 32 КБ
+    put_bits(&w, 0x01, 8); // FLEVEL = 0 (самый быстрый), (0x7801 % 31 == 0)
+
+    int count = 0;
+    size_t blockStart = 0, i = 0;
+    while (i < size)
+    {
+        size_t len = 0, dist = 0;
+        if (i + DEFLATE_MIN_MATCH <= size)
+        {
+            unsigned int v = load32(data + i);
+            unsigned int h = (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+            size_t candidate = head[h];
+            head[h] = (unsigned int)(i + 1);
+
+            if (candidate && i - (candidate - 1) <= DEFLATE_WINDOW && load32(data + candidate - 1) == v)
+            {
+                const unsigned char *match = data + candidate - 1;
+                size_t max = size - i < DEFLATE_MAX_MATCH ? size - i : DEFLATE_MAX_MATCH;
+                len = DEFLATE_MIN_MATCH;
+                while (len < max && match[len] == data[i + len])
+                    len++;
+                dist = i - (candidate - 1);
+            }
+        }
+
+        if (len)
+        {
+            symbols[count].value = (unsigned short)len;
+            symbols[count].dist = (unsigned short)dist;
+            i += len;
+        }
+        else
+        {
+            symbols[count].value = data[i];
+            symbols[count].dist = 0;
+            i++;
+        }
+        count++;
+
+        if (count == DEFLATE_BLOCK_SYMBOLS && i < size)
+        {
+            write_block(&w, &tables, symbols, count, data + blockStart, i - blockStart, 0);
+            blockStart = i;
+            count = 0;
+        }
+    }
+    write_block(&w, &tables, symbols, count, data + blockStart, size - blockStart, 1);
+
+    free(head);
+    free(symbols);
+
+    writer_reserve(&w, 8);
+    if (w.failed)
+    {
+        free(w.data);
+        return NULL;
+    }
+    align_byte(&w);
+    unsigned int adler = adler32(1, data, size);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        put_bits(&w, (adler >> shift) & 0xFF, 8);
+
+    *compressedSize = w.size;
+    return w.data;
+}
+
+// ---------------------------------------------------------------------------
+// Распаковка
+// ---------------------------------------------------------------------------
+
+typedef struct
+{
+    const unsigned char *data, *end;
+    unsigned long long bits;
+    int count;
+    int padding; // байты, добавленные нулями после конца данных
+} BIT_READER;
+
+typedef struct
+{
+    unsigned short fast[1 << INFLATE_FAST_BITS]; // (символ << 4) | длина для коротких кодов, 0 - длинный код
+    unsigned short first[DEFLATE_MAX_BITS + 1];  // первый канонический код каждой длины
+    unsigned short count[DEFLATE_MAX_BITS + 1];  // количество кодов каждой длины
+    unsigned short index[DEFLATE_MAX_BITS + 1];  // позиция первого символа длины в symbols
+    unsigned short symbols[288];                 // символы, упорядоченные по коду
+} HUFFMAN;
+
+static void refill(BIT_READER *r)
+{
+    while (r->count <= 56)
+    {
+        if (r->data < r->end)
+            r->bits |= (unsigned long long)*r->data++ << r->count;
+        else
+            r->padding++;
+        r->count += 8;
+    }
+}
+
+static unsigned int get_bits(BIT_READER *r, int n)
+{
+    if (r->count < n)
+        refill(r);
+    unsigned int value = (unsigned int)(r->bits & ((1ULL << n) - 1));
+    r->bits >>= n;
+    r->count -= n;
+    return value;
+}
+
+/**
+ * @brief Проверяет, что не прочитаны биты за концом данных.
+ */
+static int reader_ok(const BIT_READER *r)
+{
+    return r->padding * 8 <= r->count;
+}
+
+/**
+ * @brief Строит таблицы декодирования по длинам кодов.
+ *
+ * @return 1 при успехе, 0 если коды переопределены.
+ */
+static int huffman_build(HUFFMAN *h, const unsigned char *lengths, int n)
+{
+    unsigned int next[DEFLATE_MAX_BITS + 1];
+
+    memset(h, 0, sizeof(*h));
+    for (int s = 0; s < n; s++)
+        h->count[lengths[s]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int b = 1; b <= DEFLATE_MAX_BITS; b++)
+    {
+        left = (left << 1) - h->count[b];
+        if (left < 0)
+            return 0;
+    }
+
+    unsigned int code = 0, index = 0;
+    for (int b = 1; b <= DEFLATE_MAX_BITS; b++)
+    {
+        code = (code + h->count[b - 1]) << 1;
+        h->first[b] = (unsigned short)code;
+        h->index[b] = (unsigned short)index;
+        next[b] = code;
+        index += h->count[b];
+    }
+
+    unsigned short position[DEFLATE_MAX_BITS + 1];
+    memcpy(position, h->index, sizeof(position));
+    for (int s = 0; s < n; s++)
+    {
+        int len = lengths[s];
+        if (!len)
+            continue;
+        h->symbols[position[len]++] = (unsigned short)s;
+
+        unsigned int c = next[len]++;
+        if (len <= INFLATE_FAST_BITS)
+        {
+            for (unsigned int k = reverse_bits(c, len); k < (1u << INFLATE_FAST_BITS); k += 1u << len)
+                h->fast[k] = (unsigned short)(s << 4 | len);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Декодирует один символ.
+ *
+ * @return Символ или -1, если код не определен.
+ */
+static int huffman_decode(BIT_READER *r, const HUFFMAN *h)
+{
+    if (r->count < DEFLATE_MAX_BITS)
+        refill(r);
+
+    unsigned int entry = h->fast[r->bits & ((1u << INFLATE_FAST_BITS) - 1)];
+    if (entry)
+    {
+        r->bits >>= entry & 15;
+        r->count -= entry & 15;
+        return entry >> 4;
+    }
+
+    // длинный код: биты кода читаются старшим вперед
+    unsigned int code = 0;
+    for (int len = 1; len <= DEFLATE_MAX_BITS; len++)
+    {
+        code = (code << 1) | ((r->bits >> (len - 1)) & 1);
+        if (code - h->first[len] < h->count[len])
+        {
+            r->bits >>= len;
+            r->count -= len;
+            return h->symbols[h->index[len] + code - h->first[len]];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Читает описание кодов динамического блока.
+ */
+static int read_dynamic(BIT_READER *r, HUFFMAN *lit, HUFFMAN *dist)
+{
+    int hlit = get_bits(r, 5) + 257, hdist = get_bits(r, 5) + 1, hclen = get_bits(r, 4) + 4;
+    if (hlit > 286 || hdist > 30)
+        return 0;
+
+    unsigned char clLengths[19] = {0};
+    for (int i = 0; i < hclen; i++)
+        clLengths[codeLengthOrder[i]] = (unsigned char)get_bits(r, 3);
+
+    HUFFMAN cl;
+    if (!huffman_build(&cl, clLengths, 19))
+        return 0;
+
+    unsigned char lengths[286 + 30];
+    for (int n = 0; n < hlit + hdist;)
+    {
+        int sym = huffman_decode(r, &cl);
+        if (sym < 0)
+            return 0;
+        if (sym < 16)
+        {
+            lengths[n++] = (unsigned char)sym;
+            continue;
+        }
+
+        int repeat, value = 0;
+        if (sym == 16)
+        {
+            if (n == 0)
+                return 0;
+            value = lengths[n - 1];
+            repeat = 3 + get_bits(r, 2);
+        }
+        else if (sym == 17)
+            repeat = 3 + get_bits(r, 3);
+        else
+            repeat = 11 + get_bits(r, 7);
+
+        if (n + repeat > hlit + hdist)
+            return 0;
+        memset(lengths + n, value, repeat);
+        n += repeat;
+    }
+
+    if (lengths[256] == 0)
+        return 0;
+    return huffman_build(lit, lengths, hlit) && huffman_build(dist, lengths + hlit, hdist) && reader_ok(r);
+}
+
+/**
+ * @brief Распаковывает символы одного блока до кода конца блока.
+ */
+static int inflate_block(BIT_READER *r, const HUFFMAN *lit, const HUFFMAN *dist, unsigned char *out, size_t outSize,
+                         size_t *pos)
+{
+    size_t p = *pos;
+    for (;;)
+    {
+        int sym = huffman_decode(r, lit);
+        if (sym < 256)
+        {
+            if (sym < 0 || p >= outSize)
+                return 0;
+            out[p++] = (unsigned char)sym;
+            continue;
+        }
+        if (sym == 256)
+            break;
+
+        sym -= 257;
+        if (sym >= 29)
+            return 0;
+        size_t len = lengthBase[sym] + get_bits(r, lengthExtra[sym]);
+
+        int dsym = huffman_decode(r, dist);
+        if (dsym < 0 || dsym >= 30)
+            return 0;
+        size_t d = distBase[dsym] + get_bits(r, distExtra[dsym]);
+        if (d > p || len > outSize - p)
+            return 0;
+
+        unsigned char *dst = out + p;
+        const unsigned char *src = dst - d;
+        if (d >= len)
+            memcpy(dst, src, len);
+        else
+        {
+            for (size_t k = 0; k < len; k++)
+                dst[k] = src[k];
+        }
+        p += len;
+
+        if (r->padding > 8)
+            return 0;
+    }
+    *pos = p;
+    return reader_ok(r);
+}
+
+/**
+ * @brief Распаковывает поток zlib (RFC 1950) известного размера.
+ *
+ * @param data Сжатые данные.
+ * @param size Размер сжатых данных.
+ * @param out Буфер для результата.
+ * @param outSize Ожидаемый размер результата.
+ * @return 1 если поток корректен, распакован ровно в outSize байт и контрольная сумма совпала, иначе 0.
+ */
+int zlib_decompress(const unsigned char *data, size_t size, unsigned char *out, size_t outSize)
+{
+    if (size < 6 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 ||
+        (data[1] & 0x20))
+        return 0;
+
+    BIT_READER r;
+    memset(&r, 0, sizeof(r));
+    r.data = data + 2;
+    r.end = data + size;
+
+    HUFFMAN *lit = malloc(2 * sizeof(HUFFMAN));
+    if (!lit)
+        return 0;
+    HUFFMAN *dist = lit + 1;
+
+    size_t pos = 0;
+    int final = 0, ok = 1;
+    while (ok && !final)
+    {
+        final = get_bits(&r, 1);
+        int type = get_bits(&r, 2);
+
+        if (type == 0)
+        {
+            get_bits(&r, r.count % 8);
+            size_t len = get_bits(&r, 16), nlen = get_bits(&r, 16);
+            if (len != (nlen ^ 0xFFFF) || len > outSize - pos || !reader_ok(&r))
+            {
+                ok = 0;
+                break;
+            }
+            // остаток буфера битов - целые байты
+            while (len > 0 && r.count >= 8)
+            {
+                out[pos++] = (unsigned char)get_bits(&r, 8);
+                len--;
+            }
+            if (len > (size_t)(r.end - r.data))
+            {
+                ok = 0;
+                break;
+            }
+            memcpy(out + pos, r.data, len);
+            r.data += len;
+            pos += len;
+            if (!reader_ok(&r))
+                ok = 0;
+        }
+        else if (type == 1)
+        {
+            unsigned char lengths[288 + 30];
+            for (int s = 0; s < 288; s++)
+                lengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+            memset(lengths + 288, 5, 30);
+            ok = huffman_build(lit, lengths, 288) && huffman_build(dist, lengths + 288, 30) &&
+                 inflate_block(&r, lit, dist, out, outSize, &pos);
+        }
+        else if (type == 2)
+            ok = read_dynamic(&r, lit, dist) && inflate_block(&r, lit, dist, out, outSize, &pos);
+        else
+            ok = 0;
+    }
+    free(lit);
+
+    if (!ok || pos != outSize)
+        return 0;
+
+    get_bits(&r, r.count % 8);
+    unsigned int expected = 0;
+    for (int i = 0; i < 4; i++)
+        expected = (expected << 8) | get_bits(&r, 8);
+    return reader_ok(&r) && expected == adler32(1, out, outSize);
+}
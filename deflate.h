@@ -0,0 +1,9 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stddef.h>
+
+unsigned char *zlib_compress(const unsigned char *data, size_t size, size_t *compressedSize);
+int zlib_decompress(const unsigned char *data, size_t size, unsigned char *out, size_t outSize);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,703 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bmpinfo.h"
+#include "simple.h"
+#include "simple_dec.h"
+#include "stats.h"
+#include "stream.h"
+#include "ecc.h"
+
+// Таблицы поля и порождающий многочлен кода с parity проверочными байтами
+typedef struct
+{
+    unsigned char exp[512], log[256];
+    int parity;
+    // genLo[t][k] = g(k+1) * t, genHi[t][k] = g(k+1) * 16t, где g(1)..g(parity) - коэффициенты g(x)
+    // после старшего; за parity - нули. Шаг регистра сдвига для байта f складывает строки
+    // genLo[f & 15] и genHi[f >> 4] со сдвинутым остатком - по 16 проверочных байтов за операцию
+    unsigned char genLo[16][ECC_MAX_PARITY], genHi[16][ECC_MAX_PARITY];
+} RS_CODE;
+
+/**
+ * @brief Умножение в GF(2^8) без таблиц (для построения таблиц и эталонных проверок).
+ */
+unsigned char gf_mul(unsigned char a, unsigned char b)
+{
+    unsigned int r = 0, x = a;
+    for (; b; b >>= 1)
+    {
+        if (b & 1)
+            r ^= x;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x11d;
+    }
+    return (unsigned char)r;
+}
+
+static inline unsigned char gf_mul_log(const RS_CODE *rs, unsigned char a, unsigned char b)
+{
+    return a && b ? rs->exp[rs->log[a] + rs->log[b]] : 0;
+}
+
+static inline unsigned char gf_div_log(const RS_CODE *rs, unsigned char a, unsigned char b)
+{
+    return a ? rs->exp[rs->log[a] + 255 - rs->log[b]] : 0;
+}
+
+static RS_CODE *rs_create(int parity)
+{
+    RS_CODE *rs = calloc(1, sizeof(RS_CODE));
+    if (!rs)
+        return NULL;
+    rs->parity = parity;
+    unsigned char x = 1;
+    for (int i = 0; i < 255; i++)
+    {
+        rs->exp[i] = rs->exp[i + 255] = x;
+        rs->log[x] = (unsigned char)i;
+        x = gf_mul(x, 2);
+    }
+    rs->exp[510] = rs->exp[0];
+    rs->exp[511] = rs->exp[1];
+    rs->log[0] = 0;
+
+    // g(x) = (x - 1)(x - a)...(x - a^(parity-1))
+    unsigned char g[ECC_MAX_PARITY + 1] = {1};
+    for (int i = 0; i < parity; i++)
+    {
+        unsigned char root = rs->exp[i];
+        for (int j = i + 1; j > 0; j--)
+            g[j] ^= gf_mul_log(rs, g[j - 1], root);
+    }
+    for (int t = 0; t < 16; t++)
+        for (int k = 0; k < parity; k++)
+        {
+            rs->genLo[t][k] = gf_mul_log(rs, g[k + 1], (unsigned char)t);
+            rs->genHi[t][k] = gf_mul_log(rs, g[k + 1], (unsigned char)(t << 4));
+        }
+    return rs;
+}
+
+/**
+ * @brief Шаг деления на g(x) регистром сдвига: остаток rem (parity байтов, старший первым, за ним
+ * не меньше 16 нулевых байтов) после очередного байта данных.
+ *
+ * Множитель f один для всех проверочных байтов, поэтому произведения g(k+1) * f берутся
+ * готовыми строками таблиц: с SSE2 шаг - по две загрузки и сложения на 16 байтов остатка.
+ */
+static inline void rs_step(const RS_CODE *rs, unsigned char *rem, unsigned char data)
+{
+    unsigned char f = data ^ rem[0];
+    const unsigned char *lo = rs->genLo[f & 15], *hi = rs->genHi[f >> 4];
+    int p = rs->parity;
+#ifdef __SSE2__
+    // чтение rem[k + 16] опережает его запись следующей итерацией
+    for (int k = 0; k < p; k += 16)
+        _mm_storeu_si128((__m128i *)(rem + k),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)(rem + k + 1)),
+                                       _mm_xor_si128(_mm_loadu_si128((const __m128i *)(lo + k)),
+                                                     _mm_loadu_si128((const __m128i *)(hi + k)))));
+#else
+    for (int k = 0; k < p; k++)
+        rem[k] = rem[k + 1] ^ lo[k] ^ hi[k];
+#endif
+}
+
+/**
+ * @brief Остаток от деления на g(x) первых d байтов кодового слова b (байт j - body[j*lanes+b]),
+ * то есть проверочные байты, которые кодер записал бы для этих данных.
+ */
+static void rs_remainder(const RS_CODE *rs, const unsigned char *body, int lanes, int b, int d, unsigned char *rem)
+{
+    memset(rem, 0, ECC_MAX_PARITY + 16);
+    for (int j = 0; j < d; j++)
+        rs_step(rs, rem, body[(size_t)j * lanes + b]);
+}
+
+/**
+ * @brief Проверочные байты кодовых слов lanes, перемежаемых побайтно (байт j слова b - body[j*lanes+b]).
+ */
+static void rs_encode(const RS_CODE *rs, unsigned char *body, int lanes, int d)
+{
+    unsigned char rem[ECC_MAX_PARITY + 16];
+    for (int b = 0; b < lanes; b++)
+    {
+        rs_remainder(rs, body, lanes, b, d, rem);
+        for (int k = 0; k < rs->parity; k++)
+            body[(size_t)(d + k) * lanes + b] = rem[k];
+    }
+}
+
+/**
+ * @brief Синдромы S_i = c(a^i) всех кодовых слов длины n: syndromes[i*lanes+b].
+ *
+ * Корни a^i - корни g(x), поэтому c(a^i) = R(a^i), где R - остаток от деления слова на g(x):
+ * сумма проверочных байтов, пересчитанных по данным слова, и прочитанных. У неповрежденного
+ * слова остаток нулевой, и синдромы не вычисляются; у поврежденного R из parity байтов
+ * вычисляется в parity точках схемой Горнера.
+ */
+static void rs_syndromes(const RS_CODE *rs, const unsigned char *body, int lanes, int n, unsigned char *syndromes)
+{
+    int p = rs->parity, d = n - p;
+    unsigned char rem[ECC_MAX_PARITY + 16];
+    for (int b = 0; b < lanes; b++)
+    {
+        rs_remainder(rs, body, lanes, b, d, rem);
+        int dirty = 0;
+        for (int k = 0; k < p; k++)
+            dirty |= rem[k] ^= body[(size_t)(d + k) * lanes + b];
+        // R(a^i) = сумма R_k * a^(i*(p-1-k)): логарифм слагаемого k растет на p-1-k с каждым i
+        int logTerm[ECC_MAX_PARITY], terms = 0, step[ECC_MAX_PARITY];
+        for (int k = 0; dirty && k < p; k++)
+            if (rem[k])
+            {
+                logTerm[terms] = rs->log[rem[k]];
+                step[terms++] = p - 1 - k;
+            }
+        for (int i = 0; i < p; i++)
+        {
+            unsigned char s = 0;
+            for (int t = 0; t < terms; t++)
+            {
+                s ^= rs->exp[logTerm[t]];
+                logTerm[t] += step[t];
+                if (logTerm[t] >= 255)
+                    logTerm[t] -= 255;
+            }
+            syndromes[(size_t)i * lanes + b] = s;
+        }
+    }
+}
+
+/**
+ * @brief Исправляет до parity/2 ошибочных байтов кодового слова длины n по его синдромам:
+ * многочлен локаторов - алгоритмом Берлекэмпа-Мэсси, позиции - перебором Ченя,
+ * значения - формулой Форни.
+ *
+ * @return Количество исправленных байтов или -1, если ошибок больше, чем код исправляет.
+ */
+static int rs_correct(const RS_CODE *rs, unsigned char *cw, int n, const unsigned char *syn)
+{
+    int p = rs->parity, L = 0, m = 1;
+    unsigned char C[ECC_MAX_PARITY + 1] = {1}, B[ECC_MAX_PARITY + 1] = {1}, T[ECC_MAX_PARITY + 1];
+    unsigned char b = 1;
+
+    for (int r = 0; r < p; r++)
+    {
+        unsigned char delta = syn[r];
+        for (int i = 1; i <= L; i++)
+            delta ^= gf_mul_log(rs, C[i], syn[r - i]);
+        if (!delta)
+        {
+            m++;
+            continue;
+        }
+        // C(x) -= delta / b * x^m * B(x); степень B не больше L
+        int logCoef = rs->log[delta] + 255 - rs->log[b];
+        memcpy(T, C, sizeof(C));
+        for (int i = 0; i <= L && i + m <= p; i++)
+            if (B[i])
+                C[i + m] ^= rs->exp[(logCoef + rs->log[B[i]]) % 255];
+        if (2 * L <= r)
+        {
+            L = r + 1 - L;
+            memcpy(B, T, sizeof(B));
+            b = delta;
+            m = 1;
+        }
+        else
+            m++;
+    }
+    if (2 * L > p)
+        return -1;
+
+    // многочлен значений ошибок: Omega(x) = S(x) * Lambda(x) mod x^p
+    unsigned char omega[ECC_MAX_PARITY];
+    for (int i = 0; i < p; i++)
+    {
+        omega[i] = 0;
+        for (int k = 0; k <= i && k <= L; k++)
+            omega[i] ^= gf_mul_log(rs, C[k], syn[i - k]);
+    }
+
+    // Чень: логарифмы слагаемых C_i * X^-i; у следующего байта X^-1 больше в a раз,
+    // поэтому логарифм слагаемого i растет на i
+    int logTerm[ECC_MAX_PARITY + 1], inv0 = (256 - n) % 255;
+    for (int i = 0; i <= L; i++)
+        logTerm[i] = C[i] ? (rs->log[C[i]] + inv0 * i) % 255 : -1;
+
+    int found = 0;
+    for (int j = 0; j < n && found < L; j++)
+    {
+        int e = n - 1 - j;        // байт j - коэффициент при x^e, локатор X = a^e
+        int inv = (255 - e) % 255; // log X^-1
+        unsigned char lambda = 0, derivative = 0, value = 0;
+        for (int i = 0; i <= L; i++)
+            if (logTerm[i] >= 0)
+            {
+                lambda ^= rs->exp[logTerm[i]];
+                logTerm[i] += i;
+                if (logTerm[i] >= 255)
+                    logTerm[i] -= 255;
+            }
+        if (lambda)
+            continue;
+        // Lambda'(X^-1) = сумма C_i * X^-(i-1) по нечетным i, Omega(X^-1) - схемой Горнера
+        int inv2 = 2 * inv % 255;
+        for (int i = L - !(L & 1); i >= 1; i -= 2)
+            derivative = (derivative ? rs->exp[rs->log[derivative] + inv2] : 0) ^ C[i];
+        for (int i = p - 1; i >= 0; i--)
+            value = (value ? rs->exp[rs->log[value] + inv] : 0) ^ omega[i];
+        if (!derivative)
+            return -1;
+        // Форни для корней, начинающихся с a^0: e = X * Omega(X^-1) / Lambda'(X^-1)
+        cw[j] ^= gf_mul_log(rs, rs->exp[e], gf_div_log(rs, value, derivative));
+        found++;
+    }
+    return found == L ? L : -1;
+}
+
+/**
+ * @brief Допустимое число проверочных байтов: четное от ECC_MIN_PARITY до ECC_MAX_PARITY.
+ */
+int ecc_valid_parity(int parity)
+{
+    return parity >= ECC_MIN_PARITY && parity <= ECC_MAX_PARITY && parity % 2 == 0;
+}
+
+/**
+ * @brief Разбиение сообщения на кодовые слова: количество слов и байтов данных в каждом.
+ */
+static void ecc_layout(size_t size, int parity, size_t *lanes, int *d)
+{
+    size_t k = 255 - parity;
+    *lanes = (size + k - 1) / k;
+    *d = *lanes ? (int)((size + *lanes - 1) / *lanes) : 0;
+}
+
+/**
+ * @brief Размер сообщения после кодирования с заголовком.
+ */
+size_t ecc_coded_size(size_t size, int parity)
+{
+    size_t lanes;
+    int d;
+    ecc_layout(size, parity, &lanes, &d);
+    return ECC_HEADER_SIZE + lanes * (d + parity);
+}
+
+/**
+ * @brief Наибольший размер сообщения, которое после кодирования занимает не больше
+ * codedCapacity байтов (0, если не помещается даже заголовок).
+ */
+size_t ecc_max_size(size_t codedCapacity, int parity)
+{
+    // ecc_coded_size не убывает с ростом размера: двоичный поиск
+    size_t lo = 0, hi = codedCapacity;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (ecc_coded_size(mid, parity) <= codedCapacity)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/**
+ * @brief Байты кодового слова заголовка, предшествующие самому заголовку: префикс длины
+ * метода прямого шифрования, старший байт первым.
+ */
+static void ecc_prefix_bytes(unsigned int prefix, unsigned char *bytes)
+{
+    for (int i = 0; i < ECC_PREFIX_SIZE; i++)
+        bytes[i] = (unsigned char)(prefix >> (8 * (ECC_PREFIX_SIZE - 1 - i)));
+}
+
+/**
+ * @brief Кодирует сообщение; depth > 0 - сообщение метода прямого шифрования с этой глубиной,
+ * его префикс длины входит в кодовое слово заголовка.
+ */
+static unsigned char *ecc_encode_prefixed(const unsigned char *data, size_t size, int parity, int depth,
+                                          size_t *codedSize)
+{
+    if (!ecc_valid_parity(parity) || size == 0 || size > 0xFFFFFFFFu)
+    {
+        printf("Error: ECC needs a non-empty message and an even parity from %d to %d\n", ECC_MIN_PARITY,
+               ECC_MAX_PARITY);
+        stats_error(STAT_ERR_OTHER);
+        return NULL;
+    }
+
+    size_t lanes;
+    int d;
+    ecc_layout(size, parity, &lanes, &d);
+    *codedSize = ecc_coded_size(size, parity);
+    unsigned char *coded = calloc(*codedSize, 1);
+    RS_CODE *headerCode = rs_create(ECC_HEADER_PARITY), *rs = rs_create(parity);
+    if (!coded || !headerCode || !rs)
+    {
+        printf("Error: Not enough memory for the ECC-coded message\n");
+        stats_error(STAT_ERR_MEMORY);
+        free(coded);
+        free(headerCode);
+        free(rs);
+        return NULL;
+    }
+
+    memcpy(coded, ECC_MAGIC, 2);
+    for (int i = 0; i < 4; i++)
+        coded[2 + i] = (unsigned char)(size >> (8 * i));
+    coded[6] = (unsigned char)parity;
+    // нулевые байты в начале кодового слова не меняют проверочные байты, поэтому без префикса
+    // это то же кодовое слово RS(23,7)
+    unsigned char header[ECC_PREFIX_SIZE + ECC_HEADER_SIZE] = {0};
+    if (depth > 0)
+        ecc_prefix_bytes(simplePrefix((int)*codedSize, depth), header);
+    memcpy(header + ECC_PREFIX_SIZE, coded, ECC_HEADER_DATA);
+    rs_encode(headerCode, header, 1, ECC_PREFIX_SIZE + ECC_HEADER_DATA);
+    memcpy(coded + ECC_HEADER_DATA, header + ECC_PREFIX_SIZE + ECC_HEADER_DATA, ECC_HEADER_PARITY);
+
+    unsigned char *body = coded + ECC_HEADER_SIZE;
+    for (size_t b = 0; b < lanes; b++)
+    {
+        size_t start = b * d, count = start < size ? size - start : 0;
+        if (count > (size_t)d)
+            count = d;
+        for (size_t j = 0; j < count; j++)
+            body[j * lanes + b] = data[start + j];
+    }
+    rs_encode(rs, body, (int)lanes, d);
+
+    free(headerCode);
+    free(rs);
+    return coded;
+}
+
+/**
+ * @brief Кодирует сообщение кодом Рида-Соломона с parity проверочными байтами на кодовое слово.
+ *
+ * Кодовые слова перемежаются побайтно, поэтому подряд идущие искаженные байты (например,
+ * соседние пиксели) распределяются между словами: код исправляет до B * parity / 2
+ * подряд идущих байтов, где B - количество слов.
+ *
+ * @return Закодированное сообщение (необходимо освободить) или NULL при ошибке.
+ */
+unsigned char *ecc_encode(const unsigned char *data, size_t size, int parity, size_t *codedSize)
+{
+    return ecc_encode_prefixed(data, size, parity, 0, codedSize);
+}
+
+/**
+ * @brief Как ecc_encode, но для встраивания методом прямого шифрования с глубиной depth:
+ * кодовое слово заголовка защищает и 32-битный префикс, который simple_encode_bytes запишет
+ * перед сообщением.
+ */
+unsigned char *ecc_encode_simple(const unsigned char *data, size_t size, int parity, int depth, size_t *codedSize)
+{
+    return ecc_encode_prefixed(data, size, parity, depth, codedSize);
+}
+
+/**
+ * @brief Синдромы перемежаемых кодовых слов (рабочее ядро; для сравнения с эталоном в selfcheck).
+ */
+void ecc_syndromes(const unsigned char *body, int lanes, int n, int parity, unsigned char *syndromes)
+{
+    RS_CODE *rs = rs_create(parity);
+    if (!rs)
+        return;
+    rs_syndromes(rs, body, lanes, n, syndromes);
+    free(rs);
+}
+
+/**
+ * @brief Читает и исправляет кодовое слово заголовка. Если prefix не NULL, слово начинается
+ * с префикса длины метода прямого шифрования, и prefix получает исправленное значение.
+ */
+static int ecc_read_header(const unsigned char *coded, unsigned int *prefix, size_t *size, int *parity,
+                           int *corrected)
+{
+    RS_CODE *rs = rs_create(ECC_HEADER_PARITY);
+    if (!rs)
+        return 0;
+    unsigned char word[ECC_PREFIX_SIZE + ECC_HEADER_SIZE], syn[ECC_HEADER_PARITY];
+    unsigned char *header = word + ECC_PREFIX_SIZE;
+    unsigned char *start = prefix ? word : header; // без префикса - укороченный код RS(23,7)
+    int n = prefix ? ECC_PREFIX_SIZE + ECC_HEADER_SIZE : ECC_HEADER_SIZE;
+    if (prefix)
+        ecc_prefix_bytes(*prefix, word);
+    memcpy(header, coded, ECC_HEADER_SIZE);
+    rs_syndromes(rs, start, 1, n, syn);
+    int errors = 0;
+    for (int i = 0; i < ECC_HEADER_PARITY; i++)
+        if (syn[i])
+        {
+            errors = rs_correct(rs, start, n, syn);
+            break;
+        }
+    free(rs);
+    if (prefix)
+        *prefix = (unsigned int)word[0] << 24 | word[1] << 16 | word[2] << 8 | word[3];
+
+    *size = 0;
+    for (int i = 0; i < 4; i++)
+        *size |= (size_t)header[2 + i] << (8 * i);
+    *parity = header[6];
+    *corrected = errors;
+    return errors >= 0 && memcmp(header, ECC_MAGIC, 2) == 0 && *size > 0 && ecc_valid_parity(*parity);
+}
+
+/**
+ * @brief Читает заголовок закодированного сообщения, исправляя до 8 ошибочных байтов.
+ *
+ * @return 1 если заголовок корректен (size и parity заполнены), иначе 0.
+ */
+int ecc_header(const unsigned char *coded, size_t *size, int *parity)
+{
+    int corrected;
+    return ecc_read_header(coded, NULL, size, parity, &corrected);
+}
+
+/**
+ * @brief Читает заголовок сообщения метода прямого шифрования, прочитанного с глубиной depth,
+ * вместе с префиксом: исправленный префикс должен указывать ту же глубину и длину.
+ */
+static int ecc_simple_header(const unsigned char *coded, unsigned int prefix, int depth, size_t *size, int *parity)
+{
+    int corrected;
+    return ecc_read_header(coded, &prefix, size, parity, &corrected) &&
+           prefix == simplePrefix((int)ecc_coded_size(*size, *parity), depth);
+}
+
+/**
+ * @brief Проверяет, что len байтов, извлеченных методом прямого шифрования без флага --ecc по префиксу
+ * prefix, - сообщение с кодом: заголовок читается вместе с префиксом и указывает ровно len байтов.
+ */
+int ecc_simple_coded(const unsigned char *text, size_t len, unsigned int prefix)
+{
+    size_t size;
+    int parity, corrected;
+    return len >= ECC_HEADER_SIZE && memcmp(text, ECC_MAGIC, 2) == 0 &&
+           ecc_read_header(text, &prefix, &size, &parity, &corrected) && ecc_coded_size(size, parity) == len;
+}
+
+/**
+ * @brief Декодирует сообщение; prefix - префикс длины метода прямого шифрования или NULL.
+ */
+static unsigned char *ecc_decode_prefixed(const unsigned char *coded, size_t codedSize, unsigned int *prefix,
+                                          size_t *size, int *corrected)
+{
+    int parity, total;
+    if (codedSize < ECC_HEADER_SIZE || !ecc_read_header(coded, prefix, size, &parity, &total) ||
+        ecc_coded_size(*size, parity) > codedSize)
+    {
+        printf("Error: No valid ECC header in the message\n");
+        stats_error(STAT_ERR_PAYLOAD);
+        return NULL;
+    }
+
+    size_t lanes;
+    int d;
+    ecc_layout(*size, parity, &lanes, &d);
+    int n = d + parity;
+    unsigned char *body = malloc(lanes * n), *syn = malloc(lanes * parity), *out = malloc(*size + 1);
+    RS_CODE *rs = rs_create(parity);
+    if (!body || !syn || !out || !rs)
+    {
+        printf("Error: Not enough memory to decode the ECC-coded message\n");
+        stats_error(STAT_ERR_MEMORY);
+        free(body);
+        free(syn);
+        free(out);
+        free(rs);
+        return NULL;
+    }
+    memcpy(body, coded + ECC_HEADER_SIZE, lanes * n);
+    rs_syndromes(rs, body, (int)lanes, n, syn);
+
+    int failed = 0;
+    for (size_t b = 0; b < lanes && !failed; b++)
+    {
+        unsigned char cw[255], s[ECC_MAX_PARITY];
+        int dirty = 0;
+        for (int i = 0; i < parity; i++)
+            dirty |= s[i] = syn[i * lanes + b];
+        if (!dirty)
+            continue;
+        for (int j = 0; j < n; j++)
+            cw[j] = body[j * lanes + b];
+        int errors = rs_correct(rs, cw, n, s);
+        if (errors < 0)
+        {
+            printf("Error: Codeword %zu of the ECC-coded message has more than %d damaged bytes\n", b + 1,
+                   parity / 2);
+            stats_error(STAT_ERR_PAYLOAD);
+            failed = 1;
+            break;
+        }
+        for (int j = 0; j < d; j++)
+            body[j * lanes + b] = cw[j];
+        total += errors;
+    }
+
+    if (!failed)
+    {
+        for (size_t b = 0; b < lanes; b++)
+        {
+            size_t start = b * d, count = start < *size ? *size - start : 0;
+            if (count > (size_t)d)
+                count = d;
+            for (size_t j = 0; j < count; j++)
+                out[start + j] = body[j * lanes + b];
+        }
+        out[*size] = '\0';
+        stats_add(STAT_ECC_CORRECTED, total);
+        if (corrected)
+            *corrected = total;
+    }
+    free(body);
+    free(syn);
+    free(rs);
+    if (failed)
+    {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/**
+ * @brief Проверяет и исправляет закодированное сообщение.
+ *
+ * Для каждого кодового слова проверочные байты пересчитываются по его данным (см. rs_syndromes);
+ * синдромы и исправление вычисляются только для слов, у которых они не совпали с прочитанными,
+ * поэтому неповрежденное сообщение стоит одного прохода кодера.
+ *
+ * @param corrected Количество исправленных байтов (может быть NULL).
+ * @return Сообщение с завершающим нулем (необходимо освободить) или NULL, если заголовок
+ * не найден или ошибок больше, чем код исправляет.
+ */
+unsigned char *ecc_decode(const unsigned char *coded, size_t codedSize, size_t *size, int *corrected)
+{
+    return ecc_decode_prefixed(coded, codedSize, NULL, size, corrected);
+}
+
+/**
+ * @brief Как ecc_simple_decode, но читает BMP окнами строк: для каждой глубины сначала
+ * заголовок кода, затем все сообщение.
+ */
+static char *simple_decode_window(const char *filename, int *corrected)
+{
+    long long limit = stream_max_memory();
+    for (int depth = 1; depth <= SIMPLE_MAX_DEPTH; depth++)
+    {
+        unsigned char header[ECC_HEADER_SIZE];
+        unsigned int prefix;
+        size_t size;
+        int parity;
+        long long pixels = stream_simple_read(filename, depth, &prefix, header, ECC_HEADER_SIZE);
+        if (pixels < 0)
+            return NULL;
+        if (!pixels || !ecc_simple_header(header, prefix, depth, &size, &parity))
+            continue;
+        size_t codedSize = ecc_coded_size(size, parity);
+        if (codedSize > (size_t)limit)
+            continue; // сообщение должно помещаться в пределе памяти
+        unsigned char *coded = malloc(codedSize);
+        if (!coded)
+        {
+            stats_error(STAT_ERR_MEMORY);
+            return NULL;
+        }
+        pixels = stream_simple_read(filename, depth, NULL, coded, codedSize);
+        if (pixels < 0)
+        {
+            free(coded);
+            return NULL;
+        }
+        if (pixels)
+        {
+            stats_add(STAT_PIXELS, pixels);
+            char *text = (char *)ecc_decode_prefixed(coded, codedSize, &prefix, &size, corrected);
+            free(coded);
+            if (text)
+            {
+                stats_alloc(size + 1);
+                stats_add(STAT_PAYLOAD, size);
+            }
+            return text;
+        }
+        free(coded);
+    }
+
+    printf("Error: No ECC-coded message found in %s\n", filename);
+    stats_error(STAT_ERR_PAYLOAD);
+    return NULL;
+}
+
+/**
+ * @brief Извлекает закодированное сообщение метода прямого шифрования.
+ *
+ * Префикс входит в кодовое слово заголовка и исправляется вместе с ним (исправленные байты
+ * префикса учитываются в corrected). Глубины 1..SIMPLE_MAX_DEPTH перебираются, пока
+ * заголовок не прочитается и исправленный префикс не укажет ту же глубину и длину, поэтому
+ * искажение префикса не мешает извлечению. С пределом памяти (--max-memory) BMP читается
+ * окнами строк, для каждой глубины заново.
+ *
+ * @return Сообщение (необходимо освободить) или NULL при ошибке.
+ */
+char *ecc_simple_decode(const char *filename, int *corrected)
+{
+    if (stream_max_memory())
+        return simple_decode_window(filename, corrected);
+
+    BMP_FILE bmp;
+    if (!bmp_load(filename, &bmp, 0))
+        return NULL;
+    const BMP_FORMAT *format = &bmp.format;
+    int imageSize = format->width * format->height * format->channels;
+
+    char *text = NULL;
+    int found = 0;
+    unsigned int prefix = decryptPrefix(format, bmp.pixels, imageSize);
+    for (int depth = 1; depth <= SIMPLE_MAX_DEPTH && !found; depth++)
+    {
+        unsigned char header[ECC_HEADER_SIZE];
+        size_t size;
+        int parity;
+        STATS_SPAN span;
+        stats_kernel_start(&span);
+        int ok = decryptBytes(format, bmp.pixels, imageSize, depth, header, ECC_HEADER_SIZE) &&
+                 ecc_simple_header(header, prefix, depth, &size, &parity);
+        size_t codedSize = ok ? ecc_coded_size(size, parity) : 0;
+        unsigned char *coded = ok && codedSize <= (size_t)imageSize ? malloc(codedSize) : NULL;
+        ok = coded && decryptBytes(format, bmp.pixels, imageSize, depth, coded, (int)codedSize);
+        stats_kernel_stop(STAT_EXTRACT, &span);
+        if (ok)
+        {
+            found = 1;
+            stats_add(STAT_PIXELS, (simpleSamples((int)codedSize, depth) + format->channels - 1) / format->channels);
+            text = (char *)ecc_decode_prefixed(coded, codedSize, &prefix, &size, corrected);
+            if (text)
+            {
+                stats_alloc(size + 1);
+                stats_add(STAT_PAYLOAD, size);
+            }
+        }
+        free(coded);
+    }
+    bmp_free(&bmp);
+
+    if (!found)
+    {
+        printf("Error: No ECC-coded message found in %s\n", filename);
+        stats_error(STAT_ERR_PAYLOAD);
+    }
+    return text;
+}
@@ -0,0 +1,34 @@
+#ifndef ECC_H
+#define ECC_H
+
+#include <stddef.h>
+
+// Сообщение с кодом Рида-Соломона над GF(2^8) (многочлен 0x11d, корни 1, a, ..., a^(p-1)):
+// заголовок - отдельное кодовое слово RS(23,7) с меткой "RS", размером сообщения (32 бита LE)
+// и числом проверочных байтов p, за ним B кодовых слов RS(d+p,d) с равными долями сообщения
+// (последняя дополнена нулями), перемежаемые побайтно: байт j слова b лежит по смещению j*B+b.
+// У метода прямого шифрования кодовое слово заголовка начинается с 32-битного префикса длины
+// (4 байта, старший первым): RS(27,11), из которых в сообщение попадают последние 23 байта;
+// у остальных методов эти 4 байта нулевые и код укорачивается до RS(23,7)
+#define ECC_MAGIC "RS"
+#define ECC_HEADER_DATA 7
+#define ECC_HEADER_PARITY 16
+#define ECC_HEADER_SIZE (ECC_HEADER_DATA + ECC_HEADER_PARITY)
+#define ECC_PREFIX_SIZE 4
+#define ECC_MIN_PARITY 2
+#define ECC_MAX_PARITY 128
+#define ECC_DEFAULT_PARITY 32 // RS(255,223): до 16 ошибочных байтов на кодовое слово
+
+unsigned char gf_mul(unsigned char a, unsigned char b);
+int ecc_valid_parity(int parity);
+size_t ecc_coded_size(size_t size, int parity);
+size_t ecc_max_size(size_t codedCapacity, int parity);
+unsigned char *ecc_encode(const unsigned char *data, size_t size, int parity, size_t *codedSize);
+unsigned char *ecc_encode_simple(const unsigned char *data, size_t size, int parity, int depth, size_t *codedSize);
+void ecc_syndromes(const unsigned char *body, int lanes, int n, int parity, unsigned char *syndromes);
+int ecc_header(const unsigned char *coded, size_t *size, int *parity);
+unsigned char *ecc_decode(const unsigned char *coded, size_t codedSize, size_t *size, int *corrected);
+int ecc_simple_coded(const unsigned char *text, size_t len, unsigned int prefix);
+char *ecc_simple_decode(const char *filename, int *corrected);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <string.h>
+#include "hash.h"
+
+// Константы XXH64 (https://github.com/Cyan4973/xxHash, формат зафиксирован)
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static unsigned long long rotl(unsigned long long x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Чтение little-endian слов независимо от порядка байтов платформы.
+ */
+static unsigned long long read64(const unsigned char *p)
+{
+    unsigned long long v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static unsigned int read32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static unsigned long long round64(unsigned long long acc, unsigned long long input)
+{
+    acc += input * PRIME2;
+    return rotl(acc, 31) * PRIME1;
+}
+
+static unsigned long long merge64(unsigned long long acc, unsigned long long val)
+{
+    acc ^= round64(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * @brief Обрабатывает полосу из 32 байт: по 8 байт в каждый накопитель.
+ */
+static void hash_stripe(HASH_STATE *h, const unsigned char *p)
+{
+    h->acc[0] = round64(h->acc[0], read64(p));
+    h->acc[1] = round64(h->acc[1], read64(p + 8));
+    h->acc[2] = round64(h->acc[2], read64(p + 16));
+    h->acc[3] = round64(h->acc[3], read64(p + 24));
+}
+
+/**
+ * @brief Начинает вычисление хеша.
+ */
+void hash_init(HASH_STATE *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->acc[0] = PRIME1 + PRIME2;
+    h->acc[1] = PRIME2;
+    h->acc[2] = 0;
+    h->acc[3] = 0 - PRIME1;
+}
+
+/**
+ * @brief Добавляет очередной фрагмент данных; результат не зависит от разбиения на фрагменты.
+ */
+void hash_update(HASH_STATE *h, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    h->total += size;
+
+    if (h->buffered)
+    {
+        size_t fill = 32 - h->buffered;
+        if (fill > size)
+            fill = size;
+        memcpy(h->buffer + h->buffered, p, fill);
+        h->buffered += (int)fill;
+        p += fill;
+        size -= fill;
+        if (h->buffered < 32)
+            return;
+        hash_stripe(h, h->buffer);
+        h->buffered = 0;
+    }
+
+    for (; size >= 32; p += 32, size -= 32)
+        hash_stripe(h, p);
+
+    memcpy(h->buffer, p, size);
+    h->buffered = (int)size;
+}
+
+/**
+ * @brief Возвращает хеш данных, добавленных к этому моменту; состояние не меняется.
+ */
+unsigned long long hash_digest(const HASH_STATE *h)
+{
+    unsigned long long v;
+    if (h->total >= 32)
+    {
+        v = rotl(h->acc[0], 1) + rotl(h->acc[1], 7) + rotl(h->acc[2], 12) + rotl(h->acc[3], 18);
+        for (int i = 0; i < 4; i++)
+            v = merge64(v, h->acc[i]);
+    }
+    else
+        v = h->acc[2] + PRIME5;
+    v += h->total;
+
+    const unsigned char *p = h->buffer, *end = h->buffer + h->buffered;
+    for (; p + 8 <= end; p += 8)
+        v = rotl(v ^ round64(0, read64(p)), 27) * PRIME1 + PRIME4;
+    if (p + 4 <= end)
+    {
+        v = rotl(v ^ read32(p) * PRIME1, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        v = rotl(v ^ *p * PRIME5, 11) * PRIME1;
+
+    v ^= v >> 33;
+    v *= PRIME2;
+    v ^= v >> 29;
+    v *= PRIME3;
+    v ^= v >> 32;
+    return v;
+}
+
+/**
+ * @brief Хеш блока памяти целиком.
+ */
+unsigned long long hash_bytes(const void *data, size_t size)
+{
+    HASH_STATE h;
+    hash_init(&h);
+    hash_update(&h, data, size);
+    return hash_digest(&h);
+}
@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+// Потоковое состояние некриптографического хеша XXH64 (seed 0)
+typedef struct
+{
+    unsigned long long acc[4];    // четыре независимых накопителя по 8 байт
+    unsigned long long total;     // количество обработанных байтов
+    unsigned char buffer[32];     // хвост, не заполнивший целую полосу
+    int buffered;
+} HASH_STATE;
+
+void hash_init(HASH_STATE *h);
+void hash_update(HASH_STATE *h, const void *data, size_t size);
+unsigned long long hash_digest(const HASH_STATE *h);
+unsigned long long hash_bytes(const void *data, size_t size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include "json.h"
+
+/**
+ * @brief Выводит строку как строковый литерал JSON (в кавычках, с экранированием).
+ *
+ * @param out Поток вывода.
+ * @param s Строка для вывода; NULL выводится как null.
+ */
+void json_print_string(FILE *out, const char *s)
+{
+    if (!s)
+    {
+        fputs("null", out);
+        return;
+    }
+
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(out, "\\%c", *p);
+        else if (*p == '\n')
+            fputs("\\n", out);
+        else if (*p < 0x20)
+            fprintf(out, "\\u%04x", *p);
+        else
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
@@ -0,0 +1,8 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdio.h>
+
+void json_print_string(FILE *out, const char *s);
+
+#endif
\ No newline at end of file
@@ -1,66 +1,209 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include "stegano.h"
-#include "stegano_dec.h"
-#include "color.h"
-#include "color_dec.h"
-#include "simple.h"
-#include "simple_dec.h"
-
-int main()
-{
-    int choice, method;
-
-    printf("Welcome! If you want to encrypt the message enter 1, otherwise 0: ");
-    scanf("%d", &choice);
-
-    if (choice == 1)
-    {
-        printf("\nWhat method do you want to use?\n");
-        printf("1 - steganography\n");
-        printf("2 - color substitution\n");
-        printf("3 - direct encryption\n");
-        printf("Enter your choice: ");
-        scanf("%d", &method);
-
-        switch (method)
-        {
-        case 1:
-            return stegano();
-        case 2:
-            return color();
-        case 3:
-            return simple();
-        default:
-            printf("Invalid choice!\n");
-            return 1;
-        }
-    }
-    else if (choice == 0)
-    {
-        printf("\nWhat method did you use?\n");
-        printf("1 - steganography\n");
-        printf("2 - color substitution\n");
-        printf("3 - direct encryption\n");
-        printf("Enter your choice: ");
-        scanf("%d", &method);
-
-        switch (method)
-        {
-        case 1:
-            return stegano_dec();
-        case 2:
-            return color_dec();
-        case 3:
-            return simple_dec();
-        default:
-            printf("Invalid choice!\n");
-            return 1;
-        }
-    }
-    else
-    {
-        printf("Invalid choice! Please enter 1 for encryption or 0 for decryption.\n");
-        return 1;
-    }
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "color.h"
+#include "color_dec.h"
+#include "simple.h"
+#include "simple_dec.h"
+#include "capacity.h"
+#include "probe.h"
+#include "analysis.h"
+#include "metrics.h"
+#include "batch.h"
+#include "selfcheck.h"
+#include "stream.h"
+#include "slots.h"
+#include "update.h"
+#include "patch.h"
+#include "plane.h"
+#include "recover.h"
+#include "shard.h"
+#include "stats.h"
+#include "aead.h"
+
+typedef int (*COMMAND_RUN)(int argc, char *argv[]);
+
+// Команды; withStats - команда учитывает статистику фаз (--stats, --stats-json, --perf)
+typedef struct
+{
+    const char *name;
+    COMMAND_RUN run;
+    int withStats;
+} COMMAND;
+
+static const COMMAND commands[] = {
+    {"capacity", capacity, 0},
+    {"probe", probe, 0},
+    {"analyze", analyze, 0},
+    {"metrics", metrics, 0},
+    {"batch", batch, 0},
+    {"selfcheck", selfcheck, 0},
+    {"stream", stream, 1},
+    {"slots", slots, 1},
+    {"update", update, 1},
+    {"patch", patch, 1},
+    {"plane", plane, 1},
+    {"recover", recover, 1},
+    {"shard", shard, 1},
+};
+
+/**
+ * @brief Выводит статистику операции: statsMode 1 - в читаемом виде, 2 - строкой JSON.
+ */
+static void print_stats(FILE *out, int statsMode, const STATS *stats)
+{
+    if (statsMode == 1)
+        stats_print(out, stats);
+    else if (statsMode == 2)
+    {
+        stats_print_json(out, stats);
+        fprintf(out, "\n");
+    }
+}
+
+/**
+ * @brief Диалоговый режим: выбор действия и метода шифрования.
+ *
+ * @return Код завершения выбранной операции.
+ */
+static int menu()
+{
+    int choice, method;
+
+    printf("Welcome! If you want to encrypt the message enter 1, otherwise 0: ");
+    scanf("%d", &choice);
+
+    if (choice == 1)
+    {
+        printf("\nWhat method do you want to use?\n");
+        printf("1 - steganography\n");
+        printf("2 - color substitution\n");
+        printf("3 - direct encryption\n");
+        printf("Enter your choice: ");
+        scanf("%d", &method);
+
+        switch (method)
+        {
+        case 1:
+            return stegano();
+        case 2:
+            return color();
+        case 3:
+            return simple();
+        default:
+            printf("Invalid choice!\n");
+            return 1;
+        }
+    }
+    else if (choice == 0)
+    {
+        printf("\nWhat method did you use?\n");
+        printf("1 - steganography\n");
+        printf("2 - color substitution\n");
+        printf("3 - direct encryption\n");
+        printf("Enter your choice: ");
+        scanf("%d", &method);
+
+        switch (method)
+        {
+        case 1:
+            return stegano_dec();
+        case 2:
+            return color_dec();
+        case 3:
+            return simple_dec();
+        default:
+            printf("Invalid choice!\n");
+            return 1;
+        }
+    }
+    else
+    {
+        printf("Invalid choice! Please enter 1 for encryption or 0 for decryption.\n");
+        return 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // --stats и --stats-json выводят статистику фаз операции диалогового режима или команды
+    // (у команд - в stderr, чтобы не смешивать ее с их выводом; batch собирает свою),
+    // --perf добавляет к ней аппаратные счетчики ядер встраивания и извлечения,
+    // --max-memory ограничивает память изображения: BMP обрабатываются окнами строк,
+    // --passphrase-file шифрует сообщения диалогового режима, пакета и stream паролем
+    int statsMode = 0;
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+    {
+        if (strcmp(argv[1], "--stats") == 0)
+            statsMode = 1;
+        else if (strcmp(argv[1], "--stats-json") == 0)
+            statsMode = 2;
+        else if (strcmp(argv[1], "--perf") == 0)
+        {
+            if (!statsMode)
+                statsMode = 1;
+            stats_enable_perf();
+        }
+        else if (strcmp(argv[1], "--max-memory") == 0 && argc > 2)
+        {
+            long long limit = stream_parse_size(argv[2]);
+            if (limit <= 0)
+            {
+                printf("Error: Invalid memory limit %s\n", argv[2]);
+                return 1;
+            }
+            stream_set_max_memory(limit);
+            argc--;
+            argv++;
+        }
+        else if (strcmp(argv[1], "--passphrase-file") == 0 && argc > 2)
+        {
+            char *passphrase = aead_read_passphrase(argv[2]);
+            if (!passphrase)
+                return 1;
+            aead_set_passphrase(passphrase);
+            argc--;
+            argv++;
+        }
+        else
+            break;
+        argc--;
+        argv++;
+    }
+
+    STATS stats;
+    memset(&stats, 0, sizeof(stats));
+    if (argc > 1)
+    {
+        for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+        {
+            if (strcmp(argv[1], commands[i].name) != 0)
+                continue;
+            if (statsMode && !commands[i].withStats)
+            {
+                printf("Error: The %s command does not collect --stats, --stats-json or --perf%s\n", argv[1],
+                       strcmp(argv[1], "batch") == 0 ? " (use batch <jobfile> --stats or --perf)" : "");
+                return 1;
+            }
+            if (statsMode)
+                stats_attach(&stats);
+            int result = commands[i].run(argc - 2, argv + 2);
+            print_stats(stderr, statsMode, &stats);
+            return result;
+        }
+
+        printf("Unknown command: %s\n", argv[1]);
+        printf("Available commands: capacity, probe, analyze, metrics, batch, selfcheck, stream, slots, update, patch, "
+               "plane, recover, shard\n");
+        return 1;
+    }
+
+    if (statsMode)
+        stats_attach(&stats);
+
+    int result = menu();
+    print_stats(stdout, statsMode, &stats);
+    return result;
+}
@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bmpinfo.h"
+#include "metrics.h"
+
+#define METRICS_TILE (256 * 1024)
+
+/**
+ * @brief Сбрасывает накопленные метрики искажения.
+ *
+ * @param d Указатель на структуру DISTORTION.
+ */
+void distortion_init(DISTORTION *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->minX = d->minY = d->maxX = d->maxY = -1;
+}
+
+/**
+ * @brief Расширяет область изменений на пиксели x0..x1 строки y.
+ */
+static void extend_box(DISTORTION *d, int x0, int x1, int y)
+{
+    if (d->minX < 0)
+    {
+        d->minX = x0;
+        d->maxX = x1;
+        d->minY = d->maxY = y;
+        return;
+    }
+
+    if (x0 < d->minX)
+        d->minX = x0;
+    if (x1 > d->maxX)
+        d->maxX = x1;
+    if (y < d->minY)
+        d->minY = y;
+    if (y > d->maxY)
+        d->maxY = y;
+}
+
+/**
+ * @brief Сравнивает одну строку пикселей (n байт BGR).
+ *
+ * Блоки по 16 байт без изменений отбрасываются одним сравнением, поэтому
+ * стоимость прохода определяется чтением памяти. Для измененных блоков сумма
+ * модулей считается через psadbw, квадраты - через pmaddwd, а измененные
+ * младшие биты каждого канала - через popcount маски блока.
+ */
+static void distortion_row(DISTORTION *d, const unsigned char *a, const unsigned char *b, int n, int y)
+{
+    int i = 0, x0 = -1, x1 = -1;
+
+#ifdef __SSE2__
+    // channelMask[phase][c]: байты блока, относящиеся к каналу c, если блок начинается с канала phase
+    static const unsigned short channelMask[3][3] = {
+        {0x9249, 0x2492, 0x4924},
+        {0x4924, 0x9249, 0x2492},
+        {0x2492, 0x4924, 0x9249},
+    };
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sad = zero, sq = zero;
+    unsigned int tmp[4];
+    int blocks = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+        int changed = ~_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFF;
+        if (!changed)
+            continue;
+
+        sad = _mm_add_epi64(sad, _mm_sad_epu8(va, vb));
+
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i lo = _mm_unpacklo_epi8(diff, zero), hi = _mm_unpackhi_epi8(diff, zero);
+        sq = _mm_add_epi32(sq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+
+        // полоса sq растет не более чем на 4 * 255^2 за блок, сбрасываем до переполнения
+        if (++blocks == 4096)
+        {
+            _mm_storeu_si128((__m128i *)tmp, sq);
+            d->sumSq += (unsigned long long)tmp[0] + tmp[1] + tmp[2] + tmp[3];
+            sq = zero;
+            blocks = 0;
+        }
+
+        int lsb = _mm_movemask_epi8(_mm_slli_epi16(_mm_xor_si128(va, vb), 7));
+        const unsigned short *mask = channelMask[i % 3];
+        for (int c = 0; c < 3; c++)
+            d->changedLsb[c] += __builtin_popcount(lsb & mask[c]);
+        d->changedBytes += __builtin_popcount(changed);
+
+        if (x0 < 0)
+            x0 = (i + __builtin_ctz(changed)) / 3;
+        x1 = (i + 31 - __builtin_clz(changed)) / 3;
+    }
+
+    _mm_storeu_si128((__m128i *)tmp, sq);
+    d->sumSq += (unsigned long long)tmp[0] + tmp[1] + tmp[2] + tmp[3];
+    d->sumAbs += (unsigned long long)_mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+#endif
+
+    for (; i < n; i++)
+    {
+        if (a[i] == b[i])
+            continue;
+
+        int diff = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        d->sumSq += diff * diff;
+        d->sumAbs += diff;
+        d->changedBytes++;
+        d->changedLsb[i % 3] += (a[i] ^ b[i]) & 1;
+
+        if (x0 < 0)
+            x0 = i / 3;
+        x1 = i / 3;
+    }
+
+    d->samples += n;
+    if (x0 >= 0)
+        extend_box(d, x0, x1, y);
+}
+
+/**
+ * @brief Накапливает метрики искажения для фрагмента изображения.
+ *
+ * Буферы рассматриваются как строки по stride байт, в каждой из которых первые
+ * width * 3 байт - пиксели BGR, остальное - выравнивание (не сравнивается).
+ * Последняя строка может быть неполной.
+ *
+ * @param d Накопитель метрик.
+ * @param original Исходные пиксельные данные.
+ * @param output Пиксельные данные после встраивания.
+ * @param size Размер буферов в байтах.
+ * @param stride Размер строки в байтах.
+ * @param width Ширина изображения в пикселях.
+ * @param firstRow Номер первой строки фрагмента (в порядке строк файла).
+ */
+void distortion_rows(DISTORTION *d, const unsigned char *original, const unsigned char *output,
+                     long long size, long long stride, int width, int firstRow)
+{
+    int y = firstRow;
+    for (long long offset = 0; offset < size; offset += stride, y++)
+    {
+        long long n = size - offset;
+        if (n > width * 3)
+            n = width * 3;
+        distortion_row(d, original + offset, output + offset, (int)n, y);
+    }
+}
+
+/**
+ * @brief Учитывает изменение одного байта пиксельных данных.
+ *
+ * Используется методами, которые изменяют отдельные разрозненные байты, прямо в цикле
+ * встраивания: сравнивать весь буфер после встраивания для них не нужно.
+ *
+ * @param d Накопитель метрик.
+ * @param offset Смещение байта от начала пиксельных данных.
+ * @param stride Размер строки в байтах.
+ * @param width Ширина изображения в пикселях.
+ * @param before Значение байта до встраивания.
+ * @param after Значение байта после встраивания.
+ */
+void distortion_byte(DISTORTION *d, long long offset, long long stride, int width,
+                     unsigned char before, unsigned char after)
+{
+    int x = (int)(offset % stride);
+    if (before == after || x >= width * 3) // байты выравнивания строки не учитываются
+        return;
+
+    int diff = before > after ? before - after : after - before;
+    d->sumSq += diff * diff;
+    d->sumAbs += diff;
+    d->changedBytes++;
+    d->changedLsb[x % 3] += (before ^ after) & 1;
+    extend_box(d, x / 3, x / 3, (int)(offset / stride));
+}
+
+/**
+ * @brief Вычисляет MSE и PSNR по накопленным суммам.
+ *
+ * @return PSNR в дБ или отрицательное значение, если изображения совпадают.
+ */
+static double distortion_psnr(const DISTORTION *d, double *mse)
+{
+    *mse = d->samples ? (double)d->sumSq / d->samples : 0;
+    return *mse > 0 ? 10 * log10(255.0 * 255.0 / *mse) : -1;
+}
+
+/**
+ * @brief Выводит метрики искажения в читаемом виде.
+ *
+ * @param d Накопленные метрики.
+ */
+void distortion_print(const DISTORTION *d)
+{
+    double mse, psnr = distortion_psnr(d, &mse);
+
+    printf("MSE: %.6f\n", mse);
+    if (psnr < 0)
+        printf("PSNR: inf (images are identical)\n");
+    else
+        printf("PSNR: %.2f dB\n", psnr);
+    printf("Changed bytes: %llu of %llu\n", d->changedBytes, d->samples);
+    printf("Changed LSBs: B %llu, G %llu, R %llu\n", d->changedLsb[0], d->changedLsb[1], d->changedLsb[2]);
+    if (d->minX >= 0)
+        printf("Changed area: x %d..%d, row %d..%d\n", d->minX, d->maxX, d->minY, d->maxY);
+}
+
+/**
+ * @brief Выводит метрики искажения как объект JSON (без перевода строки).
+ *
+ * @param out Поток вывода.
+ * @param d Накопленные метрики.
+ */
+void distortion_print_json(FILE *out, const DISTORTION *d)
+{
+    double mse, psnr = distortion_psnr(d, &mse);
+
+    fprintf(out, "{\"mse\":%.6f,", mse);
+    if (psnr < 0)
+        fprintf(out, "\"psnr\":null,");
+    else
+        fprintf(out, "\"psnr\":%.2f,", psnr);
+    fprintf(out, "\"mae\":%.6f,\"changed_bytes\":%llu,\"samples\":%llu,",
+            d->samples ? (double)d->sumAbs / d->samples : 0, d->changedBytes, d->samples);
+    fprintf(out, "\"changed_lsb\":{\"b\":%llu,\"g\":%llu,\"r\":%llu},",
+            d->changedLsb[0], d->changedLsb[1], d->changedLsb[2]);
+    if (d->minX >= 0)
+        fprintf(out, "\"bbox\":[%d,%d,%d,%d]}", d->minX, d->minY, d->maxX, d->maxY);
+    else
+        fprintf(out, "\"bbox\":null}");
+}
+
+/**
+ * @brief Открывает BMP-файл и переходит к пиксельным данным.
+ */
+static FILE *open_pixels(const char *filename, BMP_HEADER *header)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        printf("Error: Cannot open file %s\n", filename);
+        return NULL;
+    }
+
+    if (fread(header, sizeof(BMP_HEADER), 1, f) != 1 || !check_bmp_header(header) ||
+        fseek(f, header->bfOffBits, SEEK_SET) != 0)
+    {
+        printf("Error: Only 24-bit BMP files are supported\n");
+        fclose(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+/**
+ * @brief Команда metrics: сравнивает исходное изображение с результатом встраивания.
+ *
+ * Использование: metrics <исходный.bmp> <результат.bmp> [--json]
+ *
+ * Оба файла читаются тайлами по 256 КБ, целиком в память не загружаются.
+ * Выводятся MSE, PSNR, количество измененных младших бит по каналам и область изменений.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int metrics(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: metrics <original.bmp> <stego.bmp> [--json]\n");
+        return 1;
+    }
+
+    int json = argc > 2 && strcmp(argv[2], "--json") == 0;
+
+    BMP_HEADER h1, h2;
+    FILE *f1 = open_pixels(argv[0], &h1);
+    if (!f1)
+        return 1;
+    FILE *f2 = open_pixels(argv[1], &h2);
+    if (!f2)
+    {
+        fclose(f1);
+        return 1;
+    }
+
+    if (h1.biWidth != h2.biWidth || h1.biHeight != h2.biHeight)
+    {
+        printf("Error: Image dimensions do not match\n");
+        fclose(f1);
+        fclose(f2);
+        return 1;
+    }
+
+    long long rowSize = bmp_row_size(&h1);
+    int height = abs(h1.biHeight);
+    long long tileRows = METRICS_TILE / rowSize;
+    if (tileRows < 1)
+        tileRows = 1;
+
+    unsigned char *a = malloc(tileRows * rowSize);
+    unsigned char *b = malloc(tileRows * rowSize);
+    if (!a || !b)
+    {
+        printf("Failed to allocate memory.\n");
+        free(a);
+        free(b);
+        fclose(f1);
+        fclose(f2);
+        return 1;
+    }
+
+    DISTORTION d;
+    distortion_init(&d);
+
+    // метод прямого шифрования сохраняет данные без выравнивания строк, поэтому
+    // файл может оказаться короче заявленного - сравнивается общая часть
+    int truncated = 0;
+    for (int y = 0; y < height && !truncated; y += tileRows)
+    {
+        int rows = height - y < tileRows ? height - y : (int)tileRows;
+        size_t want = rows * rowSize;
+        size_t n1 = fread(a, 1, want, f1);
+        size_t n2 = fread(b, 1, want, f2);
+        size_t n = n1 < n2 ? n1 : n2;
+
+        truncated = n < want;
+        distortion_rows(&d, a, b, n, rowSize, h1.biWidth, y);
+    }
+
+    free(a);
+    free(b);
+    fclose(f1);
+    fclose(f2);
+
+    if (truncated && !json)
+        printf("Warning: File is shorter than its header declares, compared %llu bytes\n", d.samples);
+
+    if (json)
+    {
+        distortion_print_json(stdout, &d);
+        printf("\n");
+    }
+    else
+    {
+        distortion_print(&d);
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+typedef struct
+{
+    unsigned long long sumSq;         // сумма квадратов разностей байтов
+    unsigned long long sumAbs;        // сумма модулей разностей байтов
+    unsigned long long samples;       // количество сравненных байтов пикселей
+    unsigned long long changedBytes;  // количество измененных байтов
+    unsigned long long changedLsb[3]; // измененные младшие биты по каналам B, G, R
+    int minX, minY, maxX, maxY;       // область изменений, minX == -1 если изменений нет
+} DISTORTION;
+
+void distortion_init(DISTORTION *d);
+void distortion_rows(DISTORTION *d, const unsigned char *original, const unsigned char *output,
+                     long long size, long long stride, int width, int firstRow);
+void distortion_byte(DISTORTION *d, long long offset, long long stride, int width,
+                     unsigned char before, unsigned char after);
+void distortion_print(const DISTORTION *d);
+void distortion_print_json(FILE *out, const DISTORTION *d);
+int metrics(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,145 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "numa.h"
+
+typedef struct
+{
+    int id; // номер узла в системе
+#ifdef _WIN32
+    DWORD_PTR mask;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+#endif
+} NUMA_NODE;
+
+static NUMA_NODE nodes[NUMA_MAX_NODES];
+static int nodeCount = 0;
+static pthread_once_t nodesOnce = PTHREAD_ONCE_INIT;
+static __thread int currentNode = -1;
+
+#ifdef __linux__
+/**
+ * @brief Читает список процессоров узла ("0-7,16-23") и оставляет только доступные процессу.
+ *
+ * @return Количество доступных процессоров узла.
+ */
+static int numa_read_cpus(int id, const cpu_set_t *allowed, cpu_set_t *cpus)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+
+    CPU_ZERO(cpus);
+    int first, last, c;
+    while (fscanf(f, "%d", &first) == 1)
+    {
+        last = first;
+        c = fgetc(f);
+        if (c == '-' && fscanf(f, "%d", &last) == 1)
+            c = fgetc(f);
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, cpus);
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+
+    CPU_AND(cpus, cpus, allowed);
+    return CPU_COUNT(cpus);
+}
+#endif
+
+/**
+ * @brief Находит узлы NUMA, на которых процессу разрешено выполняться.
+ *
+ * Учитывается маска процесса, поэтому запуск через taskset или numactl
+ * --cpunodebind ограничивает и узлы, за которыми закрепляются рабочие потоки.
+ */
+static void numa_init()
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    for (int id = 0; id < NUMA_MAX_NODES; id++)
+    {
+        if (numa_read_cpus(id, &allowed, &nodes[nodeCount].cpus) > 0)
+            nodes[nodeCount++].id = id;
+    }
+#elif defined(_WIN32)
+    ULONG highest;
+    DWORD_PTR process, system;
+    if (!GetNumaHighestNodeNumber(&highest) || !GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+        return;
+    for (ULONG id = 0; id <= highest && id < NUMA_MAX_NODES; id++)
+    {
+        ULONGLONG mask;
+        if (GetNumaNodeProcessorMask((UCHAR)id, &mask) && (mask & process) != 0)
+        {
+            nodes[nodeCount].id = (int)id;
+            nodes[nodeCount++].mask = (DWORD_PTR)mask & process;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Возвращает количество узлов NUMA с доступными процессорами.
+ *
+ * @return Количество узлов, 1 если система не NUMA или узлы не определены.
+ */
+int numa_nodes()
+{
+    pthread_once(&nodesOnce, numa_init);
+    return nodeCount > 0 ? nodeCount : 1;
+}
+
+/**
+ * @brief Закрепляет текущий поток за процессорами узла NUMA с номером worker по кругу.
+ *
+ * Память, которую поток выделяет и впервые записывает после закрепления
+ * (пиксели при чтении изображения, буферы сообщения), по умолчанию размещается
+ * ядром на том же узле, поэтому чтение, встраивание и запись задания остаются
+ * локальными. Если узел один, поток не закрепляется.
+ *
+ * @param worker Порядковый номер рабочего потока.
+ * @return Номер узла потока или -1, если закрепить не удалось.
+ */
+int numa_bind_worker(int worker)
+{
+    if (numa_nodes() < 2)
+    {
+        currentNode = nodeCount ? nodes[0].id : 0;
+        return currentNode;
+    }
+
+    const NUMA_NODE *node = &nodes[worker % nodeCount];
+#ifdef __linux__
+    if (sched_setaffinity(0, sizeof(node->cpus), &node->cpus) == 0)
+        currentNode = node->id;
+#elif defined(_WIN32)
+    if (SetThreadAffinityMask(GetCurrentThread(), node->mask) != 0)
+        currentNode = node->id;
+#endif
+    return currentNode;
+}
+
+/**
+ * @brief Возвращает узел NUMA, за которым закреплен текущий поток.
+ *
+ * @return Номер узла или -1 для потоков, не прошедших numa_bind_worker.
+ */
+int numa_node()
+{
+    return currentNode;
+}
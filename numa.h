@@ -0,0 +1,11 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+// Узлы NUMA с доступными процессу процессорами (Linux: /sys/devices/system/node, Windows: группа 0)
+#define NUMA_MAX_NODES 64
+
+int numa_nodes();
+int numa_bind_worker(int worker);
+int numa_node();
+
+#endif
\ No newline at end of file
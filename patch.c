@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "bmpinfo.h"
+#include "simple.h"
+#include "color.h"
+#include "stegano.h"
+#include "hash.h"
+#include "stats.h"
+#include "patch.h"
+
+#define PATCH_TILE (256 * 1024) // размер буфера чтения исходного изображения, байт
+#define PATCH_BLOCK 64          // блоки без изменений отбрасываются одним memcmp
+#define PATCH_TEMP_TRIES 100    // попытки подобрать незанятое имя временного файла
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/**
+ * @brief Закодированный список изменений, растущий по мере сравнения.
+ */
+typedef struct
+{
+    unsigned char *data;
+    size_t size, capacity;
+    long long count;
+    long long last; // смещение предыдущего изменения, -1 в начале
+} PATCH_LIST;
+
+/**
+ * @brief Состояние сравнения исходного файла с результатом встраивания.
+ */
+typedef struct
+{
+    FILE *file;
+    unsigned char *buffer; // очередной фрагмент исходного файла
+    long long offset;      // смещение следующего байта результата
+    long long carrierSize;
+    HASH_STATE carrierHash, outputHash;
+    PATCH_LIST list;
+} PATCH_DIFF;
+
+static void put64(unsigned char *p, unsigned long long v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static unsigned long long get64(const unsigned char *p)
+{
+    unsigned long long v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+/**
+ * @brief Добавляет изменение: разность смещений в varint (по 7 бит, младшие группы первыми) и новый байт.
+ */
+static int patch_push(PATCH_LIST *list, long long offset, unsigned char value)
+{
+    if (list->size + 11 > list->capacity) // varint 64-битного числа занимает не больше 10 байт
+    {
+        size_t capacity = list->capacity ? list->capacity * 2 : 4096;
+        unsigned char *data = realloc(list->data, capacity);
+        if (!data)
+        {
+            printf("Error: Not enough memory for the patch\n");
+            stats_error(STAT_ERR_MEMORY);
+            return 0;
+        }
+        list->data = data;
+        list->capacity = capacity;
+    }
+
+    unsigned long long delta = (unsigned long long)(offset - list->last - 1);
+    for (; delta >= 0x80; delta >>= 7)
+        list->data[list->size++] = (unsigned char)(delta | 0x80);
+    list->data[list->size++] = (unsigned char)delta;
+    list->data[list->size++] = value;
+    list->last = offset;
+    list->count++;
+    return 1;
+}
+
+/**
+ * @brief Читает следующее изменение; проверяет, что оно не выходит за конец патча и результата.
+ */
+static int patch_next(const unsigned char **p, const unsigned char *end, long long *offset, long long outputSize,
+                      unsigned char *value)
+{
+    unsigned long long delta = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        if (*p >= end || shift > 63)
+            return 0;
+        unsigned char b = *(*p)++;
+        delta |= (unsigned long long)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    if (*p >= end || delta >= (unsigned long long)(outputSize - *offset - 1))
+        return 0;
+
+    *offset += (long long)delta + 1;
+    *value = *(*p)++;
+    return 1;
+}
+
+/**
+ * @brief Сравнивает очередные size байт результата с тем же участком исходного файла.
+ *
+ * Байты за концом исходного файла считаются нулевыми.
+ */
+static int patch_compare(PATCH_DIFF *d, const unsigned char *output, size_t size)
+{
+    size_t n = fread(d->buffer, 1, size, d->file);
+    hash_update(&d->carrierHash, d->buffer, n);
+    memset(d->buffer + n, 0, size - n);
+    d->carrierSize += n;
+    hash_update(&d->outputHash, output, size);
+
+    for (size_t i = 0; i < size; i += PATCH_BLOCK)
+    {
+        size_t block = size - i < PATCH_BLOCK ? size - i : PATCH_BLOCK;
+        if (memcmp(d->buffer + i, output + i, block) == 0)
+            continue;
+        for (size_t j = i; j < i + block; j++)
+            if (d->buffer[j] != output[j] && !patch_push(&d->list, d->offset + j, output[j]))
+                return 0;
+    }
+    d->offset += size;
+    return 1;
+}
+
+/**
+ * @brief Сравнивает исходный файл с тем, что записал бы bmp_save для изображения с сообщением.
+ *
+ * Строки результата формируются по одной, поэтому память нужна только на строку и фрагмент
+ * исходного файла; хвост исходного файла за пиксельными данными только хешируется.
+ */
+static int patch_diff(PATCH_DIFF *d, const BMP_FILE *img, const char *carrierFilename)
+{
+    const BMP_FORMAT *format = &img->format;
+    long long stride = bmp_stride(img);
+    size_t bufferSize = format->rowSize > PATCH_TILE ? (size_t)format->rowSize : PATCH_TILE;
+    if (format->dataOffset > bufferSize)
+        bufferSize = format->dataOffset;
+
+    d->file = fopen(carrierFilename, "rb");
+    d->buffer = malloc(bufferSize);
+    unsigned char *row = calloc((size_t)format->rowSize, 1); // выравнивание строк bmp_save заполняет нулями
+    if (!d->file || !d->buffer || !row)
+    {
+        printf("Error: Cannot read carrier file %s\n", carrierFilename);
+        stats_error(d->file ? STAT_ERR_MEMORY : STAT_ERR_IO);
+        free(row);
+        return 0;
+    }
+
+    long long t = stats_start();
+    int ok = patch_compare(d, img->prefix, format->dataOffset);
+    for (int y = 0; ok && y < format->height; y++)
+    {
+        memcpy(row, img->pixels + stride * y, (size_t)stride);
+        ok = patch_compare(d, row, (size_t)format->rowSize);
+    }
+    free(row);
+
+    size_t n;
+    while (ok && (n = fread(d->buffer, 1, PATCH_TILE, d->file)) > 0)
+    {
+        hash_update(&d->carrierHash, d->buffer, n);
+        d->carrierSize += n;
+    }
+    stats_add(STAT_BYTES_READ, d->carrierSize);
+    stats_stop(STAT_READ, t);
+    return ok;
+}
+
+/**
+ * @brief Записывает заголовок и список изменений в файл патча.
+ */
+static int patch_write(const char *patchFilename, const PATCH_DIFF *d, PATCH_RESULT *result)
+{
+    long long t = stats_start();
+    FILE *file = fopen(patchFilename, "wb");
+    if (!file)
+    {
+        printf("Error: Cannot create patch file %s\n", patchFilename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    unsigned char header[PATCH_HEADER_SIZE];
+    memcpy(header, PATCH_MAGIC, 4);
+    put64(header + 4, d->carrierSize);
+    put64(header + 12, hash_digest(&d->carrierHash));
+    put64(header + 20, d->offset);
+    put64(header + 28, hash_digest(&d->outputHash));
+    put64(header + 36, d->list.count);
+    fwrite(header, 1, PATCH_HEADER_SIZE, file);
+    fwrite(d->list.data, 1, d->list.size, file);
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed)
+    {
+        printf("Error: Cannot write patch file %s\n", patchFilename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    result->carrierSize = d->carrierSize;
+    result->outputSize = d->offset;
+    result->changes = d->list.count;
+    result->patchSize = PATCH_HEADER_SIZE + (long long)d->list.size;
+    stats_add(STAT_BYTES_WRITTEN, result->patchSize);
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
+
+/**
+ * @brief Встраивает сообщение в копию исходного BMP в памяти и сохраняет вместо изображения патч.
+ *
+ * Результат встраивания совпадает с тем, что записал бы соответствующий метод шифрования:
+ * патч содержит каждый байт, которым файл результата отличается от исходного. Ключ метода
+ * цветов и стеганографии сохраняется так же, как при обычном шифровании; ключ метода прямого
+ * шифрования - только если задан keyFilename. Генератор rand() должен быть проинициализирован
+ * вызывающей стороной.
+ *
+ * @param method PATCH_SIMPLE, PATCH_COLOR или PATCH_STEGANO.
+ * @param carrierFilename Исходный BMP, который уже есть у получателя.
+ * @param patchFilename Файл для сохранения патча.
+ * @param keyFilename Файл ключа.
+ * @param text Сообщение.
+ * @param step Шаг обхода пикселей стеганографии.
+ * @param mask Маска каналов стеганографии.
+ * @param depth Глубина встраивания метода прямого шифрования.
+ * @param result Размеры исходного изображения, результата и патча.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int patch_export(int method, const char *carrierFilename, const char *patchFilename, const char *keyFilename,
+                 const char *text, int step, int mask, int depth, PATCH_RESULT *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    BMP_FILE img;
+    if (!bmp_load(carrierFilename, &img, method == PATCH_COLOR))
+        return 0;
+    if (img.format.png)
+    {
+        printf("Error: Patches support only BMP carriers\n");
+        stats_error(STAT_ERR_FORMAT);
+        bmp_free(&img);
+        return 0;
+    }
+
+    int startX = 0, startY = 0, imageSize = 0, embedded;
+    if (method == PATCH_SIMPLE)
+        embedded = (imageSize = simpleEmbedImage(&img, text, depth, NULL)) != 0;
+    else if (method == PATCH_COLOR)
+        embedded = color_embed_image(&img, text, &startX, &startY, NULL);
+    else
+        embedded = stegano_embed_image(&img, text, step, mask, NULL);
+
+    PATCH_DIFF d;
+    memset(&d, 0, sizeof(d));
+    d.list.last = -1;
+    hash_init(&d.carrierHash);
+    hash_init(&d.outputHash);
+
+    int ok = embedded && patch_diff(&d, &img, carrierFilename) && patch_write(patchFilename, &d, result);
+    bmp_free(&img);
+    if (d.file)
+        fclose(d.file);
+    free(d.buffer);
+    free(d.list.data);
+    if (!ok)
+        return 0;
+
+    size_t len = strlen(text);
+    if (method == PATCH_COLOR)
+        return saveColorKey(keyFilename, startX, startY, (int)len);
+    if (method == PATCH_STEGANO)
+        return save_stegano_key(keyFilename, step, len, mask);
+    if (keyFilename)
+        return saveSimpleKey(keyFilename, (int)len, imageSize);
+    return 1;
+}
+
+/**
+ * @brief Читает файл патча целиком и проверяет заголовок и список изменений.
+ */
+static unsigned char *patch_load(const char *patchFilename, size_t *size)
+{
+    FILE *file = fopen(patchFilename, "rb");
+    if (!file)
+    {
+        printf("Error: Cannot open patch file %s\n", patchFilename);
+        stats_error(STAT_ERR_IO);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = fileSize >= PATCH_HEADER_SIZE ? malloc((size_t)fileSize) : NULL;
+    int read = data && fread(data, 1, (size_t)fileSize, file) == (size_t)fileSize;
+    fclose(file);
+
+    long long outputSize = read ? (long long)get64(data + 20) : 0;
+    long long count = read ? (long long)get64(data + 36) : 0;
+    int ok = read && memcmp(data, PATCH_MAGIC, 4) == 0 && outputSize >= 0 && count >= 0;
+
+    // список должен содержать ровно count изменений внутри результата
+    const unsigned char *p = ok ? data + PATCH_HEADER_SIZE : NULL, *end = ok ? data + fileSize : NULL;
+    long long offset = -1;
+    unsigned char value;
+    for (long long i = 0; ok && i < count; i++)
+        ok = patch_next(&p, end, &offset, outputSize, &value);
+    if (!ok || p != end)
+    {
+        printf("Error: %s is not a valid patch file\n", patchFilename);
+        stats_error(STAT_ERR_KEY_INVALID);
+        free(data);
+        return NULL;
+    }
+
+    stats_add(STAT_BYTES_READ, fileSize);
+    *size = (size_t)fileSize;
+    return data;
+}
+
+/**
+ * @brief Создает временный файл результата рядом с ним ("<выход>.N.tmp").
+ *
+ * Файл создается только если его еще нет (O_EXCL), поэтому существующие файлы, в том
+ * числе исходное изображение и патч, не перезаписываются.
+ *
+ * @param tmp Буфер для имени не меньше strlen(outputFilename) + 16 байт.
+ * @return Файл, открытый для записи, или NULL при ошибке.
+ */
+static FILE *patch_create_temp(const char *outputFilename, char *tmp, size_t size)
+{
+    for (int i = 0; i < PATCH_TEMP_TRIES; i++)
+    {
+        snprintf(tmp, size, "%s.%d.tmp", outputFilename, i);
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0644);
+        if (fd >= 0)
+        {
+            FILE *file = fdopen(fd, "wb");
+            if (!file)
+            {
+                close(fd);
+                remove(tmp);
+            }
+            return file;
+        }
+        if (errno != EEXIST)
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Восстанавливает изображение с сообщением из исходного BMP и патча.
+ *
+ * Исходный файл читается фрагментами и сразу записывается с изменениями во временный
+ * файл рядом с результатом, поэтому память не зависит от размера изображения. Размер
+ * и XXH64 исходного файла и результата сверяются с заголовком патча; только после
+ * проверки временный файл переименовывается в результат, иначе удаляется. Поэтому
+ * результатом может быть сам исходный файл, а при ошибке он не изменяется.
+ *
+ * @param carrierFilename Исходный BMP.
+ * @param patchFilename Файл патча.
+ * @param outputFilename Файл для сохранения результата.
+ * @param result Размеры исходного изображения, результата и патча.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int patch_apply(const char *carrierFilename, const char *patchFilename, const char *outputFilename,
+                PATCH_RESULT *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    size_t patchSize;
+    unsigned char *patchData = patch_load(patchFilename, &patchSize);
+    if (!patchData)
+        return 0;
+
+    long long carrierSize = (long long)get64(patchData + 4), outputSize = (long long)get64(patchData + 20);
+    long long count = (long long)get64(patchData + 36);
+    FILE *carrier = fopen(carrierFilename, "rb");
+    long long actualSize = carrier && fseek(carrier, 0, SEEK_END) == 0 ? ftell(carrier) : -1;
+    if (carrier && actualSize != carrierSize)
+    {
+        printf("Error: Carrier %s does not match the patch\n", carrierFilename);
+        stats_error(STAT_ERR_KEY_INVALID);
+        fclose(carrier);
+        free(patchData);
+        return 0;
+    }
+    if (carrier)
+        rewind(carrier);
+
+    size_t tmpSize = strlen(outputFilename) + 16;
+    char *tmp = malloc(tmpSize);
+    FILE *output = carrier && tmp ? patch_create_temp(outputFilename, tmp, tmpSize) : NULL;
+    unsigned char *buffer = malloc(PATCH_TILE);
+    if (!carrier || !output || !buffer)
+    {
+        printf("Error: Cannot open %s\n", carrier ? outputFilename : carrierFilename);
+        stats_error(STAT_ERR_IO);
+        if (carrier)
+            fclose(carrier);
+        if (output)
+        {
+            fclose(output);
+            remove(tmp);
+        }
+        free(tmp);
+        free(buffer);
+        free(patchData);
+        return 0;
+    }
+
+    long long t = stats_start();
+    HASH_STATE carrierHash, outputHash;
+    hash_init(&carrierHash);
+    hash_init(&outputHash);
+
+    const unsigned char *p = patchData + PATCH_HEADER_SIZE, *end = patchData + patchSize;
+    long long next = -1, applied = 0, read = 0;
+    unsigned char value = 0;
+    if (count > 0)
+        patch_next(&p, end, &next, outputSize, &value);
+
+    for (long long pos = 0; pos < outputSize || !(feof(carrier) || ferror(carrier)); pos += PATCH_TILE)
+    {
+        size_t n = fread(buffer, 1, PATCH_TILE, carrier);
+        hash_update(&carrierHash, buffer, n);
+        read += n;
+        if (pos >= outputSize)
+            continue;
+
+        // байты результата за концом исходного файла нулевые, как в patch_diff
+        memset(buffer + n, 0, PATCH_TILE - n);
+        size_t m = outputSize - pos < PATCH_TILE ? (size_t)(outputSize - pos) : PATCH_TILE;
+        while (applied < count && next < pos + (long long)m)
+        {
+            buffer[next - pos] = value;
+            if (++applied < count)
+                patch_next(&p, end, &next, outputSize, &value);
+        }
+        fwrite(buffer, 1, m, output);
+        hash_update(&outputHash, buffer, m);
+    }
+    free(buffer);
+    fclose(carrier);
+    stats_add(STAT_BYTES_READ, read);
+
+    int failed = ferror(output);
+    if (fclose(output) != 0 || failed)
+    {
+        printf("Error: Cannot write output file %s\n", outputFilename);
+        stats_error(STAT_ERR_IO);
+        remove(tmp);
+        free(tmp);
+        free(patchData);
+        return 0;
+    }
+
+    int carrierOk = read == carrierSize && hash_digest(&carrierHash) == get64(patchData + 12);
+    int outputOk = hash_digest(&outputHash) == get64(patchData + 28);
+    free(patchData);
+    if (!carrierOk || !outputOk)
+    {
+        if (!carrierOk)
+            printf("Error: Carrier %s does not match the patch\n", carrierFilename);
+        else
+            printf("Error: Content hash of %s does not match the patch\n", outputFilename);
+        stats_error(STAT_ERR_KEY_INVALID);
+        remove(tmp);
+        free(tmp);
+        return 0;
+    }
+
+#ifdef _WIN32
+    // rename в Windows не заменяет существующий файл, а удалять его заранее нельзя:
+    // результатом может быть исходное изображение
+    int renamed = MoveFileExA(tmp, outputFilename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    int renamed = rename(tmp, outputFilename) == 0;
+#endif
+    if (!renamed)
+    {
+        printf("Error: Cannot write output file %s\n", outputFilename);
+        stats_error(STAT_ERR_IO);
+        remove(tmp);
+    }
+    free(tmp);
+    if (!renamed)
+        return 0;
+
+    result->carrierSize = carrierSize;
+    result->outputSize = outputSize;
+    result->changes = count;
+    result->patchSize = (long long)patchSize;
+    stats_add(STAT_BYTES_WRITTEN, outputSize);
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
+
+/**
+ * @brief Команда patch: экспорт изменений изображения в патч и восстановление по нему.
+ */
+int patch(int argc, char *argv[])
+{
+    if (argc == 4 && strcmp(argv[0], "apply") == 0)
+    {
+        PATCH_RESULT result;
+        if (!patch_apply(argv[1], argv[2], argv[3], &result))
+            return 1;
+        printf("Applied %s: %lld changes, %s verified (%lld bytes)\n", argv[2], result.changes, argv[3],
+               result.outputSize);
+        return 0;
+    }
+
+    int method = -1;
+    if (argc > 1 && strcmp(argv[0], "export") == 0)
+        method = strcmp(argv[1], "simple") == 0    ? PATCH_SIMPLE
+                 : strcmp(argv[1], "color") == 0   ? PATCH_COLOR
+                 : strcmp(argv[1], "stegano") == 0 ? PATCH_STEGANO
+                                                   : -1;
+
+    const char *keyFilename = method == PATCH_COLOR ? "color_key" : method == PATCH_STEGANO ? "stegano_key" : NULL;
+    const char *text = NULL;
+    int step = 1, depth = 1, mask = STEGANO_DEFAULT_MASK, valid = method >= 0 && argc >= 4, options = 1;
+    for (int i = 4; valid && i < argc; i++)
+    {
+        if (!options || strncmp(argv[i], "--", 2) != 0)
+        {
+            valid = !text; // текст - одно слово, лишние слова не отбрасываются молча
+            text = argv[i];
+        }
+        else if (strcmp(argv[i], "--") == 0)
+            options = 0;
+        else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc)
+            step = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc)
+            mask = stegano_parse_mask(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc)
+            keyFilename = argv[++i];
+        else
+            valid = 0;
+        if (!valid)
+            printf("Error: Unexpected or invalid argument %s\n", argv[i]);
+    }
+
+    if (!valid || !text || text[0] == '\0')
+    {
+        printf("Usage: patch export <simple|color|stegano> <carrier.bmp> <out.patch> [--step N] [--mask BGR] "
+               "[--depth K] [--key file] [--] <text>\n"
+               "       patch apply <carrier.bmp> <file.patch> <output.bmp>\n");
+        return 1;
+    }
+
+    srand(time(NULL));
+    PATCH_RESULT result;
+    if (!patch_export(method, argv[2], argv[3], keyFilename, text, step, mask, depth, &result))
+        return 1;
+    printf("Patch %s: %lld changes, %lld bytes instead of a %lld-byte image\n", argv[3], result.changes,
+           result.patchSize, result.outputSize);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+// Методы, результат которых можно передать патчем
+#define PATCH_SIMPLE 0
+#define PATCH_COLOR 1
+#define PATCH_STEGANO 2
+
+// Заголовок патча: метка, размер и XXH64 исходного изображения, размер и XXH64 результата,
+// количество изменений; все числа little-endian. За ним идут изменения по возрастанию смещений:
+// varint(смещение - предыдущее смещение - 1) и новое значение байта
+#define PATCH_MAGIC "BPT1"
+#define PATCH_HEADER_SIZE 44
+
+typedef struct
+{
+    long long carrierSize; // размер исходного изображения
+    long long outputSize;  // размер изображения с сообщением
+    long long changes;     // измененные байты
+    long long patchSize;   // размер файла патча
+} PATCH_RESULT;
+
+int patch_export(int method, const char *carrierFilename, const char *patchFilename, const char *keyFilename,
+                 const char *text, int step, int mask, int depth, PATCH_RESULT *result);
+int patch_apply(const char *carrierFilename, const char *patchFilename, const char *outputFilename,
+                PATCH_RESULT *result);
+int patch(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <string.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "perf.h"
+
+const char *const perfEventNames[PERF_EVENTS] = {"cycles", "instructions", "llc_misses", "dtlb_misses",
+                                                 "branch_misses"};
+
+#ifdef __linux__
+/**
+ * @brief Открывает один счетчик для текущего потока (только пользовательский режим).
+ */
+static int perf_open_event(unsigned int type, unsigned long long config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/**
+ * @brief Открывает счетчики циклов, инструкций, промахов LLC и dTLB и ошибок
+ * предсказания переходов для текущего потока.
+ *
+ * Счетчики, которые не поддерживаются процессором или запрещены настройкой
+ * kernel.perf_event_paranoid, остаются недоступными, код ошибки первого из них
+ * сохраняется в p->error.
+ *
+ * @param p Набор счетчиков.
+ * @return Количество открытых счетчиков.
+ */
+int perf_open(PERF *p)
+{
+    int opened = 0;
+    for (int i = 0; i < PERF_EVENTS; i++)
+        p->fd[i] = -1;
+    p->error = 0;
+
+#ifdef __linux__
+    static const unsigned long long cache = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    p->fd[PERF_CYCLES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    p->fd[PERF_INSTRUCTIONS] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    p->fd[PERF_LLC_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache);
+    p->fd[PERF_DTLB_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cache);
+    p->fd[PERF_BRANCH_MISSES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    for (int i = 0; i < PERF_EVENTS; i++)
+    {
+        if (p->fd[i] >= 0)
+            opened++;
+        else if (!p->error)
+            p->error = errno;
+    }
+#else
+    p->error = ENOSYS;
+#endif
+
+    return opened;
+}
+
+/**
+ * @brief Читает текущие значения счетчиков.
+ *
+ * Если ядро мультиплексирует счетчики, значение масштабируется на долю времени,
+ * в течение которой счетчик был активен.
+ *
+ * @param p Набор счетчиков.
+ * @param values Значения счетчиков; -1 для недоступных.
+ */
+void perf_read(const PERF *p, long long values[PERF_EVENTS])
+{
+    for (int i = 0; i < PERF_EVENTS; i++)
+    {
+        values[i] = -1;
+#ifdef __linux__
+        unsigned long long data[3]; // значение, время включения, время работы
+        if (p->fd[i] >= 0 && read(p->fd[i], data, sizeof(data)) == sizeof(data))
+            values[i] = data[2] && data[2] < data[1] ? (long long)((double)data[0] * data[1] / data[2])
+                                                     : (long long)data[0];
+#endif
+    }
+}
+
+/**
+ * @brief Закрывает счетчики.
+ */
+void perf_close(PERF *p)
+{
+    for (int i = 0; i < PERF_EVENTS; i++)
+    {
+#ifdef __linux__
+        if (p->fd[i] >= 0)
+            close(p->fd[i]);
+#endif
+        p->fd[i] = -1;
+    }
+}
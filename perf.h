@@ -0,0 +1,27 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Аппаратные счетчики производительности (perf_event_open, только Linux)
+typedef enum
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENTS
+} PERF_EVENT;
+
+typedef struct
+{
+    int fd[PERF_EVENTS]; // -1 если счетчик недоступен
+    int error;           // код ошибки первого недоступного счетчика
+} PERF;
+
+extern const char *const perfEventNames[PERF_EVENTS];
+
+int perf_open(PERF *p);
+void perf_read(const PERF *p, long long values[PERF_EVENTS]);
+void perf_close(PERF *p);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bmpinfo.h"
+#include "stats.h"
+#include "simple.h"
+#include "color_dec.h"
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "ecc.h"
+#include "plane.h"
+
+// Заголовок файла плоскости; плоскость действительна, пока размер и время изменения изображения те же
+typedef struct
+{
+    char magic[4];
+    unsigned int headerSize; // sizeof(PLANE_HEADER): формат зависит от сборки, файл - локальный кеш
+    long long imageSize, imageMtime, imageMtimeNs;
+    long long size;
+    BMP_FORMAT format;
+} PLANE_HEADER;
+
+static inline int plane_bit(const LSB_PLANE *p, long long offset)
+{
+    return (p->bits[offset >> 3] >> (offset & 7)) & 1;
+}
+
+/**
+ * @brief Собирает младшие биты size байтов в (size + 7) / 8 байт плоскости.
+ *
+ * С SSE2 16 байтов обрабатываются одной парой инструкций: сдвиг 16-битных слов на 7
+ * переносит младший бит каждого байта в старший, movemask собирает старшие биты.
+ */
+void plane_pack(const unsigned char *data, long long size, unsigned char *bits)
+{
+    long long i = 0;
+#ifdef __SSE2__
+    for (; i + 32 <= size; i += 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(data + i + 16));
+        unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_slli_epi16(a, 7)) |
+                         (unsigned int)_mm_movemask_epi8(_mm_slli_epi16(b, 7)) << 16;
+        bits[(i >> 3) + 0] = (unsigned char)m;
+        bits[(i >> 3) + 1] = (unsigned char)(m >> 8);
+        bits[(i >> 3) + 2] = (unsigned char)(m >> 16);
+        bits[(i >> 3) + 3] = (unsigned char)(m >> 24);
+    }
+#endif
+    for (; i < size; i += 8)
+    {
+        unsigned char b = 0;
+        for (int j = 0; j < 8 && i + j < size; j++)
+            b |= (data[i + j] & 1) << j;
+        bits[i >> 3] = b;
+    }
+}
+
+/**
+ * @brief Строит плоскость младших бит изображения.
+ *
+ * @param bmp Изображение, загруженное bmp_load со строками как в файле.
+ * @param plane Плоскость; освобождается plane_free.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int plane_build(const BMP_FILE *bmp, LSB_PLANE *plane)
+{
+    memset(plane, 0, sizeof(*plane));
+    if (bmp_stride(bmp) != bmp->format.rowSize)
+        return 0; // у строк без выравнивания потеряны младшие биты байтов выравнивания
+
+    plane->format = bmp->format;
+    plane->size = bmp->format.rowSize * bmp->format.height;
+    plane->bits = malloc((size_t)((plane->size + 7) / 8));
+    if (!plane->bits)
+    {
+        printf("Error: Not enough memory for the LSB plane\n");
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+    stats_alloc((plane->size + 7) / 8);
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    plane_pack(bmp->pixels, plane->size, plane->bits);
+    stats_kernel_stop(STAT_EXTRACT, &span);
+    return 1;
+}
+
+void plane_free(LSB_PLANE *plane)
+{
+    free(plane->bits);
+    plane->bits = NULL;
+}
+
+/**
+ * @brief Заполняет заголовок файла плоскости по метаданным изображения.
+ */
+static int plane_header(const char *imageFilename, const LSB_PLANE *plane, PLANE_HEADER *header)
+{
+    struct stat st;
+    if (stat(imageFilename, &st) != 0)
+        return 0;
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, PLANE_MAGIC, 4);
+    header->headerSize = sizeof(PLANE_HEADER);
+    header->imageSize = (long long)st.st_size;
+    header->imageMtime = (long long)st.st_mtime;
+#ifdef __linux__
+    header->imageMtimeNs = st.st_mtim.tv_nsec;
+#endif
+    header->size = plane->size;
+    header->format = plane->format;
+    return 1;
+}
+
+/**
+ * @brief Сохраняет плоскость в файл вместе с размером и временем изменения изображения.
+ *
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int plane_save(const char *planeFilename, const char *imageFilename, const LSB_PLANE *plane)
+{
+    PLANE_HEADER header;
+    if (!plane_header(imageFilename, plane, &header))
+        return 0;
+
+    long long t = stats_start();
+    FILE *file = fopen(planeFilename, "wb");
+    if (!file)
+    {
+        printf("Error: Cannot create LSB plane file %s\n", planeFilename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(plane->bits, 1, (size_t)((plane->size + 7) / 8), file);
+    stats_add(STAT_BYTES_WRITTEN, ftell(file));
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed)
+    {
+        printf("Error: Cannot write LSB plane file %s\n", planeFilename);
+        stats_error(STAT_ERR_IO);
+        remove(planeFilename);
+        return 0;
+    }
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
+
+/**
+ * @brief Загружает плоскость, сохраненную plane_save для того же, не изменившегося изображения.
+ *
+ * Ничего не выводит: отсутствующая или устаревшая плоскость строится заново (см. plane_open).
+ *
+ * @return 1 если плоскость загружена, 0 если файла нет, он поврежден или изображение изменилось.
+ */
+int plane_load(const char *planeFilename, const char *imageFilename, LSB_PLANE *plane)
+{
+    memset(plane, 0, sizeof(*plane));
+    PLANE_HEADER expected, header;
+    if (!plane_header(imageFilename, plane, &expected))
+        return 0;
+
+    long long t = stats_start();
+    FILE *file = fopen(planeFilename, "rb");
+    if (!file)
+        return 0;
+
+    int ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, PLANE_MAGIC, 4) == 0 &&
+             header.headerSize == sizeof(PLANE_HEADER) && header.imageSize == expected.imageSize &&
+             header.imageMtime == expected.imageMtime && header.imageMtimeNs == expected.imageMtimeNs &&
+             header.size == header.format.rowSize * header.format.height && header.size > 0;
+    size_t bytes = ok ? (size_t)((header.size + 7) / 8) : 0;
+    plane->bits = ok ? malloc(bytes) : NULL;
+    ok = plane->bits && fread(plane->bits, 1, bytes, file) == bytes;
+    fclose(file);
+    if (!ok)
+    {
+        plane_free(plane);
+        return 0;
+    }
+
+    plane->format = header.format;
+    plane->size = header.size;
+    stats_alloc(bytes);
+    stats_add(STAT_BYTES_READ, sizeof(header) + bytes);
+    stats_stop(STAT_READ, t);
+    return 1;
+}
+
+/**
+ * @brief Возвращает плоскость изображения: из файла "<изображение>.lsb", если он действителен,
+ * иначе строит ее по изображению и сохраняет рядом с ним.
+ *
+ * @param imageFilename Изображение BMP или PNG.
+ * @param plane Плоскость; освобождается plane_free.
+ * @param cached Указатель для признака того, что плоскость загружена из файла (может быть NULL).
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int plane_open(const char *imageFilename, LSB_PLANE *plane, int *cached)
+{
+    char planeFilename[1024];
+    snprintf(planeFilename, sizeof(planeFilename), "%s%s", imageFilename, PLANE_SUFFIX);
+
+    int loaded = plane_load(planeFilename, imageFilename, plane);
+    if (cached)
+        *cached = loaded;
+    if (loaded)
+        return 1;
+
+    BMP_FILE bmp;
+    if (!bmp_load(imageFilename, &bmp, 0))
+        return 0;
+    int built = plane_build(&bmp, plane);
+    bmp_free(&bmp);
+
+    // плоскость, которую не удалось сохранить, все равно пригодна для работы
+    if (built)
+        plane_save(planeFilename, imageFilename, plane);
+    return built;
+}
+
+/**
+ * @brief Извлекает текст метода прямого шифрования, встроенный с глубиной 1 (как decryptPixels).
+ *
+ * Ничего не выводит, поэтому подходит для перебора.
+ *
+ * @return Текст (освобождается вызывающей стороной) или NULL, если префикс длины некорректен,
+ * текст встроен с глубиной больше 1 или не помещается в изображение.
+ */
+char *plane_simple(const LSB_PLANE *plane)
+{
+    const BMP_FORMAT *format = &plane->format;
+    long long imageSize = (long long)format->width * format->height * format->channels;
+    int lane[3] = {format->offset[2], format->offset[1], format->offset[0]}; // B, G, R
+    int wide = format->bytesPerPixel == 4;
+    long long index = 0;
+    unsigned int prefix = 0;
+
+    for (; index < 32 && index < imageSize; index++)
+        prefix = prefix << 1 | plane_bit(plane, wide ? index / 3 * 4 + lane[index % 3] : index);
+
+    int textLen = prefix & SIMPLE_LEN_MASK;
+    int depth = (prefix >> SIMPLE_DEPTH_SHIFT) + 1;
+    if (textLen <= 0 || depth != 1 || 32 + textLen * 8LL > imageSize)
+        return NULL;
+
+    char *text = malloc(textLen + 1);
+    if (!text)
+        return NULL;
+    for (int i = 0; i < textLen; i++)
+    {
+        unsigned char ch = 0;
+        for (int j = 0; j < 8; j++, index++)
+            ch = ch << 1 | plane_bit(plane, wide ? index / 3 * 4 + lane[index % 3] : index);
+        text[i] = (char)ch;
+    }
+    text[textLen] = '\0';
+    return text;
+}
+
+/**
+ * @brief Извлекает сообщение стеганографии (как stegano_extract_format) без вывода сообщений.
+ *
+ * @param decoded Буфер из msgLen байт, заполненный нулями.
+ * @return 1 если сообщение извлечено целиком, 0 если изображение закончилось раньше или маска пуста.
+ */
+int plane_stegano(const LSB_PLANE *plane, char *decoded, size_t msgLen, int step, int mask)
+{
+    const BMP_FORMAT *format = &plane->format;
+    long long pixelCount = (long long)format->width * format->height;
+    int lanes[3];
+    int laneCount = stegano_lanes(format, mask, lanes);
+    size_t totalBits = msgLen * 8;
+    if (!laneCount || step <= 0 || (long long)((totalBits + laneCount - 1) / laneCount - 1) * step >= pixelCount)
+        return 0;
+
+    // байт сообщения собирается в регистре: обход без записи в память на каждый бит
+    long long offset = 0, stride = (long long)step * format->bytesPerPixel;
+    int lane = 0;
+    for (size_t i = 0; i < msgLen; i++)
+    {
+        unsigned int ch = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            ch |= plane_bit(plane, offset + lanes[lane]) << bit;
+            if (++lane == laneCount)
+            {
+                lane = 0;
+                offset += stride;
+            }
+        }
+        decoded[i] |= (char)ch;
+    }
+    return 1;
+}
+
+/**
+ * @brief Извлекает сообщение подстановки цветов (как extract_Message) без вывода сообщений.
+ *
+ * В отличие от extract_Message, обход не выходит за последний пиксель, а результат всегда
+ * завершается нулем, поэтому функция подходит для перебора начальных точек.
+ *
+ * @return Сообщение (освобождается вызывающей стороной) или NULL, если начальная точка вне
+ * изображения или сообщение не завершилось до его конца.
+ */
+char *plane_color(const LSB_PLANE *plane, int startX, int startY, int messageLen)
+{
+    static const int gray8[1] = {0};
+    const BMP_FORMAT *format = &plane->format;
+    const int *offset = format->bytesPerPixel == 1 ? gray8 : format->offset;
+    int width = format->width, channels = format->channels, bytesPerPixel = format->bytesPerPixel;
+    long long pixelCount = (long long)width * format->height;
+    long long pixel = (long long)startY * width + startX;
+    if (startX < 0 || startX >= width || startY < 0 || messageLen < 0 || pixel >= pixelCount)
+        return NULL;
+
+    char *message = malloc(messageLen + 1);
+    if (!message)
+        return NULL;
+
+    long long rowStart = (long long)startY * format->rowSize;
+    int x = startX, channel = 0;
+    for (int i = 0; i < messageLen + 1; i++)
+    {
+        char ch = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (pixel >= pixelCount)
+            {
+                free(message);
+                return NULL;
+            }
+            ch |= plane_bit(plane, rowStart + (long long)x * bytesPerPixel + offset[channel]) << bit;
+            if (++channel == channels)
+            {
+                channel = 0;
+                pixel++;
+                if (++x == width)
+                {
+                    x = 0;
+                    rowStart += format->rowSize;
+                }
+            }
+        }
+        message[i] = ch;
+        if (ch == '\0')
+            break;
+    }
+    message[messageLen] = '\0';
+    return message;
+}
+
+/**
+ * @brief Команда plane: построение плоскости младших бит и дешифрование по ней.
+ *
+ * Использование: plane build <изображение>
+ *                plane decode <simple|color|stegano> <изображение> [--key файл]
+ */
+int plane(int argc, char *argv[])
+{
+    int build = argc == 2 && strcmp(argv[0], "build") == 0;
+    int decode = argc >= 3 && strcmp(argv[0], "decode") == 0;
+    if (decode && strcmp(argv[1], "simple") != 0 && strcmp(argv[1], "color") != 0 &&
+        strcmp(argv[1], "stegano") != 0)
+        decode = 0;
+    if (!build && !decode)
+    {
+        printf("Usage: plane build <image>\n"
+               "       plane decode <simple|color|stegano> <image> [--key file]\n");
+        return 1;
+    }
+
+    if (build)
+    {
+        char planeFilename[1024];
+        snprintf(planeFilename, sizeof(planeFilename), "%s%s", argv[1], PLANE_SUFFIX);
+        BMP_FILE bmp;
+        LSB_PLANE p;
+        if (!bmp_load(argv[1], &bmp, 0))
+            return 1;
+        int ok = plane_build(&bmp, &p) && plane_save(planeFilename, argv[1], &p);
+        bmp_free(&bmp);
+        if (ok)
+            printf("LSB plane %s: %lld bytes for %lld bytes of pixel data\n", planeFilename, (p.size + 7) / 8,
+                   p.size);
+        plane_free(&p);
+        return ok ? 0 : 1;
+    }
+
+    const char *image = argv[2];
+    const char *keyFilename = argv[1][0] == 'c' ? "color_key" : "stegano_key";
+    for (int i = 3; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--key") == 0)
+            keyFilename = argv[++i];
+
+    LSB_PLANE p;
+    if (!plane_open(image, &p, NULL))
+        return 1;
+
+    char *message = NULL;
+    if (argv[1][0] == 's' && argv[1][1] == 'i')
+    {
+        message = plane_simple(&p);
+        if (!message)
+            printf("Error: No depth-1 text found in the LSB plane of %s\n", image);
+    }
+    else if (argv[1][0] == 'c')
+    {
+        int x, y, len;
+        if (load_color_key(keyFilename, &x, &y, &len) && !(message = plane_color(&p, x, y, len)))
+            printf("Error: Key %s does not fit image %s\n", keyFilename, image);
+    }
+    else
+    {
+        int step, mask, ecc;
+        size_t len;
+        if (load_stegano_key(keyFilename, &step, &len, &mask, &ecc))
+        {
+            message = calloc(len + 1, 1);
+            if (message && !plane_stegano(&p, message, len, step, mask))
+            {
+                printf("Reached end of image before decoding full message.\n");
+                free(message);
+                message = NULL;
+            }
+            if (message && ecc)
+            {
+                char *coded = message;
+                message = (char *)ecc_decode((unsigned char *)coded, len, &len, NULL);
+                free(coded);
+            }
+        }
+    }
+    plane_free(&p);
+
+    if (!message)
+        return 1;
+    printf("%s\n", message);
+    free(message);
+    return 0;
+}
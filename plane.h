@@ -0,0 +1,30 @@
+#ifndef PLANE_H
+#define PLANE_H
+
+#include <stddef.h>
+#include "bmpinfo.h"
+
+#define PLANE_MAGIC "LSB1"
+#define PLANE_SUFFIX ".lsb" // файл плоскости сохраняется рядом с изображением
+
+// Плоскость младших бит: бит i (bits[i / 8] >> (i % 8)) - младший бит i-го байта пиксельных
+// данных в порядке хранения, включая выравнивание строк
+typedef struct
+{
+    BMP_FORMAT format;
+    unsigned char *bits;
+    long long size; // байты пиксельных данных: rowSize * height
+} LSB_PLANE;
+
+void plane_pack(const unsigned char *data, long long size, unsigned char *bits);
+int plane_build(const BMP_FILE *bmp, LSB_PLANE *plane);
+void plane_free(LSB_PLANE *plane);
+int plane_save(const char *planeFilename, const char *imageFilename, const LSB_PLANE *plane);
+int plane_load(const char *planeFilename, const char *imageFilename, LSB_PLANE *plane);
+int plane_open(const char *imageFilename, LSB_PLANE *plane, int *cached);
+char *plane_simple(const LSB_PLANE *plane);
+int plane_stegano(const LSB_PLANE *plane, char *decoded, size_t msgLen, int step, int mask);
+char *plane_color(const LSB_PLANE *plane, int startX, int startY, int messageLen);
+int plane(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
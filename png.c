@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "deflate.h"
+#include "stats.h"
+#include "png.h"
+
+#define PNG_COLOR_RGB 2
+#define PNG_COLOR_RGBA 6
+#define PNG_IDAT_SIZE (1 << 20) // максимальный размер записываемого блока IDAT
+#define PNG_MAX_CHUNK 0x7FFFFFFFu
+
+static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+/**
+ * @brief Проверяет сигнатуру PNG в начале файла.
+ *
+ * @param data Начало файла.
+ * @param size Количество байт в data.
+ * @return 1 если это PNG, иначе 0.
+ */
+int png_signature(const unsigned char *data, size_t size)
+{
+    return size >= sizeof(pngSignature) && memcmp(data, pngSignature, sizeof(pngSignature)) == 0;
+}
+
+/**
+ * @brief Проверяет, что имя файла имеет расширение ".png" (без учета регистра).
+ *
+ * По расширению выбирается формат сохраняемого изображения.
+ */
+int png_filename(const char *filename)
+{
+    const char *dot = strrchr(filename, '.');
+    if (!dot)
+        return 0;
+
+    const char *ext = "png";
+    for (int i = 0; i < 3; i++)
+    {
+        if (tolower((unsigned char)dot[1 + i]) != ext[i])
+            return 0;
+    }
+    return dot[4] == '\0';
+}
+
+static unsigned int get_be32(const unsigned char *p)
+{
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
+}
+
+static void put_be32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/**
+ * @brief Заполняет таблицу CRC-32 (полином 0xEDB88320), которой PNG защищает блоки.
+ */
+static void crc_init(unsigned int *table)
+{
+    for (unsigned int n = 0; n < 256; n++)
+    {
+        unsigned int c = n;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+}
+
+static unsigned int crc_update(const unsigned int *table, unsigned int crc, const unsigned char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+/**
+ * @brief Разбирает данные блока IHDR.
+ *
+ * Поддерживаются изображения RGB и RGBA с 8 битами на канал без чересстрочной развертки.
+ *
+ * @return 1 если формат поддерживается, иначе 0.
+ */
+static int parse_ihdr(const unsigned char *ihdr, int *width, int *height, int *bytesPerPixel)
+{
+    unsigned int w = get_be32(ihdr), h = get_be32(ihdr + 4);
+    int depth = ihdr[8], color = ihdr[9];
+
+    if (w == 0 || h == 0 || w > INT_MAX || h > INT_MAX || depth != 8 ||
+        (color != PNG_COLOR_RGB && color != PNG_COLOR_RGBA) || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0)
+        return 0;
+
+    *width = (int)w;
+    *height = (int)h;
+    *bytesPerPixel = color == PNG_COLOR_RGBA ? 4 : 3;
+    // ядра методов адресуют пиксельные данные значениями int
+    return (long long)w * *bytesPerPixel * h <= INT_MAX;
+}
+
+/**
+ * @brief Заполняет заголовок BMP по заголовку PNG, как если бы изображение было
+ * записано в BMP со строками сверху вниз.
+ *
+ * @param data Начало файла (не меньше 33 байт: сигнатура и блок IHDR).
+ * @param size Количество байт в data.
+ * @param header Указатель на структуру для заголовка.
+ * @return 1 если формат поддерживается, иначе 0.
+ */
+int png_read_header(const unsigned char *data, size_t size, BMP_HEADER *header)
+{
+    int width, height, bytesPerPixel;
+    if (size < 33 || !png_signature(data, size) || get_be32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4) != 0 ||
+        !parse_ihdr(data + 16, &width, &height, &bytesPerPixel))
+        return 0;
+
+    memset(header, 0, sizeof(*header));
+    header->bfType = 0x4D42;
+    header->biSize = 40;
+    header->biWidth = width;
+    header->biHeight = -height;
+    header->biPlanes = 1;
+    header->biBitCount = (unsigned short)(bytesPerPixel * 8);
+    return 1;
+}
+
+/**
+ * @brief Предсказатель Паэта: из соседей a (слева), b (сверху) и c (сверху слева)
+ * выбирается ближайший к a + b - c.
+ */
+static inline int paeth(int a, int b, int c)
+{
+    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+    int ab = pb < pa ? b : a;
+    return pc < (pa < pb ? pa : pb) ? c : ab;
+}
+
+/**
+ * @brief Восстанавливает строку после фильтра PNG.
+ *
+ * @param row Строка без байта типа фильтра; восстанавливается на месте.
+ * @param prev Предыдущая восстановленная строка (для первой - нули).
+ * @return 1 при успехе, 0 при неизвестном типе фильтра.
+ */
+static int unfilter_row(unsigned char *row, const unsigned char *prev, int type, size_t len, int bpp)
+{
+    switch (type)
+    {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = bpp; i < len; i++)
+            row[i] += row[i - bpp];
+        break;
+    case 2:
+        for (size_t i = 0; i < len; i++)
+            row[i] += prev[i];
+        break;
+    case 3:
+        for (size_t i = 0; i < len; i++)
+            row[i] += ((i >= (size_t)bpp ? row[i - bpp] : 0) + prev[i]) >> 1;
+        break;
+    case 4:
+        for (size_t i = 0; i < len; i++)
+        {
+            int a = i >= (size_t)bpp ? row[i - bpp] : 0, c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+            row[i] += paeth(a, prev[i], c);
+        }
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Фильтрует строку PNG фильтром с наименьшей суммой модулей остатков.
+ *
+ * @param row Строка в порядке каналов PNG.
+ * @param prev Предыдущая строка (для первой - нули).
+ * @param out Байт типа фильтра и отфильтрованная строка (len + 1 байт).
+ */
+static void filter_row(const unsigned char *row, const unsigned char *prev, size_t len, int bpp, unsigned char *out)
+{
+    // у первых bpp байт нет левого соседа: a = c = 0
+    unsigned long long sums[5] = {0};
+    for (size_t i = 0; i < len; i++)
+    {
+        int x = row[i], b = prev[i];
+        int a = i >= (size_t)bpp ? row[i - bpp] : 0, c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+        sums[0] += abs((signed char)x);
+        sums[1] += abs((signed char)(x - a));
+        sums[2] += abs((signed char)(x - b));
+        sums[3] += abs((signed char)(x - ((a + b) >> 1)));
+        sums[4] += abs((signed char)(x - paeth(a, b, c)));
+    }
+
+    int type = 0;
+    for (int f = 1; f < 5; f++)
+    {
+        if (sums[f] < sums[type])
+            type = f;
+    }
+
+    out[0] = (unsigned char)type;
+    out++;
+    size_t i = 0;
+    switch (type)
+    {
+    case 0:
+        memcpy(out, row, len);
+        break;
+    case 1:
+        memcpy(out, row, bpp);
+        for (i = bpp; i < len; i++)
+            out[i] = (unsigned char)(row[i] - row[i - bpp]);
+        break;
+    case 2:
+        for (; i < len; i++)
+            out[i] = (unsigned char)(row[i] - prev[i]);
+        break;
+    case 3:
+        for (; i < (size_t)bpp; i++)
+            out[i] = (unsigned char)(row[i] - (prev[i] >> 1));
+        for (; i < len; i++)
+            out[i] = (unsigned char)(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+        break;
+    default:
+        for (; i < (size_t)bpp; i++)
+            out[i] = (unsigned char)(row[i] - prev[i]);
+        for (; i < len; i++)
+            out[i] = (unsigned char)(row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]));
+        break;
+    }
+}
+
+/**
+ * @brief Смещение байта альфа-канала 32-битного пикселя: байт, не занятый R, G и B.
+ */
+static int alpha_offset(const BMP_FORMAT *format)
+{
+    return 6 - format->offset[0] - format->offset[1] - format->offset[2];
+}
+
+/**
+ * @brief Загружает PNG в структуру BMP-файла.
+ *
+ * Пиксели хранятся как у BMP со строками сверху вниз: BGR для RGB и BGRA (маски
+ * BI_BITFIELDS) для RGBA, без выравнивания строк, как в самом PNG. Для них
+ * создаются заголовки BMP, поэтому результат можно сохранить и как BMP.
+ * Контрольные суммы блоков и потока zlib проверяются.
+ *
+ * @param file Файл, прочитанный до конца сигнатуры.
+ * @param filename Имя файла для сообщений об ошибках.
+ * @param bmp Указатель на структуру для загруженного файла.
+ * @param packed Значение поля packed (строки PNG не выравниваются).
+ * @param start Время начала разбора заголовка для статистики.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int png_load(FILE *file, const char *filename, BMP_FILE *bmp, int packed, long long start)
+{
+    unsigned int crcTable[256];
+    crc_init(crcTable);
+
+    unsigned char *idat = NULL, *chunk = NULL;
+    size_t idatSize = 0, idatCapacity = 0;
+    int width = 0, height = 0, bytesPerPixel = 0, header = 0, ended = 0, ok = 1;
+    unsigned long long bytesRead = sizeof(pngSignature);
+    long long t = start;
+
+    unsigned char head[8];
+    while (ok && !ended && fread(head, 1, sizeof(head), file) == sizeof(head))
+    {
+        unsigned int length = get_be32(head);
+        const unsigned char *type = head + 4;
+        if (length > PNG_MAX_CHUNK || (!header && memcmp(type, "IHDR", 4) != 0))
+        {
+            ok = 0;
+            break;
+        }
+
+        // данные IDAT сразу дописываются к сжатому потоку
+        unsigned char *data;
+        if (memcmp(type, "IDAT", 4) == 0)
+        {
+            if (idatSize + length > idatCapacity)
+            {
+                size_t capacity = idatCapacity * 2 > idatSize + length ? idatCapacity * 2 : idatSize + length;
+                unsigned char *grown = realloc(idat, capacity);
+                if (!grown)
+                {
+                    printf("Error: Not enough memory for %s\n", filename);
+                    stats_error(STAT_ERR_MEMORY);
+                    free(idat);
+                    return 0;
+                }
+                idat = grown;
+                idatCapacity = capacity;
+            }
+            data = idat + idatSize;
+        }
+        else
+        {
+            free(chunk);
+            chunk = malloc(length ? length : 1);
+            if (!chunk)
+            {
+                ok = 0;
+                break;
+            }
+            data = chunk;
+        }
+
+        unsigned char crc[4];
+        if (fread(data, 1, length, file) != length || fread(crc, 1, sizeof(crc), file) != sizeof(crc) ||
+            (crc_update(crcTable, crc_update(crcTable, 0xFFFFFFFFu, type, 4), data, length) ^ 0xFFFFFFFFu) !=
+                get_be32(crc))
+        {
+            ok = 0;
+            break;
+        }
+        bytesRead += 12ULL + length;
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (header || length != 13 || !parse_ihdr(data, &width, &height, &bytesPerPixel))
+            {
+                printf("Error: Unsupported PNG format in %s (bit depth %d, color type %d); "
+                       "8-bit RGB and RGBA PNGs without interlacing are supported\n",
+                       filename, length == 13 ? data[8] : 0, length == 13 ? data[9] : 0);
+                stats_error(STAT_ERR_FORMAT);
+                free(chunk);
+                free(idat);
+                return 0;
+            }
+            header = 1;
+            stats_stop(STAT_HEADER, t);
+            t = stats_start();
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+            idatSize += length;
+        else if (memcmp(type, "IEND", 4) == 0)
+            ended = 1;
+        else if (isupper(type[0]) && memcmp(type, "PLTE", 4) != 0)
+            ok = 0; // неизвестный обязательный блок
+    }
+    free(chunk);
+    stats_add(STAT_BYTES_READ, bytesRead);
+
+    if (!ok || !ended)
+    {
+        printf("Error: Corrupted or unsupported PNG file %s\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+        free(idat);
+        return 0;
+    }
+
+    size_t rowBytes = (size_t)width * bytesPerPixel;
+    size_t rawSize = (rowBytes + 1) * height;
+    unsigned char *raw = malloc(rawSize), *zero = calloc(rowBytes, 1);
+    if (!raw || !zero || !bmp_create(bmp, width, -height, bytesPerPixel * 8) ||
+        !(bmp->pixels = malloc(rowBytes * height)))
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        free(raw);
+        free(zero);
+        free(idat);
+        bmp_free(bmp);
+        return 0;
+    }
+    stats_alloc(rowBytes * height);
+    bmp->packed = packed;
+    bmp->format.png = 1;
+    bmp->format.rowSize = rowBytes;
+
+    ok = zlib_decompress(idat, idatSize, raw, rawSize);
+    free(idat);
+
+    // RGB(A) -> BGR(A): R и B меняются местами, альфа остается в последнем байте
+    const unsigned char *prev = zero;
+    for (int y = 0; ok && y < height; y++)
+    {
+        unsigned char *row = raw + (rowBytes + 1) * y + 1;
+        ok = unfilter_row(row, prev, row[-1], rowBytes, bytesPerPixel);
+        prev = row;
+
+        unsigned char *out = bmp->pixels + rowBytes * y;
+        for (size_t i = 0; i < rowBytes; i += bytesPerPixel)
+        {
+            out[i] = row[i + 2];
+            out[i + 1] = row[i + 1];
+            out[i + 2] = row[i];
+            if (bytesPerPixel == 4)
+                out[i + 3] = row[i + 3];
+        }
+    }
+    free(raw);
+    free(zero);
+
+    if (!ok)
+    {
+        printf("Error: Corrupted PNG file %s\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+        bmp_free(bmp);
+        return 0;
+    }
+    stats_stop(STAT_READ, t);
+    return 1;
+}
+
+/**
+ * @brief Записывает блок PNG: длину, тип, данные и CRC.
+ */
+static void write_chunk(FILE *file, const unsigned int *crcTable, const char *type, const unsigned char *data,
+                        size_t length)
+{
+    unsigned char head[8], crc[4];
+    put_be32(head, (unsigned int)length);
+    memcpy(head + 4, type, 4);
+    put_be32(crc, crc_update(crcTable, crc_update(crcTable, 0xFFFFFFFFu, head + 4, 4), data, length) ^ 0xFFFFFFFFu);
+
+    fwrite(head, 1, sizeof(head), file);
+    fwrite(data, 1, length, file);
+    fwrite(crc, 1, sizeof(crc), file);
+}
+
+/**
+ * @brief Сохраняет изображение в PNG (RGB для 24-битных, RGBA для 32-битных пикселей).
+ *
+ * Каждая строка фильтруется фильтром с наименьшей суммой остатков и сжимается
+ * быстрым уровнем DEFLATE. Младшие биты каналов сохраняются без потерь.
+ *
+ * @param filename Имя файла для сохранения.
+ * @param bmp Изображение с 3 или 4 байтами на пиксель.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int png_save(const char *filename, const BMP_FILE *bmp)
+{
+    const BMP_FORMAT *format = &bmp->format;
+    int bpp = format->bytesPerPixel, width = format->width, height = format->height;
+    if (bpp != 3 && bpp != 4)
+    {
+        printf("Error: PNG output supports only 24-bit and 32-bit images\n");
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+
+    long long t = stats_start();
+    size_t rowBytes = (size_t)width * bpp;
+    size_t rawSize = (rowBytes + 1) * height;
+    unsigned char *raw = malloc(rawSize), *rows = calloc(2, rowBytes);
+    if (!raw || !rows)
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        free(raw);
+        free(rows);
+        return 0;
+    }
+
+    const int *offset = format->offset;
+    int alpha = bpp == 4 ? alpha_offset(format) : 0;
+    long long stride = bmp_stride(bmp);
+    unsigned char *row = rows, *prev = rows + rowBytes;
+
+    for (int y = 0; y < height; y++)
+    {
+        // строки PNG идут сверху вниз
+        const unsigned char *src = bmp->pixels + stride * (format->topDown ? y : height - 1 - y);
+        for (int x = 0; x < width; x++, src += bpp)
+        {
+            unsigned char *px = row + (size_t)x * bpp;
+            px[0] = src[offset[0]];
+            px[1] = src[offset[1]];
+            px[2] = src[offset[2]];
+            if (bpp == 4)
+                px[3] = src[alpha];
+        }
+        filter_row(row, prev, rowBytes, bpp, raw + (rowBytes + 1) * y);
+
+        unsigned char *swap = prev;
+        prev = row;
+        row = swap;
+    }
+    free(rows);
+
+    size_t compressedSize;
+    unsigned char *compressed = zlib_compress(raw, rawSize, &compressedSize);
+    free(raw);
+    if (!compressed)
+    {
+        printf("Error: Not enough memory for %s\n", filename);
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        printf("Error: Cannot create output file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        free(compressed);
+        return 0;
+    }
+
+    unsigned int crcTable[256];
+    crc_init(crcTable);
+
+    unsigned char ihdr[13];
+    put_be32(ihdr, (unsigned int)width);
+    put_be32(ihdr + 4, (unsigned int)height);
+    ihdr[8] = 8;
+    ihdr[9] = bpp == 4 ? PNG_COLOR_RGBA : PNG_COLOR_RGB;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    fwrite(pngSignature, 1, sizeof(pngSignature), file);
+    write_chunk(file, crcTable, "IHDR", ihdr, sizeof(ihdr));
+    for (size_t pos = 0; pos < compressedSize; pos += PNG_IDAT_SIZE)
+    {
+        size_t n = compressedSize - pos < PNG_IDAT_SIZE ? compressedSize - pos : PNG_IDAT_SIZE;
+        write_chunk(file, crcTable, "IDAT", compressed + pos, n);
+    }
+    write_chunk(file, crcTable, "IEND", NULL, 0);
+    free(compressed);
+
+    stats_add(STAT_BYTES_WRITTEN, ftell(file));
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed)
+    {
+        printf("Error: Cannot write output file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
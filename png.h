@@ -0,0 +1,13 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdio.h>
+#include "bmpinfo.h"
+
+int png_signature(const unsigned char *data, size_t size);
+int png_filename(const char *filename);
+int png_read_header(const unsigned char *data, size_t size, BMP_HEADER *header);
+int png_load(FILE *file, const char *filename, BMP_FILE *bmp, int packed, long long start);
+int png_save(const char *filename, const BMP_FILE *bmp);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "numa.h"
+#include "stats.h"
+#include "pool.h"
+
+#define POOL_QUEUE_SIZE 4096
+#define POOL_MAX_THREADS 64
+
+struct POOL
+{
+    char *items[POOL_QUEUE_SIZE];
+    int head, tail, count;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    POOL_TASK task;
+    void *ctx;
+    pthread_t workers[POOL_MAX_THREADS];
+    int started;
+    int bound;    // рабочие потоки, уже закрепленные за узлами NUMA
+    STATS *stats; // накопитель потока, запустившего пул, или NULL
+};
+
+/**
+ * @brief Возвращает число потоков по умолчанию (количество логических процессоров).
+ *
+ * @return Количество потоков, не меньше 1.
+ */
+int pool_threads()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int n = (int)info.dwNumberOfProcessors;
+#else
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        n = 1;
+    if (n > POOL_MAX_THREADS)
+        n = POOL_MAX_THREADS;
+    return n;
+}
+
+/**
+ * @brief Рабочий поток: забирает элементы из очереди и вызывает для них обработчик.
+ *
+ * Потоки по очереди закрепляются за узлами NUMA, поэтому элемент целиком
+ * обрабатывается на одном узле и с памятью этого узла. Если у потока, запустившего
+ * пул, включен сбор статистики, каждый рабочий поток ведет свой накопитель и при
+ * завершении добавляет его к накопителю запустившего.
+ */
+static void *pool_worker(void *arg)
+{
+    POOL *pool = arg;
+    numa_bind_worker(__atomic_fetch_add(&pool->bound, 1, __ATOMIC_RELAXED));
+    STATS stats;
+    memset(&stats, 0, sizeof(stats));
+    if (pool->stats)
+        stats_attach(&stats);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->count == 0 && !pool->done)
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+
+        if (pool->count == 0)
+        {
+            if (pool->stats)
+                stats_merge(pool->stats, &stats);
+            pthread_mutex_unlock(&pool->lock);
+            stats_attach(NULL);
+            return NULL;
+        }
+
+        char *item = pool->items[pool->head];
+        pool->head = (pool->head + 1) % POOL_QUEUE_SIZE;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->task(item, pool->ctx);
+        free(item);
+    }
+}
+
+/**
+ * @brief Запускает пул рабочих потоков с ограниченной очередью заданий.
+ *
+ * Обработчик вызывается одновременно из нескольких потоков и должен сам
+ * синхронизировать доступ к общим данным в ctx. На системах с несколькими
+ * узлами NUMA потоки распределяются между узлами поровну (см. numa_bind_worker).
+ *
+ * @param threads Количество рабочих потоков (0 - по числу процессоров).
+ * @param task Обработчик элемента очереди.
+ * @param ctx Пользовательские данные для обработчика.
+ * @return Указатель на пул или NULL при ошибке.
+ */
+POOL *pool_start(int threads, POOL_TASK task, void *ctx)
+{
+    if (threads <= 0)
+        threads = pool_threads();
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    POOL *pool = calloc(1, sizeof(POOL));
+    if (!pool)
+        return NULL;
+
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->stats = stats_current();
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create(&pool->workers[pool->started], NULL, pool_worker, pool) == 0)
+            pool->started++;
+    }
+
+    if (pool->started == 0)
+    {
+        printf("Error: Cannot start worker threads\n");
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->not_empty);
+        pthread_cond_destroy(&pool->not_full);
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Кладет элемент в очередь, ожидая свободного места.
+ *
+ * @param pool Пул потоков.
+ * @param item Строка, выделенная через malloc; освобождается пулом после обработки.
+ */
+void pool_push(POOL *pool, char *item)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count == POOL_QUEUE_SIZE)
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+
+    pool->items[pool->tail] = item;
+    pool->tail = (pool->tail + 1) % POOL_QUEUE_SIZE;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Дожидается обработки всех элементов очереди и останавливает потоки.
+ *
+ * @param pool Пул потоков; после вызова освобождается.
+ */
+void pool_finish(POOL *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->done = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+    free(pool);
+}
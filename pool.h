@@ -0,0 +1,12 @@
+#ifndef POOL_H
+#define POOL_H
+
+typedef void (*POOL_TASK)(const char *item, void *ctx);
+typedef struct POOL POOL;
+
+int pool_threads();
+POOL *pool_start(int threads, POOL_TASK task, void *ctx);
+void pool_push(POOL *pool, char *item);
+void pool_finish(POOL *pool);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bmpinfo.h"
+#include "png.h"
+#include "walk.h"
+#include "simple.h"
+#include "probe.h"
+
+#define PROBE_PAGE 4096
+#define PROBE_PREVIEW 32
+#define PROBE_PREFIX_BYTES 48 // байты пикселей с 32 битами префикса (у 32-битных изображений)
+
+typedef struct
+{
+    long long files, candidates, skipped;
+    pthread_mutex_t lock;
+} PROBE_CTX;
+
+/**
+ * @brief Проверяет, может ли байт встретиться в тексте, введенном пользователем.
+ *
+ * Текст вводится одной строкой, поэтому управляющие символы недопустимы.
+ * Байты от 0x80 разрешены (UTF-8).
+ */
+static int is_text_byte(unsigned char c)
+{
+    return (c >= 0x20 && c != 0x7F) || c >= 0x80;
+}
+
+/**
+ * @brief Читает одну страницу пиксельных данных BMP, начиная с dataOffset.
+ *
+ * Обычно заголовок и начало пикселей лежат в первой странице файла,
+ * и хватает одного чтения.
+ *
+ * @return Указатель на начало пиксельных данных в buffer и их количество в *available,
+ *         или NULL при ошибке.
+ */
+static unsigned char *read_first_page(FILE *f, unsigned char *buffer, size_t n, const BMP_FORMAT *format,
+                                      size_t *available)
+{
+    if (format->dataOffset + PROBE_PREFIX_BYTES <= n)
+    {
+        *available = n - format->dataOffset;
+        return buffer + format->dataOffset;
+    }
+
+    if (fseek(f, format->dataOffset, SEEK_SET) != 0)
+        return NULL;
+
+    *available = fread(buffer, 1, PROBE_PAGE, f);
+    return *available >= PROBE_PREFIX_BYTES ? buffer : NULL;
+}
+
+/**
+ * @brief Смещение байта канала с номером sample метода прямого шифрования (как в extractFormat):
+ * у 32-битных пикселей байт альфа-канала пропускается.
+ */
+static size_t sample_offset(const BMP_FORMAT *format, size_t sample)
+{
+    if (format->bytesPerPixel == 4)
+        return sample / 3 * 4 + format->offset[2 - sample % 3]; // B, G, R
+    return sample;
+}
+
+/**
+ * @brief Проверяет префикс и начало текста метода прямого шифрования.
+ *
+ * Из младших битов первых 32 байтов каналов собирается префикс (как в decryptText):
+ * длина текста и глубина встраивания. Изображение считается кандидатом, если старшие
+ * биты префикса равны нулю, длина не превышает емкость изображения при этой глубине и
+ * все символы, попавшие в available байт данных, похожи на текст.
+ *
+ * @return 1 для кандидата; длина текста и начало сообщения - в *textLen и preview.
+ */
+static int probe_data(const BMP_FORMAT *format, const unsigned char *data, size_t available, unsigned int *textLen,
+                      char *preview)
+{
+    size_t samples = format->bytesPerPixel == 4 ? available / 4 * 3 : available;
+    if (samples < 32)
+        return 0;
+
+    unsigned int prefix = 0;
+    for (size_t i = 0; i < 32; i++)
+        prefix = (prefix << 1) | (data[sample_offset(format, i)] & 1);
+
+    *textLen = prefix & SIMPLE_LEN_MASK;
+    int depth = (int)(prefix >> SIMPLE_DEPTH_SHIFT) + 1;
+    long long capacity = (long long)format->width * format->height * format->channels;
+    int candidate = *textLen > 0 && depth <= SIMPLE_MAX_DEPTH && simpleSamples((int)*textLen, depth) <= capacity;
+
+    int previewLen = 0;
+    size_t inPage = (samples - 32) * depth / 8;
+    if (inPage > *textLen)
+        inPage = *textLen;
+
+    // биты текста идут подряд по depth младших бит каждого байта, от старшего к младшему
+    unsigned char mask = (unsigned char)((1 << depth) - 1);
+    unsigned int acc = 0;
+    int accBits = 0;
+    size_t sample = 32;
+    for (size_t i = 0; candidate && i < inPage; i++)
+    {
+        while (accBits < 8)
+        {
+            acc = acc << depth | (data[sample_offset(format, sample++)] & mask);
+            accBits += depth;
+        }
+        accBits -= 8;
+        unsigned char ch = (unsigned char)(acc >> accBits);
+        acc &= (1u << accBits) - 1;
+
+        if (!is_text_byte(ch))
+            candidate = 0;
+        else if (previewLen < PROBE_PREVIEW)
+            preview[previewLen++] = ch;
+    }
+    preview[previewLen] = '\0';
+    return candidate;
+}
+
+/**
+ * @brief Обработчик одного файла: проверяет сигнатуру метода прямого шифрования.
+ *
+ * У BMP любого поддерживаемого формата (см. bmp_parse_format) читается одна страница:
+ * заголовки и начало пикселей. PNG сжат, поэтому загружается целиком.
+ */
+static void probe_visit(const char *path, void *arg)
+{
+    PROBE_CTX *ctx = arg;
+    unsigned char buffer[PROBE_PAGE];
+    BMP_FORMAT format;
+    BMP_FILE png;
+    size_t n = 0, available = 0;
+    unsigned char *data = NULL;
+
+    memset(&png, 0, sizeof(png));
+    FILE *f = fopen(path, "rb");
+    if (f)
+    {
+        setvbuf(f, NULL, _IONBF, 0);
+        n = fread(buffer, 1, PROBE_PAGE, f);
+        if (png_signature(buffer, n))
+        {
+            fclose(f);
+            f = NULL;
+            if (bmp_load(path, &png, 0))
+            {
+                format = png.format;
+                data = png.pixels;
+                available = (size_t)bmp_stride(&png) * format.height;
+            }
+        }
+        else if (bmp_parse_format(buffer, n, &format))
+            data = read_first_page(f, buffer, n, &format, &available);
+        if (f)
+            fclose(f);
+    }
+
+    unsigned int textLen = 0;
+    char preview[PROBE_PREVIEW + 1];
+    int candidate = data && probe_data(&format, data, available, &textLen, preview);
+    bmp_free(&png);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->files++;
+    if (!data)
+        ctx->skipped++;
+    else if (candidate)
+    {
+        printf("%s\t%u\t%s\n", path, textLen, preview);
+        ctx->candidates++;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief Команда probe: ищет изображения, содержащие сообщение метода прямого шифрования.
+ *
+ * Использование: probe <файл|каталог> [потоки]
+ *
+ * Для каждого BMP-файла (8, 24 или 32 бита) читается одна страница (заголовок и
+ * начало пикселей), PNG загружается целиком; проверяется префикс длины и первые
+ * символы текста. Выводятся файлы-кандидаты:
+ * путь, длина текста и начало сообщения.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int probe(int argc, char *argv[])
+{
+    if (argc < 1)
+    {
+        printf("Usage: probe <file|directory> [threads]\n");
+        return 1;
+    }
+
+    // Проверка упирается в диск, поэтому потоков больше, чем процессоров
+    int threads = argc > 1 ? atoi(argv[1]) : pool_threads() * 4;
+
+    PROBE_CTX ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    printf("# file\tlength\tpreview\n");
+    int found = walk_tree(argv[0], threads, WALK_BMP | WALK_PNG, probe_visit, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+
+    if (found < 0)
+        return 1;
+
+    printf("\nFiles: %lld, candidates: %lld, skipped (unsupported format): %lld\n",
+           ctx.files, ctx.candidates, ctx.skipped);
+    return 0;
+}
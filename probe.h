@@ -0,0 +1,6 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+int probe(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netdb.h>
+#endif
+#include "prom.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Период проверки входящих соединений и флага остановки, мс
+#define PROM_TICK_MS 200
+
+// Границы интервалов гистограмм длительности, с
+static const double promBuckets[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                     0.05,   0.1,     0.25,   0.5,   1,      2.5,   5,     10};
+#define PROM_BUCKETS (int)(sizeof(promBuckets) / sizeof(promBuckets[0]))
+
+struct PROM
+{
+    PROM_RENDER render;
+    void *ctx;
+    const char *file;   // путь файла для node_exporter textfile collector или NULL
+    int interval;       // период перезаписи файла, с
+    int listenFd;       // слушающий сокет HTTP или -1
+    char unixPath[108]; // путь unix-сокета, удаляемый при остановке
+    int stop;
+    pthread_t thread;
+};
+
+/**
+ * @brief Выводит заголовок семейства метрик (HELP и TYPE).
+ *
+ * @param out Поток вывода.
+ * @param name Имя метрики.
+ * @param type Тип: counter, gauge или histogram.
+ * @param help Описание метрики.
+ */
+void prom_family(FILE *out, const char *name, const char *type, const char *help)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief Выводит гистограмму длительностей в наносекундах как гистограмму Prometheus в секундах.
+ *
+ * @param out Поток вывода.
+ * @param name Имя метрики (без суффиксов _bucket, _sum и _count).
+ * @param label Имя метки или NULL.
+ * @param value Значение метки.
+ * @param h Гистограмма.
+ */
+void prom_histogram(FILE *out, const char *name, const char *label, const char *value, const STATS_HIST *h)
+{
+    char labels[128] = "";
+    if (label)
+        snprintf(labels, sizeof(labels), "%s=\"%s\",", label, value);
+
+    for (int i = 0; i < PROM_BUCKETS; i++)
+        fprintf(out, "%s_bucket{%sle=\"%g\"} %lld\n", name, labels, promBuckets[i],
+                stats_hist_count_below(h, (long long)(promBuckets[i] * 1e9)));
+    fprintf(out, "%s_bucket{%sle=\"+Inf\"} %llu\n", name, labels, h->count);
+
+    if (label)
+        labels[strlen(labels) - 1] = '\0';
+    fprintf(out, "%s_sum{%s} %.9f\n", name, labels, h->sum / 1e9);
+    fprintf(out, "%s_count{%s} %llu\n", name, labels, h->count);
+}
+
+/**
+ * @brief Записывает метрики во временный файл и переименовывает его, чтобы читатель
+ * никогда не видел файл частично записанным.
+ *
+ * @return 1 при успехе, 0 при ошибке.
+ */
+static int prom_write_file(PROM *prom)
+{
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", prom->file);
+
+    FILE *out = fopen(tmp, "w");
+    if (!out)
+        return 0;
+    prom->render(out, prom->ctx);
+    if (fclose(out) != 0)
+    {
+        remove(tmp);
+        return 0;
+    }
+#ifdef _WIN32
+    remove(prom->file);
+#endif
+    return rename(tmp, prom->file) == 0;
+}
+
+#ifndef _WIN32
+/**
+ * @brief Открывает слушающий сокет: "unix:/путь" или "[адрес]:порт".
+ *
+ * @return Дескриптор сокета или -1 при ошибке.
+ */
+static int prom_listen(PROM *prom, const char *spec)
+{
+    if (strncmp(spec, "unix:", 5) == 0)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(spec + 5) >= sizeof(addr.sun_path))
+        {
+            printf("Error: Unix socket path is too long: %s\n", spec + 5);
+            return -1;
+        }
+        strcpy(addr.sun_path, spec + 5);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        unlink(addr.sun_path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+        {
+            printf("Error: Cannot listen on %s\n", spec);
+            close(fd);
+            return -1;
+        }
+        strcpy(prom->unixPath, addr.sun_path);
+        return fd;
+    }
+
+    char host[256] = "";
+    const char *port = strrchr(spec, ':');
+    if (port)
+    {
+        size_t len = port - spec;
+        if (len >= sizeof(host))
+            len = sizeof(host) - 1;
+        memcpy(host, spec, len);
+        host[len] = '\0';
+        port++;
+    }
+    else
+        port = spec;
+
+    struct addrinfo hints, *list;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &list) != 0)
+    {
+        printf("Error: Cannot resolve listen address %s\n", spec);
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = list; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 16) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+
+    if (fd < 0)
+        printf("Error: Cannot listen on %s\n", spec);
+    return fd;
+}
+
+/**
+ * @brief Отвечает на один HTTP-запрос текущими значениями метрик и закрывает соединение.
+ */
+static void prom_serve(PROM *prom, int client)
+{
+    struct timeval timeout = {1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // тело запроса не разбирается: на любой путь отдаются метрики
+    char request[2048];
+    if (recv(client, request, sizeof(request), 0) <= 0)
+        return;
+
+    FILE *body = tmpfile();
+    if (!body)
+        return;
+    prom->render(body, prom->ctx);
+    long length = ftell(body);
+    rewind(body);
+
+    char buffer[4096];
+    int n = snprintf(buffer, sizeof(buffer),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %ld\r\nConnection: close\r\n\r\n",
+                     length);
+    int ok = send(client, buffer, n, MSG_NOSIGNAL) == n;
+    size_t got;
+    while (ok && (got = fread(buffer, 1, sizeof(buffer), body)) > 0)
+        ok = send(client, buffer, got, MSG_NOSIGNAL) == (ssize_t)got;
+    fclose(body);
+}
+#endif
+
+/**
+ * @brief Ждет один такт, обслуживая входящие соединения.
+ */
+static void prom_tick(PROM *prom)
+{
+#ifdef _WIN32
+    Sleep(PROM_TICK_MS);
+#else
+    if (prom->listenFd < 0)
+    {
+        struct timespec ts = {0, PROM_TICK_MS * 1000000L};
+        nanosleep(&ts, NULL);
+        return;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(prom->listenFd, &fds);
+    struct timeval timeout = {0, PROM_TICK_MS * 1000};
+    if (select(prom->listenFd + 1, &fds, NULL, NULL, &timeout) > 0)
+    {
+        int client = accept(prom->listenFd, NULL, NULL);
+        if (client >= 0)
+        {
+            prom_serve(prom, client);
+            close(client);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Поток экспорта: обслуживает HTTP-запросы и периодически перезаписывает файл метрик.
+ */
+static void *prom_thread(void *arg)
+{
+    PROM *prom = arg;
+    long long next = stats_now() + prom->interval * 1000000000LL;
+
+    while (!__atomic_load_n(&prom->stop, __ATOMIC_ACQUIRE))
+    {
+        if (prom->file && stats_now() >= next)
+        {
+            prom_write_file(prom);
+            next += prom->interval * 1000000000LL;
+        }
+        prom_tick(prom);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Запускает экспорт метрик в текстовом формате Prometheus.
+ *
+ * Функция render вызывается из потока экспорта и должна сама синхронизировать
+ * доступ к данным в ctx.
+ *
+ * @param listen Адрес HTTP-эндпоинта ("[адрес]:порт" или "unix:/путь") или NULL.
+ * @param file Файл для node_exporter textfile collector или NULL.
+ * @param interval Период перезаписи файла, с (не меньше 1).
+ * @param render Функция вывода метрик.
+ * @param ctx Пользовательские данные для render.
+ * @return Указатель на экспорт или NULL при ошибке.
+ */
+PROM *prom_start(const char *listen, const char *file, int interval, PROM_RENDER render, void *ctx)
+{
+    PROM *prom = calloc(1, sizeof(PROM));
+    if (!prom)
+        return NULL;
+
+    prom->render = render;
+    prom->ctx = ctx;
+    prom->file = file;
+    prom->interval = interval < 1 ? 1 : interval;
+    prom->listenFd = -1;
+
+    if (file && !prom_write_file(prom))
+    {
+        printf("Error: Cannot write metrics file %s\n", file);
+        free(prom);
+        return NULL;
+    }
+
+    if (listen)
+    {
+#ifdef _WIN32
+        printf("Error: Metrics endpoint is not supported on this platform, use --prom-file\n");
+        free(prom);
+        return NULL;
+#else
+        prom->listenFd = prom_listen(prom, listen);
+        if (prom->listenFd < 0)
+        {
+            free(prom);
+            return NULL;
+        }
+#endif
+    }
+
+    if (pthread_create(&prom->thread, NULL, prom_thread, prom) != 0)
+    {
+        printf("Error: Cannot start metrics thread\n");
+#ifndef _WIN32
+        if (prom->listenFd >= 0)
+            close(prom->listenFd);
+        if (prom->unixPath[0])
+            unlink(prom->unixPath);
+#endif
+        free(prom);
+        return NULL;
+    }
+    return prom;
+}
+
+/**
+ * @brief Останавливает экспорт, записывая в файл итоговые значения метрик.
+ *
+ * @param prom Экспорт; после вызова освобождается.
+ */
+void prom_stop(PROM *prom)
+{
+    if (!prom)
+        return;
+
+    __atomic_store_n(&prom->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(prom->thread, NULL);
+
+    if (prom->file)
+        prom_write_file(prom);
+#ifndef _WIN32
+    if (prom->listenFd >= 0)
+        close(prom->listenFd);
+    if (prom->unixPath[0])
+        unlink(prom->unixPath);
+#endif
+    free(prom);
+}
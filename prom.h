@@ -0,0 +1,17 @@
+#ifndef PROM_H
+#define PROM_H
+
+#include <stdio.h>
+#include "stats.h"
+
+// Выводит текущие значения метрик в текстовом формате Prometheus
+typedef void (*PROM_RENDER)(FILE *out, void *ctx);
+typedef struct PROM PROM;
+
+PROM *prom_start(const char *listen, const char *file, int interval, PROM_RENDER render, void *ctx);
+void prom_stop(PROM *prom);
+
+void prom_family(FILE *out, const char *name, const char *type, const char *help);
+void prom_histogram(FILE *out, const char *name, const char *label, const char *value, const STATS_HIST *h);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,761 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "bmpinfo.h"
+#include "stats.h"
+#include "json.h"
+#include "pool.h"
+#include "color.h"
+#include "stegano.h"
+#include "plane.h"
+#include "recover.h"
+
+#define RECOVER_CHUNK_PIXELS 65536 // начальные точки подстановки цветов в одном задании пула
+#define RECOVER_CHUNK_STEPS 1024   // шаги стеганографии в одном задании пула
+#define RECOVER_PREVIEW 60         // байты текста кандидата в таблице
+#define RECOVER_WINDOW 16          // байты по обе стороны границы сообщения, по которым она уточняется
+#define RECOVER_DENSITY 75         // процент похожих на текст байтов в окне за концом, ниже которого он возможен
+#define RECOVER_EDGE_PENALTY 2.0   // штраф кандидату за каждый байт между его началом и границей сообщения
+#define RECOVER_EDGE_MARGIN 4      // перевес границы перед начальной точкой (в четвертях), достижимый случайным байтом
+#define RECOVER_CHAR_BASELINE 0.375 // средний вес случайного печатного байта ASCII: (27 + 39 * 0.25) / 98
+#define RECOVER_EDGE_BAD (-32)      // вес неправдоподобного байта у границы: его окупают лишь 9 строчных букв за ним
+
+// Результат проверки очередного байта текста
+#define SCORE_NEXT 0
+#define SCORE_END 1  // нулевой байт: конец сообщения
+#define SCORE_STOP 2 // неправдоподобных байтов больше допустимого: перебор параметров отсекается
+
+// Оценка правдоподобия текста, накапливаемая побайтно
+typedef struct
+{
+    int minPrintable;
+    int length;  // проверенные байты
+    int bad;     // неправдоподобные байты
+    int pending; // ожидаемые байты продолжения UTF-8
+    int started; // прочитанные байты текущего символа UTF-8
+    double charWeight; // вес текущего символа UTF-8, начисляемый после его последнего байта
+    double score;
+} TEXT_SCORE;
+
+typedef struct
+{
+    const LSB_PLANE *plane;
+    const RECOVER_OPTIONS *options;
+    RECOVER_CANDIDATE *best; // лучшие кандидаты по убыванию оценки
+    int count;
+    long long probes;
+    pthread_mutex_t lock;
+} RECOVER_CTX;
+
+static inline int recover_bit(const LSB_PLANE *p, long long offset)
+{
+    return (p->bits[offset >> 3] >> (offset & 7)) & 1;
+}
+
+static void score_reset(TEXT_SCORE *s, int minPrintable)
+{
+    memset(s, 0, sizeof(*s));
+    s->minPrintable = minPrintable;
+}
+
+/**
+ * @brief Ведущий байт двухбайтового символа UTF-8 букв распространенных алфавитов: латиница с
+ * диакритикой, греческий, кириллица, армянский, иврит и арабский (прочие двухбайтовые символы -
+ * знаки, модификаторы и редкие письменности - в тексте редки, а в случайных байтах так же часты).
+ */
+static int utf8_letter_lead(unsigned char ch)
+{
+    return (ch >= 0xC3 && ch <= 0xC5) || (ch >= 0xCE && ch <= 0xD5) || (ch >= 0xD7 && ch <= 0xDB);
+}
+
+/**
+ * @brief Учитывает n неправдоподобных байтов.
+ */
+static int score_bad(TEXT_SCORE *s, int n)
+{
+    s->bad += n;
+    s->score -= n;
+    return s->bad * 100LL > s->length * (100LL - s->minPrintable) ? SCORE_STOP : SCORE_NEXT;
+}
+
+/**
+ * @brief Учитывает очередной байт в оценке правдоподобия текста.
+ *
+ * Вес символа тем больше, чем чаще он встречается в тексте, чем в случайных битах: строчные буквы
+ * и пробел - 1, прописные буквы, цифры и перевод строки - 0.25, прочие печатные символы - 0 (среди
+ * случайных печатных байтов они встречаются не реже, чем в тексте). Символ UTF-8 учитывается только
+ * целиком, после последнего байта: двухбайтовая буква (utf8_letter_lead) - 1, символ из трех или
+ * четырех байтов - 0.5, прочий двухбайтовый - 0. Из веса каждого символа вычитается
+ * RECOVER_CHAR_BASELINE, поэтому случайные печатные байты, которые прошли отсечение, в среднем
+ * не увеличивают оценку, и длинный случайный кандидат не обгоняет короткое сообщение. Остальные
+ * байты и байты нарушенных последовательностей UTF-8 дают минус 1.
+ *
+ * @return SCORE_NEXT, SCORE_END или SCORE_STOP.
+ */
+static int score_byte(TEXT_SCORE *s, unsigned char ch)
+{
+    if (s->pending)
+    {
+        if ((ch & 0xC0) == 0x80)
+        {
+            s->length++;
+            s->started++;
+            if (--s->pending == 0)
+                s->score += s->charWeight - RECOVER_CHAR_BASELINE;
+            return SCORE_NEXT;
+        }
+        // последовательность прервана: ее байты неправдоподобны, текущий байт оценивается сам по себе
+        s->pending = 0;
+        if (score_bad(s, s->started) == SCORE_STOP)
+            return SCORE_STOP;
+    }
+    if (ch == 0)
+        return SCORE_END;
+
+    s->length++;
+    if ((ch >= 'a' && ch <= 'z') || ch == ' ')
+        s->score += 1 - RECOVER_CHAR_BASELINE;
+    else if ((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '\t' || ch == '\n' || ch == '\r')
+        s->score += 0.25 - RECOVER_CHAR_BASELINE;
+    else if (ch >= 0xC2 && ch <= 0xF4)
+    {
+        s->pending = ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : 1;
+        s->started = 1;
+        s->charWeight = s->pending > 1 ? 0.5 : utf8_letter_lead(ch) ? 1 : 0;
+    }
+    else if (ch > ' ' && ch < 0x7F)
+        s->score -= RECOVER_CHAR_BASELINE;
+    else
+        return score_bad(s, 1);
+    return SCORE_NEXT;
+}
+
+/**
+ * @brief Оценка правдоподобия первых length байтов текста; незавершенный в конце символ UTF-8
+ * не учитывается.
+ */
+static void score_text(const char *text, int length, int minPrintable, TEXT_SCORE *s)
+{
+    score_reset(s, minPrintable);
+    for (int i = 0; i < length; i++)
+        score_byte(s, (unsigned char)text[i]);
+}
+
+/**
+ * @brief Веса байтов для поиска границы сообщения (в четвертях): насколько байт больше похож на текст,
+ * чем на случайные младшие биты.
+ *
+ * Строчные буквы и пробел - 4, байты завершенной двухбайтовой буквы UTF-8 (utf8_letter_lead) - 2,
+ * прочего двухбайтового символа - 0, символа из трех или четырех байтов - 1,
+ * прописные буквы и цифры - 1 (перед началом сообщения - 0: среди случайных байтов они встречаются
+ * чаще, чем в тексте), прочие печатные символы - минус 1 (перед началом - минус 2), остальные байты
+ * и нарушенные последовательности UTF-8 - RECOVER_EDGE_BAD: в тексте они почти не встречаются, и
+ * граница не должна переходить через такой байт ради нескольких случайных букв за ним.
+ */
+static void edge_weights(const unsigned char *bytes, int n, int head, signed char *weights)
+{
+    for (int i = 0; i < n; i++)
+    {
+        unsigned char ch = bytes[i];
+        int extra = ch >= 0xC2 && ch <= 0xF4 ? (ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : 1) : 0;
+        if (extra)
+        {
+            int k = 1;
+            while (k <= extra && i + k < n && (bytes[i + k] & 0xC0) == 0x80)
+                k++;
+            if (k > extra)
+            {
+                memset(weights + i, extra > 1 ? 1 : utf8_letter_lead(ch) ? 2 : 0, extra + 1);
+                i += extra;
+            }
+            else
+                weights[i] = RECOVER_EDGE_BAD;
+        }
+        else if ((ch >= 'a' && ch <= 'z') || ch == ' ')
+            weights[i] = 4;
+        else if ((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9'))
+            weights[i] = head ? 0 : 1;
+        else if ((ch > ' ' && ch < 0x7F) || ch == '\t' || ch == '\n' || ch == '\r')
+            weights[i] = head ? -2 : -1;
+        else
+            weights[i] = RECOVER_EDGE_BAD;
+    }
+}
+
+/**
+ * @brief Надбавка за символ, которым обычно начинается (прописная буква, цифра, открывающая кавычка
+ * или скобка) или заканчивается (знак конца предложения, закрывающая кавычка или скобка) текст.
+ */
+static int edge_bonus(unsigned char ch, int head)
+{
+    if (head && ((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')))
+        return 4;
+    return ch && strchr(head ? "\"'(" : ".!?)\"'", ch) ? 4 : 0;
+}
+
+/**
+ * @brief Граница между байтами pos - 1 и pos не разрезает символ UTF-8.
+ */
+static int edge_allowed(const unsigned char *bytes, int n, const signed char *weights, int pos)
+{
+    return pos == 0 || pos == n || (bytes[pos] & 0xC0) != 0x80 || weights[pos] <= 0;
+}
+
+/**
+ * @brief Конец сообщения стеганографии среди n извлеченных байтов.
+ *
+ * Длина в изображении не хранится, и извлечение продолжается за концом сообщения, пока доля
+ * неправдоподобных байтов не превысит допустимую, - среди случайных байтов печатных больше половины.
+ * Конец ставится только там, где в следующих RECOVER_WINDOW байтах похожих на текст (с положительным
+ * весом) меньше RECOVER_DENSITY процентов, а из таких мест выбирается то, где сумма весов байтов
+ * от начала наибольшая: случайные байты в среднем ее уменьшают.
+ *
+ * @return Длина сообщения или -1, если конец не найден не раньше minLength.
+ */
+static int text_end(const unsigned char *text, int n, int minLength, signed char *weights)
+{
+    edge_weights(text, n, 0, weights);
+    int dense = 0; // байты с положительным весом в окне [end, end + RECOVER_WINDOW)
+    for (int i = 0; i < n && i < RECOVER_WINDOW; i++)
+        dense += weights[i] > 0;
+
+    long long sum = 0, best = LLONG_MIN;
+    int end = -1;
+    for (int pos = 0;; pos++)
+    {
+        if (pos >= minLength && dense * 100 < RECOVER_WINDOW * RECOVER_DENSITY && edge_allowed(text, n, weights, pos))
+        {
+            long long value = sum + (pos > 0 ? edge_bonus(text[pos - 1], 0) : 0);
+            if (value > best)
+            {
+                best = value;
+                end = pos;
+            }
+        }
+        if (pos == n)
+            break;
+        sum += weights[pos];
+        dense -= weights[pos] > 0;
+        if (pos + RECOVER_WINDOW < n)
+            dense += weights[pos + RECOVER_WINDOW] > 0;
+    }
+    return end;
+}
+
+/**
+ * @brief Байт, извлеченный подстановкой цветов начиная с бита bit (номер канала от начала изображения).
+ *
+ * Биты перед началом изображения дают неправдоподобный байт 0xFF: там сообщение начаться не может.
+ */
+static unsigned char recover_color_byte(const LSB_PLANE *plane, const int *offset, long long bit)
+{
+    const BMP_FORMAT *format = &plane->format;
+    if (bit < 0)
+        return 0xFF;
+    unsigned char ch = 0;
+    for (int k = 0; k < 8; k++, bit++)
+    {
+        long long pixel = bit / format->channels;
+        ch |= recover_bit(plane, pixel / format->width * format->rowSize +
+                                     pixel % format->width * format->bytesPerPixel + offset[bit % format->channels])
+              << k;
+    }
+    return ch;
+}
+
+/**
+ * @brief Сдвиг начала сообщения подстановки цветов относительно начальной точки кандидата, в байтах.
+ *
+ * По RECOVER_WINDOW байтам, извлеченным тем же порядком перед начальной точкой, и первым байтам
+ * текста выбирается граница, перед которой байты меньше всего похожи на текст, а после - больше
+ * всего. Отрицательный сдвиг означает, что перед кандидатом тоже правдоподобный текст (он начинается
+ * внутри сообщения), положительный - что первые байты кандидата похожи на случайные. Назад граница
+ * сдвигается, только если она лучше самой начальной точки больше чем на RECOVER_EDGE_MARGIN:
+ * один похожий на текст байт перед истинным началом часто встречается и среди случайных. При
+ * равенстве предпочитается граница ближе к начальной точке.
+ */
+static int text_start(const LSB_PLANE *plane, const int *offset, long long startBit, const char *text, int length,
+                      signed char *weights)
+{
+    unsigned char bytes[2 * RECOVER_WINDOW];
+    int after = length < RECOVER_WINDOW ? length : RECOVER_WINDOW, n = RECOVER_WINDOW + after;
+    for (int k = 0; k < RECOVER_WINDOW; k++)
+        bytes[k] = recover_color_byte(plane, offset, startBit - 8LL * (RECOVER_WINDOW - k));
+    memcpy(bytes + RECOVER_WINDOW, text, after);
+    edge_weights(bytes, n, 1, weights);
+
+    long long sum = 0, best = LLONG_MIN, unshifted = LLONG_MIN;
+    int start = 0;
+    for (int pos = 0; pos <= n; pos++)
+    {
+        long long value = -sum + (pos < n ? edge_bonus(bytes[pos], 1) : 0);
+        int shift = pos - RECOVER_WINDOW;
+        if (edge_allowed(bytes, n, weights, pos))
+        {
+            if (shift == 0)
+                unshifted = value;
+            if (value > best || (value == best && abs(shift) < abs(start)))
+            {
+                best = value;
+                start = shift;
+            }
+        }
+        if (pos < n)
+            sum += weights[pos];
+    }
+    return start < 0 && unshifted != LLONG_MIN && best - unshifted <= RECOVER_EDGE_MARGIN ? 0 : start;
+}
+
+/**
+ * @brief Порядок кандидатов: по оценке, затем по доле правдоподобных байтов (при равной оценке
+ * кандидат с неправдоподобными байтами скорее случаен), затем по параметрам, чтобы результат
+ * не зависел от порядка работы потоков.
+ */
+static int candidate_better(const RECOVER_CANDIDATE *a, const RECOVER_CANDIDATE *b)
+{
+    if (a->score != b->score)
+        return a->score > b->score;
+    long long densityA = (long long)a->printable * b->length, densityB = (long long)b->printable * a->length;
+    if (densityA != densityB)
+        return densityA > densityB;
+    if (a->step != b->step)
+        return a->step < b->step;
+    if (a->mask != b->mask)
+        return a->mask < b->mask;
+    if (a->y != b->y)
+        return a->y < b->y;
+    return a->x < b->x;
+}
+
+/**
+ * @brief Добавляет кандидата в список лучших, если он туда попадает.
+ *
+ * Кандидаты, прошедшие отсечение, редки, поэтому общий список защищен одним мьютексом.
+ */
+static void recover_offer(RECOVER_CTX *ctx, const RECOVER_CANDIDATE *candidate, const char *text)
+{
+    int top = ctx->options->top;
+    pthread_mutex_lock(&ctx->lock);
+    int pos = ctx->count;
+    while (pos > 0 && candidate_better(candidate, &ctx->best[pos - 1]))
+        pos--;
+
+    char *copy = pos < top ? malloc(candidate->length + 1) : NULL;
+    if (copy)
+    {
+        memcpy(copy, text, candidate->length);
+        copy[candidate->length] = '\0';
+        if (ctx->count == top)
+            free(ctx->best[--ctx->count].text);
+        memmove(&ctx->best[pos + 1], &ctx->best[pos], (ctx->count - pos) * sizeof(RECOVER_CANDIDATE));
+        ctx->best[pos] = *candidate;
+        ctx->best[pos].text = copy;
+        ctx->count++;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief Проверяет начальные точки подстановки цветов в строках [y0, y1).
+ *
+ * Сообщение извлекается как plane_color; кандидат должен завершаться нулевым байтом,
+ * который записывает hideMessage. Оценка кандидата, начальная точка которого не совпадает
+ * с границей сообщения (text_start), уменьшается на RECOVER_EDGE_PENALTY за каждый байт сдвига:
+ * иначе случайные печатные байты перед сообщением добавляли бы к оценке.
+ */
+static long long recover_color_rows(RECOVER_CTX *ctx, int y0, int y1, char *text, signed char *weights)
+{
+    static const int gray8[1] = {0};
+    const LSB_PLANE *plane = ctx->plane;
+    const RECOVER_OPTIONS *options = ctx->options;
+    const BMP_FORMAT *format = &plane->format;
+    const int *offset = format->bytesPerPixel == 1 ? gray8 : format->offset;
+    int width = format->width, channels = format->channels, bytesPerPixel = format->bytesPerPixel;
+    long long pixelCount = (long long)width * format->height;
+    long long probes = 0;
+    TEXT_SCORE score;
+
+    for (int startY = y0; startY < y1; startY++)
+    {
+        for (int startX = 0; startX < width; startX++, probes++)
+        {
+            score_reset(&score, options->minPrintable);
+            long long pixel = (long long)startY * width + startX;
+            long long rowStart = (long long)startY * format->rowSize;
+            int x = startX, channel = 0, state = SCORE_NEXT;
+
+            while (state == SCORE_NEXT && score.length <= options->maxLength)
+            {
+                unsigned char ch = 0;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    if (pixel >= pixelCount)
+                    {
+                        state = SCORE_STOP;
+                        break;
+                    }
+                    ch |= recover_bit(plane, rowStart + (long long)x * bytesPerPixel + offset[channel]) << bit;
+                    if (++channel == channels)
+                    {
+                        channel = 0;
+                        pixel++;
+                        if (++x == width)
+                        {
+                            x = 0;
+                            rowStart += format->rowSize;
+                        }
+                    }
+                }
+                if (state == SCORE_NEXT)
+                {
+                    text[score.length] = (char)ch; // буфер на maxLength + 1 байт
+                    state = score_byte(&score, ch);
+                }
+            }
+
+            if (state == SCORE_END && score.length >= options->minLength)
+            {
+                long long startBit = ((long long)startY * width + startX) * channels;
+                int shift = text_start(plane, offset, startBit, text, score.length, weights);
+                RECOVER_CANDIDATE candidate = {startX, startY, 0, 0, score.length, score.length - score.bad,
+                                               score.score - RECOVER_EDGE_PENALTY * abs(shift), NULL};
+                recover_offer(ctx, &candidate, text);
+            }
+        }
+    }
+    return probes;
+}
+
+/**
+ * @brief Проверяет шаги стеганографии [step0, step1) с маской mask.
+ *
+ * Длина сообщения в изображении не хранится: байты извлекаются, пока доля неправдоподобных
+ * не превысит допустимую, а конец сообщения среди них находит text_end.
+ */
+static long long recover_stegano_steps(RECOVER_CTX *ctx, int mask, int step0, int step1, char *text,
+                                       signed char *weights)
+{
+    const LSB_PLANE *plane = ctx->plane;
+    const RECOVER_OPTIONS *options = ctx->options;
+    const BMP_FORMAT *format = &plane->format;
+    long long pixelCount = (long long)format->width * format->height;
+    int lanes[3];
+    int laneCount = stegano_lanes(format, mask, lanes);
+    TEXT_SCORE score;
+
+    for (int step = step0; step < step1; step++)
+    {
+        score_reset(&score, options->minPrintable);
+        long long offset = 0, visit = 0, stride = (long long)step * format->bytesPerPixel;
+        int lane = 0, state = SCORE_NEXT;
+
+        while (state == SCORE_NEXT && score.length < options->maxLength)
+        {
+            unsigned int ch = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                if (visit >= pixelCount)
+                {
+                    state = SCORE_STOP;
+                    break;
+                }
+                ch |= recover_bit(plane, offset + lanes[lane]) << bit;
+                if (++lane == laneCount)
+                {
+                    lane = 0;
+                    offset += stride;
+                    visit += step;
+                }
+            }
+            if (state == SCORE_NEXT)
+            {
+                text[score.length] = (char)ch;
+                state = score_byte(&score, (unsigned char)ch);
+            }
+        }
+
+        int length = score.length >= options->minLength
+                         ? text_end((const unsigned char *)text, score.length, options->minLength, weights)
+                         : -1;
+        if (length >= options->minLength)
+        {
+            score_text(text, length, options->minPrintable, &score);
+            RECOVER_CANDIDATE candidate = {0, 0, step, mask, length, length - score.bad, score.score, NULL};
+            recover_offer(ctx, &candidate, text);
+        }
+    }
+    return step1 - step0;
+}
+
+/**
+ * @brief Задание пула: "c y0 y1" - строки начальных точек, "s маска шаг0 шаг1" - шаги стеганографии.
+ */
+static void recover_task(const char *item, void *arg)
+{
+    RECOVER_CTX *ctx = arg;
+    // веса байтов: весь текст стеганографии или окна по обе стороны начала подстановки цветов
+    char *text = malloc(ctx->options->maxLength + 1);
+    signed char *weights = malloc(ctx->options->maxLength + 2 * RECOVER_WINDOW + 1);
+    if (!text || !weights)
+    {
+        free(text);
+        free(weights);
+        return;
+    }
+
+    int a, b, c;
+    long long probes = 0;
+    if (sscanf(item, "c %d %d", &a, &b) == 2)
+        probes = recover_color_rows(ctx, a, b, text, weights);
+    else if (sscanf(item, "s %d %d %d", &a, &b, &c) == 3)
+        probes = recover_stegano_steps(ctx, a, b, c, text, weights);
+    free(text);
+    free(weights);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->probes += probes;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief Наибольший шаг стеганографии, при котором в изображение помещается minLength байт.
+ */
+static int recover_max_step(const RECOVER_OPTIONS *options, long long pixelCount, int laneCount)
+{
+    long long visits = ((long long)options->minLength * 8 + laneCount - 1) / laneCount;
+    long long maxStep = visits > 1 ? (pixelCount - 1) / (visits - 1) : pixelCount;
+    if (options->maxStep > 0 && options->maxStep < maxStep)
+        maxStep = options->maxStep;
+    return maxStep > INT_MAX - 1 ? INT_MAX - 1 : (int)maxStep;
+}
+
+/**
+ * @brief Перебирает параметры ключа по плоскости младших бит на всех ядрах.
+ *
+ * Подстановка цветов - все начальные точки, стеганография - все маски каналов и шаги.
+ * Извлечение по каждому набору параметров прекращается, как только доля неправдоподобных
+ * байтов превышает допустимую.
+ *
+ * @param candidates Массив из options->top элементов для лучших кандидатов по убыванию оценки;
+ * тексты освобождаются recover_free.
+ * @param probes Указатель для количества проверенных наборов параметров.
+ * @return Количество найденных кандидатов или -1 при ошибке.
+ */
+int recover_search(const LSB_PLANE *plane, const RECOVER_OPTIONS *options, RECOVER_CANDIDATE *candidates,
+                   long long *probes)
+{
+    RECOVER_CTX ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.plane = plane;
+    ctx.options = options;
+    ctx.best = candidates;
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    POOL *pool = pool_start(options->threads, recover_task, &ctx);
+    if (!pool)
+    {
+        pthread_mutex_destroy(&ctx.lock);
+        return -1;
+    }
+
+    const BMP_FORMAT *format = &plane->format;
+    char item[64];
+    if (options->method == RECOVER_COLOR)
+    {
+        int rows = RECOVER_CHUNK_PIXELS / format->width > 1 ? RECOVER_CHUNK_PIXELS / format->width : 1;
+        for (int y = 0; y < format->height; y += rows)
+        {
+            snprintf(item, sizeof(item), "c %d %d", y, y + rows < format->height ? y + rows : format->height);
+            pool_push(pool, strdup(item));
+        }
+    }
+    else
+    {
+        long long pixelCount = (long long)format->width * format->height;
+        for (int mask = 1; mask <= STEGANO_MASK_ALL; mask++)
+        {
+            // у 8-битных изображений маска не учитывается: достаточно одной
+            if (options->mask ? mask != options->mask : format->bytesPerPixel == 1 && mask != STEGANO_DEFAULT_MASK)
+                continue;
+            int lanes[3];
+            int maxStep = recover_max_step(options, pixelCount, stegano_lanes(format, mask, lanes));
+            for (int step = 1; step <= maxStep; step += RECOVER_CHUNK_STEPS)
+            {
+                int last = maxStep - step < RECOVER_CHUNK_STEPS ? maxStep : step + RECOVER_CHUNK_STEPS - 1;
+                snprintf(item, sizeof(item), "s %d %d %d", mask, step, last + 1);
+                pool_push(pool, strdup(item));
+            }
+        }
+    }
+    pool_finish(pool);
+
+    pthread_mutex_destroy(&ctx.lock);
+    *probes = ctx.probes;
+    return ctx.count;
+}
+
+void recover_free(RECOVER_CANDIDATE *candidates, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        free(candidates[i].text);
+        candidates[i].text = NULL;
+    }
+}
+
+/**
+ * @brief Выводит начало текста кандидата: управляющие символы заменяются точками,
+ * символ UTF-8 на границе не разрезается.
+ */
+static void print_preview(const char *text)
+{
+    int n = (int)strlen(text);
+    if (n > RECOVER_PREVIEW)
+    {
+        n = RECOVER_PREVIEW;
+        while (n > 0 && ((unsigned char)text[n] & 0xC0) == 0x80)
+            n--;
+    }
+    for (int i = 0; i < n; i++)
+        putchar((unsigned char)text[i] < ' ' ? '.' : text[i]);
+    if (text[n])
+        printf("...");
+}
+
+/**
+ * @brief Команда recover: подбор параметров утерянного ключа подстановки цветов или стеганографии.
+ *
+ * Использование: recover <color|stegano> <изображение> [--top N] [--min-length N] [--max-length N]
+ *                        [--min-printable P] [--max-step N] [--mask BGR] [--threads N] [--json]
+ *                        [--save-key файл]
+ */
+int recover(int argc, char *argv[])
+{
+    RECOVER_OPTIONS options = {-1, RECOVER_DEFAULT_MIN_LENGTH, RECOVER_DEFAULT_MAX_LENGTH, RECOVER_DEFAULT_PRINTABLE,
+                               0, 0, RECOVER_DEFAULT_TOP, 0};
+    if (argc >= 2)
+        options.method = strcmp(argv[0], "color") == 0     ? RECOVER_COLOR
+                         : strcmp(argv[0], "stegano") == 0 ? RECOVER_STEGANO
+                                                           : -1;
+
+    const char *keyFilename = NULL;
+    int json = 0, valid = options.method >= 0;
+    for (int i = 2; i < argc && valid; i++)
+    {
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            options.top = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-length") == 0 && i + 1 < argc)
+            options.minLength = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-length") == 0 && i + 1 < argc)
+            options.maxLength = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-printable") == 0 && i + 1 < argc)
+            options.minPrintable = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-step") == 0 && i + 1 < argc)
+            options.maxStep = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc)
+            valid = (options.mask = stegano_parse_mask(argv[++i])) != 0;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0)
+            json = 1;
+        else if (strcmp(argv[i], "--save-key") == 0 && i + 1 < argc)
+            keyFilename = argv[++i];
+        else
+            valid = 0;
+    }
+    if (options.top < 1 || options.top > RECOVER_MAX_TOP || options.minLength < 1 ||
+        options.maxLength < options.minLength || options.minPrintable < 0 || options.minPrintable > 100)
+        valid = 0;
+
+    if (!valid)
+    {
+        printf("Usage: recover <color|stegano> <image> [--top N] [--min-length N] [--max-length N]\n"
+               "               [--min-printable P] [--max-step N] [--mask BGR] [--threads N] [--json]\n"
+               "               [--save-key file]\n");
+        return 1;
+    }
+
+    const char *image = argv[1];
+    LSB_PLANE plane;
+    int cached;
+    if (!plane_open(image, &plane, &cached))
+        return 1;
+
+    RECOVER_CANDIDATE *candidates = calloc(options.top, sizeof(RECOVER_CANDIDATE));
+    if (!candidates)
+    {
+        printf("Error: Not enough memory for recovery candidates\n");
+        stats_error(STAT_ERR_MEMORY);
+        plane_free(&plane);
+        return 1;
+    }
+
+    long long probes = 0, t = stats_now();
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    int found = recover_search(&plane, &options, candidates, &probes);
+    stats_kernel_stop(STAT_EXTRACT, &span);
+    double ms = (stats_now() - t) / 1e6;
+    plane_free(&plane);
+    if (found < 0)
+    {
+        free(candidates);
+        return 1;
+    }
+
+    if (!json)
+    {
+        printf("Searched %lld %s parameter sets of %s in %.1f ms (LSB plane %s), %d candidates\n", probes,
+               options.method == RECOVER_COLOR ? "color" : "stegano", image, ms, cached ? "cached" : "built", found);
+        if (found > 0)
+            printf("%-4s %8s  %-18s %7s  %s\n", "rank", "score", "parameters", "length", "text");
+    }
+    for (int i = 0; i < found; i++)
+    {
+        const RECOVER_CANDIDATE *c = &candidates[i];
+        char params[32], name[4];
+        if (options.method == RECOVER_COLOR)
+            snprintf(params, sizeof(params), "x %d y %d", c->x, c->y);
+        else
+        {
+            stegano_mask_name(c->mask, name);
+            snprintf(params, sizeof(params), "step %d mask %s", c->step, name);
+        }
+
+        if (json)
+        {
+            printf("{\"rank\":%d,\"score\":%.1f,", i + 1, c->score);
+            if (options.method == RECOVER_COLOR)
+                printf("\"x\":%d,\"y\":%d,", c->x, c->y);
+            else
+                printf("\"step\":%d,\"mask\":\"%s\",", c->step, name);
+            printf("\"length\":%d,\"text\":", c->length);
+            json_print_string(stdout, c->text);
+            printf("}\n");
+        }
+        else
+        {
+            printf("%-4d %8.1f  %-18s %7d  ", i + 1, c->score, params, c->length);
+            print_preview(c->text);
+            printf("\n");
+        }
+    }
+
+    int ok = 1;
+    if (keyFilename && found > 0)
+    {
+        const RECOVER_CANDIDATE *c = &candidates[0];
+        ok = options.method == RECOVER_COLOR ? saveColorKey(keyFilename, c->x, c->y, c->length)
+                                             : save_stegano_key(keyFilename, c->step, c->length, c->mask);
+        if (ok && !json)
+            printf("Key of the best candidate saved to %s\n", keyFilename);
+    }
+
+    recover_free(candidates, found);
+    free(candidates);
+    if (found == 0)
+        stats_error(STAT_ERR_PAYLOAD);
+    return found > 0 && ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#ifndef RECOVER_H
+#define RECOVER_H
+
+#include "plane.h"
+
+// Методы, параметры которых подбираются без ключа
+#define RECOVER_COLOR 0
+#define RECOVER_STEGANO 1
+
+#define RECOVER_DEFAULT_TOP 10
+#define RECOVER_MAX_TOP 1000
+#define RECOVER_DEFAULT_MIN_LENGTH 4
+#define RECOVER_DEFAULT_MAX_LENGTH 4096
+#define RECOVER_DEFAULT_PRINTABLE 95 // процент правдоподобных байтов, ниже которого кандидат отбрасывается
+
+// Параметры перебора
+typedef struct
+{
+    int method;
+    int minLength, maxLength; // границы длины сообщения в байтах
+    int minPrintable;         // процент правдоподобных байтов
+    int maxStep;              // стеганография: наибольший шаг (0 - пока помещается minLength байт)
+    int mask;                 // стеганография: маска каналов (0 - все маски)
+    int top;                  // количество лучших кандидатов
+    int threads;              // рабочие потоки (0 - по числу процессоров)
+} RECOVER_OPTIONS;
+
+// Кандидат: параметры ключа и извлеченный по ним текст
+typedef struct
+{
+    int x, y;       // подстановка цветов: начальная точка
+    int step, mask; // стеганография: шаг и каналы
+    int length;     // длина сообщения, как в ключе
+    int printable;  // правдоподобные байты текста
+    double score;   // правдоподобие текста: больше - лучше
+    char *text;
+} RECOVER_CANDIDATE;
+
+int recover_search(const LSB_PLANE *plane, const RECOVER_OPTIONS *options, RECOVER_CANDIDATE *candidates,
+                   long long *probes);
+void recover_free(RECOVER_CANDIDATE *candidates, int count);
+int recover(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
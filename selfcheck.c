@@ -0,0 +1,2301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+#include "simple.h"
+#include "simple_dec.h"
+#include "color.h"
+#include "color_dec.h"
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "stream.h"
+#include "slots.h"
+#include "update.h"
+#include "patch.h"
+#include "plane.h"
+#include "recover.h"
+#include "shard.h"
+#include "aead.h"
+#include "ecc.h"
+#include "selfcheck.h"
+
+#ifdef __SSE2__
+#define SELFCHECK_ISA "SSE2"
+#else
+#define SELFCHECK_ISA "scalar"
+#endif
+
+#define SELFCHECK_MAX_WIDTH 333
+#define SELFCHECK_MAX_HEIGHT 97
+#define SELFCHECK_WIDE_WIDTH 22000 // строка длиннее 4096 блоков SSE2 проверяет сброс накопителей
+#define SIMPLE_MAX_TEXT 1000       // длина сообщений файловых проверок (декодеры принимают и длиннее)
+
+#define CARRIER_FILE "selfcheck_carrier.bmp"
+#define OUTPUT_FILE "selfcheck_output.bmp"
+#define KEY_FILE "selfcheck_output.key"
+#define OUTPUT_PNG "selfcheck_output.png"
+#define REFERENCE_FILE "selfcheck_reference.bmp"
+#define PATCH_FILE "selfcheck_output.patch"
+#define SHARD_DIR "selfcheck_shards"
+#define SHARD_PAYLOAD "selfcheck_payload.bin"
+
+typedef int (*SELFCHECK_FN)(int iteration);
+
+static unsigned int rngState;
+
+/**
+ * @brief Генератор псевдослучайных чисел xorshift32.
+ */
+static unsigned int next_random()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+/**
+ * @brief Случайное число от 0 до n - 1.
+ */
+static int random_below(int n)
+{
+    return n > 0 ? (int)(next_random() % (unsigned int)n) : 0;
+}
+
+static void random_bytes(unsigned char *buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (unsigned char)(next_random() >> 24);
+}
+
+/**
+ * @brief Случайный текст из ненулевых байтов (включая байты >= 0x80).
+ */
+static char *random_text(size_t len)
+{
+    char *text = malloc(len + 1);
+    for (size_t i = 0; i < len; i++)
+        text[i] = (char)(1 + random_below(255));
+    text[len] = '\0';
+    return text;
+}
+
+/*
+ * Эталонные реализации: копии скалярных ядер на момент введения самопроверки.
+ * Не изменяются при оптимизации рабочих ядер - любое отличие результата
+ * рабочего ядра от эталона считается ошибкой.
+ */
+
+static void ref_encrypt_text(unsigned char *imageData, const char *text, int imageSize)
+{
+    int textLen = strlen(text);
+    int bitIndex = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (bitIndex >= imageSize)
+            break;
+        imageData[bitIndex] = (imageData[bitIndex] & 0xFE) | ((textLen >> (31 - i)) & 1);
+        bitIndex++;
+    }
+
+    for (int i = 0; i < textLen; i++)
+    {
+        for (int j = 7; j >= 0; j--)
+        {
+            if (bitIndex >= imageSize)
+                return;
+            imageData[bitIndex] = (imageData[bitIndex] & 0xFE) | ((text[i] >> j) & 1);
+            bitIndex++;
+        }
+    }
+}
+
+/*
+ * Эталон метода прямого шифрования с глубиной depth (добавлен вместе с глубиной):
+ * текст - поток бит от старшего к младшему, дополненный нулями; каждый байт после
+ * префикса принимает очередные depth бит потока.
+ */
+static void ref_encrypt_depth(unsigned char *imageData, const char *text, int imageSize, int depth)
+{
+    int textLen = strlen(text);
+    unsigned int prefix = (unsigned int)(depth - 1) << 24 | (unsigned int)textLen;
+
+    for (int i = 0; i < 32 && i < imageSize; i++)
+        imageData[i] = (imageData[i] & 0xFE) | ((prefix >> (31 - i)) & 1);
+
+    long long bits = 8LL * textLen;
+    for (long long b = 0; b < bits; b += depth)
+    {
+        int sample = 32 + (int)(b / depth);
+        if (sample >= imageSize)
+            return;
+
+        int value = 0;
+        for (int k = 0; k < depth; k++)
+            value = value << 1 | (b + k < bits ? (text[(b + k) / 8] >> (7 - (b + k) % 8)) & 1 : 0);
+        imageData[sample] = (imageData[sample] & (0xFF << depth)) | value;
+    }
+}
+
+static char *ref_decrypt_text(const unsigned char *imageData, int imageSize)
+{
+    int bitIndex = 0;
+    int textLen = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (bitIndex >= imageSize)
+            break;
+        textLen = (textLen << 1) | (imageData[bitIndex] & 1);
+        bitIndex++;
+    }
+
+    if (textLen <= 0)
+        return NULL;
+
+    char *text = malloc(textLen + 1);
+    text[textLen] = '\0';
+
+    for (int i = 0; i < textLen; i++)
+    {
+        char ch = 0;
+        for (int j = 7; j >= 0; j--)
+        {
+            if (bitIndex >= imageSize)
+            {
+                free(text);
+                return NULL;
+            }
+            ch = (ch << 1) | (imageData[bitIndex] & 1);
+            bitIndex++;
+        }
+        text[i] = ch;
+    }
+
+    return text;
+}
+
+static void ref_hide_message(PIXEL *pixels, int width, const char *message, int startX, int startY)
+{
+    int messageLen = strlen(message);
+    int startIndex = startY * width + startX;
+    int bitIndex = 0;
+
+    for (int i = 0; i < messageLen + 1; i++)
+    {
+        char ch = (i < messageLen) ? message[i] : '\0';
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            PIXEL *pixel = &pixels[startIndex + bitIndex / 3];
+            unsigned char *color = bitIndex % 3 == 0 ? &pixel->r : bitIndex % 3 == 1 ? &pixel->g : &pixel->b;
+
+            if ((ch >> bit) & 1)
+                *color |= 1;
+            else
+                *color &= ~1;
+            bitIndex++;
+        }
+    }
+}
+
+static char *ref_extract_message(const PIXEL *pixels, int width, int startX, int startY, int messageLen)
+{
+    char *message = malloc(messageLen + 1);
+    int startIndex = startY * width + startX;
+    int bitIndex = 0;
+
+    for (int i = 0; i < messageLen + 1; i++)
+    {
+        char ch = 0;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            const PIXEL *pixel = &pixels[startIndex + bitIndex / 3];
+            unsigned char color = bitIndex % 3 == 0 ? pixel->r : bitIndex % 3 == 1 ? pixel->g : pixel->b;
+
+            if (color & 1)
+                ch |= (1 << bit);
+            bitIndex++;
+        }
+
+        message[i] = ch;
+        if (ch == '\0')
+            break;
+    }
+
+    return message;
+}
+
+static int ref_stegano_embed(unsigned char *data, int pixel_count, const char *message, size_t msg_len, int step)
+{
+    size_t total_bits = msg_len * 8;
+    size_t pixel_index = 0;
+
+    for (size_t i = 0; i < total_bits; i++)
+    {
+        if (pixel_index >= (size_t)pixel_count)
+            break;
+
+        unsigned char *pixel = &data[pixel_index * 3]; // B G R
+        pixel[2] = (pixel[2] & 0xFE) | ((message[i / 8] >> (i % 8)) & 1);
+
+        pixel_index += step;
+        if (pixel_index >= (size_t)pixel_count && i != total_bits - 1)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int ref_stegano_extract(const unsigned char *data, int pixel_count, char *decoded_message, size_t msg_len,
+                               int step)
+{
+    size_t total_bits = msg_len * 8;
+    size_t pixel_index = 0;
+
+    for (size_t i = 0; i < total_bits; i++)
+    {
+        if (pixel_index >= (size_t)pixel_count)
+            break;
+
+        decoded_message[i / 8] |= (data[pixel_index * 3 + 2] & 1) << (i % 8);
+
+        pixel_index += step;
+        if (pixel_index >= (size_t)pixel_count && i != total_bits - 1)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Эталон стеганографии с маской каналов (добавлен вместе с маской): в каждом посещенном
+ * пикселе 24-битного изображения биты сообщения занимают выбранные байты B, G, R по порядку.
+ */
+static int ref_stegano_embed_mask(unsigned char *data, int pixel_count, const char *message, size_t msg_len, int step,
+                                  int mask)
+{
+    size_t total_bits = msg_len * 8, i = 0;
+
+    for (size_t pixel_index = 0; i < total_bits; pixel_index += step)
+    {
+        if (pixel_index >= (size_t)pixel_count)
+            return 0;
+        for (int c = 0; c < 3 && i < total_bits; c++)
+        {
+            if (!(mask & (1 << c)))
+                continue;
+            unsigned char *sample = &data[pixel_index * 3 + c];
+            *sample = (*sample & 0xFE) | ((message[i / 8] >> (i % 8)) & 1);
+            i++;
+        }
+    }
+    return 1;
+}
+
+static int ref_stegano_extract_mask(const unsigned char *data, int pixel_count, char *decoded_message, size_t msg_len,
+                                    int step, int mask)
+{
+    size_t total_bits = msg_len * 8, i = 0;
+
+    for (size_t pixel_index = 0; i < total_bits; pixel_index += step)
+    {
+        if (pixel_index >= (size_t)pixel_count)
+            return 0;
+        for (int c = 0; c < 3 && i < total_bits; c++)
+        {
+            if (!(mask & (1 << c)))
+                continue;
+            decoded_message[i / 8] |= (data[pixel_index * 3 + c] & 1) << (i % 8);
+            i++;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Эталон метрик искажения: побайтовое сравнение без векторных блоков.
+ */
+static void ref_distortion(DISTORTION *d, const unsigned char *original, const unsigned char *output, long long size,
+                           long long stride, int width, int firstRow)
+{
+    for (long long offset = 0; offset < size; offset++)
+    {
+        if (offset % stride < width * 3)
+            d->samples++;
+        distortion_byte(d, offset + firstRow * stride, stride, width, original[offset], output[offset]);
+    }
+}
+
+/**
+ * @brief Сравнивает буферы и сообщает о первом отличающемся байте.
+ *
+ * @return 1 если буферы совпадают, иначе 0.
+ */
+static int same_bytes(const char *check, const char *params, const unsigned char *expected,
+                      const unsigned char *actual, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (expected[i] != actual[i])
+        {
+            printf("MISMATCH %s (%s): first differing byte at offset %zu: expected 0x%02X, got 0x%02X\n", check,
+                   params, i, expected[i], actual[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Сравнивает извлеченные сообщения (NULL - сообщение не извлечено).
+ */
+static int same_text(const char *check, const char *params, const char *expected, const char *actual, size_t len)
+{
+    if (!expected != !actual || (expected && strncmp(expected, actual, len) != 0))
+    {
+        printf("MISMATCH %s (%s): extracted message differs from the reference\n", check, params);
+        return 0;
+    }
+    return 1;
+}
+
+static int same_distortion(const char *check, const char *params, const DISTORTION *expected,
+                           const DISTORTION *actual)
+{
+    if (memcmp(expected, actual, sizeof(DISTORTION)) == 0)
+        return 1;
+
+    printf("MISMATCH %s (%s): distortion differs from the reference\n", check, params);
+    printf("  expected: sumSq %llu sumAbs %llu samples %llu changed %llu lsb %llu/%llu/%llu box %d,%d-%d,%d\n",
+           expected->sumSq, expected->sumAbs, expected->samples, expected->changedBytes, expected->changedLsb[0],
+           expected->changedLsb[1], expected->changedLsb[2], expected->minX, expected->minY, expected->maxX,
+           expected->maxY);
+    printf("  actual:   sumSq %llu sumAbs %llu samples %llu changed %llu lsb %llu/%llu/%llu box %d,%d-%d,%d\n",
+           actual->sumSq, actual->sumAbs, actual->samples, actual->changedBytes, actual->changedLsb[0],
+           actual->changedLsb[1], actual->changedLsb[2], actual->minX, actual->minY, actual->maxX, actual->maxY);
+    return 0;
+}
+
+/**
+ * @brief Метод прямого шифрования: encryptText/decryptText, при глубине больше 1 -
+ * encryptPixels/decryptPixels.
+ *
+ * Длина сообщения иногда превышает емкость, чтобы проверить обрыв записи.
+ */
+static int check_simple(int iteration)
+{
+    int width = 14 + random_below(SELFCHECK_MAX_WIDTH - 13);
+    int height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    int imageSize = width * height * 3;
+
+    int capacity = (imageSize - 32) * depth / 8;
+    size_t len = 1 + random_below(capacity + 8);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %dx%d, depth %d, length %zu", iteration, width, height, depth,
+             len);
+
+    unsigned char *expected = malloc(imageSize), *actual = malloc(imageSize);
+    char *text = random_text(len);
+    random_bytes(expected, imageSize);
+    memcpy(actual, expected, imageSize);
+
+    if (depth > 1)
+    {
+        BMP_FORMAT format;
+        bmp_format_bgr24(&format, width, height);
+        ref_encrypt_depth(expected, text, imageSize, depth);
+        encryptPixels(&format, actual, text, imageSize, depth);
+        int ok = same_bytes("simple_depth_embed", params, expected, actual, imageSize);
+        if (ok)
+        {
+            char *outText = decryptPixels(&format, actual, imageSize);
+            ok = same_text("simple_depth_extract", params, simpleSamples((int)len, depth) <= imageSize ? text : NULL,
+                           outText, len + 1);
+            free(outText);
+        }
+
+        free(text);
+        free(expected);
+        free(actual);
+        return ok;
+    }
+
+    ref_encrypt_text(expected, text, imageSize);
+    encryptText(actual, text, imageSize);
+    int ok = same_bytes("simple_embed", params, expected, actual, imageSize);
+
+    if (ok)
+    {
+        char *refText = ref_decrypt_text(expected, imageSize);
+        char *outText = decryptText(actual, imageSize);
+        ok = same_text("simple_extract", params, refText, outText, len + 1);
+        free(refText);
+        free(outText);
+    }
+
+    free(text);
+    free(expected);
+    free(actual);
+    return ok;
+}
+
+/**
+ * @brief Метод подстановки цветов: hideMessage/extract_Message со случайной начальной точкой.
+ */
+static int check_color(int iteration)
+{
+    int width, height, pixelCount, maxLen;
+    do
+    {
+        width = 1 + random_below(SELFCHECK_MAX_WIDTH);
+        height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+        pixelCount = width * height;
+        maxLen = pixelCount * 3 / 8 - 1;
+        while (maxLen > 0 && (maxLen + 1) * 8 / 3 >= pixelCount) // то же условие, что и в hideMessage
+            maxLen--;
+    } while (maxLen < 1);
+
+    int len = 1 + random_below(maxLen);
+    int startIndex = random_below(pixelCount - (len + 1) * 8 / 3);
+    int startX = startIndex % width, startY = startIndex / width;
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %dx%d, length %d, start %d,%d", iteration, width, height, len,
+             startX, startY);
+
+    BMP_FILE actual;
+    memset(&actual, 0, sizeof(actual));
+    bmp_format_bgr24(&actual.format, width, height);
+    actual.packed = 1;
+    PIXEL *expected = malloc(pixelCount * sizeof(PIXEL));
+    actual.pixels = malloc(pixelCount * sizeof(PIXEL));
+    random_bytes((unsigned char *)expected, pixelCount * sizeof(PIXEL));
+    memcpy(actual.pixels, expected, pixelCount * sizeof(PIXEL));
+    char *text = random_text(len);
+
+    ref_hide_message(expected, width, text, startX, startY);
+    hideMessage(&actual, text, startX, startY);
+    int ok = same_bytes("color_embed", params, (unsigned char *)expected, actual.pixels, pixelCount * sizeof(PIXEL));
+
+    if (ok)
+    {
+        char *refText = ref_extract_message(expected, width, startX, startY, len);
+        char *outText = extract_Message(&actual, startX, startY, len);
+        ok = same_text("color_extract", params, refText, outText, len + 1);
+        free(refText);
+        free(outText);
+    }
+
+    free(text);
+    free(expected);
+    free(actual.pixels);
+    return ok;
+}
+
+/**
+ * @brief Метод стеганографии: stegano_embed/stegano_extract с выравниванием строк и
+ * метриками, которые считаются прямо при встраивании; при маске каналов, отличной от R, -
+ * stegano_embed_format/stegano_extract_format.
+ */
+static int check_stegano(int iteration)
+{
+    int width, height, pixelCount, step;
+    do
+    {
+        width = 1 + random_below(SELFCHECK_MAX_WIDTH);
+        height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+        step = 1 + random_below(64);
+        pixelCount = width * height;
+    } while (pixelCount / step / 8 < 1);
+
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    int lanes = (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+    size_t len = 1 + random_below(pixelCount / step * lanes / 8);
+    int rowPadded = (width * 3 + 3) & ~3;
+    size_t size = (size_t)rowPadded * height;
+    BMP_FORMAT format;
+    bmp_format_bgr24(&format, width, height);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %dx%d, step %d, mask %d, length %zu", iteration, width, height,
+             step, mask, len);
+
+    unsigned char *original = malloc(size), *expected = malloc(size), *actual = malloc(size);
+    char *text = random_text(len);
+    random_bytes(original, size);
+    memcpy(expected, original, size);
+    memcpy(actual, original, size);
+
+    DISTORTION refDist, dist;
+    distortion_init(&refDist);
+    distortion_init(&dist);
+
+    int refResult, result;
+    if (mask == STEGANO_R)
+    {
+        refResult = ref_stegano_embed(expected, pixelCount, text, len, step);
+        result = stegano_embed(actual, width, pixelCount, text, len, step, &dist);
+    }
+    else
+    {
+        refResult = ref_stegano_embed_mask(expected, pixelCount, text, len, step, mask);
+        result = stegano_embed_format(&format, actual, text, len, step, mask, &dist);
+    }
+    ref_distortion(&refDist, original, expected, size, rowPadded, width, 0);
+
+    int ok = same_bytes("stegano_embed", params, expected, actual, size) &&
+             same_distortion("stegano_embed_metrics", params, &refDist, &dist);
+    if (ok && refResult != result)
+    {
+        printf("MISMATCH stegano_embed (%s): returned %d, reference %d\n", params, result, refResult);
+        ok = 0;
+    }
+
+    if (ok)
+    {
+        char *refText = calloc(len + 1, 1), *outText = calloc(len + 1, 1);
+        if (mask == STEGANO_R)
+        {
+            refResult = ref_stegano_extract(expected, pixelCount, refText, len, step);
+            result = stegano_extract(actual, pixelCount, outText, len, step);
+        }
+        else
+        {
+            refResult = ref_stegano_extract_mask(expected, pixelCount, refText, len, step, mask);
+            result = stegano_extract_format(&format, actual, outText, len, step, mask);
+        }
+        ok = same_text("stegano_extract", params, refText, outText, len + 1);
+        if (ok && refResult != result)
+        {
+            printf("MISMATCH stegano_extract (%s): returned %d, reference %d\n", params, result, refResult);
+            ok = 0;
+        }
+        free(refText);
+        free(outText);
+    }
+
+    free(text);
+    free(original);
+    free(expected);
+    free(actual);
+    return ok;
+}
+
+/**
+ * @brief Плоскость младших бит: упаковка сравнивается с побитной, извлечение по плоскости -
+ * с рабочими декодерами на том же изображении со встроенными сообщениями всех методов.
+ */
+static int check_plane(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 1 + random_below(SELFCHECK_MAX_WIDTH);
+    int height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+
+    BMP_FILE bmp;
+    if (!bmp_create(&bmp, width, height, bitCount))
+        return 0;
+    const BMP_FORMAT *format = &bmp.format;
+    long long size = format->rowSize * height;
+    int pixelCount = width * height, channels = format->channels;
+    bmp.pixels = malloc((size_t)size);
+    random_bytes(bmp.pixels, (size_t)size);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d", iteration, bitCount, width, height);
+
+    LSB_PLANE plane;
+    unsigned char *expected = calloc((size_t)(size + 7) / 8, 1);
+    for (long long i = 0; i < size; i++)
+        expected[i >> 3] |= (bmp.pixels[i] & 1) << (i & 7);
+    int ok = plane_build(&bmp, &plane) && same_bytes("plane_pack", params, expected, plane.bits, (size + 7) / 8);
+    plane_free(&plane);
+    free(expected);
+
+    // simple с глубиной 1
+    int imageSize = pixelCount * channels;
+    if (ok && imageSize >= 40)
+    {
+        size_t len = 1 + random_below((imageSize - 32) / 8);
+        char *text = random_text(len);
+        encryptPixels(format, bmp.pixels, text, imageSize, 1);
+        char *refText = decryptPixels(format, bmp.pixels, imageSize);
+        char *outText = plane_build(&bmp, &plane) ? plane_simple(&plane) : NULL;
+        ok = same_text("plane_simple", params, refText, outText, len + 1);
+        plane_free(&plane);
+        free(refText);
+        free(outText);
+        free(text);
+    }
+
+    // stegano со случайными маской и шагом
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    int lanes = bitCount == 8 ? 1 : (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+    size_t maxLen = (size_t)pixelCount * lanes / 8;
+    if (ok && maxLen > 0)
+    {
+        size_t len = 1 + random_below(maxLen < 300 ? (int)maxLen : 300);
+        int visits = (int)((len * 8 + lanes - 1) / lanes);
+        int step = 1 + random_below(visits > 1 ? (pixelCount - 1) / (visits - 1) : pixelCount);
+        char *text = random_text(len);
+        char *refText = calloc(len + 1, 1), *outText = calloc(len + 1, 1);
+        stegano_embed_format(format, bmp.pixels, text, len, step, mask, NULL);
+        int refOk = stegano_extract_format(format, bmp.pixels, refText, len, step, mask);
+        int outOk = plane_build(&bmp, &plane) && plane_stegano(&plane, outText, len, step, mask);
+        ok = same_text("plane_stegano", params, refOk ? refText : NULL, outOk ? outText : NULL, len + 1);
+        plane_free(&plane);
+        free(refText);
+        free(outText);
+        free(text);
+    }
+
+    // color: ядро работает со строками без выравнивания
+    int colorCapacity = (pixelCount - 1) * channels / 8 - 2;
+    if (ok && colorCapacity > 0)
+    {
+        size_t len = 1 + random_below(colorCapacity < 300 ? colorCapacity : 300);
+        int required = (int)(((len + 1) * 8 + channels - 1) / channels);
+        int startIndex = random_below(pixelCount - required); // hideMessage требует запаса в один пиксель
+        int startX = startIndex % width, startY = startIndex / width;
+        long long rowBytes = (long long)width * format->bytesPerPixel;
+        BMP_FILE img = bmp;
+        img.packed = 1;
+        img.pixels = malloc((size_t)(rowBytes * height));
+        for (int y = 0; y < height; y++)
+            memcpy(img.pixels + rowBytes * y, bmp.pixels + format->rowSize * y, (size_t)rowBytes);
+
+        char *text = random_text(len);
+        hideMessage(&img, text, startX, startY);
+        for (int y = 0; y < height; y++)
+            memcpy(bmp.pixels + format->rowSize * y, img.pixels + rowBytes * y, (size_t)rowBytes);
+        char *refText = extract_Message(&img, startX, startY, (int)len);
+        char *outText = plane_build(&bmp, &plane) ? plane_color(&plane, startX, startY, (int)len) : NULL;
+        ok = same_text("plane_color", params, refText, outText, len + 1);
+        plane_free(&plane);
+        free(refText);
+        free(outText);
+        free(text);
+        free(img.pixels);
+    }
+
+    bmp_free(&bmp);
+    return ok;
+}
+
+/**
+ * @brief Встраивает сообщение подстановкой цветов в изображение с выравниванием строк
+ * через упакованную копию, как это делает color.
+ */
+static void hide_in_rows(BMP_FILE *bmp, const char *text, int startX, int startY)
+{
+    const BMP_FORMAT *format = &bmp->format;
+    long long rowBytes = (long long)format->width * format->bytesPerPixel;
+    BMP_FILE img = *bmp;
+    img.packed = 1;
+    img.pixels = malloc((size_t)(rowBytes * format->height));
+    for (int y = 0; y < format->height; y++)
+        memcpy(img.pixels + rowBytes * y, bmp->pixels + format->rowSize * y, (size_t)rowBytes);
+    hideMessage(&img, text, startX, startY);
+    for (int y = 0; y < format->height; y++)
+        memcpy(bmp->pixels + format->rowSize * y, img.pixels + rowBytes * y, (size_t)rowBytes);
+    free(img.pixels);
+}
+
+/**
+ * @brief Границы длинного сообщения при подборе параметров (800 байтов букв и пробелов в шумовом
+ * 24-битном изображении 224x224).
+ *
+ * Стеганография с шагом 7: за сообщением извлечение продолжается по случайным байтам, пока их
+ * доля не превысит допустимую, но найденная длина должна остаться 800 (байт сразу за сообщением
+ * делается неправдоподобным, чтобы ожидаемая длина была однозначной). Подстановка цветов с началом
+ * x = 12: перед сообщением три байта печатных знаков (начальная точка x = 4, длина 803), а перед
+ * ними неправдоподобные; лучшим кандидатом должно остаться истинное начало.
+ */
+static int check_recover_edges(int iteration)
+{
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz ";
+    static const char marks[] = "#$%&*+/;<=>@[]^_{|}~";
+    const int width = 224, height = 224, len = 800, step = 7, startY = 1 + random_below(height - 40);
+    int color = iteration / 16 % 2;
+
+    BMP_FILE bmp;
+    if (!bmp_create(&bmp, width, height, 24))
+        return 0;
+    long long size = bmp.format.rowSize * height;
+    bmp.pixels = malloc((size_t)size);
+    random_bytes(bmp.pixels, (size_t)size);
+
+    // три неправдоподобных байта, три печатных знака и сообщение (для стеганографии - сообщение и байт 0x01)
+    char *message = malloc(len + 7);
+    memset(message, 1, 3);
+    for (int i = 3; i < 6; i++)
+        message[i] = marks[random_below(sizeof(marks) - 1)];
+    char *text = color ? message + 6 : message;
+    for (int i = 0; i < len; i++)
+        text[i] = letters[random_below(sizeof(letters) - 1)];
+    text[len] = color ? '\0' : 1;
+    if (color)
+        hide_in_rows(&bmp, message, width - 4, startY - 1); // 6 байтов = 16 пикселей до x = 12
+    else
+        stegano_embed_format(&bmp.format, bmp.pixels, text, len + 1, step, STEGANO_DEFAULT_MASK, NULL);
+
+    char params[96];
+    snprintf(params, sizeof(params), "iteration %d, %s, length %d, %s %d", iteration, color ? "color" : "stegano",
+             len, color ? "start 12," : "step", color ? startY : step);
+
+    RECOVER_OPTIONS options = {color ? RECOVER_COLOR : RECOVER_STEGANO, RECOVER_DEFAULT_MIN_LENGTH,
+                               RECOVER_DEFAULT_MAX_LENGTH, RECOVER_DEFAULT_PRINTABLE, 0, 0, 1, 1};
+    RECOVER_CANDIDATE best;
+    LSB_PLANE plane;
+    long long probes;
+    int found = plane_build(&bmp, &plane) ? recover_search(&plane, &options, &best, &probes) : -1;
+    plane_free(&plane);
+
+    text[len] = '\0';
+    int ok = found == 1 && best.length == len && strcmp(best.text, text) == 0 &&
+             (color ? best.x == 12 && best.y == startY : best.step == step && best.mask == STEGANO_DEFAULT_MASK);
+    if (!ok)
+    {
+        printf("MISMATCH recover_edges (%s): message boundaries not found\n", params);
+        if (found == 1)
+            printf("  actual: step %d, mask %d, start %d,%d, length %d\n", best.step, best.mask, best.x, best.y,
+                   best.length);
+    }
+    if (found == 1)
+        recover_free(&best, 1);
+    free(message);
+    bmp_free(&bmp);
+    return ok;
+}
+
+/**
+ * @brief Подбор параметров: сообщение из букв и пробелов, встроенное стеганографией или
+ * подстановкой цветов в шумовое изображение, должно оказаться лучшим кандидатом recover_search.
+ */
+static int check_recover(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz ";
+    int bitCount = bitCounts[random_below(3)];
+    int width = 32 + random_below(SELFCHECK_MAX_WIDTH - 31);
+    int height = 32 + random_below(SELFCHECK_MAX_HEIGHT - 31);
+
+    BMP_FILE bmp;
+    if (!bmp_create(&bmp, width, height, bitCount))
+        return 0;
+    const BMP_FORMAT *format = &bmp.format;
+    long long size = format->rowSize * height;
+    int pixelCount = width * height, channels = format->channels;
+    bmp.pixels = malloc((size_t)size);
+    random_bytes(bmp.pixels, (size_t)size);
+
+    size_t len = 8 + random_below(56);
+    char *text = malloc(len + 1);
+    for (size_t i = 0; i < len; i++)
+        text[i] = letters[random_below(sizeof(letters) - 1)];
+    text[len] = '\0';
+
+    int color = random_below(2), mask = 1 + random_below(STEGANO_MASK_ALL), step = 0, startX = 0, startY = 0;
+    if (color)
+    {
+        int startIndex = random_below(pixelCount - (int)(((len + 1) * 8 + channels - 1) / channels));
+        startX = startIndex % width;
+        startY = startIndex / width;
+        hide_in_rows(&bmp, text, startX, startY);
+    }
+    else
+    {
+        int lanes = bitCount == 8 ? 1 : (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+        int visits = (int)((len * 8 + lanes - 1) / lanes);
+        step = 1 + random_below((pixelCount - 1) / (visits - 1));
+        stegano_embed_format(format, bmp.pixels, text, len, step, mask, NULL);
+    }
+
+    char params[160];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d, %s, step %d, mask %d, start %d,%d, length %zu",
+             iteration, bitCount, width, height, color ? "color" : "stegano", step, mask, startX, startY, len);
+
+    RECOVER_OPTIONS options = {color ? RECOVER_COLOR : RECOVER_STEGANO, RECOVER_DEFAULT_MIN_LENGTH,
+                               RECOVER_DEFAULT_MAX_LENGTH, RECOVER_DEFAULT_PRINTABLE, 0, 0, 1, 1};
+    RECOVER_CANDIDATE best;
+    LSB_PLANE plane;
+    long long probes;
+    int found = plane_build(&bmp, &plane) ? recover_search(&plane, &options, &best, &probes) : -1;
+    plane_free(&plane);
+
+    // без ключа границы сообщения не известны: допускаются случайные печатные байты после
+    // сообщения стеганографии и перед сообщением подстановки цветов (с тем же концом)
+    int extra = found == 1 ? best.length - (int)len : -1;
+    int ok = extra >= 0 &&
+             (color ? strcmp(best.text + extra, text) == 0 &&
+                          ((long long)best.y * width + best.x) * channels + extra * 8LL ==
+                              ((long long)startY * width + startX) * channels
+                    : strncmp(best.text, text, len) == 0 && best.step == step &&
+                          (bitCount == 8 || best.mask == mask));
+    if (!ok)
+    {
+        printf("MISMATCH recover (%s): best candidate differs from the embedded parameters\n", params);
+        if (found == 1)
+            printf("  actual: step %d, mask %d, start %d,%d, length %d\n", best.step, best.mask, best.x, best.y,
+                   best.length);
+    }
+    if (found == 1)
+        recover_free(&best, 1);
+    free(text);
+    bmp_free(&bmp);
+    return ok;
+}
+
+/**
+ * @brief Метрики искажения: distortion_rows против побайтового эталона.
+ *
+ * Проверяются строки с выравниванием и без, неполная последняя строка, разная
+ * плотность изменений и (на каждой 16-й итерации) строки длиннее 4096 блоков.
+ */
+static int check_metrics(int iteration)
+{
+    int width = 1 + random_below(iteration % 16 == 0 ? SELFCHECK_WIDE_WIDTH : SELFCHECK_MAX_WIDTH);
+    if (iteration % 16 == 0)
+        width += SELFCHECK_WIDE_WIDTH;
+    int height = 1 + random_below(iteration % 16 == 0 ? 3 : SELFCHECK_MAX_HEIGHT);
+    long long stride = random_below(2) ? (width * 3 + 3) & ~3 : width * 3;
+    long long size = stride * height - random_below((int)stride); // последняя строка может быть неполной
+    int firstRow = random_below(1000);
+    int density = random_below(4); // 0 - без изменений, 3 - изменен каждый байт
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %dx%d, stride %lld, size %lld, density %d", iteration, width,
+             height, stride, size, density);
+
+    unsigned char *original = malloc(size), *output = malloc(size);
+    random_bytes(original, size);
+    memcpy(output, original, size);
+
+    for (long long i = 0; i < size; i++)
+    {
+        int change = density == 3 || (density == 2 && random_below(16) == 0) ||
+                     (density == 1 && random_below(1000) == 0);
+        if (change)
+            output[i] = random_below(2) ? original[i] ^ 1 : (unsigned char)(next_random() >> 24);
+    }
+
+    DISTORTION refDist, dist;
+    distortion_init(&refDist);
+    distortion_init(&dist);
+    ref_distortion(&refDist, original, output, size, stride, width, firstRow);
+    distortion_rows(&dist, original, output, size, stride, width, firstRow);
+    int ok = same_distortion("distortion_rows", params, &refDist, &dist);
+
+    free(original);
+    free(output);
+    return ok;
+}
+
+/**
+ * @brief Читает файл целиком.
+ */
+static unsigned char *read_file(const char *filename, size_t *size)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    unsigned char *data = malloc(n > 0 ? n : 1);
+    *size = fread(data, 1, n > 0 ? n : 0, f);
+    fclose(f);
+    return data;
+}
+
+/**
+ * @brief Сравнивает файл результата с ожидаемым содержимым.
+ */
+static int same_file(const char *check, const char *params, const unsigned char *expected, size_t size)
+{
+    size_t actualSize = 0;
+    unsigned char *actual = read_file(OUTPUT_FILE, &actualSize);
+    if (!actual)
+    {
+        printf("MISMATCH %s (%s): output file was not written\n", check, params);
+        return 0;
+    }
+
+    int ok = same_bytes(check, params, expected, actual, actualSize < size ? actualSize : size);
+    if (ok && actualSize != size)
+    {
+        printf("MISMATCH %s (%s): output file size %zu, expected %zu\n", check, params, actualSize, size);
+        ok = 0;
+    }
+    free(actual);
+    return ok;
+}
+
+/**
+ * @brief Пути через файлы: загрузка, встраивание, сохранение и извлечение каждым методом.
+ */
+static int check_files(int iteration)
+{
+    int width = 14 + random_below(SELFCHECK_MAX_WIDTH - 13);
+    int height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+    int step = 1 + random_below(8);
+    int pixelCount = width * height;
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, height, 24, next_random(), &fileSize);
+    FILE *f = fopen(CARRIER_FILE, "wb");
+    if (!carrier || !f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        if (f)
+            fclose(f);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+
+    size_t len = 1 + random_below(pixelCount / step / 8 < SIMPLE_MAX_TEXT ? pixelCount / step / 8 : SIMPLE_MAX_TEXT);
+    if ((len * 8 - 1) * step >= (size_t)pixelCount)
+        step = 1; // в узком изображении один символ помещается только с шагом 1
+    char *text = random_text(len);
+    unsigned char *pixels = carrier + sizeof(BMP_HEADER);
+    int rowSize = (width * 3 + 3) & ~3;
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %dx%d, step %d, length %zu", iteration, width, height, step, len);
+
+    // simple: байты пикселей обходятся подряд без учета выравнивания строк
+    int imageSize = pixelCount * 3;
+    unsigned char *expected = malloc(fileSize);
+    memcpy(expected, carrier, fileSize);
+    ref_encrypt_text(expected + sizeof(BMP_HEADER), text, imageSize);
+
+    int ok = simple_encode(CARRIER_FILE, OUTPUT_FILE, text, 1, NULL) != 0 &&
+             same_file("simple_encode", params, expected, fileSize);
+    if (ok)
+    {
+        char *outText = simple_decode(OUTPUT_FILE);
+        ok = same_text("simple_decode", params, text, outText, len + 1);
+        free(outText);
+    }
+    free(expected);
+
+    // simple с сообщением длиннее SIMPLE_MAX_TEXT: декодер ограничивает длину только емкостью
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    int longCapacity = (imageSize - 32) * depth / 8;
+    if (ok && longCapacity > SIMPLE_MAX_TEXT)
+    {
+        size_t longLen = SIMPLE_MAX_TEXT + 1 + random_below(longCapacity - SIMPLE_MAX_TEXT);
+        char *longText = random_text(longLen);
+        char longParams[160];
+        snprintf(longParams, sizeof(longParams), "%s, depth %d, long length %zu", params, depth, longLen);
+        char *outText = simple_encode(CARRIER_FILE, OUTPUT_FILE, longText, depth, NULL) ? simple_decode(OUTPUT_FILE)
+                                                                                         : NULL;
+        ok = same_text("simple_decode_long", longParams, longText, outText, longLen + 1);
+        free(outText);
+        free(longText);
+    }
+
+    // сообщение, зашифрованное паролем, на треть длиннее текста: 740 символов дают больше
+    // SIMPLE_MAX_TEXT в Base64 (вывод ключа PBKDF2 медленный, поэтому проверяется реже)
+    if (ok && iteration % 64 == 0)
+    {
+        char *plainText = random_text(740);
+        char *sealed = aead_seal_text("selfcheck", plainText);
+        if (sealed && (int)strlen(sealed) <= longCapacity)
+        {
+            char sealedParams[192];
+            snprintf(sealedParams, sizeof(sealedParams), "%s, depth %d, sealed length %zu", params, depth,
+                     strlen(sealed));
+            char *outText = simple_encode(CARRIER_FILE, OUTPUT_FILE, sealed, depth, NULL) ? simple_decode(OUTPUT_FILE)
+                                                                                         : NULL;
+            char *opened = outText ? aead_open_text("selfcheck", outText) : NULL;
+            ok = same_text("simple_decode_sealed", sealedParams, plainText, opened, 741);
+            free(opened);
+            free(outText);
+        }
+        else if (!sealed)
+        {
+            printf("MISMATCH aead_seal_text (%s): 740-character text not sealed\n", params);
+            ok = 0;
+        }
+        free(sealed);
+        free(plainText);
+    }
+
+    // stegano
+    if (ok)
+    {
+        expected = malloc(fileSize);
+        memcpy(expected, carrier, fileSize);
+        ref_stegano_embed(expected + sizeof(BMP_HEADER), pixelCount, text, len, step);
+
+        ok = stegano_encode(CARRIER_FILE, OUTPUT_FILE, text, step, STEGANO_DEFAULT_MASK, NULL) &&
+             save_stegano_key(KEY_FILE, step, len, STEGANO_DEFAULT_MASK) &&
+             same_file("stegano_encode", params, expected, fileSize);
+        if (ok)
+        {
+            char *outText = stegano_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text("stegano_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+        free(expected);
+    }
+
+    // color: начальная точка выбирается случайно, эталон применяется к той же точке
+    if (ok && (len + 1) * 8 / 3 < (size_t)pixelCount)
+    {
+        int startX = 0, startY = 0;
+        PIXEL *img = malloc(pixelCount * sizeof(PIXEL));
+        for (int y = 0; y < height; y++)
+            memcpy(&img[y * width], pixels + (size_t)rowSize * y, width * sizeof(PIXEL));
+
+        srand(next_random());
+        ok = color_encode(CARRIER_FILE, OUTPUT_FILE, text, &startX, &startY, NULL) &&
+             saveColorKey(KEY_FILE, startX, startY, (int)len);
+        if (ok)
+        {
+            ref_hide_message(img, width, text, startX, startY);
+            expected = malloc(fileSize);
+            memcpy(expected, carrier, fileSize);
+            for (int y = 0; y < height; y++)
+                memcpy(expected + sizeof(BMP_HEADER) + (size_t)rowSize * y, &img[y * width], width * sizeof(PIXEL));
+
+            ok = same_file("color_encode", params, expected, fileSize);
+            free(expected);
+        }
+        if (ok)
+        {
+            char *outText = color_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text("color_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+        free(img);
+    }
+
+    free(text);
+    free(carrier);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Проверяет, что файл результата отличается от носителя только младшими битами
+ * пикселей: заголовки, маски, палитра, байты альфа-канала и выравнивание строк не изменились.
+ * Методы simple и stegano обходят байты подряд без учета выравнивания, для них (wholeRows = 1)
+ * младшие биты выравнивания тоже могут меняться.
+ */
+static int same_carrier(const char *check, const char *params, const unsigned char *carrier, size_t size,
+                        const BMP_FORMAT *format, int wholeRows)
+{
+    size_t actualSize = 0;
+    unsigned char *actual = read_file(OUTPUT_FILE, &actualSize);
+    if (!actual)
+    {
+        printf("MISMATCH %s (%s): output file was not written\n", check, params);
+        return 0;
+    }
+
+    int ok = actualSize == size;
+    if (!ok)
+        printf("MISMATCH %s (%s): output file size %zu, expected %zu\n", check, params, actualSize, size);
+
+    long long rowBytes = wholeRows ? format->rowSize : format->width * format->bytesPerPixel;
+    for (size_t i = 0; ok && i < size; i++)
+    {
+        long long pos = (long long)i - format->dataOffset;
+        long long x = pos < 0 ? -1 : pos % format->rowSize;
+        unsigned char mask = 0xFF; // байты вне пикселей должны совпадать целиком
+        if (x >= 0 && x < rowBytes && !(format->bytesPerPixel == 4 && x % 4 == 3))
+            mask = 0xFE;
+
+        if ((carrier[i] ^ actual[i]) & mask)
+        {
+            printf("MISMATCH %s (%s): byte %zu changed from %02x to %02x\n", check, params, i, carrier[i], actual[i]);
+            ok = 0;
+        }
+    }
+    free(actual);
+    return ok;
+}
+
+/**
+ * @brief Форматы носителей: 8-битные с палитрой, 32-битные с BI_BITFIELDS и изображения
+ * со строками сверху вниз проходят через файлы каждым методом без изменения чего-либо,
+ * кроме младших битов каналов.
+ */
+static int check_formats(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 14 + random_below(SELFCHECK_MAX_WIDTH - 13);
+    int height = 8 + random_below(SELFCHECK_MAX_HEIGHT - 7);
+    int topDown = random_below(2);
+    int step = 1 + random_below(8);
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    BMP_FORMAT format;
+    if (!carrier || !bmp_parse_format(carrier, fileSize, &format))
+    {
+        printf("Error: Cannot create %d-bit carrier\n", bitCount);
+        free(carrier);
+        return 0;
+    }
+
+    FILE *f = fopen(CARRIER_FILE, "wb");
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+
+    // самая малая емкость у stegano и simple при 8-битных пикселях
+    int capacity = (width * height - 32) / 8 / step;
+    size_t len = 1 + random_below(capacity < SIMPLE_MAX_TEXT ? capacity : SIMPLE_MAX_TEXT);
+    char *text = random_text(len);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, step %d, mask %d, length %zu", iteration, bitCount,
+             width, height, topDown ? " top-down" : "", step, mask, len);
+
+    int ok = simple_encode(CARRIER_FILE, OUTPUT_FILE, text, 1, NULL) != 0 &&
+             same_carrier("simple_format", params, carrier, fileSize, &format, 1);
+    if (ok)
+    {
+        char *outText = simple_decode(OUTPUT_FILE);
+        ok = same_text("simple_format_decode", params, text, outText, len + 1);
+        free(outText);
+    }
+
+    if (ok)
+    {
+        ok = stegano_encode(CARRIER_FILE, OUTPUT_FILE, text, step, mask, NULL) &&
+             save_stegano_key(KEY_FILE, step, len, mask) &&
+             same_carrier("stegano_format", params, carrier, fileSize, &format, 1);
+        if (ok)
+        {
+            char *outText = stegano_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text("stegano_format_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+    }
+
+    if (ok)
+    {
+        int startX = 0, startY = 0;
+        srand(next_random());
+        ok = color_encode(CARRIER_FILE, OUTPUT_FILE, text, &startX, &startY, NULL) &&
+             saveColorKey(KEY_FILE, startX, startY, (int)len) &&
+             same_carrier("color_format", params, carrier, fileSize, &format, 0);
+        if (ok)
+        {
+            char *outText = color_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text("color_format_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+    }
+
+    free(text);
+    free(carrier);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Проверяет, что пиксели PNG-результата отличаются от носителя, приведенного
+ * к строкам PNG, только младшими битами каналов, а альфа-канал не изменился.
+ */
+static int same_png(const char *check, const char *params)
+{
+    BMP_FILE carrier, output;
+    if (!bmp_load(CARRIER_FILE, &carrier, 0))
+        return 0;
+    if (!bmp_prepare_output(&carrier, OUTPUT_PNG) || !bmp_load(OUTPUT_PNG, &output, 0))
+    {
+        bmp_free(&carrier);
+        return 0;
+    }
+
+    const BMP_FORMAT *format = &carrier.format;
+    int ok = output.format.png && output.format.width == format->width && output.format.height == format->height &&
+             output.format.bytesPerPixel == format->bytesPerPixel;
+    if (!ok)
+        printf("MISMATCH %s (%s): output PNG has a different format\n", check, params);
+
+    long long size = format->rowSize * format->height;
+    for (long long i = 0; ok && i < size; i++)
+    {
+        unsigned char mask = format->bytesPerPixel == 4 && i % 4 == 3 ? 0xFF : 0xFE;
+        if ((carrier.pixels[i] ^ output.pixels[i]) & mask)
+        {
+            printf("MISMATCH %s (%s): pixel byte %lld changed from %02x to %02x\n", check, params, i,
+                   carrier.pixels[i], output.pixels[i]);
+            ok = 0;
+        }
+    }
+
+    bmp_free(&carrier);
+    bmp_free(&output);
+    return ok;
+}
+
+/**
+ * @brief PNG: каждый метод встраивает сообщение из 24- или 32-битного BMP в PNG, сообщение
+ * извлекается из PNG, пиксели меняются только в младших битах; затем PNG служит носителем
+ * для BMP-результата.
+ */
+static int check_png(int iteration)
+{
+    int bitCount = random_below(2) ? 32 : 24;
+    int width = 14 + random_below(SELFCHECK_MAX_WIDTH - 13);
+    int height = 8 + random_below(SELFCHECK_MAX_HEIGHT - 7);
+    int topDown = random_below(2);
+    int step = 1 + random_below(8);
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+    free(carrier);
+
+    int capacity = width * height / 8 / step;
+    size_t len = 1 + random_below(capacity < SIMPLE_MAX_TEXT ? capacity : SIMPLE_MAX_TEXT);
+    char *text = random_text(len);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, step %d, mask %d, length %zu", iteration, bitCount,
+             width, height, topDown ? " top-down" : "", step, mask, len);
+
+    int ok = simple_encode(CARRIER_FILE, OUTPUT_PNG, text, 1, NULL) != 0 && same_png("simple_png", params);
+    if (ok)
+    {
+        char *outText = simple_decode(OUTPUT_PNG);
+        ok = same_text("simple_png_decode", params, text, outText, len + 1);
+        free(outText);
+    }
+
+    if (ok)
+    {
+        ok = stegano_encode(CARRIER_FILE, OUTPUT_PNG, text, step, mask, NULL) &&
+             save_stegano_key(KEY_FILE, step, len, mask) &&
+             same_png("stegano_png", params);
+        if (ok)
+        {
+            char *outText = stegano_decode(OUTPUT_PNG, KEY_FILE);
+            ok = same_text("stegano_png_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+    }
+
+    if (ok)
+    {
+        int startX = 0, startY = 0;
+        srand(next_random());
+        ok = color_encode(CARRIER_FILE, OUTPUT_PNG, text, &startX, &startY, NULL) &&
+             saveColorKey(KEY_FILE, startX, startY, (int)len) && same_png("color_png", params);
+        if (ok)
+        {
+            char *outText = color_decode(OUTPUT_PNG, KEY_FILE);
+            ok = same_text("color_png_decode", params, text, outText, len + 1);
+            free(outText);
+        }
+    }
+
+    // PNG как носитель: строки без выравнивания превращаются в строки BMP с выравниванием
+    if (ok)
+    {
+        ok = simple_encode(OUTPUT_PNG, OUTPUT_FILE, text, 1, NULL) != 0;
+        if (ok)
+        {
+            char *outText = simple_decode(OUTPUT_FILE);
+            ok = same_text("simple_png_carrier", params, text, outText, len + 1);
+            free(outText);
+        }
+    }
+
+    free(text);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(OUTPUT_PNG);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Потоковая обработка: stream_encode дает побайтно тот же файл, что simple_encode
+ * и stegano_encode, а stream_decode извлекает сообщение. Длинные строки, длинные сообщения и
+ * большой шаг стеганографии разносят биты сообщения по нескольким тайлам.
+ */
+static int check_stream(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 14 + random_below(SELFCHECK_WIDE_WIDTH - 13);
+    int height = 1 + random_below(12);
+    int topDown = random_below(2);
+    int pixelCount = width * height;
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+    free(carrier);
+
+    // через раз длина - до емкости изображения: декодер ограничивает ее только емкостью,
+    // и у широких изображений сообщение длиннее 1000 байтов
+    int capacity = (pixelCount - 32) / 8, maxLen = iteration % 32 == 0 ? capacity : 200;
+    size_t len = 1 + random_below(capacity < maxLen ? capacity : maxLen);
+    int step = 1 + random_below(pixelCount / (int)(8 * len));
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    char *text = random_text(len);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, step %d, mask %d, depth %d, length %zu",
+             iteration, bitCount, width, height, topDown ? " top-down" : "", step, mask, depth, len);
+
+    int ok = 1;
+    for (int method = STREAM_SIMPLE; ok && method <= STREAM_STEGANO; method++)
+    {
+        const char *check = method == STREAM_SIMPLE ? "simple_stream" : "stegano_stream";
+        ok = method == STREAM_SIMPLE ? simple_encode(CARRIER_FILE, OUTPUT_FILE, text, depth, NULL) != 0
+                                     : stegano_encode(CARRIER_FILE, OUTPUT_FILE, text, step, mask, NULL);
+        size_t expectedSize = 0;
+        unsigned char *expected = ok ? read_file(OUTPUT_FILE, &expectedSize) : NULL;
+        if (!expected)
+        {
+            printf("MISMATCH %s (%s): file encoder failed\n", check, params);
+            ok = 0;
+            break;
+        }
+
+        FILE *in = fopen(CARRIER_FILE, "rb");
+        FILE *out = fopen(OUTPUT_FILE, "wb");
+        ok = in && out && stream_encode(in, out, method, text, len, step, mask, depth) != 0;
+        if (in)
+            fclose(in);
+        if (out)
+            fclose(out);
+        ok = ok && same_file(check, params, expected, expectedSize);
+        free(expected);
+
+        if (ok)
+        {
+            in = fopen(OUTPUT_FILE, "rb");
+            size_t outLen = len;
+            char *outText = in ? stream_decode(in, method, step, mask, &outLen) : NULL;
+            if (in)
+                fclose(in);
+            ok = same_text(method == STREAM_SIMPLE ? "simple_stream_decode" : "stegano_stream_decode", params, text,
+                           outText, len + 1);
+            free(outText);
+        }
+    }
+
+    free(text);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    return ok;
+}
+
+/**
+ * @brief Кодирует сообщение методом method (0 - simple, 1 - stegano, 2 - color) через файлы.
+ */
+static int window_encode(int method, const char *text, size_t len, int step, int mask, int depth,
+                         unsigned int colorSeed, DISTORTION *dist)
+{
+    distortion_init(dist);
+    if (method == 0)
+        return simple_encode(CARRIER_FILE, OUTPUT_FILE, text, depth, dist) != 0;
+    if (method == 1)
+        return stegano_encode_bytes(CARRIER_FILE, OUTPUT_FILE, text, len, step, mask, dist);
+    int startX, startY;
+    srand(colorSeed);
+    return color_encode(CARRIER_FILE, OUTPUT_FILE, text, &startX, &startY, dist) &&
+           saveColorKey(KEY_FILE, startX, startY, (int)len);
+}
+
+/**
+ * @brief Предел памяти (--max-memory): каждый метод, обрабатывая изображение окнами
+ * в одну-три строки, дает побайтно тот же файл и те же метрики искажения, что и без
+ * предела, и извлекает сообщение (для simple - и с кодом Рида-Соломона).
+ */
+static int check_window(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    static const char *names[3] = {"simple_window", "stegano_window", "color_window"};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 14 + random_below(SELFCHECK_MAX_WIDTH - 13);
+    int height = 4 + random_below(SELFCHECK_MAX_HEIGHT - 3);
+    int topDown = random_below(2);
+    int pixelCount = width * height;
+    long long rowSize = ((long long)width * bitCount + 31) / 32 * 4;
+    long long budget = STREAM_RESERVE + rowSize * (1 + random_below(3));
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+    free(carrier);
+
+    int capacity = pixelCount / 8 - 5; // цвет: один канал на пиксель и завершающий нуль
+    size_t len = 1 + random_below(capacity < 200 ? capacity : 200);
+    int step = 1 + random_below(pixelCount / (int)(8 * len));
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    unsigned int colorSeed = next_random();
+    char *text = random_text(len);
+
+    char params[160];
+    snprintf(params, sizeof(params),
+             "iteration %d, %d-bit %dx%d%s, budget %lld, step %d, mask %d, depth %d, length %zu", iteration, bitCount,
+             width, height, topDown ? " top-down" : "", budget, step, mask, depth, len);
+
+    int ok = 1;
+    for (int method = 0; ok && method < 3; method++)
+    {
+        DISTORTION refDist, dist;
+        ok = window_encode(method, text, len, step, mask, depth, colorSeed, &refDist);
+        size_t expectedSize = 0;
+        unsigned char *expected = ok ? read_file(OUTPUT_FILE, &expectedSize) : NULL;
+        if (!expected)
+        {
+            printf("MISMATCH %s (%s): in-memory encoder failed\n", names[method], params);
+            ok = 0;
+            break;
+        }
+
+        stream_set_max_memory(budget);
+        ok = window_encode(method, text, len, step, mask, depth, colorSeed, &dist) &&
+             same_file(names[method], params, expected, expectedSize) &&
+             same_distortion(names[method], params, &refDist, &dist);
+        free(expected);
+        if (ok)
+        {
+            char *outText = NULL;
+            if (method == 0)
+                outText = simple_decode(OUTPUT_FILE);
+            else if (method == 1)
+                outText = save_stegano_key(KEY_FILE, step, len, mask) ? stegano_decode(OUTPUT_FILE, KEY_FILE) : NULL;
+            else
+                outText = color_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text(names[method], params, text, outText, len + 1);
+            free(outText);
+        }
+        stream_set_max_memory(0);
+    }
+
+    // код Рида-Соломона: заголовок и сообщение читаются окнами для каждой глубины
+    size_t codedSize = 0;
+    unsigned char *coded =
+        ok ? ecc_encode_simple((const unsigned char *)text, len, 2 + 2 * random_below(8), depth, &codedSize) : NULL;
+    if (coded && simpleSamples((int)codedSize, depth) <= pixelCount)
+    {
+        stream_set_max_memory(budget);
+        int corrected = 0;
+        char *outText = simple_encode_bytes(CARRIER_FILE, OUTPUT_FILE, coded, (int)codedSize, depth, NULL)
+                            ? ecc_simple_decode(OUTPUT_FILE, &corrected)
+                            : NULL;
+        ok = outText && same_bytes("ecc_simple_window", params, (const unsigned char *)text,
+                                   (const unsigned char *)outText, len);
+        if (!outText)
+            printf("MISMATCH ecc_simple_window (%s): message not recovered\n", params);
+        free(outText);
+        // без --ecc сообщение с кодом узнается по заголовку - и окнами, и целиком
+        for (int windowed = 1; ok && windowed >= 0; windowed--)
+        {
+            stream_set_max_memory(windowed ? budget : 0);
+            outText = simple_decode(OUTPUT_FILE);
+            ok = outText && same_bytes("simple_decode_ecc", params, (const unsigned char *)text,
+                                       (const unsigned char *)outText, len);
+            if (!outText)
+                printf("MISMATCH simple_decode_ecc (%s): message not recovered\n", params);
+            free(outText);
+        }
+        stream_set_max_memory(0);
+    }
+    free(coded);
+
+    free(text);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Слоты: несколько сообщений встраиваются за один вызов, каждое читается отдельно;
+ * после удаления слота освободившаяся область занимается новым сообщением, а остальные
+ * сообщения не меняются. Байты изображения меняются только в младшем бите.
+ */
+static int check_slots(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 40 + random_below(SELFCHECK_MAX_WIDTH - 39); // 8-битному 40x40 хватает места на таблицу и 5 слотов
+    int height = 40 + random_below(SELFCHECK_MAX_HEIGHT - 39);
+    int topDown = random_below(2);
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+
+    int count = 1 + random_below(4);
+    long long samples = (long long)width * height * (bitCount == 8 ? 1 : 3);
+    int room = (int)((samples - SLOTS_TABLE_BITS) / 8 / (count + 1));
+    char *texts[5];
+    for (int i = 0; i <= count; i++)
+        texts[i] = random_text(1 + random_below(room < 200 ? room : 200));
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, %d slots", iteration, bitCount, width, height,
+             topDown ? " top-down" : "", count);
+
+    int numbers[4];
+    int ok = slots_add(CARRIER_FILE, OUTPUT_FILE, (const char *const *)texts, count, numbers);
+    for (int i = 0; ok && i < count; i++)
+    {
+        char *outText = slots_read(OUTPUT_FILE, numbers[i], NULL);
+        ok = numbers[i] == i + 1 && same_text("slots_read", params, texts[i], outText, strlen(texts[i]) + 1);
+        free(outText);
+    }
+
+    // удаляется случайный слот: номера остальных не меняются, а последнее сообщение
+    // занимает освободившийся номер и область
+    int removed = random_below(count);
+    ok = ok && slots_remove(OUTPUT_FILE, OUTPUT_FILE, removed + 1) &&
+         slots_add(OUTPUT_FILE, OUTPUT_FILE, (const char *const *)(texts + count), 1, numbers);
+    if (ok && numbers[0] != removed + 1)
+    {
+        printf("MISMATCH slots_reuse (%s): new message got slot %d instead of %d\n", params, numbers[0], removed + 1);
+        ok = 0;
+    }
+    for (int i = 0; ok && i < count; i++)
+    {
+        const char *expected = i == removed ? texts[count] : texts[i];
+        char *outText = slots_read(OUTPUT_FILE, i + 1, NULL);
+        ok = same_text("slots_reuse", params, expected, outText, strlen(expected) + 1);
+        free(outText);
+    }
+
+    size_t outSize = 0;
+    unsigned char *output = ok ? read_file(OUTPUT_FILE, &outSize) : NULL;
+    if (output)
+    {
+        for (size_t i = 0; ok && i < fileSize; i++)
+        {
+            if (i >= outSize || (carrier[i] ^ output[i]) > 1)
+            {
+                printf("MISMATCH slots_lsb (%s): byte %zu changed beyond the low bit\n", params, i);
+                ok = 0;
+            }
+        }
+        free(output);
+    }
+    else if (ok)
+    {
+        printf("MISMATCH slots (%s): output file was not written\n", params);
+        ok = 0;
+    }
+
+    for (int i = 0; i <= count; i++)
+        free(texts[i]);
+    free(carrier);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    return ok;
+}
+
+/**
+ * @brief Обновление на месте: после замены или дополнения сообщения файл побайтно совпадает
+ * с результатом повторного шифрования прежнего изображения итоговым сообщением, а
+ * сообщение извлекается обычным декодером.
+ */
+static int check_update(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 40 + random_below(SELFCHECK_MAX_WIDTH - 39);
+    int height = 40 + random_below(SELFCHECK_MAX_HEIGHT - 39);
+    int topDown = random_below(2);
+    int pixelCount = width * height;
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    fclose(f);
+    free(carrier);
+
+    // 8-битному 40x40 хватает места на 120 символов при любой начальной точке подстановки цветов
+    int append = random_below(2);
+    size_t len1 = 1 + random_below(60), len2 = 1 + random_below(60);
+    char *text1 = random_text(len1), *text2 = random_text(len2);
+    size_t finalLen = append ? len1 + len2 : len2;
+    char *final = malloc(finalLen + 1);
+    snprintf(final, finalLen + 1, "%s%s", append ? text1 : "", text2);
+
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    size_t maxLen = len1 > finalLen ? len1 : finalLen;
+    int lanes = bitCount == 8 ? 1 : (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+    int visits = (int)((8 * maxLen + lanes - 1) / lanes);
+    int step = 1 + random_below((pixelCount - 1) / visits);
+    int channels = bitCount == 8 ? 1 : 3;
+    int startIndex = random_below(pixelCount - (int)((maxLen + 1) * 8 / channels) - 1);
+    int startX = startIndex % width, startY = startIndex / width;
+
+    char params[160];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, %s, depth %d, step %d, mask %d, lengths %zu/%zu",
+             iteration, bitCount, width, height, topDown ? " top-down" : "", append ? "append" : "replace", depth,
+             step, mask, len1, len2);
+
+    int ok = 1;
+    for (int method = UPDATE_SIMPLE; ok && method <= UPDATE_STEGANO; method++)
+    {
+        static const char *const names[3] = {"simple_update", "color_update", "stegano_update"};
+        BMP_FILE img;
+        if (method == UPDATE_SIMPLE)
+            ok = simple_encode(CARRIER_FILE, OUTPUT_FILE, text1, depth, NULL) != 0;
+        else if (method == UPDATE_STEGANO)
+            ok = stegano_encode(CARRIER_FILE, OUTPUT_FILE, text1, step, mask, NULL) &&
+                 save_stegano_key(KEY_FILE, step, len1, mask);
+        else
+        {
+            ok = bmp_load(CARRIER_FILE, &img, 1);
+            if (ok)
+            {
+                hideMessage(&img, text1, startX, startY);
+                ok = bmp_save(OUTPUT_FILE, &img) && saveColorKey(KEY_FILE, startX, startY, (int)len1);
+                bmp_free(&img);
+            }
+        }
+
+        // эталон: прежнее изображение шифруется итоговым сообщением целиком
+        if (ok)
+        {
+            if (method == UPDATE_SIMPLE)
+                ok = simple_encode(OUTPUT_FILE, REFERENCE_FILE, final, depth, NULL) != 0;
+            else if (method == UPDATE_STEGANO)
+                ok = stegano_encode(OUTPUT_FILE, REFERENCE_FILE, final, step, mask, NULL);
+            else if ((ok = bmp_load(OUTPUT_FILE, &img, 1)) != 0)
+            {
+                hideMessage(&img, final, startX, startY);
+                ok = bmp_save(REFERENCE_FILE, &img);
+                bmp_free(&img);
+            }
+        }
+
+        UPDATE_RESULT result;
+        size_t expectedSize = 0;
+        unsigned char *expected = ok ? read_file(REFERENCE_FILE, &expectedSize) : NULL;
+        ok = expected && update_image(method, OUTPUT_FILE, KEY_FILE, append ? text2 : final, append, 0, &result);
+        if (!ok)
+            printf("MISMATCH %s (%s): update failed\n", names[method], params);
+        ok = ok && same_file(names[method], params, expected, expectedSize);
+        free(expected);
+
+        if (ok)
+        {
+            char *outText = method == UPDATE_SIMPLE    ? simple_decode(OUTPUT_FILE)
+                            : method == UPDATE_STEGANO ? stegano_decode(OUTPUT_FILE, KEY_FILE)
+                                                       : color_decode(OUTPUT_FILE, KEY_FILE);
+            ok = same_text(names[method], params, final, outText, finalLen + 1);
+            free(outText);
+        }
+    }
+
+    free(text1);
+    free(text2);
+    free(final);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(REFERENCE_FILE);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Экспорт патча и восстановление по нему на случайном носителе.
+ *
+ * Изображение, восстановленное из носителя и патча, должно побайтно совпасть с
+ * результатом обычного шифрования тем же сообщением (для метода цветов - с той же
+ * начальной точкой rand()).
+ */
+static int check_patch(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    int bitCount = bitCounts[random_below(3)];
+    int width = 40 + random_below(SELFCHECK_MAX_WIDTH - 39);
+    int height = 40 + random_below(SELFCHECK_MAX_HEIGHT - 39);
+    int topDown = random_below(2);
+    int tail = random_below(2) ? 1 + random_below(100) : 0; // данные за пиксельными строками
+    size_t fileSize;
+
+    unsigned char *carrier = bmp_synthetic(width, topDown ? -height : height, bitCount, next_random(), &fileSize);
+    FILE *f = carrier ? fopen(CARRIER_FILE, "wb") : NULL;
+    if (!f)
+    {
+        printf("Error: Cannot create %s\n", CARRIER_FILE);
+        free(carrier);
+        return 0;
+    }
+    fwrite(carrier, 1, fileSize, f);
+    for (int i = 0; i < tail; i++)
+        fputc((int)(next_random() & 0xFF), f);
+    fclose(f);
+    free(carrier);
+
+    size_t len = 1 + random_below(60);
+    char *text = random_text(len);
+    int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+    int mask = 1 + random_below(STEGANO_MASK_ALL);
+    int lanes = bitCount == 8 ? 1 : (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+    int visits = (int)((8 * len + lanes - 1) / lanes);
+    int step = 1 + random_below((width * height - 1) / visits);
+    unsigned int seed = next_random();
+
+    char params[160];
+    snprintf(params, sizeof(params), "iteration %d, %d-bit %dx%d%s, tail %d, depth %d, step %d, mask %d, length %zu",
+             iteration, bitCount, width, height, topDown ? " top-down" : "", tail, depth, step, mask, len);
+
+    int ok = 1;
+    for (int method = PATCH_SIMPLE; ok && method <= PATCH_STEGANO; method++)
+    {
+        static const char *const names[3] = {"simple_patch", "color_patch", "stegano_patch"};
+        int x, y;
+        srand(seed);
+        if (method == PATCH_SIMPLE)
+            ok = simple_encode(CARRIER_FILE, REFERENCE_FILE, text, depth, NULL) != 0;
+        else if (method == PATCH_COLOR)
+            ok = color_encode(CARRIER_FILE, REFERENCE_FILE, text, &x, &y, NULL);
+        else
+            ok = stegano_encode(CARRIER_FILE, REFERENCE_FILE, text, step, mask, NULL);
+
+        PATCH_RESULT result;
+        size_t expectedSize = 0;
+        unsigned char *expected = ok ? read_file(REFERENCE_FILE, &expectedSize) : NULL;
+        srand(seed);
+        ok = expected && patch_export(method, CARRIER_FILE, PATCH_FILE, KEY_FILE, text, step, mask, depth, &result) &&
+             patch_apply(CARRIER_FILE, PATCH_FILE, OUTPUT_FILE, &result);
+        if (!ok)
+            printf("MISMATCH %s (%s): patch failed\n", names[method], params);
+        ok = ok && same_file(names[method], params, expected, expectedSize);
+        free(expected);
+    }
+
+    free(text);
+    remove(CARRIER_FILE);
+    remove(OUTPUT_FILE);
+    remove(REFERENCE_FILE);
+    remove(PATCH_FILE);
+    remove(KEY_FILE);
+    return ok;
+}
+
+/**
+ * @brief Фрагменты: случайный файл делится между 1-4 носителями разных форматов и собирается
+ * из результатов, переданных в обратном порядке; собранный файл должен совпасть с исходным.
+ */
+static int check_shard(int iteration)
+{
+    static const int bitCounts[3] = {8, 24, 32};
+    char carriers[4][32], outputs[4][64];
+    char *carrierNames[4], *outputNames[4];
+    int count = 1 + random_below(4);
+    long long capacity = 0;
+
+    char params[160];
+    int n = snprintf(params, sizeof(params), "iteration %d, carriers", iteration);
+    for (int i = 0; i < count; i++)
+    {
+        int bitCount = bitCounts[random_below(3)];
+        int width = 1 + random_below(SELFCHECK_MAX_WIDTH), height = 1 + random_below(SELFCHECK_MAX_HEIGHT);
+        size_t fileSize;
+        unsigned char *carrier = bmp_synthetic(width, height, bitCount, next_random(), &fileSize);
+        snprintf(carriers[i], sizeof(carriers[i]), "selfcheck_shard_%d.bmp", i);
+        snprintf(outputs[i], sizeof(outputs[i]), "%s/%s", SHARD_DIR, carriers[i]);
+        carrierNames[i] = carriers[i];
+        outputNames[count - 1 - i] = outputs[i];
+        FILE *f = carrier ? fopen(carriers[i], "wb") : NULL;
+        if (!f)
+        {
+            printf("Error: Cannot create %s\n", carriers[i]);
+            free(carrier);
+            return 0;
+        }
+        fwrite(carrier, 1, fileSize, f);
+        fclose(f);
+        free(carrier);
+        capacity += shard_capacity(carriers[i]);
+        n += snprintf(params + n, sizeof(params) - n, " %d-bit %dx%d", bitCount, width, height);
+    }
+
+    int ok = 1;
+    if (capacity > 0)
+    {
+        size_t size = 1 + random_below(capacity < 100000 ? (int)capacity : 100000);
+        unsigned char *payload = malloc(size);
+        random_bytes(payload, size);
+        FILE *f = fopen(SHARD_PAYLOAD, "wb");
+        ok = f && fwrite(payload, 1, size, f) == size;
+        if (f)
+            fclose(f);
+
+        SHARD_RESULT result;
+        ok = ok && shard_split(SHARD_PAYLOAD, SHARD_DIR, carrierNames, count, NULL, 2, &result);
+        int written = 0;
+        for (int i = 0; ok && i < count; i++)
+        {
+            // носители, которым не досталось данных, не сохраняются
+            FILE *out = fopen(outputNames[i], "rb");
+            if (out)
+            {
+                outputNames[written++] = outputNames[i];
+                fclose(out);
+            }
+        }
+        ok = ok && shard_join(OUTPUT_FILE, outputNames, written, NULL, 2, &result);
+        if (!ok)
+            printf("MISMATCH shard (%s, payload %zu): split or join failed\n", params, size);
+        ok = ok && same_file("shard", params, payload, size);
+        free(payload);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        remove(carriers[i]);
+        remove(outputs[i]);
+    }
+    remove(SHARD_PAYLOAD);
+    remove(OUTPUT_FILE);
+    remove(SHARD_DIR);
+    return ok;
+}
+
+// Тестовый вектор ChaCha20-Poly1305 из RFC 8439, раздел 2.8.2 (ключ 80..9f, nonce 07000000 4041..47)
+static const char AEAD_KAT_PLAIN[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for "
+                                     "the future, sunscreen would be it.";
+static const unsigned char AEAD_KAT_AAD[12] = {0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7};
+static const unsigned char AEAD_KAT_CIPHER[114] = {
+    0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2, 0xa4, 0xad, 0xed,
+    0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6, 0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9,
+    0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b, 0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05,
+    0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36, 0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3,
+    0x28, 0x09, 0x1b, 0x58, 0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7,
+    0xbc, 0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b, 0x61, 0x16};
+static const unsigned char AEAD_KAT_TAG[AEAD_TAG] = {0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a,
+                                                     0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91};
+
+// Тестовые векторы PBKDF2-HMAC-SHA256 из RFC 7914, раздел 11
+static const unsigned char PBKDF2_KAT_PASSWD[64] = {
+    0x55, 0xac, 0x04, 0x6e, 0x56, 0xe3, 0x08, 0x9f, 0xec, 0x16, 0x91, 0xc2, 0x25, 0x44, 0xb6, 0x05,
+    0xf9, 0x41, 0x85, 0x21, 0x6d, 0xde, 0x04, 0x65, 0xe6, 0x8b, 0x9d, 0x57, 0xc2, 0x0d, 0xac, 0xbc,
+    0x49, 0xca, 0x9c, 0xcc, 0xf1, 0x79, 0xb6, 0x45, 0x99, 0x16, 0x64, 0xb3, 0x9d, 0x77, 0xef, 0x31,
+    0x7c, 0x71, 0xb8, 0x45, 0xb1, 0xe3, 0x0b, 0xd5, 0x09, 0x11, 0x20, 0x41, 0xd3, 0xa1, 0x97, 0x83};
+static const unsigned char PBKDF2_KAT_NACL[64] = {
+    0x4d, 0xdc, 0xd8, 0xf6, 0x0b, 0x98, 0xbe, 0x21, 0x83, 0x0c, 0xee, 0x5e, 0xf2, 0x27, 0x01, 0xf9,
+    0x64, 0x1a, 0x44, 0x18, 0xd0, 0x4c, 0x04, 0x14, 0xae, 0xff, 0x08, 0x87, 0x6b, 0x34, 0xab, 0x56,
+    0xa1, 0xd4, 0x25, 0xa1, 0x22, 0x58, 0x33, 0x54, 0x9a, 0xdb, 0x84, 0x1b, 0x51, 0xc9, 0xb3, 0x17,
+    0x6a, 0x27, 0x2b, 0xde, 0xbb, 0xa1, 0xd0, 0x78, 0x47, 0x8f, 0x62, 0xb3, 0x97, 0xf3, 0x3c, 0x8d};
+
+/**
+ * @brief Известные ответы RFC 8439 (ChaCha20-Poly1305) и RFC 7914 (PBKDF2-HMAC-SHA256): случайные
+ * проверки сравнивают ядра только между собой и не заметят ошибку, общую для всех.
+ */
+static int check_aead_vectors(void)
+{
+    unsigned char key[AEAD_KEY], cipher[sizeof(AEAD_KAT_CIPHER)], plain[sizeof(AEAD_KAT_CIPHER)], tag[AEAD_TAG];
+    for (int i = 0; i < 32; i++)
+        key[i] = (unsigned char)(0x80 + i);
+    static const unsigned char nonce[12] = {0x07, 0, 0, 0, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47};
+    memcpy(key + 32, nonce, sizeof(nonce));
+
+    aead_encrypt(key, AEAD_KAT_AAD, sizeof(AEAD_KAT_AAD), (const unsigned char *)AEAD_KAT_PLAIN,
+                 sizeof(AEAD_KAT_CIPHER), cipher, tag);
+    int ok = same_bytes("aead_encrypt", "RFC 8439 2.8.2", AEAD_KAT_CIPHER, cipher, sizeof(cipher)) &&
+             same_bytes("aead_tag", "RFC 8439 2.8.2", AEAD_KAT_TAG, tag, AEAD_TAG);
+    if (ok && !aead_decrypt(key, AEAD_KAT_AAD, sizeof(AEAD_KAT_AAD), AEAD_KAT_CIPHER, sizeof(AEAD_KAT_CIPHER),
+                            AEAD_KAT_TAG, plain))
+    {
+        printf("MISMATCH aead_decrypt (RFC 8439 2.8.2): authentic message rejected\n");
+        ok = 0;
+    }
+
+    unsigned char derived[64];
+    if (ok)
+    {
+        pbkdf2_sha256("passwd", 6, (const unsigned char *)"salt", 4, 1, derived, sizeof(derived));
+        ok = same_bytes("pbkdf2_sha256", "RFC 7914 11, passwd/salt, c=1", PBKDF2_KAT_PASSWD, derived, sizeof(derived));
+    }
+    if (ok)
+    {
+        pbkdf2_sha256("Password", 8, (const unsigned char *)"NaCl", 4, 80000, derived, sizeof(derived));
+        ok = same_bytes("pbkdf2_sha256", "RFC 7914 11, Password/NaCl, c=80000", PBKDF2_KAT_NACL, derived,
+                        sizeof(derived));
+    }
+    return ok;
+}
+
+/**
+ * @brief Шифрование: ключевой поток ChaCha20 (с SSE2 - по четыре блока) сравнивается с поблочным,
+ * ChaCha20-Poly1305 расшифровывает свой шифртекст и отвергает его после изменения одного байта;
+ * на первой итерации - известные ответы RFC 8439 и RFC 7914 (см. check_aead_vectors).
+ */
+static int check_aead(int iteration)
+{
+    if (iteration == 0 && !check_aead_vectors())
+        return 0;
+
+    size_t size = (size_t)random_below(1200);
+    unsigned int counter = next_random() % 1000;
+    size_t aadLen = (size_t)random_below(40);
+    unsigned char key[AEAD_KEY], aad[40], tag[AEAD_TAG];
+    random_bytes(key, sizeof(key));
+    random_bytes(aad, aadLen);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, size %zu, counter %u, aad %zu", iteration, size, counter, aadLen);
+
+    unsigned char *plain = malloc(size + 1), *expected = malloc(size + 1), *actual = malloc(size + 1);
+    random_bytes(plain, size);
+    for (size_t i = 0; i < size; i += 64)
+    {
+        unsigned char block[64];
+        chacha20_block(key, key + 32, counter + (unsigned int)(i / 64), block);
+        for (size_t j = 0; j < 64 && i + j < size; j++)
+            expected[i + j] = plain[i + j] ^ block[j];
+    }
+    chacha20_xor(key, key + 32, counter, plain, actual, size);
+    int ok = same_bytes("chacha20", params, expected, actual, size);
+
+    if (ok)
+    {
+        aead_encrypt(key, aad, aadLen, plain, size, expected, tag);
+        ok = aead_decrypt(key, aad, aadLen, expected, size, tag, actual) &&
+             same_bytes("aead_decrypt", params, plain, actual, size);
+        if (!ok)
+            printf("MISMATCH aead_decrypt (%s): authentic message rejected or damaged\n", params);
+    }
+    if (ok)
+    {
+        size_t at = (size_t)random_below((int)(size + AEAD_TAG));
+        unsigned char bit = (unsigned char)(1 << random_below(8));
+        if (at < size)
+            expected[at] ^= bit;
+        else
+            tag[at - size] ^= bit;
+        ok = !aead_decrypt(key, aad, aadLen, expected, size, tag, actual);
+        if (!ok)
+            printf("MISMATCH aead_tamper (%s): byte %zu changed, tag still accepted\n", params, at);
+    }
+    if (ok && iteration % 64 == 0) // вывод ключа PBKDF2 медленный: текстовая форма проверяется реже
+    {
+        // длина текста с разным остатком от деления на 3 проверяет дополнение Base64
+        char text[8] = "abcdefg";
+        text[iteration / 64 % 7 + 1] = '\0';
+        char *sealed = aead_seal_text("selfcheck", text);
+        char *opened = sealed ? aead_open_text("selfcheck", sealed) : NULL;
+        ok = opened && strcmp(opened, text) == 0 &&
+             strspn(sealed, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=") == strlen(sealed);
+        if (!ok)
+            printf("MISMATCH aead_seal_text (%s): text \"%s\" not restored\n", params, text);
+        free(opened);
+        free(sealed);
+    }
+
+    free(plain);
+    free(expected);
+    free(actual);
+    return ok;
+}
+
+/**
+ * @brief Синдромы кодового слова эталонной схемой Горнера со скалярным умножением gf_mul.
+ */
+static void ref_ecc_syndromes(const unsigned char *body, int lanes, int lane, int n, int parity,
+                              unsigned char *syndromes)
+{
+    unsigned char root = 1;
+    for (int i = 0; i < parity; i++)
+    {
+        unsigned char s = 0;
+        for (int j = 0; j < n; j++)
+            s = gf_mul(s, root) ^ body[(size_t)j * lanes + lane];
+        syndromes[i] = s;
+        root = gf_mul(root, 2);
+    }
+}
+
+/**
+ * @brief Код Рида-Соломона: векторные кодер и синдромы против скалярной схемы Горнера,
+ * исправление пакетов ошибок в пределах p/2 байтов на кодовое слово; на каждой 16-й
+ * итерации - сообщение simple с ECC, прочитанное после порчи префикса и данных в файле.
+ */
+static int check_ecc(int iteration)
+{
+    size_t size = 1 + (size_t)random_below(3000);
+    int parity = ECC_MIN_PARITY + 2 * random_below((ECC_MAX_PARITY - ECC_MIN_PARITY) / 2 + 1);
+    unsigned char *data = malloc(size);
+    random_bytes(data, size);
+
+    char params[128];
+    snprintf(params, sizeof(params), "iteration %d, size %zu, parity %d", iteration, size, parity);
+
+    size_t codedSize = 0;
+    unsigned char *coded = ecc_encode(data, size, parity, &codedSize);
+    int ok = coded && codedSize == ecc_coded_size(size, parity);
+    if (!ok)
+        printf("MISMATCH ecc_encode (%s): coded size %zu\n", params, codedSize);
+
+    size_t bodySize = codedSize - ECC_HEADER_SIZE;
+    int lanes = (int)((size + 254 - parity) / (255 - parity));
+    int n = (int)(bodySize / lanes);
+    unsigned char *body = coded + ECC_HEADER_SIZE;
+    unsigned char *expected = malloc(parity), *actual = malloc((size_t)lanes * parity);
+    for (int b = 0; ok && b < lanes; b++)
+    {
+        ref_ecc_syndromes(body, lanes, b, n, parity, expected);
+        for (int i = 0; i < parity && ok; i++)
+            if (expected[i] != 0)
+            {
+                printf("MISMATCH ecc_encode (%s): codeword %d syndrome %d is %u\n", params, b, i, expected[i]);
+                ok = 0;
+            }
+    }
+
+    if (ok)
+    {
+        // пакет из lanes * p/2 подряд идущих байтов задевает каждое слово не более p/2 раз
+        size_t burst = (size_t)random_below(lanes * (parity / 2) + 1);
+        size_t at = (size_t)random_below((int)(bodySize - burst + 1));
+        for (size_t i = 0; i < burst; i++)
+            body[at + i] ^= (unsigned char)(1 + random_below(255));
+        int headerErrors = random_below(ECC_HEADER_PARITY / 2 + 1);
+        for (int i = 0; i < headerErrors; i++)
+            coded[random_below(ECC_HEADER_SIZE)] ^= (unsigned char)(1 + random_below(255));
+
+        ecc_syndromes(body, lanes, n, parity, actual);
+        for (int b = 0; b < lanes && ok; b++)
+        {
+            ref_ecc_syndromes(body, lanes, b, n, parity, expected);
+            for (int i = 0; i < parity && ok; i++)
+                if (expected[i] != actual[(size_t)i * lanes + b])
+                {
+                    printf("MISMATCH ecc_syndromes (%s): codeword %d syndrome %d: expected 0x%02X, got 0x%02X\n",
+                           params, b, i, expected[i], actual[(size_t)i * lanes + b]);
+                    ok = 0;
+                }
+        }
+
+        size_t outSize = 0;
+        int corrected = 0;
+        unsigned char *out = ok ? ecc_decode(coded, codedSize, &outSize, &corrected) : NULL;
+        if (ok && (!out || outSize != size))
+        {
+            printf("MISMATCH ecc_decode (%s): burst %zu at %zu, %d header errors not corrected\n", params, burst,
+                   at, headerErrors);
+            ok = 0;
+        }
+        ok = ok && same_bytes("ecc_decode", params, data, out, size);
+        free(out);
+    }
+    free(expected);
+    free(actual);
+
+    if (ok && iteration % 16 == 0)
+    {
+        int width = 4 * (8 + random_below(SELFCHECK_MAX_WIDTH / 4)); // строки без выравнивания
+        int depth = 1 + random_below(SIMPLE_MAX_DEPTH);
+        int samples = simpleSamples((int)codedSize, depth);
+        int height = (samples + width * 3 - 1) / (width * 3) + random_below(4);
+        size_t fileSize;
+        unsigned char *carrier = bmp_synthetic(width, height, 24, next_random(), &fileSize);
+        FILE *f = fopen(CARRIER_FILE, "wb");
+        if (f)
+        {
+            fwrite(carrier, 1, fileSize, f);
+            fclose(f);
+        }
+        free(coded);
+        coded = ecc_encode_simple(data, size, parity, depth, &codedSize);
+        snprintf(params, sizeof(params), "iteration %d, size %zu, parity %d, %dx%d, depth %d", iteration, size,
+                 parity, width, height, depth);
+
+        ok = f && simple_encode_bytes(CARRIER_FILE, OUTPUT_FILE, coded, (int)codedSize, depth, NULL);
+        size_t outputSize = 0;
+        unsigned char *output = ok ? read_file(OUTPUT_FILE, &outputSize) : NULL;
+        if (output)
+        {
+            unsigned char *samplesData = output + sizeof(BMP_HEADER);
+            // префикс входит в кодовое слово заголовка: декодер должен исправить его байты
+            int prefixFlips = 1 + random_below(32);
+            unsigned int prefixDamage = 0;
+            for (int i = 0; i < prefixFlips; i++)
+            {
+                int bit = random_below(32);
+                samplesData[bit] ^= 1;
+                prefixDamage ^= 1u << (31 - bit);
+            }
+            int damagedBytes = 0;
+            for (int i = 0; i < ECC_PREFIX_SIZE; i++)
+                damagedBytes += (prefixDamage >> (8 * i) & 0xFF) != 0;
+            int bodyStart = simpleSamples(ECC_HEADER_SIZE, depth) + 1;
+            for (int i = 0; i < parity / 2 && bodyStart < samples; i++)
+                samplesData[bodyStart + random_below(samples - bodyStart)] ^= 1;
+            f = fopen(OUTPUT_FILE, "wb");
+            if (f)
+            {
+                fwrite(output, 1, outputSize, f);
+                fclose(f);
+            }
+            int corrected = 0;
+            char *text = f ? ecc_simple_decode(OUTPUT_FILE, &corrected) : NULL;
+            ok = text && same_bytes("ecc_simple_decode", params, data, (unsigned char *)text, size);
+            if (!text)
+                printf("MISMATCH ecc_simple_decode (%s): message not recovered\n", params);
+            else if (ok && corrected < damagedBytes)
+            {
+                printf("MISMATCH ecc_simple_decode (%s): %d damaged prefix bytes, %d bytes corrected\n", params,
+                       damagedBytes, corrected);
+                ok = 0;
+            }
+            free(text);
+        }
+        else
+        {
+            printf("MISMATCH ecc_simple_encode (%s): output file was not written\n", params);
+            ok = 0;
+        }
+        free(output);
+        free(carrier);
+    }
+
+    free(coded);
+    free(data);
+    return ok;
+}
+
+/**
+ * @brief Команда selfcheck: сравнивает рабочие ядра с эталонными реализациями.
+ *
+ * Использование: selfcheck [итерации] [seed]
+ *
+ * На каждой итерации со случайными размерами изображения (включая ширины,
+ * требующие выравнивания строк), сообщениями, шагами и начальными точками
+ * рабочие ядра встраивания, извлечения и метрик сравниваются с эталонными
+ * скалярными копиями; пути через файлы проверяются на каждой 16-й итерации,
+ * там же 8-битные, 32-битные и записанные сверху вниз носители, сохранение в PNG,
+ * потоковая обработка и обработка окнами строк с пределом памяти, слоты, обновление
+ * на месте, патчи и фрагменты. Шифрование
+ * ChaCha20-Poly1305 и код Рида-Соломона проверяются на каждой итерации.
+ * Проверка останавливается на первом отличающемся байте. Набор инструкций
+ * ядер задается при сборке, поэтому для каждого варианта сборки (например,
+ * с -mno-sse2) самопроверку нужно запускать отдельно.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 если все проверки пройдены, иначе 1.
+ */
+int selfcheck(int argc, char *argv[])
+{
+    static const struct
+    {
+        const char *name;
+        SELFCHECK_FN fn;
+        int every; // проверка выполняется на каждой every-й итерации
+    } checks[] = {
+        {"simple", check_simple, 1},   {"color", check_color, 1},         {"stegano", check_stegano, 1},
+        {"metrics", check_metrics, 1}, {"plane", check_plane, 1},         {"files", check_files, 16},
+        {"formats", check_formats, 16}, {"png", check_png, 16},           {"stream", check_stream, 16},
+        {"slots", check_slots, 16},    {"update", check_update, 16},     {"patch", check_patch, 16},
+        {"recover", check_recover, 16}, {"shard", check_shard, 16},      {"aead", check_aead, 1},
+        {"ecc", check_ecc, 1},         {"window", check_window, 16},     {"recover_edges", check_recover_edges, 16},
+    };
+    int iterations = argc > 0 ? atoi(argv[0]) : 200;
+    unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 1;
+
+    if (iterations <= 0)
+    {
+        printf("Usage: selfcheck [iterations] [seed]\n");
+        return 1;
+    }
+
+    rngState = seed ? seed : 1;
+    int cases = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        for (size_t c = 0; c < sizeof(checks) / sizeof(checks[0]); c++)
+        {
+            if (i % checks[c].every != 0)
+                continue;
+
+            if (!checks[c].fn(i))
+            {
+                printf("selfcheck FAILED in %s check (%s kernels, seed %u)\n", checks[c].name, SELFCHECK_ISA, seed);
+                printf("Reproduce with: cipher_app selfcheck %d %u\n", i + 1, seed);
+                return 1;
+            }
+            cases++;
+        }
+    }
+
+    printf("selfcheck passed: %d iterations, %d cases (%s kernels, seed %u)\n", iterations, cases, SELFCHECK_ISA,
+           seed);
+    return 0;
+}
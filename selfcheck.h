@@ -0,0 +1,6 @@
+#ifndef SELFCHECK_H
+#define SELFCHECK_H
+
+int selfcheck(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
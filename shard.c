@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bmpinfo.h"
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "hash.h"
+#include "aead.h"
+#include "pool.h"
+#include "stats.h"
+#include "shard.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define shard_mkdir(dir) _mkdir(dir)
+#else
+#include <sys/stat.h>
+#define shard_mkdir(dir) mkdir(dir, 0777)
+#endif
+
+#define SHARD_HASHED 36 // байты заголовка, которые входят в XXH64 вместе с данными фрагмента
+
+// Фрагмент одного носителя при разбиении или одного изображения при сборке
+typedef struct
+{
+    const char *input;
+    char *output;
+    SHARD_HEADER header;
+    unsigned char *data; // сборка: данные фрагмента
+    int ok;
+} SHARD_JOB;
+
+typedef struct
+{
+    SHARD_JOB *jobs;
+    const unsigned char *payload; // разбиение: весь файл
+} SHARD_CTX;
+
+static void put_le(unsigned char *p, unsigned long long v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static unsigned long long get_le(const unsigned char *p, int bytes)
+{
+    unsigned long long v = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static void shard_encode_header(unsigned char *p, const SHARD_HEADER *h)
+{
+    memcpy(p, SHARD_MAGIC, 4);
+    put_le(p + 4, h->payloadId, 8);
+    put_le(p + 12, h->payloadSize, 8);
+    put_le(p + 20, (unsigned int)h->index, 2);
+    put_le(p + 22, (unsigned int)h->count, 2);
+    put_le(p + 24, h->offset, 8);
+    put_le(p + 32, h->length, 4);
+}
+
+static int shard_decode_header(const unsigned char *p, SHARD_HEADER *h)
+{
+    if (memcmp(p, SHARD_MAGIC, 4) != 0)
+        return 0;
+    h->payloadId = get_le(p + 4, 8);
+    h->payloadSize = get_le(p + 12, 8);
+    h->index = (int)get_le(p + 20, 2);
+    h->count = (int)get_le(p + 22, 2);
+    h->offset = get_le(p + 24, 8);
+    h->length = (unsigned int)get_le(p + 32, 4);
+    return h->count > 0 && h->index < h->count && h->offset + h->length <= h->payloadSize &&
+           h->offset <= h->payloadSize;
+}
+
+static unsigned long long shard_record_hash(const unsigned char *record, const unsigned char *data,
+                                            unsigned int length)
+{
+    HASH_STATE h;
+    hash_init(&h);
+    hash_update(&h, record, SHARD_HASHED);
+    hash_update(&h, data, length);
+    return hash_digest(&h);
+}
+
+/**
+ * @brief Байты данных, которые помещаются в изображение вместе с заголовком фрагмента.
+ *
+ * @param filename Изображение BMP или PNG (читается только заголовок).
+ * @return Емкость в байтах (0, если не помещается даже заголовок) или -1 при ошибке.
+ */
+long long shard_capacity(const char *filename)
+{
+    BMP_HEADER header;
+    if (!read_bmp_header(filename, &header))
+        return -1;
+    long long capacity = bmp_pixel_count(&header) * bmp_channels(&header) / 8 - SHARD_HEADER_SIZE;
+    if (capacity > UINT_MAX)
+        capacity = UINT_MAX;
+    return capacity > 0 ? capacity : 0;
+}
+
+/**
+ * @brief Проверяет, что запись из size байт помещается в младшие биты каналов изображения.
+ */
+static int shard_fits(const BMP_FORMAT *format, long long size)
+{
+    int lanes[3];
+    int laneCount = stegano_lanes(format, STEGANO_MASK_ALL, lanes);
+    return (size * 8 + laneCount - 1) / laneCount <= (long long)format->width * format->height;
+}
+
+/**
+ * @brief Задание пула при разбиении: встраивает фрагмент в носитель и сохраняет результат.
+ */
+static void shard_split_job(const char *item, void *arg)
+{
+    SHARD_CTX *ctx = arg;
+    SHARD_JOB *job = &ctx->jobs[atoi(item)];
+    size_t size = SHARD_HEADER_SIZE + (size_t)job->header.length;
+    unsigned char *record = malloc(size);
+    if (!record)
+    {
+        printf("Error: Not enough memory for shard %d\n", job->header.index);
+        stats_error(STAT_ERR_MEMORY);
+        return;
+    }
+
+    const unsigned char *data = ctx->payload + job->header.offset;
+    shard_encode_header(record, &job->header);
+    memcpy(record + SHARD_HEADER_SIZE, data, job->header.length);
+    put_le(record + SHARD_HASHED, shard_record_hash(record, data, job->header.length), 8);
+
+    BMP_FILE bmp;
+    if (bmp_load(job->input, &bmp, 0))
+    {
+        if (!shard_fits(&bmp.format, (long long)size))
+        {
+            printf("Error: Shard %d does not fit %s\n", job->header.index, job->input);
+            stats_error(STAT_ERR_CAPACITY);
+        }
+        else if (bmp_prepare_output(&bmp, job->output))
+        {
+            STATS_SPAN span;
+            stats_kernel_start(&span);
+            stegano_embed_format(&bmp.format, bmp.pixels, (const char *)record, size, 1, STEGANO_MASK_ALL, NULL);
+            stats_kernel_stop(STAT_EMBED, &span);
+            job->ok = bmp_save(job->output, &bmp);
+        }
+        bmp_free(&bmp);
+    }
+    free(record);
+}
+
+/**
+ * @brief Возвращает имя файла без каталогов.
+ */
+static const char *shard_basename(const char *path)
+{
+    const char *name = path;
+    for (const char *p = path; *p; p++)
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    return name;
+}
+
+/**
+ * @brief Читает файл целиком.
+ */
+static unsigned char *shard_read_file(const char *filename, long long *size)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Error: Cannot open payload file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *data = *size > 0 ? malloc((size_t)*size) : NULL;
+    if (!data || fread(data, 1, (size_t)*size, file) != (size_t)*size)
+    {
+        printf(*size > 0 ? "Error: Cannot read payload file %s\n" : "Error: Payload file %s is empty\n", filename);
+        stats_error(*size > 0 ? STAT_ERR_IO : STAT_ERR_PAYLOAD);
+        free(data);
+        data = NULL;
+    }
+    else
+        stats_add(STAT_BYTES_READ, (unsigned long long)*size);
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Делит файл между носителями пропорционально их емкости и параллельно встраивает фрагменты.
+ *
+ * Результат для носителя "путь/имя" сохраняется в "outputDir/имя" в том же формате; каталог
+ * создается, если его нет.
+ * Носители, которым не досталось данных (файл меньше числа носителей), пропускаются.
+ *
+ * @param passphrase Пароль: файл целиком шифруется aead_seal до разбиения (NULL - без шифрования).
+ * @param threads Количество рабочих потоков (0 - по числу процессоров).
+ * @return 1 если все фрагменты записаны, 0 при ошибке.
+ */
+int shard_split(const char *payloadFilename, const char *outputDir, char *const *carriers, int count,
+                const char *passphrase, int threads, SHARD_RESULT *result)
+{
+    memset(result, 0, sizeof(*result));
+    long long payloadSize;
+    unsigned char *payload = shard_read_file(payloadFilename, &payloadSize);
+    if (!payload)
+        return 0;
+    result->payloadSize = payloadSize;
+    if (passphrase)
+    {
+        size_t sealedSize;
+        unsigned char *sealed = aead_seal(passphrase, payload, (size_t)payloadSize, &sealedSize);
+        free(payload);
+        if (!sealed)
+            return 0;
+        payload = sealed;
+        payloadSize = (long long)sealedSize;
+    }
+
+    SHARD_JOB *jobs = calloc(count, sizeof(SHARD_JOB));
+    long long *capacity = calloc(count, sizeof(long long));
+    long long total = 0;
+    int ok = jobs && capacity;
+    for (int i = 0; ok && i < count; i++)
+    {
+        for (int j = 0; j < i; j++)
+            if (strcmp(shard_basename(carriers[i]), shard_basename(carriers[j])) == 0)
+            {
+                printf("Error: Carriers %s and %s would be saved to the same file\n", carriers[j], carriers[i]);
+                stats_error(STAT_ERR_OTHER);
+                ok = 0;
+            }
+        capacity[i] = ok ? shard_capacity(carriers[i]) : -1;
+        if (ok && capacity[i] < 0)
+        {
+            printf("Error: Cannot read image %s\n", carriers[i]);
+            stats_error(STAT_ERR_FORMAT);
+            ok = 0;
+        }
+        total += ok ? capacity[i] : 0;
+    }
+    if (ok && payloadSize > total)
+    {
+        printf("Error: Payload of %lld bytes exceeds the total capacity of the carriers (%lld bytes)\n", payloadSize,
+               total);
+        stats_error(STAT_ERR_CAPACITY);
+        ok = 0;
+    }
+
+    // доли пропорциональны емкости; остаток от округления - первым носителям со свободным местом
+    long long assigned = 0;
+    for (int i = 0; ok && i < count; i++)
+    {
+        long long share = (long long)((long double)payloadSize * capacity[i] / total);
+        jobs[i].header.length = (unsigned int)(share < capacity[i] ? share : capacity[i]);
+        assigned += jobs[i].header.length;
+    }
+    for (int i = 0; ok && i < count && assigned < payloadSize; i++)
+    {
+        long long extra = capacity[i] - jobs[i].header.length;
+        if (extra > payloadSize - assigned)
+            extra = payloadSize - assigned;
+        jobs[i].header.length += (unsigned int)extra;
+        assigned += extra;
+    }
+
+    int shards = 0;
+    unsigned long long offset = 0, payloadId = ok ? hash_bytes(payload, (size_t)payloadSize) : 0;
+    for (int i = 0; ok && i < count; i++)
+        shards += jobs[i].header.length > 0;
+    if (ok && shards > SHARD_MAX)
+    {
+        printf("Error: At most %d shards are supported\n", SHARD_MAX);
+        stats_error(STAT_ERR_OTHER);
+        ok = 0;
+    }
+
+    if (ok)
+        shard_mkdir(outputDir); // уже существующий каталог - не ошибка, ошибки записи сообщит bmp_save
+
+    SHARD_CTX ctx = {jobs, payload};
+    POOL *pool = ok ? pool_start(threads, shard_split_job, &ctx) : NULL;
+    for (int i = 0, index = 0; pool && i < count; i++)
+    {
+        SHARD_JOB *job = &jobs[i];
+        if (job->header.length == 0)
+        {
+            result->skipped++;
+            continue;
+        }
+        job->input = carriers[i];
+        job->output = malloc(strlen(outputDir) + strlen(shard_basename(carriers[i])) + 2);
+        if (!job->output)
+            continue;
+        sprintf(job->output, "%s/%s", outputDir, shard_basename(carriers[i]));
+        unsigned int length = job->header.length;
+        job->header = (SHARD_HEADER){payloadId, (unsigned long long)payloadSize, index++, shards, offset, length};
+        offset += length;
+
+        char item[16];
+        snprintf(item, sizeof(item), "%d", i);
+        pool_push(pool, strdup(item));
+    }
+    if (pool)
+        pool_finish(pool);
+    ok = ok && pool;
+
+    for (int i = 0; ok && i < count; i++)
+    {
+        if (jobs[i].header.length > 0 && !jobs[i].ok)
+            ok = 0;
+    }
+    result->shards = ok ? shards : 0;
+
+    for (int i = 0; jobs && i < count; i++)
+        free(jobs[i].output);
+    free(jobs);
+    free(capacity);
+    free(payload);
+    return ok;
+}
+
+/**
+ * @brief Задание пула при сборке: извлекает и проверяет фрагмент изображения.
+ */
+static void shard_join_job(const char *item, void *arg)
+{
+    SHARD_CTX *ctx = arg;
+    SHARD_JOB *job = &ctx->jobs[atoi(item)];
+    BMP_FILE bmp;
+    if (!bmp_load(job->input, &bmp, 0))
+        return;
+
+    unsigned char head[SHARD_HEADER_SIZE];
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    int ok = shard_fits(&bmp.format, SHARD_HEADER_SIZE);
+    if (ok)
+    {
+        memset(head, 0, sizeof(head));
+        stegano_extract_format(&bmp.format, bmp.pixels, (char *)head, SHARD_HEADER_SIZE, 1, STEGANO_MASK_ALL);
+        ok = shard_decode_header(head, &job->header) &&
+             shard_fits(&bmp.format, SHARD_HEADER_SIZE + (long long)job->header.length);
+    }
+
+    size_t size = SHARD_HEADER_SIZE + (size_t)(ok ? job->header.length : 0);
+    unsigned char *record = ok ? calloc(size, 1) : NULL;
+    if (record)
+    {
+        stegano_extract_format(&bmp.format, bmp.pixels, (char *)record, size, 1, STEGANO_MASK_ALL);
+        const unsigned char *data = record + SHARD_HEADER_SIZE;
+        if (shard_record_hash(record, data, job->header.length) == get_le(record + SHARD_HASHED, 8))
+        {
+            job->data = malloc(job->header.length + 1);
+            if (job->data)
+            {
+                memcpy(job->data, data, job->header.length);
+                job->ok = 1;
+            }
+        }
+        free(record);
+    }
+    stats_kernel_stop(STAT_EXTRACT, &span);
+    bmp_free(&bmp);
+}
+
+/**
+ * @brief Параллельно извлекает фрагменты из изображений, переданных в любом порядке, и собирает файл.
+ *
+ * Изображения без фрагмента или с поврежденным фрагментом пропускаются; файл собирается, если
+ * нашлись все фрагменты, и сохраняется только при совпадении его XXH64 с идентификатором.
+ * Проверочных фрагментов нет (фрагменты не кодируются кодом Рида-Соломона, см. ecc.c):
+ * поврежденный фрагмент обнаруживается по XXH64, но не восстанавливается.
+ *
+ * @param passphrase Пароль, если файл зашифрован при разбиении (NULL - без шифрования); файл
+ * сохраняется, только если тег Poly1305 совпал.
+ * @param threads Количество рабочих потоков (0 - по числу процессоров).
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int shard_join(const char *outputFilename, char *const *images, int count, const char *passphrase, int threads,
+               SHARD_RESULT *result)
+{
+    memset(result, 0, sizeof(*result));
+    SHARD_JOB *jobs = calloc(count, sizeof(SHARD_JOB));
+    SHARD_CTX ctx = {jobs, NULL};
+    POOL *pool = jobs ? pool_start(threads, shard_join_job, &ctx) : NULL;
+    if (!pool)
+    {
+        free(jobs);
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        char item[16];
+        jobs[i].input = images[i];
+        snprintf(item, sizeof(item), "%d", i);
+        pool_push(pool, strdup(item));
+    }
+    pool_finish(pool);
+
+    // собирается файл первого корректного фрагмента; фрагменты других файлов пропускаются
+    const SHARD_HEADER *first = NULL;
+    for (int i = 0; i < count && !first; i++)
+        if (jobs[i].ok)
+            first = &jobs[i].header;
+
+    unsigned char *payload = NULL, *have = NULL;
+    int ok = first != NULL;
+    if (!ok)
+    {
+        printf("Error: No valid shards found\n");
+        stats_error(STAT_ERR_PAYLOAD);
+    }
+    else
+    {
+        result->payloadSize = (long long)first->payloadSize;
+        payload = malloc(first->payloadSize ? (size_t)first->payloadSize : 1);
+        have = calloc(first->count, 1);
+        ok = payload && have;
+        if (!ok)
+        {
+            printf("Error: Not enough memory to join %llu bytes\n", first->payloadSize);
+            stats_error(STAT_ERR_MEMORY);
+        }
+    }
+
+    for (int i = 0; ok && i < count; i++)
+    {
+        const SHARD_HEADER *h = &jobs[i].header;
+        if (!jobs[i].ok || h->payloadId != first->payloadId || h->payloadSize != first->payloadSize ||
+            h->count != first->count || have[h->index])
+        {
+            if (!jobs[i].ok)
+                printf("Warning: %s does not contain a valid shard\n", images[i]);
+            else if (h->payloadId != first->payloadId)
+                printf("Warning: %s holds a shard of another payload (%016llx)\n", images[i], h->payloadId);
+            result->skipped++;
+            continue;
+        }
+        memcpy(payload + h->offset, jobs[i].data, h->length);
+        have[h->index] = 1;
+        result->shards++;
+    }
+
+    if (ok && result->shards < first->count)
+    {
+        printf("Error: %d of %d shards missing:", first->count - result->shards, first->count);
+        for (int i = 0; i < first->count; i++)
+            if (!have[i])
+                printf(" %d", i + 1);
+        printf("\n");
+        stats_error(STAT_ERR_PAYLOAD);
+        ok = 0;
+    }
+    if (ok && hash_bytes(payload, (size_t)first->payloadSize) != first->payloadId)
+    {
+        printf("Error: Joined payload does not match its XXH64 %016llx\n", first->payloadId);
+        stats_error(STAT_ERR_PAYLOAD);
+        ok = 0;
+    }
+
+    size_t outputSize = ok ? (size_t)first->payloadSize : 0;
+    if (ok && passphrase)
+    {
+        unsigned char *plain = aead_open(passphrase, payload, outputSize, &outputSize);
+        free(payload);
+        payload = plain;
+        ok = plain != NULL;
+        result->payloadSize = (long long)outputSize;
+    }
+
+    if (ok)
+    {
+        long long t = stats_start();
+        FILE *file = fopen(outputFilename, "wb");
+        ok = file && fwrite(payload, 1, outputSize, file) == outputSize;
+        if (file && fclose(file) != 0)
+            ok = 0;
+        if (!ok)
+        {
+            printf("Error: Cannot write %s\n", outputFilename);
+            stats_error(STAT_ERR_IO);
+            remove(outputFilename);
+        }
+        else
+        {
+            stats_add(STAT_BYTES_WRITTEN, outputSize);
+            stats_stop(STAT_SAVE, t);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        free(jobs[i].data);
+    free(jobs);
+    free(payload);
+    free(have);
+    return ok;
+}
+
+/**
+ * @brief Команда shard: разбиение файла на фрагменты в нескольких изображениях и сборка.
+ *
+ * Использование: shard split <файл> <каталог> <носитель>... [--threads N] [--passphrase-file файл]
+ *                shard join <файл> <изображение>... [--threads N] [--passphrase-file файл]
+ */
+int shard(int argc, char *argv[])
+{
+    int threads = 0, count = 0;
+    const char *passphraseFile = NULL;
+    char **files = argc > 0 ? malloc(argc * sizeof(char *)) : NULL;
+    for (int i = 1; files && i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--passphrase-file") == 0 && i + 1 < argc)
+            passphraseFile = argv[++i];
+        else
+            files[count++] = argv[i];
+    }
+
+    int split = argc > 0 && strcmp(argv[0], "split") == 0 && count >= 3;
+    int join = argc > 0 && strcmp(argv[0], "join") == 0 && count >= 2;
+    if (!split && !join)
+    {
+        printf("Usage: shard split <payload> <output dir> <carrier>... [--threads N] [--passphrase-file file]\n"
+               "       shard join <payload> <image>... [--threads N] [--passphrase-file file]\n");
+        free(files);
+        return 1;
+    }
+
+    // пароль команды или глобального --passphrase-file
+    char *passphrase = NULL;
+    if (passphraseFile ? !(passphrase = aead_read_passphrase(passphraseFile))
+                       : aead_passphrase() && !(passphrase = strdup(aead_passphrase())))
+    {
+        free(files);
+        return 1;
+    }
+
+    SHARD_RESULT result;
+    int ok;
+    if (split)
+    {
+        ok = shard_split(files[0], files[1], files + 2, count - 2, passphrase, threads, &result);
+        if (ok)
+            printf("Split %lld bytes of %s into %d shards in %s", result.payloadSize, files[0], result.shards,
+                   files[1]);
+    }
+    else
+    {
+        ok = shard_join(files[0], files + 1, count - 1, passphrase, threads, &result);
+        if (ok)
+            printf("Joined %d shards into %s: %lld bytes, XXH64%s verified", result.shards, files[0],
+                   result.payloadSize, passphrase ? " and Poly1305 tag" : "");
+    }
+    if (ok)
+        printf(result.skipped ? " (%d images skipped)\n" : "\n", result.skipped);
+    free(passphrase);
+    free(files);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+// Фрагмент занимает младший бит каналов B, G, R каждого пикселя (как стеганография с шагом 1
+// и маской BGR) и начинается с заголовка: метка, идентификатор (XXH64) и размер всего файла,
+// номер фрагмента и их количество (по 16 бит), смещение и длина фрагмента в файле, XXH64
+// заголовка и данных фрагмента; все числа little-endian
+#define SHARD_MAGIC "SHD1"
+#define SHARD_HEADER_SIZE 44
+#define SHARD_MAX 65535
+
+// Заголовок фрагмента
+typedef struct
+{
+    unsigned long long payloadId;   // XXH64 всего файла
+    unsigned long long payloadSize; // размер всего файла
+    int index, count;               // номер фрагмента (с 0) и количество фрагментов
+    unsigned long long offset;      // смещение фрагмента в файле
+    unsigned int length;            // длина фрагмента
+} SHARD_HEADER;
+
+typedef struct
+{
+    long long payloadSize;
+    int shards;  // записанные или прочитанные фрагменты
+    int skipped; // носители без фрагмента: не хватило данных или изображение не содержит фрагмента
+} SHARD_RESULT;
+
+long long shard_capacity(const char *filename);
+int shard_split(const char *payloadFilename, const char *outputDir, char *const *carriers, int count,
+                const char *passphrase, int threads, SHARD_RESULT *result);
+int shard_join(const char *outputFilename, char *const *images, int count, const char *passphrase, int threads,
+               SHARD_RESULT *result);
+int shard(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
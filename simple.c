@@ -1,225 +1,370 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdint.h>
-
-#pragma pack(push, 1)
-typedef struct
-{
-    uint16_t type;
-    uint32_t size;
-    uint16_t reserved1;
-    uint16_t reserved2;
-    uint32_t offset;
-} BMPHeader;
-
-typedef struct
-{
-    uint32_t size;
-    int32_t width;
-    int32_t height;
-    uint16_t planes;
-    uint16_t bitCount;
-    uint32_t compression;
-    uint32_t imageSize;
-    int32_t xPixelsPerMeter;
-    int32_t yPixelsPerMeter;
-    uint32_t colorsUsed;
-    uint32_t colorsImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-/**
- * load - Загружает BMP изображение из файла.
- * @param filename: Имя файла изображения.
- * @param imageData: Указатель на указатель, куда будет сохранена выделенная память под данные изображения.
- * @param header: Указатель на структуру BMPHeader для хранения заголовка файла.
- * @param infoHeader: Указатель на структуру BMPInfoHeader для хранения информации о изображении.
- *
- * Возвращает размер изображения в байтах при успешной загрузке, 0 при ошибке.
- */
-int load(const char *filename, unsigned char **imageData, BMPHeader *header, BMPInfoHeader *infoHeader)
-{
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-    {
-        printf("Error: Cannot open image file %s\n", filename);
-        return 0;
-    }
-
-    fread(header, sizeof(BMPHeader), 1, file);
-    fread(infoHeader, sizeof(BMPInfoHeader), 1, file);
-
-    if (header->type != 0x4D42 || infoHeader->bitCount != 24)
-    {
-        printf("Error: Only 24-bit BMP files are supported\n");
-        fclose(file);
-        return 0;
-    }
-
-    fseek(file, header->offset, SEEK_SET);
-    int imageSize = infoHeader->width * abs(infoHeader->height) * 3;
-    *imageData = (unsigned char *)malloc(imageSize);
-    fread(*imageData, 1, imageSize, file);
-
-    fclose(file);
-
-    return imageSize;
-}
-
-/**
- * saveBMP - Сохраняет изображение в файл BMP.
- * @param filename: Имя файла для сохранения изображения.
- * @param imageData: Указатель на данные изображения.
- * @param header: Указатель на структуру BMPHeader с заголовком файла.
- * @param infoHeader: Указатель на структуру BMPInfoHeader с информацией об изображении.
- *
- * Возвращает 1 при успешном сохранении, 0 при ошибке.
- */
-int saveBMP(const char *filename, unsigned char *imageData, BMPHeader *header, BMPInfoHeader *infoHeader)
-{
-    FILE *file = fopen(filename, "wb");
-    if (!file)
-    {
-        printf("Error: Cannot create output file %s\n", filename);
-        return 0;
-    }
-    fwrite(header, sizeof(BMPHeader), 1, file);
-    fwrite(infoHeader, sizeof(BMPInfoHeader), 1, file);
-
-    fseek(file, header->offset, SEEK_SET);
-    int imageSize = infoHeader->width * abs(infoHeader->height) * 3;
-    fwrite(imageData, 1, imageSize, file);
-    fclose(file);
-    return 1;
-}
-
-/**
- * encryptText - Встраивает текст в изображение с помощью метода LSB (младших бит).
- * @param imageData: Массив байтов данных изображения, в который будет встроен текст.
- * @param text: Строка текста для скрытия.
- * @param imageSize: Размер данных изображения в байтах.
- */
-void encryptText(unsigned char *imageData, const char *text, int imageSize)
-{
-    int textLen = strlen(text);
-    int bitIndex = 0;
-
-    for (int i = 0; i < 32; i++)
-    {
-        if (bitIndex >= imageSize)
-            break;
-        imageData[bitIndex] = (imageData[bitIndex] & 0xFE) | ((textLen >> (31 - i)) & 1);
-        bitIndex++;
-    }
-
-    for (int i = 0; i < textLen; i++)
-    {
-        for (int j = 7; j >= 0; j--)
-        {
-            if (bitIndex >= imageSize)
-                return;
-            imageData[bitIndex] = (imageData[bitIndex] & 0xFE) | ((text[i] >> j) & 1);
-            bitIndex++;
-        }
-    }
-}
-
-/**
- * simple - Основная функция для шифрования текста в BMP изображение и сохранения ключа.
- *
- * Выполняет:
- * - Запрос пути к изображению у пользователя
- * - Загрузку изображения
- * - Ввод текста для скрытия
- * - Встраивание текста в изображение
- * - Сохранение измененного изображения
- * - Создание файла ключа с информацией о длине текста и размере изображения
- *
- * Возвращает 0 при успешной работе или 1 при ошибках.
- */
-int simple()
-{
-    FILE *file, *keyFile, *outputFile;
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char *imageData;
-    char filename[256], outputFilename[256], text[1000];
-
-    printf("\nBMP Image Text Encryption\n");
-    printf("=========================\n\n");
-
-    printf("Enter BMP filename: ");
-    scanf("%s", filename);
-
-    file = fopen(filename, "rb");
-    if (!file)
-    {
-        printf("Error: Cannot open file %s\n", filename);
-        return 1;
-    }
-
-    fread(&header, sizeof(BMPHeader), 1, file);
-    fread(&infoHeader, sizeof(BMPInfoHeader), 1, file);
-
-    if (header.type != 0x4D42) // 'BM'
-    {
-        printf("Error: Not a valid BMP file\n");
-        fclose(file);
-        return 1;
-    }
-
-    if (infoHeader.bitCount != 24)
-    {
-        printf("Error: Only 24-bit BMP files are supported\n");
-        fclose(file);
-        return 1;
-    }
-
-    int imageSize = load(filename, &imageData, &header, &infoHeader);
-
-    if (!imageSize)
-        return 1;
-
-    int maxChars = (imageSize - 32) / 8;
-    printf("\nImage loaded successfully!\n");
-    printf("Maximum characters that can be hidden: %d\n\n", maxChars);
-    printf("Enter text to encrypt (max %d characters): ", maxChars);
-
-    scanf(" %[^\n]", text);
-
-    if (strlen(text) > maxChars)
-    {
-        printf("Error: Text too long! Maximum %d characters allowed.\n", maxChars);
-        free(imageData);
-        return 1;
-    }
-
-    printf("Enter output filename: ");
-    scanf("%s", outputFilename);
-
-    outputFile = fopen(outputFilename, "wb");
-
-    encryptText(imageData, text, imageSize);
-
-    if (saveBMP(outputFilename, imageData, &header, &infoHeader))
-    {
-        keyFile = fopen("simple_key", "w");
-        if (keyFile)
-        {
-            fprintf(keyFile, "TEXT_LENGTH: %d\n", (int)strlen(text));
-            fprintf(keyFile, "IMAGE_SIZE: %d\n", imageSize);
-            fclose(keyFile);
-            printf("\nImage saved as %s\n", outputFilename);
-            printf("Key information saved to 'simple_key' file.\n");
-        }
-        else
-        {
-            printf("Warning: Could not save key file!\n");
-        }
-    }
-
-    free(imageData);
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+#include "stats.h"
+#include "stegano.h"
+#include "stream.h"
+#include "aead.h"
+#include "simple.h"
+
+/**
+ * sampleOffset - Смещение index-го байта каналов в пиксельных данных.
+ *
+ * У 24- и 8-битных изображений байты идут подряд, как в файле; у 32-битных k-й байт -
+ * канал B, G или R (по k % 3) пикселя k / 3, байт альфа-канала пропускается.
+ */
+static inline int sampleOffset(int bytesPerPixel, const int *lane, int index)
+{
+    return bytesPerPixel == 4 ? index / 3 * 4 + lane[index % 3] : index;
+}
+
+/**
+ * embedSamples - Встраивает префикс длины и текст в младшие биты последовательных байтов каналов.
+ *
+ * Префикс всегда занимает младший бит первых 32 байтов, текст - по depth младших бит
+ * следующих байтов: биты символов идут от старшего к младшему, первый бит группы
+ * попадает в старший из depth бит. При depth 1, 2 и 4 символ занимает ровно 8 / depth
+ * байтов, при depth 3 три символа занимают 8 байтов.
+ * Вызывается с константными bytesPerPixel и depth, поэтому для каждого формата
+ * пикселей и глубины компилятор строит отдельное ядро.
+ */
+static inline void embedSamples(unsigned char *imageData, int bytesPerPixel, const int *lane, const char *text,
+                                int textLen, int imageSize, int depth)
+{
+    unsigned int prefix = simplePrefix(textLen, depth);
+    int bitIndex = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (bitIndex >= imageSize)
+            break;
+        unsigned char *sample = &imageData[sampleOffset(bytesPerPixel, lane, bitIndex)];
+        *sample = (*sample & 0xFE) | ((prefix >> (31 - i)) & 1);
+        bitIndex++;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)text;
+    const unsigned char keep = (unsigned char)(0xFF << depth);
+    const unsigned char mask = (unsigned char)~keep;
+
+    if (depth == 3)
+    {
+        for (int i = 0; i < textLen; i += 3)
+        {
+            unsigned int group = bytes[i] << 16 | (i + 1 < textLen ? bytes[i + 1] << 8 : 0) |
+                                 (i + 2 < textLen ? bytes[i + 2] : 0);
+            int samples = i + 3 <= textLen ? 8 : ((textLen - i) * 8 + 2) / 3;
+            for (int j = 0; j < samples; j++)
+            {
+                if (bitIndex >= imageSize)
+                    return;
+                unsigned char *sample = &imageData[sampleOffset(bytesPerPixel, lane, bitIndex)];
+                *sample = (*sample & keep) | ((group >> (21 - 3 * j)) & mask);
+                bitIndex++;
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < textLen; i++)
+    {
+        for (int j = 8 - depth; j >= 0; j -= depth)
+        {
+            if (bitIndex >= imageSize)
+                return;
+            unsigned char *sample = &imageData[sampleOffset(bytesPerPixel, lane, bitIndex)];
+            *sample = (*sample & keep) | ((bytes[i] >> j) & mask);
+            bitIndex++;
+        }
+    }
+}
+
+/**
+ * encryptText - Встраивает текст в изображение с помощью метода LSB (младших бит).
+ * @param imageData: Массив байтов данных изображения, в который будет встроен текст.
+ * @param text: Строка текста для скрытия.
+ * @param imageSize: Размер данных изображения в байтах.
+ */
+void encryptText(unsigned char *imageData, const char *text, int imageSize)
+{
+    embedSamples(imageData, 1, NULL, text, (int)strlen(text), imageSize, 1);
+}
+
+/**
+ * embedFormat - Выбирает ядро по формату пикселей для константной глубины.
+ */
+static inline void embedFormat(const BMP_FORMAT *format, unsigned char *imageData, const char *text, int textLen,
+                               int imageSize, int depth)
+{
+    if (format->bytesPerPixel == 4)
+    {
+        int lane[3] = {format->offset[2], format->offset[1], format->offset[0]}; // B, G, R
+        embedSamples(imageData, 4, lane, text, textLen, imageSize, depth);
+    }
+    else
+        embedSamples(imageData, 1, NULL, text, textLen, imageSize, depth);
+}
+
+/**
+ * encryptPixels - Встраивает текст в изображение любого поддерживаемого формата.
+ * @param format: Формат пикселей.
+ * @param imageData: Пиксельные данные в порядке хранения.
+ * @param text: Строка текста для скрытия.
+ * @param imageSize: Количество байтов каналов: ширина * высота * format->channels.
+ * @param depth: Количество младших бит каждого байта канала, занимаемых текстом (1..SIMPLE_MAX_DEPTH).
+ */
+void encryptPixels(const BMP_FORMAT *format, unsigned char *imageData, const char *text, int imageSize, int depth)
+{
+    encryptBytes(format, imageData, (const unsigned char *)text, (int)strlen(text), imageSize, depth);
+}
+
+/**
+ * encryptBytes - Встраивает len байтов (в том числе нулевых) с префиксом длины.
+ * @param format: Формат пикселей.
+ * @param imageData: Пиксельные данные в порядке хранения.
+ * @param bytes: Встраиваемые байты, например сообщение с кодом Рида-Соломона (см. ecc.c).
+ * @param len: Количество байтов.
+ * @param imageSize: Количество байтов каналов: ширина * высота * format->channels.
+ * @param depth: Количество младших бит каждого байта канала, занимаемых текстом (1..SIMPLE_MAX_DEPTH).
+ */
+void encryptBytes(const BMP_FORMAT *format, unsigned char *imageData, const unsigned char *bytes, int len,
+                  int imageSize, int depth)
+{
+    const char *text = (const char *)bytes;
+    switch (depth)
+    {
+    case 2:
+        embedFormat(format, imageData, text, len, imageSize, 2);
+        break;
+    case 3:
+        embedFormat(format, imageData, text, len, imageSize, 3);
+        break;
+    case 4:
+        embedFormat(format, imageData, text, len, imageSize, 4);
+        break;
+    default:
+        embedFormat(format, imageData, text, len, imageSize, 1);
+        break;
+    }
+}
+
+/**
+ * simplePrefix - Значение 32-битного префикса: длина текста и глубина встраивания.
+ * @param textLen: Длина текста.
+ * @param depth: Глубина встраивания.
+ */
+unsigned int simplePrefix(int textLen, int depth)
+{
+    return (unsigned int)(depth - 1) << SIMPLE_DEPTH_SHIFT | ((unsigned int)textLen & SIMPLE_LEN_MASK);
+}
+
+/**
+ * simpleSamples - Количество байтов каналов, занимаемых префиксом и текстом.
+ * @param textLen: Длина текста.
+ * @param depth: Глубина встраивания.
+ */
+int simpleSamples(int textLen, int depth)
+{
+    return 32 + (8 * textLen + depth - 1) / depth;
+}
+
+/**
+ * saveSimpleKey - Сохраняет файл ключа с информацией о длине текста и размере изображения.
+ * @param keyFilename: Имя файла ключа.
+ * @param textLen: Длина скрытого текста.
+ * @param imageSize: Размер данных изображения в байтах.
+ *
+ * Возвращает 1 при успешном сохранении, 0 при ошибке.
+ */
+int saveSimpleKey(const char *keyFilename, int textLen, int imageSize)
+{
+    long long t = stats_start();
+    FILE *keyFile = fopen(keyFilename, "w");
+    if (!keyFile)
+    {
+        printf("Warning: Could not save key file!\n");
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    fprintf(keyFile, "TEXT_LENGTH: %d\n", textLen);
+    fprintf(keyFile, "IMAGE_SIZE: %d\n", imageSize);
+    stats_add(STAT_BYTES_WRITTEN, ftell(keyFile));
+    fclose(keyFile);
+    stats_stop(STAT_KEY, t);
+    return 1;
+}
+
+/**
+ * simpleEmbedImage - Встраивает текст в загруженное изображение.
+ * @param bmp: Изображение, загруженное bmp_load со строками как в файле.
+ * @param text: Текст для скрытия.
+ * @param depth: Количество младших бит каждого байта канала, занимаемых текстом (1..SIMPLE_MAX_DEPTH).
+ * @param dist: Накопитель метрик искажения или NULL, если метрики не нужны.
+ *
+ * Возвращает размер данных изображения в байтах при успешной работе, 0 если глубина
+ * некорректна или текст не помещается.
+ */
+int simpleEmbedImage(BMP_FILE *bmp, const char *text, int depth, DISTORTION *dist)
+{
+    return simpleEmbedBytes(bmp, (const unsigned char *)text, (int)strlen(text), depth, dist);
+}
+
+/**
+ * simpleEmbedBytes - Встраивает len байтов (в том числе нулевых) в загруженное изображение.
+ *
+ * Возвращает размер данных изображения в байтах при успешной работе, 0 при ошибке.
+ */
+int simpleEmbedBytes(BMP_FILE *bmp, const unsigned char *bytes, int len, int depth, DISTORTION *dist)
+{
+    if (depth < 1 || depth > SIMPLE_MAX_DEPTH)
+    {
+        printf("Error: Bit depth must be between 1 and %d\n", SIMPLE_MAX_DEPTH);
+        stats_error(STAT_ERR_OTHER);
+        return 0;
+    }
+
+    const BMP_FORMAT *format = &bmp->format;
+    int imageSize = format->width * format->height * format->channels;
+    int maxChars = imageSize > 32 ? (int)((long long)(imageSize - 32) * depth / 8) : 0;
+    if (len > maxChars)
+    {
+        printf("Error: Text too long! Maximum %d characters allowed.\n", maxChars);
+        stats_error(STAT_ERR_CAPACITY);
+        return 0;
+    }
+
+    // изменяются только первые simpleSamples(len, depth) байт, поэтому для метрик копируется лишь
+    // эта часть; метрики считаются только для 24-битных изображений
+    int touched = simpleSamples(len, depth);
+    unsigned char *original = dist && format->bytesPerPixel == 3 ? malloc(touched) : NULL;
+    if (original)
+        memcpy(original, bmp->pixels, touched);
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    encryptBytes(format, bmp->pixels, bytes, len, imageSize, depth);
+    stats_kernel_stop(STAT_EMBED, &span);
+    stats_add(STAT_PIXELS, (touched + format->channels - 1) / format->channels);
+    stats_add(STAT_PAYLOAD, len);
+
+    if (original)
+    {
+        distortion_rows(dist, original, bmp->pixels, touched, format->rowSize, format->width, 0);
+        dist->samples = imageSize;
+        free(original);
+    }
+    return imageSize;
+}
+
+/**
+ * simple_encode - Встраивает текст в BMP изображение и сохраняет результат (без диалога с пользователем).
+ * @param filename: Имя исходного файла изображения.
+ * @param outputFilename: Имя файла для сохранения результата.
+ * @param text: Текст для скрытия.
+ * @param depth: Количество младших бит каждого байта канала, занимаемых текстом (1..SIMPLE_MAX_DEPTH).
+ * @param dist: Накопитель метрик искажения или NULL, если метрики не нужны.
+ *
+ * Возвращает размер данных изображения в байтах при успешной работе, 0 при ошибке.
+ */
+int simple_encode(const char *filename, const char *outputFilename, const char *text, int depth, DISTORTION *dist)
+{
+    return simple_encode_bytes(filename, outputFilename, (const unsigned char *)text, (int)strlen(text), depth, dist);
+}
+
+/**
+ * simple_encode_bytes - Как simple_encode, но встраивает len байтов (в том числе нулевых).
+ * С пределом памяти (--max-memory) BMP обрабатывается окнами строк (stream_encode_file).
+ *
+ * Возвращает размер данных изображения в байтах при успешной работе, 0 при ошибке.
+ */
+int simple_encode_bytes(const char *filename, const char *outputFilename, const unsigned char *bytes, int len,
+                        int depth, DISTORTION *dist)
+{
+    if (stream_max_memory())
+        return stream_encode_file(filename, outputFilename, STREAM_SIMPLE, (const char *)bytes, (size_t)len, 1,
+                                  STEGANO_DEFAULT_MASK, depth, dist);
+
+    BMP_FILE bmp;
+    if (!bmp_load(filename, &bmp, 0))
+        return 0;
+
+    int imageSize = bmp_prepare_output(&bmp, outputFilename) ? simpleEmbedBytes(&bmp, bytes, len, depth, dist) : 0;
+    int saved = imageSize && bmp_save(outputFilename, &bmp);
+    bmp_free(&bmp);
+
+    return saved ? imageSize : 0;
+}
+
+/**
+ * simple - Основная функция для шифрования текста в BMP изображение и сохранения ключа.
+ *
+ * Выполняет:
+ * - Запрос пути к изображению у пользователя
+ * - Проверку заголовка изображения
+ * - Ввод текста для скрытия
+ * - Встраивание текста в изображение
+ * - Сохранение измененного изображения
+ * - Создание файла ключа с информацией о длине текста и размере изображения
+ *
+ * Возвращает 0 при успешной работе или 1 при ошибках.
+ */
+int simple()
+{
+    BMP_HEADER header;
+    char filename[256], outputFilename[256], text[1000];
+
+    printf("\nBMP Image Text Encryption\n");
+    printf("=========================\n\n");
+
+    printf("Enter BMP filename: ");
+    scanf("%s", filename);
+
+    if (!read_bmp_header(filename, &header))
+    {
+        printf("Error: Cannot open file %s or its BMP format is not supported\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+        return 1;
+    }
+
+    int imageSize = (int)(bmp_pixel_count(&header) * bmp_channels(&header));
+    int maxChars = (imageSize - 32) / 8;
+    printf("\nImage loaded successfully!\n");
+    printf("Maximum characters that can be hidden: %d\n\n", maxChars);
+    printf("Enter text to encrypt (max %d characters): ", maxChars);
+
+    scanf(" %999[^\n]", text);
+
+    // с глобальным --passphrase-file встраивается зашифрованное сообщение
+    const char *passphrase = aead_passphrase();
+    char *sealed = passphrase ? aead_seal_text(passphrase, text) : NULL;
+    if (passphrase && !sealed)
+        return 1;
+    const char *payload = sealed ? sealed : text;
+
+    if (strlen(payload) > maxChars)
+    {
+        printf("Error: Text too long! Maximum %d characters allowed%s.\n", maxChars,
+               sealed ? " (encrypted text is a third longer)" : "");
+        stats_error(STAT_ERR_CAPACITY);
+        free(sealed);
+        return 1;
+    }
+
+    printf("Enter output filename: ");
+    scanf("%s", outputFilename);
+
+    imageSize = simple_encode(filename, outputFilename, payload, 1, NULL);
+    int textLen = (int)strlen(payload);
+    free(sealed);
+    if (!imageSize)
+        return 1;
+
+    printf("\nImage saved as %s\n", outputFilename);
+    if (saveSimpleKey("simple_key", textLen, imageSize))
+        printf("Key information saved to 'simple_key' file.\n");
+
+    return 0;
+}
@@ -1,6 +1,27 @@
-#ifndef SIMPLE_H
-#define SIMPLE_H
-
-int simple();
-
+#ifndef SIMPLE_H
+#define SIMPLE_H
+
+#include "bmpinfo.h"
+#include "metrics.h"
+
+// Префикс сообщения занимает младший бит первых 32 байтов каналов: младшие 24 бита -
+// длина текста, биты 24-25 - глубина встраивания текста минус 1, старшие биты равны нулю
+#define SIMPLE_LEN_MASK 0x00FFFFFF
+#define SIMPLE_DEPTH_SHIFT 24
+#define SIMPLE_MAX_DEPTH 4
+
+void encryptText(unsigned char *imageData, const char *text, int imageSize);
+void encryptPixels(const BMP_FORMAT *format, unsigned char *imageData, const char *text, int imageSize, int depth);
+void encryptBytes(const BMP_FORMAT *format, unsigned char *imageData, const unsigned char *bytes, int len,
+                  int imageSize, int depth);
+unsigned int simplePrefix(int textLen, int depth);
+int simpleSamples(int textLen, int depth);
+int simpleEmbedImage(BMP_FILE *bmp, const char *text, int depth, DISTORTION *dist);
+int simpleEmbedBytes(BMP_FILE *bmp, const unsigned char *bytes, int len, int depth, DISTORTION *dist);
+int saveSimpleKey(const char *keyFilename, int textLen, int imageSize);
+int simple_encode(const char *filename, const char *outputFilename, const char *text, int depth, DISTORTION *dist);
+int simple_encode_bytes(const char *filename, const char *outputFilename, const unsigned char *bytes, int len,
+                        int depth, DISTORTION *dist);
+int simple();
+
 #endif
\ No newline at end of file
@@ -1,193 +1,378 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdint.h>
-
-#pragma pack(push, 1)
-typedef struct
-{
-    uint16_t type;
-    uint32_t size;
-    uint16_t reserved1;
-    uint16_t reserved2;
-    uint32_t offset;
-} BMPHeader;
-
-typedef struct
-{
-    uint32_t size;
-    int32_t width;
-    int32_t height;
-    uint16_t planes;
-    uint16_t bitCount;
-    uint32_t compression;
-    uint32_t imageSize;
-    int32_t xPixelsPerMeter;
-    int32_t yPixelsPerMeter;
-    uint32_t colorsUsed;
-    uint32_t colorsImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-/**
- * loadBMP - Загружает BMP изображение из файла.
- * @param filename: Имя файла изображения.
- * @param imageData: Указатель на указатель, куда будет сохранена выделенная память под данные изображения.
- * @param header: Указатель на структуру BMPHeader для хранения заголовка файла.
- * @param infoHeader: Указатель на структуру BMPInfoHeader для хранения информации об изображении.
- *
- * Возвращает размер изображения в байтах при успешной загрузке, 0 при ошибке.
- */
-int loadBMP(const char *filename, unsigned char **imageData, BMPHeader *header, BMPInfoHeader *infoHeader)
-{
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-    {
-        printf("Error: Cannot open image file %s\n", filename);
-        return 0;
-    }
-
-    fread(header, sizeof(BMPHeader), 1, file);
-    fread(infoHeader, sizeof(BMPInfoHeader), 1, file);
-
-    if (header->type != 0x4D42 || infoHeader->bitCount != 24)
-    {
-        printf("Error: Only 24-bit BMP files are supported\n");
-        fclose(file);
-        return 0;
-    }
-
-    fseek(file, header->offset, SEEK_SET);
-    int imageSize = infoHeader->width * abs(infoHeader->height) * 3;
-    *imageData = (unsigned char *)malloc(imageSize);
-    fread(*imageData, 1, imageSize, file);
-    fclose(file);
-    return imageSize;
-}
-
-/**
- * decryptText - Извлекает скрытый текст из данных изображения, закодированный методом LSB.
- * @param imageData: Массив байтов данных изображения с встроенным текстом.
- * @param imageSize: Размер данных изображения в байтах.
- *
- * Возвращает указатель на строку с извлеченным текстом или NULL при ошибке.
- */
-char *decryptText(unsigned char *imageData, int imageSize)
-{
-    int bitIndex = 0;
-    int textLen = 0;
-
-    for (int i = 0; i < 32; i++)
-    {
-        if (bitIndex >= imageSize)
-            break;
-        textLen = (textLen << 1) | (imageData[bitIndex] & 1);
-        bitIndex++;
-    }
-
-    if (textLen <= 0 || textLen > 1000)
-    {
-        printf("Error: Invalid text length detected: %d\n", textLen);
-        return NULL;
-    }
-
-    char *text = (char *)malloc(textLen + 1);
-    text[textLen] = '\0';
-
-    for (int i = 0; i < textLen; i++)
-    {
-        char ch = 0;
-        for (int j = 7; j >= 0; j--)
-        {
-            if (bitIndex >= imageSize)
-            {
-                free(text);
-                return NULL;
-            }
-            ch = (ch << 1) | (imageData[bitIndex] & 1);
-            bitIndex++;
-        }
-        text[i] = ch;
-    }
-
-    return text;
-}
-
-/**
- * readKeyFile - Читает файл ключа и извлекает путь к зашифрованному изображению.
- * @param imagePath: Буфер для хранения пути к изображению (должен быть достаточно большим).
- *
- * Возвращает 1 при успешном чтении файла и извлечении пути, 0 при ошибке.
- */
-int readKeyFile(char *imagePath)
-{
-    FILE *keyFile = fopen("simple_key", "r");
-    if (!keyFile)
-    {
-        printf("Error: Cannot open key file 'simple_key'\n");
-        return 0;
-    }
-
-    char line[256];
-    while (fgets(line, sizeof(line), keyFile))
-    {
-        if (strncmp(line, "ENCRYPTED_IMAGE:", 16) == 0)
-        {
-            strcpy(imagePath, line + 16);
-            imagePath[strcspn(imagePath, "\n")] = 0;
-        }
-    }
-
-    fclose(keyFile);
-    return 1;
-}
-
-/**
- * simple_dec - Основная функция для декодирования текста из BMP изображения.
- *
- * Выполняет:
- * - Запрос пути к изображению у пользователя
- * - Загрузку изображения
- * - Извлечение скрытого текста из изображения
- * - Вывод расшифрованного сообщения
- *
- * Возвращает 0 при успешной работе или 1 при ошибках.
- */
-int simple_dec()
-{
-    char imagePath[256];
-
-    printf("\nBMP Image Text Decryption\n");
-    printf("=========================\n\n");
-
-    printf("Enter encrypted BMP filename: ");
-    scanf("%255s", imagePath);
-
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char *imageData;
-
-    int imageSize = loadBMP(imagePath, &imageData, &header, &infoHeader);
-    if (!imageSize)
-        return 1;
-
-    printf("Image loaded successfully!\n");
-
-    char *decryptedText = decryptText(imageData, imageSize);
-
-    printf("\n==================\n");
-    printf("Decrypted message:\n\n");
-
-    if (decryptedText)
-    {
-        printf("%s\n", decryptedText);
-        free(decryptedText);
-    }
-    else
-    {
-        printf("Error: Could not extract text from image\n");
-    }
-
-    free(imageData);
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "stats.h"
+#include "simple.h"
+#include "stegano.h"
+#include "stream.h"
+#include "aead.h"
+#include "ecc.h"
+#include "simple_dec.h"
+
+/**
+ * sampleOffset - Смещение index-го байта каналов в пиксельных данных (как в simple.c).
+ */
+static inline int sampleOffset(int bytesPerPixel, const int *lane, int index)
+{
+    return bytesPerPixel == 4 ? index / 3 * 4 + lane[index % 3] : index;
+}
+
+/**
+ * extractPayload - Собирает текст из depth младших бит байтов каналов, начиная с bitIndex
+ * (порядок бит - как в embedSamples из simple.c).
+ *
+ * Вызывается с константными bytesPerPixel и depth.
+ *
+ * Возвращает 1 если текст собран целиком, 0 если изображение закончилось раньше.
+ */
+static inline int extractPayload(const unsigned char *imageData, int bytesPerPixel, const int *lane, int imageSize,
+                                 int bitIndex, unsigned char *text, int textLen, int depth)
+{
+    const unsigned char mask = (unsigned char)((1 << depth) - 1);
+
+    if (depth == 3)
+    {
+        for (int i = 0; i < textLen; i += 3)
+        {
+            int samples = i + 3 <= textLen ? 8 : ((textLen - i) * 8 + 2) / 3;
+            unsigned int group = 0;
+            for (int j = 0; j < 8; j++)
+            {
+                unsigned int bits = 0;
+                if (j < samples)
+                {
+                    if (bitIndex >= imageSize)
+                        return 0;
+                    bits = imageData[sampleOffset(bytesPerPixel, lane, bitIndex)] & mask;
+                    bitIndex++;
+                }
+                group = group << 3 | bits;
+            }
+            text[i] = group >> 16;
+            if (i + 1 < textLen)
+                text[i + 1] = group >> 8;
+            if (i + 2 < textLen)
+                text[i + 2] = group;
+        }
+        return 1;
+    }
+
+    for (int i = 0; i < textLen; i++)
+    {
+        unsigned char ch = 0;
+        for (int j = 8 - depth; j >= 0; j -= depth)
+        {
+            if (bitIndex >= imageSize)
+                return 0;
+            ch = (ch << depth) | (imageData[sampleOffset(bytesPerPixel, lane, bitIndex)] & mask);
+            bitIndex++;
+        }
+        text[i] = ch;
+    }
+    return 1;
+}
+
+/**
+ * extractSamples - Собирает префикс длины и текст из младших битов последовательных байтов каналов.
+ *
+ * Глубина встраивания текста читается из префикса и, если depthOut не NULL, возвращается
+ * через него. Вызывается с константным bytesPerPixel, поэтому для каждого формата
+ * пикселей компилятор строит отдельное ядро.
+ */
+static inline char *extractSamples(const unsigned char *imageData, int bytesPerPixel, const int *lane, int imageSize,
+                                   int *depthOut)
+{
+    int bitIndex = 0;
+    unsigned int prefix = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (bitIndex >= imageSize)
+            break;
+        int sample = imageData[sampleOffset(bytesPerPixel, lane, bitIndex)];
+        prefix = (prefix << 1) | (sample & 1);
+        bitIndex++;
+    }
+
+    int textLen = prefix & SIMPLE_LEN_MASK;
+    int depth = (prefix >> SIMPLE_DEPTH_SHIFT) + 1;
+    // длина ограничена только емкостью изображения при этой глубине, как при встраивании
+    if (textLen <= 0 || depth > SIMPLE_MAX_DEPTH || simpleSamples(textLen, depth) > imageSize)
+    {
+        printf("Error: Invalid text length detected: %d characters at bit depth %d\n", textLen, depth);
+        return NULL;
+    }
+
+    char *text = (char *)malloc(textLen + 1);
+    if (!text)
+    {
+        printf("Error: Not enough memory for a %d-character message\n", textLen);
+        return NULL;
+    }
+    text[textLen] = '\0';
+
+    unsigned char *out = (unsigned char *)text;
+    int ok;
+    switch (depth)
+    {
+    case 2:
+        ok = extractPayload(imageData, bytesPerPixel, lane, imageSize, bitIndex, out, textLen, 2);
+        break;
+    case 3:
+        ok = extractPayload(imageData, bytesPerPixel, lane, imageSize, bitIndex, out, textLen, 3);
+        break;
+    case 4:
+        ok = extractPayload(imageData, bytesPerPixel, lane, imageSize, bitIndex, out, textLen, 4);
+        break;
+    default:
+        ok = extractPayload(imageData, bytesPerPixel, lane, imageSize, bitIndex, out, textLen, 1);
+        break;
+    }
+
+    if (!ok)
+    {
+        free(text);
+        return NULL;
+    }
+    if (depthOut)
+        *depthOut = depth;
+    return text;
+}
+
+/**
+ * decryptText - Извлекает скрытый текст из данных изображения, закодированный методом LSB.
+ * @param imageData: Массив байтов данных изображения с встроенным текстом.
+ * @param imageSize: Размер данных изображения в байтах.
+ *
+ * Возвращает указатель на строку с извлеченным текстом или NULL при ошибке.
+ */
+char *decryptText(unsigned char *imageData, int imageSize)
+{
+    return extractSamples(imageData, 1, NULL, imageSize, NULL);
+}
+
+/**
+ * decryptFormat - Выбирает ядро извлечения по формату пикселей.
+ */
+static char *decryptFormat(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize, int *depth)
+{
+    if (format->bytesPerPixel == 4)
+    {
+        int lane[3] = {format->offset[2], format->offset[1], format->offset[0]}; // B, G, R
+        return extractSamples(imageData, 4, lane, imageSize, depth);
+    }
+    return extractSamples(imageData, 1, NULL, imageSize, depth);
+}
+
+/**
+ * decryptPixels - Извлекает скрытый текст из изображения любого поддерживаемого формата.
+ * @param format: Формат пикселей.
+ * @param imageData: Пиксельные данные в порядке хранения.
+ * @param imageSize: Количество байтов каналов: ширина * высота * format->channels.
+ *
+ * Возвращает указатель на строку с извлеченным текстом или NULL при ошибке.
+ */
+char *decryptPixels(const BMP_FORMAT *format, unsigned char *imageData, int imageSize)
+{
+    return decryptFormat(format, imageData, imageSize, NULL);
+}
+
+/**
+ * extractFormat - Выбирает ядро extractPayload по формату пикселей для константной глубины.
+ */
+static inline int extractFormat(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize,
+                                unsigned char *out, int len, int depth)
+{
+    if (format->bytesPerPixel == 4)
+    {
+        int lane[3] = {format->offset[2], format->offset[1], format->offset[0]}; // B, G, R
+        return extractPayload(imageData, 4, lane, imageSize, 32, out, len, depth);
+    }
+    return extractPayload(imageData, 1, NULL, imageSize, 32, out, len, depth);
+}
+
+/**
+ * decryptBytes - Извлекает len байтов, встроенных с глубиной depth после 32-битного префикса,
+ * не читая длину из префикса (для сообщений с кодом Рида-Соломона, см. ecc.c).
+ *
+ * Возвращает 1 если байты извлечены, 0 если глубина некорректна или изображение закончилось раньше.
+ */
+int decryptBytes(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize, int depth,
+                 unsigned char *out, int len)
+{
+    switch (depth)
+    {
+    case 1:
+        return extractFormat(format, imageData, imageSize, out, len, 1);
+    case 2:
+        return extractFormat(format, imageData, imageSize, out, len, 2);
+    case 3:
+        return extractFormat(format, imageData, imageSize, out, len, 3);
+    case 4:
+        return extractFormat(format, imageData, imageSize, out, len, 4);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * decryptPrefix - Читает 32-битный префикс (младший бит первых 32 байтов каналов) без проверки
+ * длины и глубины (для сообщений с кодом Рида-Соломона, см. ecc.c).
+ *
+ * Возвращает значение префикса; биты за концом изображения равны нулю.
+ */
+unsigned int decryptPrefix(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize)
+{
+    unsigned char bytes[4] = {0};
+    if (format->bytesPerPixel == 4)
+    {
+        int lane[3] = {format->offset[2], format->offset[1], format->offset[0]}; // B, G, R
+        extractPayload(imageData, 4, lane, imageSize, 0, bytes, 4, 1);
+    }
+    else
+        extractPayload(imageData, 1, NULL, imageSize, 0, bytes, 4, 1);
+    return (unsigned int)bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+/**
+ * readKeyFile - Читает файл ключа и извлекает путь к зашифрованному изображению.
+ * @param imagePath: Буфер для хранения пути к изображению (должен быть достаточно большим).
+ *
+ * Возвращает 1 при успешном чтении файла и извлечении пути, 0 при ошибке.
+ */
+int readKeyFile(char *imagePath)
+{
+    FILE *keyFile = fopen("simple_key", "r");
+    if (!keyFile)
+    {
+        printf("Error: Cannot open key file 'simple_key'\n");
+        return 0;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), keyFile))
+    {
+        if (strncmp(line, "ENCRYPTED_IMAGE:", 16) == 0)
+        {
+            strcpy(imagePath, line + 16);
+            imagePath[strcspn(imagePath, "\n")] = 0;
+        }
+    }
+
+    fclose(keyFile);
+    return 1;
+}
+
+/**
+ * extractText - Извлекает текст, учитывая время извлечения и затронутые пиксели в статистике.
+ * @param bmp: Загруженное изображение с встроенным текстом.
+ *
+ * Возвращает указатель на строку с извлеченным текстом или NULL при ошибке.
+ */
+static char *extractText(const BMP_FILE *bmp)
+{
+    const BMP_FORMAT *format = &bmp->format;
+    int imageSize = format->width * format->height * format->channels;
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    int depth = 1;
+    char *text = decryptFormat(format, bmp->pixels, imageSize, &depth);
+    stats_kernel_stop(STAT_EXTRACT, &span);
+
+    if (text)
+    {
+        stats_alloc(strlen(text) + 1);
+        stats_add(STAT_PIXELS, (simpleSamples((int)strlen(text), depth) + format->channels - 1) / format->channels);
+        stats_add(STAT_PAYLOAD, strlen(text));
+    }
+    else
+        stats_error(STAT_ERR_PAYLOAD);
+    return text;
+}
+
+/**
+ * simple_decode - Загружает изображение и извлекает из него скрытый текст (без диалога с пользователем).
+ * С пределом памяти (--max-memory) BMP читается окнами строк (stream_decode_file).
+ * Сообщение, встроенное с кодом Рида-Соломона, декодируется ecc_simple_decode, как с флагом --ecc,
+ * а не возвращается вместе с заголовком и проверочными байтами кода.
+ * @param filename: Имя файла изображения.
+ *
+ * Возвращает указатель на строку с извлеченным текстом (необходимо освободить) или NULL при ошибке.
+ */
+char *simple_decode(const char *filename)
+{
+    char *text;
+    size_t len = 0;
+    unsigned int prefix = 0;
+    if (stream_max_memory())
+    {
+        text = stream_decode_file(filename, STREAM_SIMPLE, 1, STEGANO_DEFAULT_MASK, &len);
+        if (text)
+            stats_add(STAT_PAYLOAD, len);
+        // глубина занимает старший байт префикса; если она другая, его исправит код заголовка
+        prefix = simplePrefix((int)len, 1);
+    }
+    else
+    {
+        BMP_FILE bmp;
+        if (!bmp_load(filename, &bmp, 0))
+            return NULL;
+
+        text = extractText(&bmp);
+        prefix = decryptPrefix(&bmp.format, bmp.pixels, bmp.format.width * bmp.format.height * bmp.format.channels);
+        len = prefix & SIMPLE_LEN_MASK;
+        bmp_free(&bmp);
+    }
+
+    if (text && ecc_simple_coded((const unsigned char *)text, len, prefix))
+    {
+        free(text);
+        return ecc_simple_decode(filename, NULL);
+    }
+    return text;
+}
+
+/**
+ * simple_dec - Основная функция для декодирования текста из BMP изображения.
+ *
+ * Выполняет:
+ * - Запрос пути к изображению у пользователя
+ * - Загрузку изображения
+ * - Извлечение скрытого текста из изображения
+ * - Вывод расшифрованного сообщения
+ *
+ * Возвращает 0 при успешной работе или 1 при ошибках.
+ */
+int simple_dec()
+{
+    char imagePath[256];
+
+    printf("\nBMP Image Text Decryption\n");
+    printf("=========================\n\n");
+
+    printf("Enter encrypted BMP filename: ");
+    scanf("%255s", imagePath);
+
+    char *decryptedText = simple_decode(imagePath);
+    if (decryptedText)
+        printf("Image loaded successfully!\n");
+    decryptedText = aead_open_message(decryptedText, aead_passphrase());
+
+    printf("\n==================\n");
+    printf("Decrypted message:\n\n");
+
+    if (decryptedText)
+    {
+        printf("%s\n", decryptedText);
+        free(decryptedText);
+    }
+    else
+    {
+        printf("Error: Could not extract text from image\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,6 +1,14 @@
-#ifndef SIMPLE_DEC_H
-#define SIMPLE_DEC_H
-
-int simple_dec();
-
+#ifndef SIMPLE_DEC_H
+#define SIMPLE_DEC_H
+
+#include "bmpinfo.h"
+
+char *decryptText(unsigned char *imageData, int imageSize);
+char *decryptPixels(const BMP_FORMAT *format, unsigned char *imageData, int imageSize);
+int decryptBytes(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize, int depth,
+                 unsigned char *out, int len);
+unsigned int decryptPrefix(const BMP_FORMAT *format, const unsigned char *imageData, int imageSize);
+char *simple_decode(const char *filename);
+int simple_dec();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,613 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "png.h"
+#include "stegano.h"
+#include "stats.h"
+#include "slots.h"
+
+/**
+ * @brief Байты каналов загруженной части пиксельных данных.
+ *
+ * Байты каналов нумеруются подряд по пикселям в порядке хранения строк, внутри
+ * пикселя - по возрастанию смещения; байты выравнивания строк и альфа-канала
+ * пропускаются, поэтому номер байта однозначно определяет строку изображения.
+ */
+typedef struct
+{
+    const BMP_FORMAT *format;
+    int lanes[3];
+    int laneCount;
+    unsigned char *data; // строки, начиная с firstRow
+    long long stride;    // размер строки в data
+    long long firstRow;
+    unsigned char *buffer; // строки, прочитанные с диска (data указывает на него), или NULL
+} SLOTS_VIEW;
+
+// Изображение со слотами: BMP читается с диска по строкам, PNG загружается целиком
+typedef struct
+{
+    FILE *file;
+    BMP_FILE bmp;
+    BMP_FORMAT format;
+    SLOTS_VIEW view;
+    SLOTS_TABLE table;
+    long long capacity; // количество байтов каналов
+} SLOTS_FILE;
+
+/**
+ * @brief Количество байтов каналов изображения, адресуемое таблицей (не больше 2^32 - 1).
+ */
+static long long slots_capacity(const BMP_FORMAT *format)
+{
+    long long capacity = (long long)format->width * format->height * format->channels;
+    return capacity < 0xFFFFFFFFLL ? capacity : 0xFFFFFFFFLL;
+}
+
+/**
+ * @brief Настраивает доступ ко всем пиксельным данным загруженного изображения.
+ */
+static void slots_view(SLOTS_VIEW *v, BMP_FILE *bmp)
+{
+    memset(v, 0, sizeof(*v));
+    v->format = &bmp->format;
+    v->laneCount = stegano_lanes(&bmp->format, STEGANO_MASK_ALL, v->lanes);
+    v->data = bmp->pixels;
+    v->stride = bmp_stride(bmp);
+}
+
+/**
+ * @brief Адрес байта канала с номером sample.
+ */
+static unsigned char *slots_byte(const SLOTS_VIEW *v, long long sample)
+{
+    long long pixel = sample / v->laneCount;
+    long long row = pixel / v->format->width;
+    return v->data + (row - v->firstRow) * v->stride + pixel % v->format->width * v->format->bytesPerPixel +
+           v->lanes[sample % v->laneCount];
+}
+
+/**
+ * @brief Записывает bits младших бит value в младшие биты байтов каналов, начиная со старшего.
+ */
+static void slots_put(const SLOTS_VIEW *v, long long sample, unsigned int value, int bits)
+{
+    for (int i = 0; i < bits; i++)
+    {
+        unsigned char *b = slots_byte(v, sample + i);
+        *b = (*b & 0xFE) | ((value >> (bits - 1 - i)) & 1);
+    }
+}
+
+/**
+ * @brief Читает bits бит из младших бит байтов каналов, начиная со старшего.
+ */
+static unsigned int slots_get(const SLOTS_VIEW *v, long long sample, int bits)
+{
+    unsigned int value = 0;
+    for (int i = 0; i < bits; i++)
+        value = value << 1 | (*slots_byte(v, sample + i) & 1);
+    return value;
+}
+
+/**
+ * @brief Слот с номером number (с 1) занят сообщением.
+ */
+static int slots_in_use(const SLOTS_TABLE *table, int number)
+{
+    return number >= 1 && number <= table->count && table->slot[number - 1].length != 0;
+}
+
+/**
+ * @brief Количество занятых слотов (записи удаленных слотов остаются в таблице свободными).
+ */
+static int slots_used(const SLOTS_TABLE *table)
+{
+    int used = 0;
+    for (int i = 0; i < table->count; i++)
+        used += table->slot[i].length != 0;
+    return used;
+}
+
+/**
+ * @brief Читает таблицу областей.
+ *
+ * Запись с нулевыми началом и длиной - свободный слот, оставшийся после удаления.
+ *
+ * @return 1 если таблица есть и корректна, 0 если таблицы нет, -1 если она повреждена
+ *         (записи выходят за изображение или пересекаются).
+ */
+static int slots_parse(const SLOTS_VIEW *v, long long capacity, SLOTS_TABLE *table)
+{
+    memset(table, 0, sizeof(*table));
+    if (capacity < SLOTS_TABLE_BITS || slots_get(v, 0, 32) != SLOTS_MAGIC)
+        return 0;
+
+    table->count = (int)slots_get(v, 32, 8);
+    if (table->count > SLOTS_MAX)
+        return -1;
+
+    for (int i = 0; i < table->count; i++)
+    {
+        long long at = 40 + (long long)i * SLOTS_ENTRY_BITS;
+        SLOT *s = &table->slot[i];
+        s->start = slots_get(v, at, 32);
+        s->length = slots_get(v, at + 32, 16);
+        if (s->length == 0 && s->start == 0)
+            continue;
+        if (s->length == 0 || s->start < SLOTS_TABLE_BITS || s->start + 8LL * s->length > capacity)
+            return -1;
+
+        for (int j = 0; j < i; j++)
+        {
+            const SLOT *o = &table->slot[j];
+            if (s->start < o->start + 8LL * o->length && o->start < s->start + 8LL * s->length)
+                return -1;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Записывает таблицу областей; неиспользуемые записи заполняются нулями.
+ */
+static void slots_write_table(const SLOTS_VIEW *v, const SLOTS_TABLE *table)
+{
+    slots_put(v, 0, SLOTS_MAGIC, 32);
+    slots_put(v, 32, (unsigned int)table->count, 8);
+    for (int i = 0; i < SLOTS_MAX; i++)
+    {
+        long long at = 40 + (long long)i * SLOTS_ENTRY_BITS;
+        slots_put(v, at, i < table->count ? table->slot[i].start : 0, 32);
+        slots_put(v, at + 32, i < table->count ? table->slot[i].length : 0, 16);
+    }
+}
+
+/**
+ * @brief Находит первый свободный промежуток из need байтов каналов после таблицы.
+ *
+ * Кандидат, пересекающийся с занятой областью, сдвигается за ее конец; любое начало
+ * левее этого конца тоже пересекалось бы с ней, поэтому находится самое левое место.
+ *
+ * @return Начало области или -1, если места нет.
+ */
+static long long slots_allocate(const SLOTS_TABLE *table, long long capacity, long long need)
+{
+    long long start = SLOTS_TABLE_BITS;
+    for (;;)
+    {
+        if (start + need > capacity)
+            return -1;
+
+        int moved = 0;
+        for (int i = 0; i < table->count; i++)
+        {
+            long long s = table->slot[i].start, e = s + 8LL * table->slot[i].length;
+            if (s < start + need && start < e)
+            {
+                start = e;
+                moved = 1;
+            }
+        }
+        if (!moved)
+            return start;
+    }
+}
+
+/**
+ * @brief Делает доступными байты каналов [first, first + count).
+ *
+ * У загруженного целиком изображения ничего не читается; у BMP с диска читаются
+ * только строки, в которых лежат эти байты.
+ */
+static int slots_fetch(SLOTS_FILE *sf, long long first, long long count)
+{
+    SLOTS_VIEW *v = &sf->view;
+    if (!sf->file)
+        return 1;
+
+    long long width = sf->format.width;
+    long long firstRow = first / v->laneCount / width;
+    long long lastRow = (first + count - 1) / v->laneCount / width;
+    size_t size = (size_t)((lastRow - firstRow + 1) * sf->format.rowSize);
+
+    free(v->buffer);
+    v->buffer = malloc(size);
+    if (!v->buffer)
+    {
+        printf("Error: Not enough memory to read the image\n");
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+
+    if (fseek(sf->file, (long)(sf->format.dataOffset + firstRow * sf->format.rowSize), SEEK_SET) != 0 ||
+        fread(v->buffer, 1, size, sf->file) != size)
+    {
+        printf("Error: Cannot read pixel data\n");
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+    stats_add(STAT_BYTES_READ, size);
+
+    v->data = v->buffer;
+    v->stride = sf->format.rowSize;
+    v->firstRow = firstRow;
+    return 1;
+}
+
+static void slots_close(SLOTS_FILE *sf)
+{
+    if (sf->file)
+        fclose(sf->file);
+    free(sf->view.buffer);
+    bmp_free(&sf->bmp);
+}
+
+/**
+ * @brief Открывает изображение и читает таблицу областей.
+ *
+ * У BMP читаются только заголовки и строки с таблицей; PNG распаковывается целиком.
+ *
+ * @return 1 если таблица прочитана, 0 при ошибке (сообщение выведено).
+ */
+static int slots_open(SLOTS_FILE *sf, const char *filename)
+{
+    memset(sf, 0, sizeof(*sf));
+
+    long long t = stats_start();
+    sf->file = fopen(filename, "rb");
+    if (!sf->file)
+    {
+        printf("Error: Cannot open image file %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    int bmp = bmp_read_format(sf->file, filename, &sf->format);
+    if (bmp < 0)
+    {
+        fclose(sf->file);
+        sf->file = NULL;
+        if (!bmp_load(filename, &sf->bmp, 0))
+            return 0;
+        sf->format = sf->bmp.format;
+        slots_view(&sf->view, &sf->bmp);
+    }
+    else if (!bmp)
+        return 0;
+    else
+    {
+        stats_stop(STAT_HEADER, t);
+        sf->view.format = &sf->format;
+        sf->view.laneCount = stegano_lanes(&sf->format, STEGANO_MASK_ALL, sf->view.lanes);
+    }
+
+    sf->capacity = slots_capacity(&sf->format);
+    t = stats_start();
+    int found = sf->capacity >= SLOTS_TABLE_BITS && slots_fetch(sf, 0, SLOTS_TABLE_BITS)
+                    ? slots_parse(&sf->view, sf->capacity, &sf->table)
+                    : 0;
+    stats_stop(STAT_READ, t);
+
+    if (found <= 0)
+    {
+        printf(found < 0 ? "Error: The slot table in %s is damaged\n" : "Error: %s has no slot table\n", filename);
+        stats_error(STAT_ERR_PAYLOAD);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Загружает изображение для изменения слотов и читает его таблицу.
+ *
+ * Таблица читается до приведения к формату выходного файла: при смене BMP на PNG
+ * или обратно строки переставляются, и прежние области оказались бы в других байтах,
+ * поэтому формат изображения с уже записанными слотами менять нельзя.
+ *
+ * @return 1 при успехе (bmp загружен, view и table заполнены), 0 при ошибке.
+ */
+static int slots_load(BMP_FILE *bmp, const char *inputFilename, const char *outputFilename, SLOTS_VIEW *v,
+                      SLOTS_TABLE *table, long long *capacity)
+{
+    if (!bmp_load(inputFilename, bmp, 0))
+        return 0;
+
+    *capacity = slots_capacity(&bmp->format);
+    slots_view(v, bmp);
+    int found = slots_parse(v, *capacity, table);
+    if (found < 0)
+    {
+        printf("Error: The slot table in %s is damaged\n", inputFilename);
+        stats_error(STAT_ERR_PAYLOAD);
+        bmp_free(bmp);
+        return 0;
+    }
+    if (found && png_filename(outputFilename) != bmp->format.png)
+    {
+        printf("Error: %s already holds slots; the output must keep its image format\n", inputFilename);
+        stats_error(STAT_ERR_OTHER);
+        bmp_free(bmp);
+        return 0;
+    }
+
+    if (!bmp_prepare_output(bmp, outputFilename))
+    {
+        bmp_free(bmp);
+        return 0;
+    }
+    slots_view(v, bmp);
+    return 1;
+}
+
+/**
+ * @brief Встраивает несколько сообщений в отдельные области изображения за одно чтение и одну запись.
+ *
+ * Если в изображении уже есть таблица областей, новые сообщения занимают свободные
+ * промежутки между существующими, прежние слоты сохраняются. Новое сообщение получает
+ * первый свободный номер: запись удаленного слота или следующую за последней. Каждое
+ * сообщение занимает младший бит 8 байтов каналов на байт; области не пересекаются.
+ *
+ * @param inputFilename Исходное изображение (BMP или PNG).
+ * @param outputFilename Файл для сохранения результата.
+ * @param texts Сообщения (от 1 до SLOTS_MAX_TEXT байт).
+ * @param count Количество сообщений.
+ * @param numbers Массив из count элементов для номеров слотов (с 1) или NULL.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int slots_add(const char *inputFilename, const char *outputFilename, const char *const *texts, int count,
+              int *numbers)
+{
+    BMP_FILE bmp;
+    SLOTS_VIEW v;
+    SLOTS_TABLE table;
+    long long capacity;
+    if (!slots_load(&bmp, inputFilename, outputFilename, &v, &table, &capacity))
+        return 0;
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    int ok = 1;
+    size_t payload = 0;
+    for (int i = 0; ok && i < count; i++)
+    {
+        size_t len = strlen(texts[i]);
+        long long start = -1;
+        int entry = 0;
+        while (entry < table.count && table.slot[entry].length != 0)
+            entry++;
+        if (len == 0 || len > SLOTS_MAX_TEXT)
+        {
+            printf("Error: Message %d must be 1 to %d bytes long\n", i + 1, SLOTS_MAX_TEXT);
+            stats_error(STAT_ERR_OTHER);
+            ok = 0;
+        }
+        else if (entry == SLOTS_MAX)
+        {
+            printf("Error: The image already holds %d slots\n", SLOTS_MAX);
+            stats_error(STAT_ERR_CAPACITY);
+            ok = 0;
+        }
+        else if ((start = slots_allocate(&table, capacity, 8LL * (long long)len)) < 0)
+        {
+            printf("Error: No free region for message %d (%zu bytes)\n", i + 1, len);
+            stats_error(STAT_ERR_CAPACITY);
+            ok = 0;
+        }
+        if (!ok)
+            break;
+
+        for (size_t j = 0; j < len; j++)
+            slots_put(&v, start + 8LL * (long long)j, (unsigned char)texts[i][j], 8);
+
+        table.slot[entry].start = (unsigned int)start;
+        table.slot[entry].length = (unsigned int)len;
+        if (entry == table.count)
+            table.count++;
+        if (numbers)
+            numbers[i] = entry + 1;
+        payload += len;
+    }
+    if (ok)
+        slots_write_table(&v, &table);
+    stats_kernel_stop(STAT_EMBED, &span);
+
+    if (ok)
+    {
+        stats_add(STAT_PIXELS, (SLOTS_TABLE_BITS + 8 * payload + v.laneCount - 1) / v.laneCount);
+        stats_add(STAT_PAYLOAD, payload);
+        ok = bmp_save(outputFilename, &bmp);
+    }
+    bmp_free(&bmp);
+    return ok;
+}
+
+/**
+ * @brief Удаляет слот: его область обнуляется и становится свободной, а запись - свободным
+ * номером для следующего add. Номера остальных слотов не меняются.
+ *
+ * @param inputFilename Изображение со слотами.
+ * @param outputFilename Файл для сохранения результата.
+ * @param number Номер слота (с 1).
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int slots_remove(const char *inputFilename, const char *outputFilename, int number)
+{
+    BMP_FILE bmp;
+    SLOTS_VIEW v;
+    SLOTS_TABLE table;
+    long long capacity;
+    if (!slots_load(&bmp, inputFilename, outputFilename, &v, &table, &capacity))
+        return 0;
+
+    if (!slots_in_use(&table, number))
+    {
+        printf("Error: Slot %d does not exist (%d slots)\n", number, slots_used(&table));
+        stats_error(STAT_ERR_PAYLOAD);
+        bmp_free(&bmp);
+        return 0;
+    }
+
+    SLOT *s = &table.slot[number - 1];
+    for (unsigned int j = 0; j < s->length; j++)
+        slots_put(&v, s->start + 8LL * j, 0, 8);
+    s->start = s->length = 0;
+    // свободные записи в конце таблицы не нужны: номера занятых слотов от этого не меняются
+    while (table.count > 0 && table.slot[table.count - 1].length == 0)
+        table.count--;
+    slots_write_table(&v, &table);
+
+    int saved = bmp_save(outputFilename, &bmp);
+    bmp_free(&bmp);
+    return saved;
+}
+
+/**
+ * @brief Читает таблицу областей изображения.
+ *
+ * @param filename Изображение со слотами.
+ * @param table Указатель для сохранения таблицы.
+ * @param capacity Указатель для сохранения количества байтов каналов или NULL.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int slots_list(const char *filename, SLOTS_TABLE *table, long long *capacity)
+{
+    SLOTS_FILE sf;
+    int ok = slots_open(&sf, filename);
+    if (ok)
+    {
+        *table = sf.table;
+        if (capacity)
+            *capacity = sf.capacity;
+    }
+    slots_close(&sf);
+    return ok;
+}
+
+/**
+ * @brief Извлекает одно сообщение, не затрагивая области остальных.
+ *
+ * У BMP с диска читаются только заголовки, строки с таблицей и строки области
+ * выбранного слота.
+ *
+ * @param filename Изображение со слотами.
+ * @param number Номер слота (с 1).
+ * @param length Указатель для сохранения длины сообщения или NULL.
+ * @return Сообщение (необходимо освободить) или NULL при ошибке.
+ */
+char *slots_read(const char *filename, int number, size_t *length)
+{
+    SLOTS_FILE sf;
+    if (!slots_open(&sf, filename))
+    {
+        slots_close(&sf);
+        return NULL;
+    }
+
+    if (!slots_in_use(&sf.table, number))
+    {
+        printf("Error: Slot %d does not exist (%d slots)\n", number, slots_used(&sf.table));
+        stats_error(STAT_ERR_PAYLOAD);
+        slots_close(&sf);
+        return NULL;
+    }
+
+    const SLOT *s = &sf.table.slot[number - 1];
+    long long t = stats_start();
+    int fetched = slots_fetch(&sf, s->start, 8LL * s->length);
+    stats_stop(STAT_READ, t);
+    char *text = fetched ? malloc(s->length + 1) : NULL;
+    if (!text)
+    {
+        if (fetched)
+            stats_error(STAT_ERR_MEMORY);
+        slots_close(&sf);
+        return NULL;
+    }
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    for (unsigned int j = 0; j < s->length; j++)
+        text[j] = (char)slots_get(&sf.view, s->start + 8LL * j, 8);
+    text[s->length] = '\0';
+    stats_kernel_stop(STAT_EXTRACT, &span);
+    stats_add(STAT_PIXELS, (8LL * s->length + sf.view.laneCount - 1) / sf.view.laneCount);
+    stats_add(STAT_PAYLOAD, s->length);
+
+    if (length)
+        *length = s->length;
+    slots_close(&sf);
+    return text;
+}
+
+/**
+ * @brief Команда slots: несколько независимых сообщений в одном изображении.
+ *
+ * Использование:
+ *   slots add <вход> <выход> <текст>...
+ *   slots read <изображение> <номер>
+ *   slots list <изображение>
+ *   slots remove <вход> <выход> <номер>
+ *
+ * add встраивает все сообщения за одно чтение и одну запись изображения и выводит
+ * номера их слотов; read выводит сообщение одного слота.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int slots(int argc, char *argv[])
+{
+    if (argc >= 4 && strcmp(argv[0], "add") == 0)
+    {
+        int count = argc - 3;
+        int *numbers = malloc(count * sizeof(int));
+        if (!numbers)
+            return 1;
+
+        int ok = slots_add(argv[1], argv[2], (const char *const *)(argv + 3), count, numbers);
+        for (int i = 0; ok && i < count; i++)
+            printf("slot %d: %zu bytes\n", numbers[i], strlen(argv[3 + i]));
+        free(numbers);
+        return ok ? 0 : 1;
+    }
+
+    if (argc == 3 && strcmp(argv[0], "read") == 0)
+    {
+        char *text = slots_read(argv[1], atoi(argv[2]), NULL);
+        if (!text)
+            return 1;
+        printf("%s\n", text);
+        free(text);
+        return 0;
+    }
+
+    if (argc == 2 && strcmp(argv[0], "list") == 0)
+    {
+        SLOTS_TABLE table;
+        long long capacity;
+        if (!slots_list(argv[1], &table, &capacity))
+            return 1;
+
+        long long used = SLOTS_TABLE_BITS;
+        for (int i = 0; i < table.count; i++)
+        {
+            if (!table.slot[i].length)
+                continue;
+            printf("slot %d: %u bytes at channel byte %u\n", i + 1, table.slot[i].length, table.slot[i].start);
+            used += 8LL * table.slot[i].length;
+        }
+        printf("%d of %d slots used, %lld bytes free\n", slots_used(&table), SLOTS_MAX, (capacity - used) / 8);
+        return 0;
+    }
+
+    if (argc == 4 && strcmp(argv[0], "remove") == 0)
+        return slots_remove(argv[1], argv[2], atoi(argv[3])) ? 0 : 1;
+
+    printf("Usage: slots add <input> <output> <text>...\n"
+           "       slots read <image> <number>\n"
+           "       slots list <image>\n"
+           "       slots remove <input> <output> <number>\n");
+    return 1;
+}
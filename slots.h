@@ -0,0 +1,36 @@
+#ifndef SLOTS_H
+#define SLOTS_H
+
+#include <stddef.h>
+
+// Таблица областей занимает младший бит первых SLOTS_TABLE_BITS байтов каналов:
+// метка SLOTS_MAGIC (32 бита), количество записей (8 бит) и SLOTS_MAX записей
+// "начало области в байтах каналов (32 бита), длина сообщения (16 бит)"; номер слота -
+// номер записи с 1, запись удаленного слота нулевая и занимается следующим сообщением
+#define SLOTS_MAGIC 0x534C5431u // "SLT1"
+#define SLOTS_MAX 15
+#define SLOTS_MAX_TEXT 65535
+#define SLOTS_ENTRY_BITS 48
+#define SLOTS_TABLE_BITS (32 + 8 + SLOTS_MAX * SLOTS_ENTRY_BITS)
+
+// Область одного сообщения: 8 байтов каналов на байт сообщения
+typedef struct
+{
+    unsigned int start;
+    unsigned int length;
+} SLOT;
+
+typedef struct
+{
+    int count; // записи, включая свободные (length == 0) перед последней занятой
+    SLOT slot[SLOTS_MAX];
+} SLOTS_TABLE;
+
+int slots_add(const char *inputFilename, const char *outputFilename, const char *const *texts, int count,
+              int *numbers);
+int slots_remove(const char *inputFilename, const char *outputFilename, int number);
+int slots_list(const char *filename, SLOTS_TABLE *table, long long *capacity);
+char *slots_read(const char *filename, int number, size_t *length);
+int slots(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
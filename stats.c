@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+const char *const statPhaseNames[STAT_PHASES] = {"header", "read", "embed", "extract", "key", "save"};
+const char *const statErrorNames[STAT_ERRORS] = {"none",        "io",      "format", "capacity", "key_missing",
+                                                 "key_invalid", "payload", "memory", "bad_job",  "other"};
+
+// Накопитель текущей операции потока; NULL - сбор статистики выключен
+static __thread STATS *current = NULL;
+
+// Аппаратные счетчики открываются в каждом потоке при первом замере ядра
+static int perfEnabled = 0;
+static int perfWarned = 0;
+static __thread PERF threadPerf;
+static __thread int threadPerfOpened = 0;
+
+// Память, выделенная под изображения и сообщения операциями, которые еще выполняются
+static long long inflightBytes = 0;
+
+/**
+ * @brief Возвращает монотонное время в наносекундах.
+ */
+long long stats_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Назначает накопитель статистики для операций текущего потока.
+ *
+ * @param s Накопитель или NULL, чтобы выключить сбор статистики.
+ */
+void stats_attach(STATS *s)
+{
+    current = s;
+}
+
+/**
+ * @brief Возвращает накопитель текущего потока (NULL, если сбор статистики выключен).
+ */
+STATS *stats_current()
+{
+    return current;
+}
+
+/**
+ * @brief Добавляет статистику одного потока к общей (фазы и счетчики складываются).
+ *
+ * @param into Общий накопитель; вызывающий синхронизирует доступ к нему.
+ * @param from Статистика потока.
+ */
+void stats_merge(STATS *into, const STATS *from)
+{
+    for (int i = 0; i < STAT_PHASES; i++)
+        into->phaseNs[i] += from->phaseNs[i];
+    for (int i = 0; i < STAT_COUNTERS; i++)
+        into->counters[i] += from->counters[i];
+    for (int i = 0; i < PERF_EVENTS; i++)
+        into->perf[i] += from->perf[i];
+    into->perfMask |= from->perfMask;
+    if (into->error == STAT_ERR_NONE)
+        into->error = from->error;
+}
+
+/**
+ * @brief Начинает замер фазы.
+ *
+ * @return Время начала или 0, если сбор статистики выключен (часы не читаются).
+ */
+long long stats_start()
+{
+    return current ? stats_now() : 0;
+}
+
+/**
+ * @brief Завершает замер фазы и добавляет его длительность к накопителю.
+ *
+ * @param phase Фаза операции.
+ * @param start Значение, возвращенное stats_start.
+ */
+void stats_stop(STAT_PHASE phase, long long start)
+{
+    if (current)
+        current->phaseNs[phase] += stats_now() - start;
+}
+
+/**
+ * @brief Увеличивает счетчик текущей операции.
+ */
+void stats_add(STAT_COUNTER counter, unsigned long long n)
+{
+    if (current)
+        current->counters[counter] += n;
+}
+
+/**
+ * @brief Учитывает одно выделение памяти заданного размера.
+ */
+void stats_alloc(unsigned long long bytes)
+{
+    if (current)
+    {
+        current->counters[STAT_ALLOCS]++;
+        current->counters[STAT_ALLOC_BYTES] += bytes;
+        __atomic_add_fetch(&inflightBytes, (long long)bytes, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Учитывает освобождение памяти завершившейся операции.
+ *
+ * @param bytes Объем, учтенный операцией через stats_alloc (counters[STAT_ALLOC_BYTES]).
+ */
+void stats_release(unsigned long long bytes)
+{
+    __atomic_sub_fetch(&inflightBytes, (long long)bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Возвращает объем памяти, выделенной выполняющимися операциями.
+ */
+long long stats_inflight_bytes()
+{
+    return __atomic_load_n(&inflightBytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Запоминает причину ошибки текущей операции (сохраняется только первая).
+ */
+void stats_error(STAT_ERROR cause)
+{
+    if (current && current->error == STAT_ERR_NONE)
+        current->error = cause;
+}
+
+/**
+ * @brief Включает чтение аппаратных счетчиков при замерах ядер встраивания и извлечения.
+ */
+void stats_enable_perf()
+{
+    perfEnabled = 1;
+}
+
+/**
+ * @brief Начинает замер ядра встраивания или извлечения.
+ *
+ * @param span Состояние замера.
+ */
+void stats_kernel_start(STATS_SPAN *span)
+{
+    if (!current)
+        return;
+
+    if (perfEnabled)
+    {
+        if (!threadPerfOpened)
+        {
+            int opened = perf_open(&threadPerf);
+            threadPerfOpened = 1;
+            if (opened < PERF_EVENTS && !perfWarned)
+            {
+                perfWarned = 1;
+                printf("Warning: %d of %d hardware counters unavailable (%s)\n", PERF_EVENTS - opened, PERF_EVENTS,
+                       strerror(threadPerf.error));
+            }
+        }
+        perf_read(&threadPerf, span->perf);
+    }
+    span->start = stats_now();
+}
+
+/**
+ * @brief Завершает замер ядра: добавляет время к фазе, а приращения счетчиков - к накопителю.
+ *
+ * @param phase Фаза (STAT_EMBED или STAT_EXTRACT).
+ * @param span Состояние замера, заполненное stats_kernel_start.
+ */
+void stats_kernel_stop(STAT_PHASE phase, const STATS_SPAN *span)
+{
+    if (!current)
+        return;
+
+    current->phaseNs[phase] += stats_now() - span->start;
+    if (!perfEnabled)
+        return;
+
+    long long values[PERF_EVENTS];
+    perf_read(&threadPerf, values);
+    for (int i = 0; i < PERF_EVENTS; i++)
+    {
+        if (span->perf[i] >= 0 && values[i] >= 0)
+        {
+            current->perf[i] += values[i] - span->perf[i];
+            current->perfMask |= 1u << i;
+        }
+    }
+}
+
+/**
+ * @brief Выводит статистику операции в читаемом виде.
+ *
+ * @param out Поток вывода.
+ * @param s Накопленная статистика.
+ */
+void stats_print(FILE *out, const STATS *s)
+{
+    fprintf(out, "\nStats:\n");
+    for (int i = 0; i < STAT_PHASES; i++)
+        fprintf(out, "  %-8s %10.3f ms\n", statPhaseNames[i], s->phaseNs[i] / 1e6);
+    fprintf(out, "  bytes read: %llu, bytes written: %llu\n", s->counters[STAT_BYTES_READ],
+            s->counters[STAT_BYTES_WRITTEN]);
+    fprintf(out, "  pixels touched: %llu, payload bytes: %llu\n", s->counters[STAT_PIXELS],
+            s->counters[STAT_PAYLOAD]);
+    fprintf(out, "  allocations: %llu (%llu bytes)\n", s->counters[STAT_ALLOCS], s->counters[STAT_ALLOC_BYTES]);
+    if (s->counters[STAT_ECC_CORRECTED])
+        fprintf(out, "  bytes corrected by ECC: %llu\n", s->counters[STAT_ECC_CORRECTED]);
+
+    if (!perfEnabled)
+        return;
+
+    fprintf(out, "  hardware counters (embed/extract kernels):\n");
+    for (int i = 0; i < PERF_EVENTS; i++)
+    {
+        if (!(s->perfMask & (1u << i)))
+            fprintf(out, "    %-14s n/a\n", perfEventNames[i]);
+        else if (s->counters[STAT_PAYLOAD])
+            fprintf(out, "    %-14s %14lld (%.3f per payload byte)\n", perfEventNames[i], s->perf[i],
+                    (double)s->perf[i] / s->counters[STAT_PAYLOAD]);
+        else
+            fprintf(out, "    %-14s %14lld\n", perfEventNames[i], s->perf[i]);
+    }
+}
+
+/**
+ * @brief Выводит статистику операции как объект JSON (без перевода строки).
+ *
+ * @param out Поток вывода.
+ * @param s Накопленная статистика.
+ */
+void stats_print_json(FILE *out, const STATS *s)
+{
+    fprintf(out, "{\"phases_ns\":{");
+    for (int i = 0; i < STAT_PHASES; i++)
+        fprintf(out, "%s\"%s\":%lld", i ? "," : "", statPhaseNames[i], s->phaseNs[i]);
+    fprintf(out, "},\"bytes_read\":%llu,\"bytes_written\":%llu,\"pixels\":%llu,\"payload_bytes\":%llu,"
+            "\"allocs\":%llu,\"alloc_bytes\":%llu,\"ecc_corrected\":%llu",
+            s->counters[STAT_BYTES_READ], s->counters[STAT_BYTES_WRITTEN], s->counters[STAT_PIXELS],
+            s->counters[STAT_PAYLOAD], s->counters[STAT_ALLOCS], s->counters[STAT_ALLOC_BYTES],
+            s->counters[STAT_ECC_CORRECTED]);
+
+    if (perfEnabled)
+    {
+        fprintf(out, ",\"perf\":{");
+        for (int i = 0; i < PERF_EVENTS; i++)
+        {
+            if (s->perfMask & (1u << i))
+                fprintf(out, "%s\"%s\":%lld", i ? "," : "", perfEventNames[i], s->perf[i]);
+            else
+                fprintf(out, "%s\"%s\":null", i ? "," : "", perfEventNames[i]);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}");
+}
+
+/**
+ * @brief Номер интервала гистограммы: значения меньше 2^STATS_HIST_SUB_BITS хранятся точно,
+ * большие - с STATS_HIST_SUB_BITS значащими битами после старшего.
+ */
+static int hist_index(long long value)
+{
+    if (value < (1 << STATS_HIST_SUB_BITS))
+        return value < 0 ? 0 : (int)value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (exponent - STATS_HIST_SUB_BITS)) & ((1 << STATS_HIST_SUB_BITS) - 1);
+    return ((exponent - STATS_HIST_SUB_BITS + 1) << STATS_HIST_SUB_BITS) + sub;
+}
+
+/**
+ * @brief Верхняя граница интервала гистограммы.
+ */
+static long long hist_upper(int index)
+{
+    if (index < (1 << STATS_HIST_SUB_BITS))
+        return index;
+
+    int exponent = (index >> STATS_HIST_SUB_BITS) + STATS_HIST_SUB_BITS - 1;
+    long long sub = index & ((1 << STATS_HIST_SUB_BITS) - 1);
+    return (((1LL << STATS_HIST_SUB_BITS) + sub + 1) << (exponent - STATS_HIST_SUB_BITS)) - 1;
+}
+
+/**
+ * @brief Добавляет значение в гистограмму.
+ *
+ * @param h Гистограмма (обнуленная перед первым использованием).
+ * @param value Значение (например, задержка в наносекундах).
+ */
+void stats_hist_record(STATS_HIST *h, long long value)
+{
+    h->buckets[hist_index(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+/**
+ * @brief Возвращает процентиль гистограммы.
+ *
+ * @param h Гистограмма.
+ * @param p Процентиль (0..100).
+ * @return Верхняя граница интервала, в который попадает процентиль (не больше максимума).
+ */
+long long stats_hist_percentile(const STATS_HIST *h, double p)
+{
+    if (h->count == 0)
+        return 0;
+
+    unsigned long long target = (unsigned long long)(p / 100.0 * h->count + 0.5);
+    if (target < 1)
+        target = 1;
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < STATS_HIST_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= target)
+        {
+            long long value = hist_upper(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * @brief Возвращает количество значений, не превышающих заданное.
+ *
+ * Значения учитываются по верхней границе интервала, поэтому результат
+ * может быть занижен в пределах точности гистограммы.
+ */
+long long stats_hist_count_below(const STATS_HIST *h, long long value)
+{
+    long long count = 0;
+    for (int i = 0; i < STATS_HIST_BUCKETS && hist_upper(i) <= value; i++)
+        count += h->buckets[i];
+    return count;
+}
+
+/**
+ * @brief Выводит число значений и процентили гистограммы как объект JSON (без перевода строки).
+ */
+void stats_hist_print_json(FILE *out, const STATS_HIST *h)
+{
+    fprintf(out, "{\"count\":%llu,\"p50_ns\":%lld,\"p99_ns\":%lld,\"p999_ns\":%lld,\"max_ns\":%lld}",
+            h->count, stats_hist_percentile(h, 50), stats_hist_percentile(h, 99), stats_hist_percentile(h, 99.9),
+            h->max);
+}
@@ -0,0 +1,99 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "perf.h"
+
+// Фазы операции шифрования/дешифрования
+typedef enum
+{
+    STAT_HEADER,  // открытие файла и разбор заголовка
+    STAT_READ,    // чтение пиксельных данных
+    STAT_EMBED,   // встраивание сообщения
+    STAT_EXTRACT, // извлечение сообщения
+    STAT_KEY,     // запись или чтение ключа
+    STAT_SAVE,    // сохранение изображения
+    STAT_PHASES
+} STAT_PHASE;
+
+// Счетчики операции
+typedef enum
+{
+    STAT_BYTES_READ,
+    STAT_BYTES_WRITTEN,
+    STAT_PIXELS,        // пиксели, которые читает или изменяет ядро встраивания/извлечения
+    STAT_PAYLOAD,       // байты встроенного или извлеченного сообщения
+    STAT_ALLOCS,        // количество выделений памяти под изображение и сообщение
+    STAT_ALLOC_BYTES,   // объем этих выделений
+    STAT_ECC_CORRECTED, // байты сообщения, исправленные кодом Рида-Соломона
+    STAT_COUNTERS
+} STAT_COUNTER;
+
+// Причины ошибок операций
+typedef enum
+{
+    STAT_ERR_NONE,
+    STAT_ERR_IO,          // файл не открывается или не записывается
+    STAT_ERR_FORMAT,      // файл не является поддерживаемым изображением
+    STAT_ERR_CAPACITY,    // сообщение не помещается в изображение
+    STAT_ERR_KEY_MISSING, // нет файла ключа
+    STAT_ERR_KEY_INVALID, // ключ поврежден или не подходит к изображению
+    STAT_ERR_PAYLOAD,     // в изображении нет корректного сообщения
+    STAT_ERR_MEMORY,      // не хватило памяти
+    STAT_ERR_JOB,         // некорректная строка задания пакета
+    STAT_ERR_OTHER,
+    STAT_ERRORS
+} STAT_ERROR;
+
+typedef struct
+{
+    long long phaseNs[STAT_PHASES];
+    unsigned long long counters[STAT_COUNTERS];
+    long long perf[PERF_EVENTS]; // аппаратные счетчики за время ядер встраивания и извлечения
+    unsigned int perfMask;       // биты (1 << PERF_EVENT) измеренных счетчиков
+    STAT_ERROR error;            // причина первой ошибки операции
+} STATS;
+
+// Замер ядра встраивания/извлечения: время и, если включены, аппаратные счетчики
+typedef struct
+{
+    long long start;
+    long long perf[PERF_EVENTS];
+} STATS_SPAN;
+
+// Гистограмма задержек с относительной погрешностью около 3% (как в HdrHistogram)
+#define STATS_HIST_SUB_BITS 5
+#define STATS_HIST_BUCKETS ((64 - STATS_HIST_SUB_BITS + 1) << STATS_HIST_SUB_BITS)
+
+typedef struct
+{
+    unsigned long long buckets[STATS_HIST_BUCKETS];
+    unsigned long long count;
+    long long sum, max;
+} STATS_HIST;
+
+extern const char *const statPhaseNames[STAT_PHASES];
+extern const char *const statErrorNames[STAT_ERRORS];
+
+long long stats_now();
+void stats_attach(STATS *s);
+STATS *stats_current();
+void stats_merge(STATS *into, const STATS *from);
+long long stats_start();
+void stats_stop(STAT_PHASE phase, long long start);
+void stats_add(STAT_COUNTER counter, unsigned long long n);
+void stats_alloc(unsigned long long bytes);
+void stats_release(unsigned long long bytes);
+long long stats_inflight_bytes();
+void stats_error(STAT_ERROR cause);
+void stats_enable_perf();
+void stats_kernel_start(STATS_SPAN *span);
+void stats_kernel_stop(STAT_PHASE phase, const STATS_SPAN *span);
+void stats_print(FILE *out, const STATS *s);
+void stats_print_json(FILE *out, const STATS *s);
+void stats_hist_record(STATS_HIST *h, long long value);
+long long stats_hist_percentile(const STATS_HIST *h, double p);
+long long stats_hist_count_below(const STATS_HIST *h, long long value);
+void stats_hist_print_json(FILE *out, const STATS_HIST *h);
+
+#endif
\ No newline at end of file
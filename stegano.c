@@ -1,268 +1,459 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Структура BMP
-#pragma pack(push, 1)
-typedef struct
-{
-    unsigned short bfType;      // Тип файла ("BM")
-    unsigned int bfSize;        // Размер файла в байтах
-    unsigned short bfReserved1; // Зарезервировано
-    unsigned short bfReserved2; // Зарезервировано
-    unsigned int bfOffBits;     // Смещение до данных изображения
-
-    unsigned int biSize;         // Размер заголовка BITMAPINFOHEADER (40)
-    int biWidth;                 // Ширина изображения
-    int biHeight;                // Высота изображения
-    unsigned short biPlanes;     // Количество плоскостей (должно быть 1)
-    unsigned short biBitCount;   // Битность (24)
-    unsigned int biCompression;  // Сжатие (0 - без сжатия)
-    unsigned int biSizeImage;    // Размер изображения в байтах
-    int biXPelsPerMeter;         // Горизонтальное разрешение
-    int biYPelsPerMeter;         // Вертикальное разрешение
-    unsigned int biClrUsed;      // Количество используемых цветов
-    unsigned int biClrImportant; // Важность цветов
-} BMPHeader;
-#pragma pack(pop)
-
-/**
- * Загружает BMP изображение из файла.
- * @param filename Имя файла BMP.
- * @param header Указатель на структуру BMPHeader, куда будет сохранена информация о заголовке.
- * @return Указатель на массив данных изображения в памяти или NULL при ошибке.
- */
-unsigned char *load_bmp(const char *filename, BMPHeader *header)
-{
-    FILE *f = fopen(filename, "rb");
-    if (!f)
-    {
-        printf("Failed to open file %s\n", filename);
-        return NULL;
-    }
-
-    fread(header, sizeof(BMPHeader), 1, f);
-
-    if (header->bfType != 0x4D42)
-    { // 'BM' в little-endian
-        printf("This is not a BMP file.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    if (header->biBitCount != 24)
-    {
-        printf("Only 24-bit BMPs are supported.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    fseek(f, header->bfOffBits, SEEK_SET);
-
-    int width = header->biWidth;
-    int height = header->biHeight;
-
-    int row_padded = (width * 3 + 3) & (~3);
-
-    unsigned char *data = malloc(row_padded * height);
-    if (!data)
-    {
-        printf("Failed to allocate memory.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    fread(data, 1, row_padded * height, f);
-
-    fclose(f);
-
-    return data;
-}
-
-/**
- * Сохраняет BMP изображение в файл.
- * @param filename Имя файла для сохранения BMP.
- * @param header Указатель на структуру BMPHeader с информацией о изображении.
- * @param data Данные изображения для записи.
- * @return 1 при успехе, 0 при ошибке.
- */
-int save_bmp(const char *filename, BMPHeader *header, unsigned char *data)
-{
-    FILE *f = fopen(filename, "wb");
-    if (!f)
-    {
-        printf("Failed to open file for writing %s\n", filename);
-        return 0;
-    }
-
-    fwrite(header, sizeof(BMPHeader), 1, f);
-
-    int width = header->biWidth;
-    int height = header->biHeight;
-
-    int row_padded = (width * 3 + 3) & (~3);
-
-    fwrite(data, 1, row_padded * height, f);
-
-    fclose(f);
-    return 1;
-}
-
-/**
- * Получает общее количество пикселей изображения.
- * @param header Указатель на структуру BMPHeader.
- * @return Общее число пикселей.
- */
-int get_pixel_count(BMPHeader *header)
-{
-    return header->biWidth * header->biHeight;
-}
-
-/**
- * Получает значение определенного бита из символа.
- * @param c Символ-источник.
- * @param pos Позиция бита (от 0 до 7).
- * @return Значение бита (0 или 1).
- */
-int get_bit(char c, int pos)
-{
-    return (c >> pos) & 1;
-}
-
-/**
- * Устанавливает бит в компоненте пикселя (использует только последний бит компоненты R).
- * @param pixel Указатель на байт компоненты пикселя (R).
- * @param bit Значение бита для установки (0 или 1).
- */
-void set_bit_in_pixel(unsigned char *pixel, int bit)
-{
-    pixel[2] = (pixel[2] & 0xFE) | bit;
-}
-
-/**
- * Основная функция стеганографической вставки текста в BMP изображение.
- * Взаимодействует с пользователем для выбора файлов и параметров шифрования.
- * Не возвращает значения. Выполняет операции по внедрению сообщения и сохранению результата.
- * Включает создание файла ключа с параметрами шифрования.
- */
-int stegano()
-{
-    printf("\nBMP Image Text Encryption\n");
-    printf("=========================\n\n");
-
-    char input_filename[256], output_filename[256], key_filename[] = "stegano_key";
-
-    printf("Enter the input BMP filename: ");
-    scanf("%255s", input_filename);
-
-    BMPHeader header;
-
-    unsigned char *data = load_bmp(input_filename, &header);
-    if (!data)
-    {
-        return 1;
-    }
-
-    int width = header.biWidth;
-    int height = header.biHeight;
-
-    int pixel_count = get_pixel_count(&header);
-    size_t max_message_size = pixel_count / 8;
-
-    printf("\nImage loaded successfully!\n");
-    printf("Maximum message size: %zu bytes\n\n", max_message_size);
-
-    while (getchar() != '\n')
-        ;
-    char message[1024];
-
-    printf("Enter a message (max %zu symbols): ", max_message_size);
-    fgets(message, max_message_size + 1, stdin);
-
-    size_t msg_len = strlen(message);
-    if (msg_len > 0 && message[msg_len - 1] == '\n')
-    {
-        message[msg_len - 1] = '\0';
-        msg_len--;
-    }
-
-    if (msg_len > max_message_size)
-    {
-        printf("The message is too long!\n");
-        free(data);
-        return 1;
-    }
-
-    int step;
-    printf("Enter the step to advance through the bitmap: ");
-    scanf("%d", &step);
-
-    size_t total_bits = msg_len * 8;
-
-    if ((total_bits - 1) / step >= pixel_count)
-    {
-        printf("The message is too large for the given image and step.\n");
-        free(data);
-        return 1;
-    }
-
-    size_t message_byte_index = 0;
-    int bit_in_char = 0;
-
-    size_t pixel_index = 0;
-
-    for (size_t i = 0; i < total_bits; i++)
-    {
-        if (pixel_index >= pixel_count)
-        {
-            break;
-        }
-        unsigned char *pixel = &data[pixel_index * 3]; // B G R
-
-        int bit_to_embed = get_bit(message[message_byte_index], bit_in_char);
-
-        set_bit_in_pixel(pixel, bit_to_embed);
-
-        bit_in_char++;
-        if (bit_in_char == 8)
-        {
-            bit_in_char = 0;
-            message_byte_index++;
-        }
-
-        pixel_index += step;
-
-        if (pixel_index >= pixel_count && i != total_bits - 1)
-        {
-            printf("There is not enough space for the entire message.\n");
-            free(data);
-            return 1;
-        }
-    }
-
-    printf("Enter the output BMP filename: ");
-    scanf("%255s", output_filename);
-
-    if (!save_bmp(output_filename, &header, data))
-    {
-        printf("Failed to save image.\n");
-        free(data);
-        return 1;
-    }
-
-    printf("\nImage saved as %s\n", output_filename);
-
-    free(data);
-
-    FILE *keyfile = fopen(key_filename, "w");
-    if (!keyfile)
-    {
-        printf("Failed to open key file '%s' for writing.\n", key_filename);
-        return 1;
-    }
-    fprintf(keyfile, "STEP: %d\nLENGTH: %zu\n", step, msg_len);
-    fclose(keyfile);
-    printf("The key has been saved in the file '%s'.\n", key_filename);
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+#include "stats.h"
+#include "stream.h"
+#include "aead.h"
+#include "stegano.h"
+
+/**
+ * Получает значение определенного бита из символа.
+ * @param c Символ-источник.
+ * @param pos Позиция бита (от 0 до 7).
+ * @return Значение бита (0 или 1).
+ */
+int get_bit(char c, int pos)
+{
+    return (c >> pos) & 1;
+}
+
+/**
+ * Разбирает маску каналов стеганографии: непустое подмножество букв B, G, R в любом порядке.
+ * @param name Строка вида "R", "GR" или "BGR" (без учета регистра).
+ * @return Маска из битов STEGANO_B, STEGANO_G, STEGANO_R или 0, если строка некорректна.
+ */
+int stegano_parse_mask(const char *name)
+{
+    int mask = 0;
+    for (const char *p = name; *p; p++)
+    {
+        int bit = *p == 'B' || *p == 'b' ? STEGANO_B : *p == 'G' || *p == 'g' ? STEGANO_G
+                                                   : *p == 'R' || *p == 'r' ? STEGANO_R
+                                                                            : 0;
+        if (!bit || (mask & bit))
+            return 0;
+        mask |= bit;
+    }
+    return mask;
+}
+
+/**
+ * Записывает маску каналов буквами в порядке B, G, R.
+ * @param mask Маска каналов.
+ * @param name Буфер не меньше чем на 4 символа.
+ */
+void stegano_mask_name(int mask, char *name)
+{
+    int n = 0;
+    if (mask & STEGANO_B)
+        name[n++] = 'B';
+    if (mask & STEGANO_G)
+        name[n++] = 'G';
+    if (mask & STEGANO_R)
+        name[n++] = 'R';
+    name[n] = '\0';
+}
+
+/**
+ * Определяет байты пикселя, в которые встраиваются биты сообщения.
+ *
+ * Байты перечисляются по возрастанию смещения внутри пикселя, поэтому биты
+ * сообщения идут по данным только вперед. У 8-битных изображений единственный
+ * канал - индекс палитры, маска не учитывается.
+ * @param format Формат пикселей.
+ * @param mask Маска каналов.
+ * @param lanes Массив из 3 элементов для смещений байтов.
+ * @return Количество каналов (1..3) или 0, если маска пуста.
+ */
+int stegano_lanes(const BMP_FORMAT *format, int mask, int *lanes)
+{
+    if (!(mask & STEGANO_MASK_ALL) || (mask & ~STEGANO_MASK_ALL))
+        return 0;
+    if (format->bytesPerPixel == 1)
+    {
+        lanes[0] = 0;
+        return 1;
+    }
+
+    int n = 0;
+    if (mask & STEGANO_B)
+        lanes[n++] = format->offset[2];
+    if (mask & STEGANO_G)
+        lanes[n++] = format->offset[1];
+    if (mask & STEGANO_R)
+        lanes[n++] = format->offset[0];
+
+    for (int i = 1; i < n; i++)
+    {
+        for (int j = i; j > 0 && lanes[j - 1] > lanes[j]; j--)
+        {
+            int t = lanes[j];
+            lanes[j] = lanes[j - 1];
+            lanes[j - 1] = t;
+        }
+    }
+    return n;
+}
+
+/**
+ * Сохраняет параметры шифрования (шаг, длину сообщения и каналы) в файл ключа.
+ * Строка MASK записывается только для каналов, отличных от R.
+ * @param key_filename Имя файла ключа.
+ * @param step Шаг обхода пикселей.
+ * @param msg_len Длина сообщения.
+ * @param mask Маска каналов.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int save_stegano_key(const char *key_filename, int step, size_t msg_len, int mask)
+{
+    return save_stegano_key_ecc(key_filename, step, msg_len, mask, 0);
+}
+
+/**
+ * Сохраняет ключ сообщения с кодом Рида-Соломона: строка ECC с числом проверочных байтов
+ * кодового слова (0 - без кода, строка не записывается), длина - размер закодированного сообщения.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int save_stegano_key_ecc(const char *key_filename, int step, size_t msg_len, int mask, int parity)
+{
+    long long t = stats_start();
+    FILE *keyfile = fopen(key_filename, "w");
+    if (!keyfile)
+    {
+        printf("Failed to open key file '%s' for writing.\n", key_filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+    fprintf(keyfile, "STEP: %d\nLENGTH: %zu\n", step, msg_len);
+    // ключ с каналом по умолчанию совпадает с ключами прежних версий
+    if (mask != STEGANO_DEFAULT_MASK)
+    {
+        char name[4];
+        stegano_mask_name(mask, name);
+        fprintf(keyfile, "MASK: %s\n", name);
+    }
+    if (parity)
+        fprintf(keyfile, "ECC: %d\n", parity);
+    stats_add(STAT_BYTES_WRITTEN, ftell(keyfile));
+    fclose(keyfile);
+    stats_stop(STAT_KEY, t);
+    return 1;
+}
+
+/**
+ * Встраивает сообщение в младшие биты байтов lanes каждого step-го пикселя: в каждом
+ * посещенном пикселе lane_count бит подряд.
+ * Вызывается с константными bytes_per_pixel и lane_count, поэтому для каждого формата
+ * пикселей и числа каналов компилятор строит отдельное ядро.
+ */
+static inline int embed_lanes(unsigned char *data, int bytes_per_pixel, const int *lanes, int lane_count, int width,
+                              int row_size, int pixel_count, const char *message, size_t msg_len, int step,
+                              DISTORTION *dist)
+{
+    size_t total_bits = msg_len * 8;
+    size_t pixel_index = 0;
+    size_t i = 0;
+
+    while (i < total_bits)
+    {
+        if (pixel_index >= pixel_count)
+        {
+            printf("There is not enough space for the entire message.\n");
+            return 0;
+        }
+
+        unsigned char *pixel = &data[pixel_index * bytes_per_pixel];
+        for (int j = 0; j < lane_count && i < total_bits; j++, i++)
+        {
+            unsigned char *sample = &pixel[lanes[j]];
+            unsigned char before = *sample;
+
+            *sample = (*sample & 0xFE) | get_bit(message[i >> 3], i & 7);
+
+            // метрики считаются прямо при встраивании: изменяется не больше lane_count байт из 3 * step
+            if (dist)
+                distortion_byte(dist, pixel_index * 3 + lanes[j], row_size, width, before, *sample);
+        }
+
+        pixel_index += step;
+    }
+
+    if (dist)
+        dist->samples = (unsigned long long)pixel_count * 3;
+
+    return 1;
+}
+
+/**
+ * Выбирает ядро по числу каналов для константного формата пикселей.
+ */
+static inline int embed_format(unsigned char *data, int bytes_per_pixel, const int *lanes, int lane_count, int width,
+                               int row_size, int pixel_count, const char *message, size_t msg_len, int step,
+                               DISTORTION *dist)
+{
+    switch (lane_count)
+    {
+    case 1:
+        return embed_lanes(data, bytes_per_pixel, lanes, 1, width, row_size, pixel_count, message, msg_len, step,
+                           dist);
+    case 2:
+        return embed_lanes(data, bytes_per_pixel, lanes, 2, width, row_size, pixel_count, message, msg_len, step,
+                           dist);
+    default:
+        return embed_lanes(data, bytes_per_pixel, lanes, 3, width, row_size, pixel_count, message, msg_len, step,
+                           dist);
+    }
+}
+
+/**
+ * Встраивает сообщение в младшие биты компоненты R каждого step-го пикселя 24-битного изображения.
+ * @param data Пиксельные данные изображения (BGR).
+ * @param width Ширина изображения (нужна только для метрик искажения).
+ * @param pixel_count Общее число пикселей.
+ * @param message Сообщение для скрытия.
+ * @param msg_len Длина сообщения.
+ * @param step Шаг обхода пикселей.
+ * @param dist Накопитель метрик искажения или NULL, если метрики не нужны.
+ * @return 1 при успехе, 0 если сообщение не поместилось.
+ */
+int stegano_embed(unsigned char *data, int width, int pixel_count, const char *message, size_t msg_len, int step,
+                  DISTORTION *dist)
+{
+    static const int red[1] = {2};
+    return embed_lanes(data, 3, red, 1, width, (width * 3 + 3) & (~3), pixel_count, message, msg_len, step, dist);
+}
+
+/**
+ * Встраивает сообщение в изображение любого поддерживаемого формата: в выбранные маской
+ * компоненты 24- и 32-битных пикселей или в индекс палитры 8-битных.
+ * @param format Формат пикселей.
+ * @param data Пиксельные данные в порядке хранения, строки по format->rowSize байт.
+ * @param message Сообщение для скрытия.
+ * @param msg_len Длина сообщения.
+ * @param step Шаг обхода пикселей.
+ * @param mask Маска каналов (STEGANO_B | STEGANO_G | STEGANO_R).
+ * @param dist Накопитель метрик искажения или NULL; метрики считаются только для 24-битных изображений.
+ * @return 1 при успехе, 0 если сообщение не поместилось или маска пуста.
+ */
+int stegano_embed_format(const BMP_FORMAT *format, unsigned char *data, const char *message, size_t msg_len,
+                         int step, int mask, DISTORTION *dist)
+{
+    int width = format->width;
+    int pixel_count = width * format->height;
+    int lanes[3];
+    int lane_count = stegano_lanes(format, mask, lanes);
+    if (!lane_count)
+        return 0;
+
+    switch (format->bytesPerPixel)
+    {
+    case 3:
+        return embed_format(data, 3, lanes, lane_count, width, (int)format->rowSize, pixel_count, message, msg_len,
+                            step, dist);
+    case 4:
+        return embed_format(data, 4, lanes, lane_count, width, 0, pixel_count, message, msg_len, step, NULL);
+    default:
+        return embed_lanes(data, 1, lanes, 1, width, 0, pixel_count, message, msg_len, step, NULL);
+    }
+}
+
+/**
+ * Встраивает сообщение в загруженное изображение с заданным шагом.
+ * @param bmp Изображение, загруженное bmp_load со строками как в файле.
+ * @param message Сообщение для скрытия.
+ * @param step Шаг обхода пикселей.
+ * @param mask Маска каналов (STEGANO_B | STEGANO_G | STEGANO_R).
+ * @param dist Накопитель метрик искажения или NULL, если метрики не нужны.
+ * @return 1 при успехе, 0 если маска некорректна или сообщение не помещается.
+ */
+int stegano_embed_image(BMP_FILE *bmp, const char *message, int step, int mask, DISTORTION *dist)
+{
+    return stegano_embed_bytes(bmp, message, strlen(message), step, mask, dist);
+}
+
+/**
+ * Встраивает msg_len байтов сообщения (в том числе нулевых) в загруженное изображение.
+ * @return 1 при успехе, 0 если маска некорректна или сообщение не помещается.
+ */
+int stegano_embed_bytes(BMP_FILE *bmp, const char *message, size_t msg_len, int step, int mask, DISTORTION *dist)
+{
+    int lanes[3];
+    int lane_count = stegano_lanes(&bmp->format, mask, lanes);
+    if (!lane_count)
+    {
+        printf("Invalid channel mask.\n");
+        stats_error(STAT_ERR_OTHER);
+        return 0;
+    }
+
+    int pixel_count = bmp->format.width * bmp->format.height;
+    size_t visits = (msg_len * 8 + lane_count - 1) / lane_count; // посещаемые пиксели
+
+    if (step <= 0 || msg_len == 0 || (visits - 1) * step >= pixel_count)
+    {
+        printf("The message is too large for the given image and step.\n");
+        stats_error(STAT_ERR_CAPACITY);
+        return 0;
+    }
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    int embedded = stegano_embed_format(&bmp->format, bmp->pixels, message, msg_len, step, mask, dist);
+    stats_kernel_stop(STAT_EMBED, &span);
+    stats_add(STAT_PIXELS, visits);
+    stats_add(STAT_PAYLOAD, msg_len);
+
+    if (!embedded)
+        stats_error(STAT_ERR_CAPACITY);
+    return embedded;
+}
+
+/**
+ * Встраивает сообщение в BMP изображение с заданным шагом и сохраняет результат.
+ * Не взаимодействует с пользователем.
+ * @param input_filename Имя исходного файла BMP.
+ * @param output_filename Имя файла для сохранения результата.
+ * @param message Сообщение для скрытия.
+ * @param step Шаг обхода пикселей.
+ * @param mask Маска каналов (STEGANO_B | STEGANO_G | STEGANO_R).
+ * @param dist Накопитель метрик искажения или NULL, если метрики не нужны.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int stegano_encode(const char *input_filename, const char *output_filename, const char *message, int step, int mask,
+                   DISTORTION *dist)
+{
+    return stegano_encode_bytes(input_filename, output_filename, message, strlen(message), step, mask, dist);
+}
+
+/**
+ * Как stegano_encode, но встраивает msg_len байтов (в том числе нулевых).
+ * С пределом памяти (--max-memory) BMP обрабатывается окнами строк (stream_encode_file).
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int stegano_encode_bytes(const char *input_filename, const char *output_filename, const char *message,
+                         size_t msg_len, int step, int mask, DISTORTION *dist)
+{
+    if (stream_max_memory())
+        return stream_encode_file(input_filename, output_filename, STREAM_STEGANO, message, msg_len, step, mask, 1,
+                                  dist) != 0;
+
+    BMP_FILE bmp;
+    if (!bmp_load(input_filename, &bmp, 0))
+    {
+        return 0;
+    }
+    if (!bmp_prepare_output(&bmp, output_filename) ||
+        !stegano_embed_bytes(&bmp, message, msg_len, step, mask, dist))
+    {
+        bmp_free(&bmp);
+        return 0;
+    }
+
+    if (!bmp_save(output_filename, &bmp))
+    {
+        printf("Failed to save image.\n");
+        bmp_free(&bmp);
+        return 0;
+    }
+
+    bmp_free(&bmp);
+    return 1;
+}
+
+/**
+ * Основная функция стеганографической вставки текста в BMP изображение.
+ * Взаимодействует с пользователем для выбора файлов и параметров шифрования.
+ * Выполняет внедрение сообщения и сохранение результата.
+ * Включает создание файла ключа с параметрами шифрования.
+ * @return 0 при успехе, 1 при ошибке.
+ */
+int stegano()
+{
+    printf("\nBMP Image Text Encryption\n");
+    printf("=========================\n\n");
+
+    char input_filename[256], output_filename[256], key_filename[] = "stegano_key";
+
+    printf("Enter the input BMP filename: ");
+    scanf("%255s", input_filename);
+
+    BMP_HEADER header;
+
+    if (!read_bmp_header(input_filename, &header))
+    {
+        printf("Failed to open file %s or its BMP format is not supported.\n", input_filename);
+        stats_error(STAT_ERR_FORMAT);
+        return 1;
+    }
+
+    int pixel_count = (int)bmp_pixel_count(&header);
+    size_t max_message_size = pixel_count / 8;
+
+    printf("\nImage loaded successfully!\n");
+    printf("Maximum message size: %zu bytes\n\n", max_message_size);
+
+    while (getchar() != '\n')
+        ;
+    char message[1024];
+
+    printf("Enter a message (max %zu symbols): ", max_message_size);
+    fgets(message, max_message_size + 1, stdin);
+
+    size_t msg_len = strlen(message);
+    if (msg_len > 0 && message[msg_len - 1] == '\n')
+    {
+        message[msg_len - 1] = '\0';
+        msg_len--;
+    }
+
+    // с глобальным --passphrase-file встраивается зашифрованное сообщение
+    const char *passphrase = aead_passphrase();
+    char *sealed = passphrase ? aead_seal_text(passphrase, message) : NULL;
+    if (passphrase && !sealed)
+        return 1;
+    const char *payload = sealed ? sealed : message;
+    msg_len = strlen(payload);
+
+    if (msg_len > max_message_size)
+    {
+        printf("The message is too long!\n");
+        free(sealed);
+        return 1;
+    }
+
+    int step;
+    printf("Enter the step to advance through the bitmap: ");
+    scanf("%d", &step);
+
+    size_t total_bits = msg_len * 8;
+
+    if (step <= 0 || (total_bits - 1) / step >= pixel_count)
+    {
+        printf("The message is too large for the given image and step.\n");
+        stats_error(STAT_ERR_CAPACITY);
+        free(sealed);
+        return 1;
+    }
+
+    printf("Enter the output BMP filename: ");
+    scanf("%255s", output_filename);
+
+    int ok = stegano_encode(input_filename, output_filename, payload, step, STEGANO_DEFAULT_MASK, NULL);
+    free(sealed);
+    if (!ok)
+    {
+        return 1;
+    }
+
+    printf("\nImage saved as %s\n", output_filename);
+
+    if (!save_stegano_key(key_filename, step, msg_len, STEGANO_DEFAULT_MASK))
+    {
+        return 1;
+    }
+    printf("The key has been saved in the file '%s'.\n", key_filename);
+
+    return 0;
+}
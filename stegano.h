@@ -1,6 +1,32 @@
-#ifndef STEGANO_H
-#define STEGANO_H
-
-int stegano();
-
+#ifndef STEGANO_H
+#define STEGANO_H
+
+#include <stddef.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+
+// Каналы, в младшие биты которых встраивается сообщение (маска - любое непустое подмножество)
+#define STEGANO_B 1
+#define STEGANO_G 2
+#define STEGANO_R 4
+#define STEGANO_MASK_ALL (STEGANO_B | STEGANO_G | STEGANO_R)
+#define STEGANO_DEFAULT_MASK STEGANO_R
+
+int stegano_embed(unsigned char *data, int width, int pixel_count, const char *message, size_t msg_len, int step,
+                  DISTORTION *dist);
+int stegano_embed_format(const BMP_FORMAT *format, unsigned char *data, const char *message, size_t msg_len,
+                         int step, int mask, DISTORTION *dist);
+int stegano_parse_mask(const char *name);
+void stegano_mask_name(int mask, char *name);
+int stegano_lanes(const BMP_FORMAT *format, int mask, int *lanes);
+int save_stegano_key(const char *key_filename, int step, size_t msg_len, int mask);
+int save_stegano_key_ecc(const char *key_filename, int step, size_t msg_len, int mask, int parity);
+int stegano_embed_image(BMP_FILE *bmp, const char *message, int step, int mask, DISTORTION *dist);
+int stegano_embed_bytes(BMP_FILE *bmp, const char *message, size_t msg_len, int step, int mask, DISTORTION *dist);
+int stegano_encode(const char *input_filename, const char *output_filename, const char *message, int step, int mask,
+                   DISTORTION *dist);
+int stegano_encode_bytes(const char *input_filename, const char *output_filename, const char *message,
+                         size_t msg_len, int step, int mask, DISTORTION *dist);
+int stegano();
+
 #endif
\ No newline at end of file
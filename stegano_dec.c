@@ -1,217 +1,295 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Структура BMP
-#pragma pack(push, 1)
-typedef struct
-{
-    unsigned short bfType;      // Тип файла ("BM")
-    unsigned int bfSize;        // Размер файла в байтах
-    unsigned short bfReserved1; // Зарезервировано
-    unsigned short bfReserved2; // Зарезервировано
-    unsigned int bfOffBits;     // Смещение до данных изображения
-
-    unsigned int biSize;         // Размер заголовка BITMAPINFOHEADER (40)
-    int biWidth;                 // Ширина изображения
-    int biHeight;                // Высота изображения
-    unsigned short biPlanes;     // Количество плоскостей (должно быть 1)
-    unsigned short biBitCount;   // Битность (24)
-    unsigned int biCompression;  // Сжатие (0 - без сжатия)
-    unsigned int biSizeImage;    // Размер изображения в байтах
-    int biXPelsPerMeter;         // Горизонтальное разрешение
-    int biYPelsPerMeter;         // Вертикальное разрешение
-    unsigned int biClrUsed;      // Количество используемых цветов
-    unsigned int biClrImportant; // Важность цветов
-} BMPHeader;
-#pragma pack(pop)
-
-/**
- * @brief Загружает BMP изображение из файла.
- *
- * Открывает файл, читает заголовок BMP и данные пикселей.
- * Поддерживаются только 24-битные BMP файлы без сжатия.
- *
- * @param filename Имя файла BMP.
- * @param header Указатель на структуру BMPHeader, куда будет сохранена информация о файле.
- * @return Указатель на массив данных пикселей (BGR), или NULL при ошибке.
- */
-unsigned char *loadbmp(const char *filename, BMPHeader *header)
-{
-    FILE *f = fopen(filename, "rb");
-    if (!f)
-    {
-        printf("Failed to open file %s\n", filename);
-        return NULL;
-    }
-
-    fread(header, sizeof(BMPHeader), 1, f);
-
-    if (header->bfType != 0x4D42)
-    {
-        printf("This is not a BMP file.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    if (header->biBitCount != 24)
-    {
-        printf("Only 24-bit BMPs are supported.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    fseek(f, header->bfOffBits, SEEK_SET);
-
-    int width = header->biWidth;
-    int height = header->biHeight;
-
-    int row_padded = (width * 3 + 3) & (~3);
-
-    unsigned char *data = malloc(row_padded * height);
-    if (!data)
-    {
-        printf("Failed to allocate memory.\n");
-        fclose(f);
-        return NULL;
-    }
-
-    fread(data, 1, row_padded * height, f);
-
-    fclose(f);
-    return data;
-}
-
-/**
- * @brief Получает значение бита из символа по позиции.
- *
- * @param c Символ-источник.
- * @param pos Позиция бита (0 - младший бит).
- * @return Значение бита (0 или 1).
- */
-int getbit(char c, int pos)
-{
-    return (c >> pos) & 1;
-}
-
-/**
- * @brief Расшифровывает скрытое сообщение из BMP изображения по ключу.
- *
- * Загружает изображение и ключевой файл. Извлекает закодированное сообщение,
- * основываясь на параметрах шага и длины сообщения из ключа.
- *
- * @param image_filename Имя файла BMP с скрытым сообщением.
- * @param key_filename Имя файла ключа, содержащего параметры шага и длины сообщения.
- */
-void decode_message(const char *image_filename, const char *key_filename)
-{
-    BMPHeader header;
-
-    unsigned char *data = loadbmp(image_filename, &header);
-
-    if (!data)
-        return;
-
-    int width = header.biWidth;
-    int height = header.biHeight;
-
-    int pixel_count = width * height;
-
-    FILE *keyfile = fopen(key_filename, "r");
-    if (!keyfile)
-    {
-        printf("Failed to open key file.\n");
-        free(data);
-        return;
-    }
-
-    int step;
-    size_t msg_len;
-
-    char line[100];
-    while (fgets(line, sizeof(line), keyfile))
-    {
-        if (sscanf(line, "STEP: %d", &step) == 1)
-            continue;
-        if (sscanf(line, "LENGTH: %zu", &msg_len) == 1)
-            continue;
-    }
-    fclose(keyfile);
-
-    size_t total_bits = msg_len * 8;
-
-    if ((total_bits - 1) / step >= pixel_count)
-    {
-        printf("The message length exceeds the capacity of the image with the given step.\n");
-        free(data);
-        return;
-    }
-
-    char decoded_message[msg_len + 1];
-    memset(decoded_message, 0, sizeof(decoded_message));
-
-    size_t message_byte_index = 0;
-    int bit_in_char = 0;
-
-    size_t pixel_index = 0;
-
-    for (size_t i = 0; i < total_bits; i++)
-    {
-        if (pixel_index >= pixel_count)
-            break;
-
-        unsigned char *pixel = &data[pixel_index * 3]; // B G R
-
-        int bit_extracted = pixel[2] & 1;
-
-        decoded_message[message_byte_index] |= (bit_extracted << bit_in_char);
-
-        bit_in_char++;
-        if (bit_in_char == 8)
-        {
-            bit_in_char = 0;
-            message_byte_index++;
-        }
-
-        pixel_index += step;
-
-        if (pixel_index >= pixel_count && i != total_bits - 1)
-        {
-            printf("Reached end of image before decoding full message.\n");
-            break;
-        }
-    }
-
-    printf("\n==================\n");
-    printf("Decrypted message:\n\n");
-
-    decoded_message[msg_len] = '\0';
-
-    printf("%s\n", decoded_message);
-
-    free(data);
-}
-
-/**
- * @brief Основная функция декодирования стеганографического сообщения из BMP файла.
- *
- * Запрашивает у пользователя имя файла изображения и вызывает функцию декодирования.
- *
- * @return Код завершения программы.
- */
-int stegano_dec()
-{
-    char image_filename[256];
-    const char *key_filename = "stegano_key";
-
-    printf("\nBMP Image Text Decryption\n");
-    printf("=========================\n\n");
-
-    printf("Enter encrypted BMP filename: ");
-    scanf("%255s", image_filename);
-    printf("Image loaded successfully!\n");
-
-    decode_message(image_filename, key_filename);
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "stats.h"
+#include "stegano.h"
+#include "stream.h"
+#include "aead.h"
+#include "stegano_dec.h"
+#include "ecc.h"
+
+/**
+ * @brief Получает значение бита из символа по позиции.
+ *
+ * @param c Символ-источник.
+ * @param pos Позиция бита (0 - младший бит).
+ * @return Значение бита (0 или 1).
+ */
+int getbit(char c, int pos)
+{
+    return (c >> pos) & 1;
+}
+
+/**
+ * @brief Извлекает биты сообщения из младших бит байтов lanes каждого step-го пикселя
+ * (порядок бит - как в embed_lanes из stegano.c).
+ *
+ * Вызывается с константными bytes_per_pixel и lane_count, поэтому для каждого формата
+ * пикселей и числа каналов компилятор строит отдельное ядро.
+ */
+static inline int extract_lanes(const unsigned char *data, int bytes_per_pixel, const int *lanes, int lane_count,
+                                int pixel_count, char *decoded_message, size_t msg_len, int step)
+{
+    size_t total_bits = msg_len * 8;
+    size_t pixel_index = 0;
+    size_t i = 0;
+
+    while (i < total_bits)
+    {
+        if (pixel_index >= pixel_count)
+        {
+            printf("Reached end of image before decoding full message.\n");
+            return 0;
+        }
+
+        const unsigned char *pixel = &data[pixel_index * bytes_per_pixel];
+        for (int j = 0; j < lane_count && i < total_bits; j++, i++)
+            decoded_message[i >> 3] |= (pixel[lanes[j]] & 1) << (i & 7);
+
+        pixel_index += step;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Выбирает ядро по числу каналов для константного формата пикселей.
+ */
+static inline int extract_format(const unsigned char *data, int bytes_per_pixel, const int *lanes, int lane_count,
+                                 int pixel_count, char *decoded_message, size_t msg_len, int step)
+{
+    switch (lane_count)
+    {
+    case 1:
+        return extract_lanes(data, bytes_per_pixel, lanes, 1, pixel_count, decoded_message, msg_len, step);
+    case 2:
+        return extract_lanes(data, bytes_per_pixel, lanes, 2, pixel_count, decoded_message, msg_len, step);
+    default:
+        return extract_lanes(data, bytes_per_pixel, lanes, 3, pixel_count, decoded_message, msg_len, step);
+    }
+}
+
+/**
+ * @brief Извлекает биты сообщения из компоненты R каждого step-го пикселя 24-битного изображения.
+ *
+ * @param data Пиксельные данные изображения (BGR).
+ * @param pixel_count Общее число пикселей.
+ * @param decoded_message Буфер для сообщения из msg_len байт, заполненный нулями.
+ * @param msg_len Длина сообщения.
+ * @param step Шаг обхода пикселей.
+ * @return 1 если сообщение извлечено целиком, 0 если изображение закончилось раньше.
+ */
+int stegano_extract(const unsigned char *data, int pixel_count, char *decoded_message, size_t msg_len, int step)
+{
+    static const int red[1] = {2};
+    return extract_lanes(data, 3, red, 1, pixel_count, decoded_message, msg_len, step);
+}
+
+/**
+ * @brief Извлекает биты сообщения из изображения любого поддерживаемого формата:
+ * из выбранных маской компонент 24- и 32-битных пикселей или из индекса палитры 8-битных.
+ *
+ * @param format Формат пикселей.
+ * @param data Пиксельные данные в порядке хранения, строки с выравниванием.
+ * @param decoded_message Буфер для сообщения из msg_len байт, заполненный нулями.
+ * @param msg_len Длина сообщения.
+ * @param step Шаг обхода пикселей.
+ * @param mask Маска каналов из ключа.
+ * @return 1 если сообщение извлечено целиком, 0 если изображение закончилось раньше или маска пуста.
+ */
+int stegano_extract_format(const BMP_FORMAT *format, const unsigned char *data, char *decoded_message, size_t msg_len,
+                           int step, int mask)
+{
+    int pixel_count = format->width * format->height;
+    int lanes[3];
+    int lane_count = stegano_lanes(format, mask, lanes);
+    if (!lane_count)
+        return 0;
+
+    switch (format->bytesPerPixel)
+    {
+    case 3:
+        return extract_format(data, 3, lanes, lane_count, pixel_count, decoded_message, msg_len, step);
+    case 4:
+        return extract_format(data, 4, lanes, lane_count, pixel_count, decoded_message, msg_len, step);
+    default:
+        return extract_lanes(data, 1, lanes, 1, pixel_count, decoded_message, msg_len, step);
+    }
+}
+
+/**
+ * @brief Читает шаг, длину сообщения и маску каналов из файла ключа.
+ *
+ * Ключи без строки MASK относятся к каналу R.
+ *
+ * @param key_filename Имя файла ключа.
+ * @param step Указатель для сохранения шага.
+ * @param msg_len Указатель для сохранения длины сообщения.
+ * @param mask Указатель для сохранения маски каналов.
+ * @param ecc Указатель для сохранения числа проверочных байтов кода Рида-Соломона (0 - сообщение без кода).
+ * @return 1 если ключ прочитан и корректен, иначе 0.
+ */
+int load_stegano_key(const char *key_filename, int *step, size_t *msg_len, int *mask, int *ecc)
+{
+    long long t = stats_start();
+    FILE *keyfile = fopen(key_filename, "r");
+    if (!keyfile)
+    {
+        printf("Failed to open key file.\n");
+        stats_error(STAT_ERR_KEY_MISSING);
+        return 0;
+    }
+
+    *step = 0;
+    *msg_len = 0;
+    *mask = STEGANO_DEFAULT_MASK;
+    *ecc = 0;
+
+    char line[100], name[8];
+    while (fgets(line, sizeof(line), keyfile))
+    {
+        if (sscanf(line, "STEP: %d", step) == 1)
+            continue;
+        if (sscanf(line, "LENGTH: %zu", msg_len) == 1)
+            continue;
+        if (sscanf(line, "ECC: %d", ecc) == 1)
+            continue;
+        if (sscanf(line, "MASK: %7s", name) == 1)
+            *mask = stegano_parse_mask(name);
+    }
+    stats_add(STAT_BYTES_READ, ftell(keyfile));
+    fclose(keyfile);
+    stats_stop(STAT_KEY, t);
+
+    if (*step <= 0 || *msg_len == 0 || !*mask || (*ecc && !ecc_valid_parity(*ecc)))
+    {
+        printf("Invalid key file.\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Загружает изображение целиком и извлекает msg_len байтов сообщения.
+ */
+static char *extract_file(const char *image_filename, int step, int mask, size_t msg_len)
+{
+    BMP_FILE bmp;
+    if (!bmp_load(image_filename, &bmp, 0))
+        return NULL;
+
+    int pixel_count = bmp.format.width * bmp.format.height;
+    int lanes[3];
+    int lane_count = stegano_lanes(&bmp.format, mask, lanes);
+    size_t visits = (msg_len * 8 + lane_count - 1) / lane_count; // посещаемые пиксели
+
+    if ((visits - 1) * step >= pixel_count)
+    {
+        printf("The message length exceeds the capacity of the image with the given step.\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        bmp_free(&bmp);
+        return NULL;
+    }
+
+    char *decoded_message = calloc(msg_len + 1, 1);
+    if (!decoded_message)
+    {
+        stats_error(STAT_ERR_MEMORY);
+        bmp_free(&bmp);
+        return NULL;
+    }
+    stats_alloc(msg_len + 1);
+
+    STATS_SPAN span;
+    stats_kernel_start(&span);
+    stegano_extract_format(&bmp.format, bmp.pixels, decoded_message, msg_len, step, mask);
+    stats_kernel_stop(STAT_EXTRACT, &span);
+    stats_add(STAT_PIXELS, visits);
+    bmp_free(&bmp);
+    return decoded_message;
+}
+
+/**
+ * @brief Извлекает скрытое сообщение из BMP изображения по ключу (без вывода результата).
+ *
+ * Загружает изображение и ключевой файл. Извлекает закодированное сообщение,
+ * основываясь на параметрах шага, длины сообщения и каналов из ключа (ключи без
+ * строки MASK относятся к каналу R). Если в ключе есть строка ECC, извлеченное
+ * сообщение проверяется и исправляется кодом Рида-Соломона. С пределом памяти
+ * (--max-memory) BMP читается окнами строк (stream_decode_file).
+ *
+ * @param image_filename Имя файла BMP с скрытым сообщением.
+ * @param key_filename Имя файла ключа, содержащего параметры шага и длины сообщения.
+ * @return Указатель на строку с сообщением (необходимо освободить) или NULL при ошибке.
+ */
+char *stegano_decode(const char *image_filename, const char *key_filename)
+{
+    int step, mask, ecc;
+    size_t msg_len;
+
+    if (!load_stegano_key(key_filename, &step, &msg_len, &mask, &ecc))
+        return NULL;
+
+    char *decoded_message = stream_max_memory()
+                                ? stream_decode_file(image_filename, STREAM_STEGANO, step, mask, &msg_len)
+                                : extract_file(image_filename, step, mask, msg_len);
+    if (!decoded_message)
+        return NULL;
+
+    if (ecc)
+    {
+        unsigned char *coded = (unsigned char *)decoded_message;
+        decoded_message = (char *)ecc_decode(coded, msg_len, &msg_len, NULL);
+        free(coded);
+        if (!decoded_message)
+            return NULL;
+    }
+    stats_add(STAT_PAYLOAD, msg_len);
+    return decoded_message;
+}
+
+/**
+ * @brief Расшифровывает скрытое сообщение из BMP изображения по ключу и выводит его.
+ *
+ * @param image_filename Имя файла BMP с скрытым сообщением.
+ * @param key_filename Имя файла ключа, содержащего параметры шага и длины сообщения.
+ * @return 1 если сообщение извлечено, 0 при ошибке.
+ */
+static int decode_message(const char *image_filename, const char *key_filename)
+{
+    char *decoded_message = aead_open_message(stegano_decode(image_filename, key_filename), aead_passphrase());
+    if (!decoded_message)
+        return 0;
+
+    printf("\n==================\n");
+    printf("Decrypted message:\n\n");
+
+    printf("%s\n", decoded_message);
+
+    free(decoded_message);
+    return 1;
+}
+
+/**
+ * @brief Основная функция декодирования стеганографического сообщения из BMP файла.
+ *
+ * Запрашивает у пользователя имя файла изображения и вызывает функцию декодирования.
+ *
+ * @return 0 при успехе, 1 если сообщение не извлечено.
+ */
+int stegano_dec()
+{
+    char image_filename[256];
+    const char *key_filename = "stegano_key";
+
+    printf("\nBMP Image Text Decryption\n");
+    printf("=========================\n\n");
+
+    printf("Enter encrypted BMP filename: ");
+    scanf("%255s", image_filename);
+    printf("Image loaded successfully!\n");
+
+    return decode_message(image_filename, key_filename) ? 0 : 1;
+}
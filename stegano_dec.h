@@ -1,6 +1,14 @@
-#ifndef STEGANO_DEC_H
-#define STEGANO_DEC_H
-
-int stegano_dec();
-
+#ifndef STEGANO_DEC_H
+#define STEGANO_DEC_H
+
+#include <stddef.h>
+#include "bmpinfo.h"
+
+int stegano_extract(const unsigned char *data, int pixel_count, char *decoded_message, size_t msg_len, int step);
+int stegano_extract_format(const BMP_FORMAT *format, const unsigned char *data, char *decoded_message, size_t msg_len,
+                           int step, int mask);
+int load_stegano_key(const char *key_filename, int *step, size_t *msg_len, int *mask, int *ecc);
+char *stegano_decode(const char *image_filename, const char *key_filename);
+int stegano_dec();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1089 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+#include "bmpinfo.h"
+#include "png.h"
+#include "simple.h"
+#include "stegano.h"
+#include "stats.h"
+#include "aead.h"
+#include "stream.h"
+
+#define STREAM_TILE (256 * 1024) // размер буфера строк, байт
+
+// Подстановка цветов обрабатывается окнами строк только через файлы (--max-memory):
+// начало сообщения выбирается случайно, поэтому изображение нельзя читать из канала
+#define STREAM_COLOR 2
+
+static long long streamMaxMemory = 0; // предел памяти операции над изображением (--max-memory), 0 - без предела
+static int streamWorkers = 1;         // операции, одновременно расходующие этот предел
+
+/**
+ * @brief Состояние обхода бит сообщения: номер следующего бита и байт, в который он попадает.
+ *
+ * Оба метода встраивают биты в порядке возрастания смещений байтов в пиксельных
+ * данных, поэтому сообщение обрабатывается по мере чтения строк изображения.
+ */
+typedef struct
+{
+    int method;        // STREAM_SIMPLE, STREAM_STEGANO или STREAM_COLOR
+    int step;          // шаг обхода пикселей стеганографии
+    int depth;         // глубина встраивания текста метода прямого шифрования
+    int bytesPerPixel; // 1, 3 или 4
+    int channels[3];   // байты каналов стеганографии (по возрастанию смещения) или подстановки цветов
+    int channelCount;  // количество каналов стеганографии или подстановки цветов (1..3)
+    int lane[3];       // байты каналов B, G, R метода прямого шифрования у 32-битных пикселей
+    const char *text;  // встраиваемое сообщение или NULL при извлечении
+    char *decoded;     // извлекаемое сообщение
+    size_t msgLen;
+    long long bit;       // номер следующего бита
+    long long totalBits; // количество бит с префиксом длины и дополнением до целого байта канала
+    long long limit;     // количество бит, которое вмещает изображение
+    long long start;     // пиксель начала сообщения подстановки цветов (строки без выравнивания)
+    int width;
+    long long rowSize;
+    int packed;       // результат как у изображения без выравнивания: байты выравнивания обнуляются
+    DISTORTION *dist; // метрики искажения (только 24-битные изображения) или NULL
+    int rawPrefix;    // префикс прямого шифрования только накапливается в msgLen, без проверки
+    int failed;
+} STREAM_CURSOR;
+
+/**
+ * @brief Смещение байта, в который попадает бит сообщения, от начала пиксельных данных.
+ *
+ * Префикс метода прямого шифрования занимает по одному биту 32 байтов, текст - по
+ * depth бит следующих байтов.
+ */
+static long long stream_offset(const STREAM_CURSOR *c, long long bit)
+{
+    if (c->method == STREAM_COLOR)
+    {
+        long long pixel = c->start + bit / c->channelCount;
+        return pixel / c->width * c->rowSize + pixel % c->width * c->bytesPerPixel + c->channels[bit % c->channelCount];
+    }
+    if (c->method == STREAM_STEGANO)
+        return bit / c->channelCount * c->step * c->bytesPerPixel + c->channels[bit % c->channelCount];
+    long long sample = bit < 32 ? bit : 32 + (bit - 32) / c->depth;
+    if (c->bytesPerPixel == 4)
+        return sample / 3 * 4 + c->lane[sample % 3];
+    return sample;
+}
+
+/**
+ * @brief Номер бита внутри байта: первый бит группы из depth бит попадает в старший из них.
+ */
+static int stream_shift(const STREAM_CURSOR *c, long long bit)
+{
+    if (c->method != STREAM_SIMPLE || bit < 32)
+        return 0;
+    return c->depth - 1 - (int)((bit - 32) % c->depth);
+}
+
+/**
+ * @brief Значение встраиваемого бита: у метода прямого шифрования сначала 32 бита префикса
+ * и символы от старшего бита (за текстом - нулевое дополнение последнего байта канала),
+ * у стеганографии и подстановки цветов символы от младшего бита (у подстановки цветов
+ * за текстом - завершающий нулевой байт).
+ */
+static int stream_bit(const STREAM_CURSOR *c, long long bit)
+{
+    if (c->method == STREAM_COLOR)
+        return bit < 8 * (long long)c->msgLen ? (c->text[bit >> 3] >> (bit & 7)) & 1 : 0;
+    if (c->method == STREAM_STEGANO)
+        return (c->text[bit >> 3] >> (bit & 7)) & 1;
+    if (bit < 32)
+    {
+        return (simplePrefix((int)c->msgLen, c->depth) >> (31 - bit)) & 1;
+    }
+    bit -= 32;
+    if (bit >= 8 * (long long)c->msgLen)
+        return 0;
+    return (c->text[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/**
+ * @brief Принимает извлеченный бит. После 32 бит префикса метода прямого шифрования
+ * проверяет длину и глубину и выделяет буфер для сообщения.
+ */
+static void stream_collect(STREAM_CURSOR *c, long long bit, int value)
+{
+    if (c->method != STREAM_SIMPLE)
+    {
+        c->decoded[bit >> 3] |= value << (bit & 7);
+        // подстановка цветов, как extract_Message, заканчивает сообщение на нулевом байте
+        if (c->method == STREAM_COLOR && (bit & 7) == 7 && c->decoded[bit >> 3] == 0)
+            c->totalBits = bit + 1;
+        return;
+    }
+
+    if (bit >= 32)
+    {
+        bit -= 32;
+        c->decoded[bit >> 3] = (c->decoded[bit >> 3] << 1) | value;
+        return;
+    }
+
+    c->msgLen = (c->msgLen << 1) | value;
+    if (bit < 31 || c->rawPrefix)
+        return;
+
+    long long len = c->msgLen & SIMPLE_LEN_MASK;
+    c->depth = (int)(c->msgLen >> SIMPLE_DEPTH_SHIFT) + 1;
+    // длина ограничена только емкостью изображения при этой глубине, как при встраивании
+    if (len <= 0 || c->depth > SIMPLE_MAX_DEPTH || simpleSamples((int)len, c->depth) > c->limit)
+    {
+        fprintf(stderr, "Error: Invalid text length detected: %lld characters at bit depth %d\n", len, c->depth);
+        stats_error(STAT_ERR_PAYLOAD);
+        c->failed = 1;
+        return;
+    }
+
+    c->decoded = calloc(len + 1, 1);
+    if (!c->decoded)
+    {
+        stats_error(STAT_ERR_MEMORY);
+        c->failed = 1;
+        return;
+    }
+    c->msgLen = (size_t)len;
+    c->totalBits = 32 + 8 * len;
+}
+
+/**
+ * @brief Встраивает или извлекает все биты, байты которых попадают в очередной тайл.
+ *
+ * @param c Состояние обхода.
+ * @param tile Строки изображения.
+ * @param start Смещение тайла от начала пиксельных данных.
+ * @param size Размер тайла в байтах (целое число строк).
+ */
+static void stream_tile(STREAM_CURSOR *c, unsigned char *tile, long long start, long long size)
+{
+    long long end = start + size;
+    long long changed = -1; // байт, для которого копятся метрики: биты одного байта идут подряд
+    unsigned char before = 0;
+    while (c->bit < c->totalBits && !c->failed)
+    {
+        // у 32-битных пикселей и у подстановки цветов байты каналов могут идти не по
+        // возрастанию, но строка состоит из целых пикселей, поэтому все биты пикселя
+        // попадают в один тайл
+        long long pos = stream_offset(c, c->bit);
+        if (pos >= end)
+            break;
+
+        unsigned char *sample = tile + (pos - start);
+        int shift = stream_shift(c, c->bit);
+        if (c->text)
+        {
+            if (c->dist && pos != changed)
+            {
+                if (changed >= 0)
+                    distortion_byte(c->dist, changed, c->rowSize, c->width, before, tile[changed - start]);
+                changed = pos;
+                before = *sample;
+            }
+            *sample = (*sample & ~(1 << shift)) | stream_bit(c, c->bit) << shift;
+        }
+        else
+            stream_collect(c, c->bit, (*sample >> shift) & 1);
+        c->bit++;
+    }
+    if (changed >= 0)
+        distortion_byte(c->dist, changed, c->rowSize, c->width, before, tile[changed - start]);
+}
+
+/**
+ * @brief Читает заголовки BMP из потока и определяет формат пикселей.
+ *
+ * @param in Входной поток, позиция - начало файла.
+ * @param format Указатель для сохранения формата.
+ * @return Заголовки, маски и палитра (format->dataOffset байт; необходимо освободить) или NULL при ошибке.
+ */
+static unsigned char *stream_header(FILE *in, BMP_FORMAT *format)
+{
+    BMP_HEADER header;
+    size_t n = fread(&header, 1, sizeof(header), in);
+    if (png_signature((const unsigned char *)&header, n))
+    {
+        fprintf(stderr, "Error: PNG carriers cannot be streamed; pass the PNG file by name\n");
+        stats_error(STAT_ERR_FORMAT);
+        return NULL;
+    }
+
+    if (n != sizeof(header) || header.bfType != 0x4D42 || header.bfOffBits < sizeof(header) ||
+        header.bfOffBits > BMP_MAX_PREFIX)
+    {
+        fprintf(stderr, "Error: Input is not a BMP file\n");
+        stats_error(STAT_ERR_FORMAT);
+        return NULL;
+    }
+
+    unsigned char *prefix = malloc(header.bfOffBits);
+    if (!prefix)
+    {
+        stats_error(STAT_ERR_MEMORY);
+        return NULL;
+    }
+    memcpy(prefix, &header, sizeof(header));
+
+    size_t rest = header.bfOffBits - sizeof(header);
+    if (fread(prefix + sizeof(header), 1, rest, in) != rest || !bmp_parse_format(prefix, header.bfOffBits, format))
+    {
+        fprintf(stderr,
+                "Error: Unsupported BMP format (%d-bit, compression %u); "
+                "8-bit, 24-bit and 32-bit uncompressed BMPs are supported\n",
+                header.biBitCount, header.biCompression);
+        stats_error(STAT_ERR_FORMAT);
+        free(prefix);
+        return NULL;
+    }
+    stats_add(STAT_BYTES_READ, header.bfOffBits);
+    return prefix;
+}
+
+/**
+ * @brief Заполняет состояние обхода для формата изображения.
+ *
+ * @return 1 при успехе, 0 если маска каналов стеганографии пуста или некорректна.
+ */
+static int stream_cursor_init(STREAM_CURSOR *c, const BMP_FORMAT *format, int method, int step, int mask)
+{
+    memset(c, 0, sizeof(*c));
+    c->method = method;
+    c->step = step;
+    c->depth = 1;
+    c->bytesPerPixel = format->bytesPerPixel;
+    c->channelCount = method == STREAM_STEGANO ? stegano_lanes(format, mask, c->channels) : 1;
+    c->lane[0] = format->offset[2];
+    c->lane[1] = format->offset[1];
+    c->lane[2] = format->offset[0];
+    c->width = format->width;
+    c->rowSize = format->rowSize;
+    if (method == STREAM_COLOR)
+    {
+        // порядок каналов hideMessage: R, G, B у 24-битных пикселей, по маскам у 32-битных
+        static const int bgr24[3] = {2, 1, 0};
+        c->channelCount = format->channels;
+        for (int i = 0; i < c->channelCount; i++)
+            c->channels[i] = format->bytesPerPixel == 3 ? bgr24[i] : format->bytesPerPixel == 4 ? format->offset[i] : 0;
+    }
+
+    long long pixelCount = (long long)format->width * format->height;
+    if (method == STREAM_COLOR)
+        c->limit = pixelCount * c->channelCount;
+    else if (method == STREAM_STEGANO)
+        c->limit = step > 0 ? (pixelCount + step - 1) / step * c->channelCount : 0;
+    else
+        c->limit = pixelCount * format->channels;
+    return c->channelCount > 0;
+}
+
+/**
+ * @brief Размер буфера строк: STREAM_TILE, а с --max-memory не больше доли предела
+ * на одну операцию за вычетом заголовков и буферов stdio.
+ */
+static long long stream_window()
+{
+    if (!streamMaxMemory)
+        return STREAM_TILE;
+    long long share = streamMaxMemory / streamWorkers - STREAM_RESERVE;
+    return share < STREAM_TILE ? share : STREAM_TILE;
+}
+
+/**
+ * @brief Прогоняет пиксельные данные через буфер фиксированного размера.
+ *
+ * Строки читаются тайлами по stream_window() байт (без предела памяти - не меньше
+ * одной строки), в каждом тайле встраиваются или извлекаются биты сообщения, затем
+ * тайл записывается в выходной поток. Без выходного потока чтение прекращается, как
+ * только извлечены все биты. Недостающие в конце входа байты считаются нулевыми, как в bmp_load.
+ *
+ * @return 1 при успехе, 0 при ошибке.
+ */
+static int stream_pixels(FILE *in, FILE *out, const BMP_FORMAT *format, STREAM_CURSOR *c)
+{
+    long long rowSize = format->rowSize;
+    long long window = stream_window();
+    if (streamMaxMemory && rowSize > window)
+    {
+        fprintf(stderr, "Error: An image row of %lld bytes does not fit into the memory limit\n", rowSize);
+        stats_error(STAT_ERR_MEMORY);
+        c->failed = 1;
+        return 0;
+    }
+    long long tileRows = window / rowSize;
+    if (tileRows < 1)
+        tileRows = 1;
+    if (tileRows > format->height)
+        tileRows = format->height;
+
+    unsigned char *tile = malloc(tileRows * rowSize);
+    if (!tile)
+    {
+        fprintf(stderr, "Error: Not enough memory for a %lld-byte row buffer\n", tileRows * rowSize);
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+    stats_alloc(tileRows * rowSize);
+
+    int ok = 1;
+    for (long long y = 0; y < format->height; y += tileRows)
+    {
+        long long rows = format->height - y < tileRows ? format->height - y : tileRows;
+        size_t want = (size_t)(rows * rowSize);
+        long long t = stats_start();
+        size_t n = fread(tile, 1, want, in);
+        if (n < want)
+            memset(tile + n, 0, want - n);
+        stats_add(STAT_BYTES_READ, n);
+        stats_stop(STAT_READ, t);
+
+        STATS_SPAN span;
+        stats_kernel_start(&span);
+        stream_tile(c, tile, y * rowSize, (long long)want);
+        stats_kernel_stop(c->text ? STAT_EMBED : STAT_EXTRACT, &span);
+        if (c->failed)
+        {
+            ok = 0;
+            break;
+        }
+
+        if (c->packed)
+        {
+            long long used = (long long)format->width * format->bytesPerPixel;
+            for (long long r = 0; r < rows && used < rowSize; r++)
+                memset(tile + r * rowSize + used, 0, (size_t)(rowSize - used));
+        }
+
+        if (out)
+        {
+            t = stats_start();
+            int written = fwrite(tile, 1, want, out) == want;
+            stats_stop(STAT_SAVE, t);
+            if (!written)
+            {
+                fprintf(stderr, "Error: Cannot write the output image\n");
+                stats_error(STAT_ERR_IO);
+                ok = 0;
+                break;
+            }
+            stats_add(STAT_BYTES_WRITTEN, want);
+        }
+        else if (c->bit >= c->totalBits)
+            break;
+    }
+
+    free(tile);
+    return ok;
+}
+
+/**
+ * @brief stream_encode с накоплением метрик искажения (dist может быть NULL).
+ */
+static int stream_embed(FILE *in, FILE *out, int method, const char *text, size_t msgLen, int step, int mask,
+                        int depth, DISTORTION *dist)
+{
+    BMP_FORMAT format;
+    unsigned char *prefix = stream_header(in, &format);
+    if (!prefix)
+        return 0;
+
+    STREAM_CURSOR c;
+    if (!stream_cursor_init(&c, &format, method, method == STREAM_STEGANO ? step : 1, mask))
+    {
+        fprintf(stderr, "Error: Invalid channel mask.\n");
+        stats_error(STAT_ERR_OTHER);
+        free(prefix);
+        return 0;
+    }
+    c.text = text;
+    c.msgLen = msgLen;
+    c.dist = format.bytesPerPixel == 3 ? dist : NULL;
+
+    if (method == STREAM_STEGANO)
+    {
+        c.totalBits = 8 * (long long)c.msgLen;
+        if (step <= 0 || c.totalBits > c.limit)
+        {
+            fprintf(stderr, "Error: The message is too large for the given image and step.\n");
+            stats_error(STAT_ERR_CAPACITY);
+            free(prefix);
+            return 0;
+        }
+    }
+    else
+    {
+        if (depth < 1 || depth > SIMPLE_MAX_DEPTH)
+        {
+            fprintf(stderr, "Error: Bit depth must be between 1 and %d\n", SIMPLE_MAX_DEPTH);
+            stats_error(STAT_ERR_OTHER);
+            free(prefix);
+            return 0;
+        }
+        c.depth = depth;
+        long long samples = simpleSamples((int)c.msgLen, depth);
+        c.totalBits = 32 + (samples - 32) * depth;
+        if (samples > c.limit)
+        {
+            fprintf(stderr, "Error: Text too long! Maximum %lld characters allowed.\n",
+                    c.limit > 32 ? (c.limit - 32) * depth / 8 : 0);
+            stats_error(STAT_ERR_CAPACITY);
+            free(prefix);
+            return 0;
+        }
+    }
+
+    int ok = fwrite(prefix, 1, format.dataOffset, out) == format.dataOffset;
+    free(prefix);
+    if (!ok)
+    {
+        fprintf(stderr, "Error: Cannot write the output image\n");
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+    stats_add(STAT_BYTES_WRITTEN, format.dataOffset);
+
+    if (!stream_pixels(in, out, &format, &c) || fflush(out) != 0)
+        return 0;
+
+    if (c.dist)
+        c.dist->samples = (unsigned long long)format.width * format.height * 3;
+    stats_add(STAT_PAYLOAD, c.msgLen);
+    return (int)((long long)format.width * format.height * format.channels);
+}
+
+/**
+ * @brief Встраивает сообщение в BMP, читая его из потока и сразу записывая результат.
+ *
+ * В памяти находятся только заголовки и буфер строк фиксированного размера.
+ * Результат побайтно совпадает с результатом simple_encode и stegano_encode
+ * для того же BMP-носителя и выходного файла BMP.
+ *
+ * @param in Входной поток с BMP-носителем.
+ * @param out Выходной поток для изображения с сообщением.
+ * @param method STREAM_SIMPLE или STREAM_STEGANO.
+ * @param text Сообщение (может содержать нулевые байты, например после шифрования).
+ * @param msgLen Длина сообщения в байтах.
+ * @param step Шаг обхода пикселей стеганографии (для прямого шифрования не используется).
+ * @param mask Маска каналов стеганографии (STEGANO_B | STEGANO_G | STEGANO_R).
+ * @param depth Глубина встраивания текста метода прямого шифрования (1..SIMPLE_MAX_DEPTH).
+ * @return Количество байтов каналов изображения (ширина * высота * каналы) при успехе, 0 при ошибке.
+ */
+int stream_encode(FILE *in, FILE *out, int method, const char *text, size_t msgLen, int step, int mask, int depth)
+{
+    return stream_embed(in, out, method, text, msgLen, step, mask, depth, NULL);
+}
+
+/**
+ * @brief stream_decode без учета сообщения в статистике: его учитывает вызывающая сторона.
+ */
+static char *stream_extract(FILE *in, int method, int step, int mask, size_t *msgLen)
+{
+    BMP_FORMAT format;
+    unsigned char *prefix = stream_header(in, &format);
+    if (!prefix)
+        return NULL;
+    free(prefix);
+
+    STREAM_CURSOR c;
+    if (!stream_cursor_init(&c, &format, method, method == STREAM_STEGANO ? step : 1, mask))
+    {
+        fprintf(stderr, "Error: Invalid channel mask.\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        return NULL;
+    }
+
+    if (method == STREAM_STEGANO)
+    {
+        c.msgLen = *msgLen;
+        c.totalBits = 8 * (long long)c.msgLen;
+        if (step <= 0 || c.msgLen == 0 || c.totalBits > c.limit)
+        {
+            fprintf(stderr, "Error: The message length exceeds the capacity of the image with the given step.\n");
+            stats_error(STAT_ERR_KEY_INVALID);
+            return NULL;
+        }
+        c.decoded = calloc(c.msgLen + 1, 1);
+        if (!c.decoded)
+        {
+            stats_error(STAT_ERR_MEMORY);
+            return NULL;
+        }
+    }
+    else
+        c.totalBits = 32; // длина сообщения становится известна после префикса
+
+    if (!stream_pixels(in, NULL, &format, &c) || c.bit < c.totalBits)
+    {
+        if (!c.failed)
+            fprintf(stderr, "Error: Reached end of image before decoding full message.\n");
+        free(c.decoded);
+        return NULL;
+    }
+
+    *msgLen = c.msgLen;
+    return c.decoded;
+}
+
+/**
+ * @brief Извлекает сообщение из BMP, читая его из потока.
+ *
+ * Чтение прекращается сразу после последнего бита сообщения.
+ *
+ * @param in Входной поток с BMP.
+ * @param method STREAM_SIMPLE или STREAM_STEGANO.
+ * @param step Шаг обхода пикселей стеганографии (из ключа).
+ * @param mask Маска каналов стеганографии (из ключа).
+ * @param msgLen На входе длина сообщения стеганографии (из ключа), метод прямого шифрования
+ * читает ее из изображения; на выходе длина извлеченного сообщения.
+ * @return Сообщение с завершающим нулем (необходимо освободить) или NULL при ошибке.
+ */
+char *stream_decode(FILE *in, int method, int step, int mask, size_t *msgLen)
+{
+    char *text = stream_extract(in, method, step, mask, msgLen);
+    if (text)
+        stats_add(STAT_PAYLOAD, *msgLen);
+    return text;
+}
+
+/**
+ * @brief Задает предел памяти операций над изображениями (--max-memory).
+ *
+ * С пределом simple_encode, stegano_encode, color_encode и их декодеры не загружают
+ * изображение целиком, а обрабатывают BMP окнами строк через stream_encode_file,
+ * stream_color_encode_file и соответствующие функции дешифрования.
+ *
+ * @param bytes Предел в байтах, 0 - без предела (изображения загружаются целиком).
+ */
+void stream_set_max_memory(long long bytes)
+{
+    streamMaxMemory = bytes > 0 ? bytes : 0;
+}
+
+/**
+ * @brief Задает число операций, одновременно расходующих предел памяти (потоки пакета).
+ */
+void stream_set_workers(int workers)
+{
+    streamWorkers = workers > 0 ? workers : 1;
+}
+
+/**
+ * @brief Возвращает предел памяти, заданный stream_set_max_memory (0 - без предела).
+ */
+long long stream_max_memory()
+{
+    return streamMaxMemory;
+}
+
+/**
+ * @brief Разбирает размер с необязательным суффиксом K, M или G (степени 1024).
+ *
+ * @return Размер в байтах или 0, если строка некорректна.
+ */
+long long stream_parse_size(const char *text)
+{
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    int shift = 0;
+    switch (*end)
+    {
+    case 'K':
+    case 'k':
+        shift = 10;
+        break;
+    case 'M':
+    case 'm':
+        shift = 20;
+        break;
+    case 'G':
+    case 'g':
+        shift = 30;
+        break;
+    case '\0':
+        break;
+    default:
+        return 0;
+    }
+    if (end == text || (shift && end[1] != '\0') || value <= 0 || value > (1LL << 40) >> shift)
+        return 0;
+    return value << shift;
+}
+
+/**
+ * @brief Открывает BMP-носитель для обработки окнами строк.
+ */
+static FILE *stream_open_input(const char *filename)
+{
+    FILE *in = fopen(filename, "rb");
+    if (!in)
+    {
+        fprintf(stderr, "Error: Cannot open %s\n", filename);
+        stats_error(STAT_ERR_IO);
+        return NULL;
+    }
+
+    unsigned char signature[8];
+    size_t n = fread(signature, 1, sizeof(signature), in);
+    if (png_signature(signature, n))
+    {
+        fprintf(stderr, "Error: PNG carriers are decoded whole and cannot be processed with --max-memory\n");
+        stats_error(STAT_ERR_FORMAT);
+        fclose(in);
+        return NULL;
+    }
+    rewind(in);
+    return in;
+}
+
+/**
+ * @brief Проверяет, что два имени указывают на один и тот же существующий файл
+ * (например, "a.bmp" и "./a.bmp").
+ */
+static int stream_same_file(const char *a, const char *b)
+{
+#ifdef _WIN32
+    char fullA[_MAX_PATH], fullB[_MAX_PATH];
+    return _fullpath(fullA, a, sizeof(fullA)) && _fullpath(fullB, b, sizeof(fullB)) && _stricmp(fullA, fullB) == 0;
+#else
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#endif
+}
+
+/**
+ * @brief Создает выходной BMP. Вход и выход - разные файлы: вход читается во время записи.
+ */
+static FILE *stream_open_output(const char *input, const char *output)
+{
+    if (png_filename(output))
+    {
+        fprintf(stderr, "Error: --max-memory writes BMP files only, not %s\n", output);
+        stats_error(STAT_ERR_FORMAT);
+        return NULL;
+    }
+    if (strcmp(input, output) == 0 || stream_same_file(input, output))
+    {
+        fprintf(stderr, "Error: --max-memory needs an output file different from the input\n");
+        stats_error(STAT_ERR_IO);
+        return NULL;
+    }
+
+    FILE *out = fopen(output, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "Error: Cannot create output file %s\n", output);
+        stats_error(STAT_ERR_IO);
+    }
+    return out;
+}
+
+/**
+ * @brief Закрывает выходной файл; при ошибке удаляет недописанный файл.
+ */
+static int stream_close_output(FILE *out, const char *output, int ok)
+{
+    if (fclose(out) != 0 && ok)
+    {
+        fprintf(stderr, "Error: Cannot write output file %s\n", output);
+        stats_error(STAT_ERR_IO);
+        ok = 0;
+    }
+    if (!ok)
+        remove(output);
+    return ok;
+}
+
+/**
+ * @brief Встраивает сообщение методом прямого шифрования или стеганографии, обрабатывая
+ * BMP-файл окнами строк (см. stream_encode). Результат совпадает с simple_encode_bytes
+ * и stegano_encode_bytes, метрики искажения - тоже.
+ *
+ * @param dist Накопитель метрик искажения или NULL (метрики - только для 24-битных изображений).
+ * @return Количество байтов каналов изображения при успехе, 0 при ошибке.
+ */
+int stream_encode_file(const char *input, const char *output, int method, const char *text, size_t msgLen,
+                       int step, int mask, int depth, DISTORTION *dist)
+{
+    FILE *in = stream_open_input(input);
+    FILE *out = in ? stream_open_output(input, output) : NULL;
+    int imageSize = out ? stream_embed(in, out, method, text, msgLen, step, mask, depth, dist) : 0;
+    if (out)
+        imageSize = stream_close_output(out, output, imageSize != 0) ? imageSize : 0;
+    if (in)
+        fclose(in);
+    return imageSize;
+}
+
+/**
+ * @brief Извлекает сообщение методом прямого шифрования или стеганографии из BMP-файла
+ * окнами строк (см. stream_decode); сообщение в статистике не учитывается.
+ *
+ * @return Сообщение с завершающим нулем (необходимо освободить) или NULL при ошибке.
+ */
+char *stream_decode_file(const char *input, int method, int step, int mask, size_t *msgLen)
+{
+    FILE *in = stream_open_input(input);
+    if (!in)
+        return NULL;
+    char *text = stream_extract(in, method, step, mask, msgLen);
+    fclose(in);
+    return text;
+}
+
+/**
+ * @brief Читает len байтов текста метода прямого шифрования с глубиной depth и, если lengthPrefix
+ * не NULL, 32-битный префикс без проверки (для сообщений с кодом Рида-Соломона, см.
+ * ecc_simple_decode).
+ *
+ * @return Число прочитанных пикселей; 0 если изображение не вмещает len байтов с этой
+ * глубиной; -1 при ошибке чтения файла.
+ */
+long long stream_simple_read(const char *input, int depth, unsigned int *lengthPrefix, unsigned char *out, size_t len)
+{
+    FILE *in = stream_open_input(input);
+    if (!in)
+        return -1;
+
+    BMP_FORMAT format;
+    unsigned char *prefix = stream_header(in, &format);
+    STREAM_CURSOR c;
+    if (!prefix || !stream_cursor_init(&c, &format, STREAM_SIMPLE, 1, STEGANO_DEFAULT_MASK))
+    {
+        free(prefix);
+        fclose(in);
+        return -1;
+    }
+    free(prefix);
+
+    long long pixels = 0;
+    if (depth >= 1 && depth <= SIMPLE_MAX_DEPTH && len <= (size_t)c.limit && simpleSamples((int)len, depth) <= c.limit)
+    {
+        memset(out, 0, len);
+        c.depth = depth;
+        c.decoded = (char *)out;
+        c.bit = lengthPrefix ? 0 : 32;
+        c.rawPrefix = 1;
+        c.totalBits = 32 + 8 * (long long)len;
+        pixels = stream_pixels(in, NULL, &format, &c) && c.bit >= c.totalBits
+                     ? (simpleSamples((int)len, depth) + format.channels - 1) / format.channels
+                     : -1;
+        if (lengthPrefix)
+            *lengthPrefix = (unsigned int)c.msgLen;
+    }
+    fclose(in);
+    return pixels;
+}
+
+/**
+ * @brief Встраивает сообщение подстановкой цветов со случайной стартовой позицией,
+ * обрабатывая BMP-файл окнами строк.
+ *
+ * Стартовая позиция выбирается теми же вызовами rand(), что в color_embed_image,
+ * байты выравнивания строк обнуляются, как при сохранении изображения, загруженного
+ * без выравнивания, поэтому результат совпадает с color_encode.
+ *
+ * @param dist Накопитель метрик искажения или NULL (метрики - только для 24-битных изображений).
+ * @return 1 в случае успеха, 0 в случае ошибки.
+ */
+int stream_color_encode_file(const char *input, const char *output, const char *message, int *startX,
+                             int *startY, DISTORTION *dist)
+{
+    FILE *in = stream_open_input(input);
+    if (!in)
+        return 0;
+
+    BMP_FORMAT format;
+    unsigned char *prefix = stream_header(in, &format);
+    STREAM_CURSOR c;
+    if (!prefix || !stream_cursor_init(&c, &format, STREAM_COLOR, 1, STEGANO_DEFAULT_MASK))
+    {
+        free(prefix);
+        fclose(in);
+        return 0;
+    }
+
+    int width = format.width, channels = format.channels;
+    long long imageSize = (long long)width * format.height;
+    long long messageLen = (long long)strlen(message);
+    long long requiredPixels = ((messageLen + 1) * 8 + channels - 1) / channels;
+    if ((messageLen + 1) * 8 / channels >= imageSize)
+    {
+        fprintf(stderr, "Error: Message too long for image\n");
+        stats_error(STAT_ERR_CAPACITY);
+        free(prefix);
+        fclose(in);
+        return 0;
+    }
+
+    int maxX = width - 1;
+    int maxY = format.height - 1;
+    *startX = maxX > 0 ? rand() % maxX : 0;
+    *startY = maxY > 0 ? rand() % maxY : 0;
+    if ((long long)*startY * width + *startX + requiredPixels >= imageSize)
+    {
+        *startX = 0;
+        *startY = 0;
+    }
+
+    c.text = message;
+    c.msgLen = (size_t)messageLen;
+    c.start = (long long)*startY * width + *startX;
+    c.totalBits = (messageLen + 1) * 8;
+    c.packed = 1;
+    c.dist = format.bytesPerPixel == 3 ? dist : NULL;
+
+    FILE *out = stream_open_output(input, output);
+    int ok = out && fwrite(prefix, 1, format.dataOffset, out) == format.dataOffset;
+    if (ok)
+        stats_add(STAT_BYTES_WRITTEN, format.dataOffset);
+    else if (out)
+    {
+        fprintf(stderr, "Error: Cannot write the output image\n");
+        stats_error(STAT_ERR_IO);
+    }
+    ok = ok && stream_pixels(in, out, &format, &c);
+    if (out)
+        ok = stream_close_output(out, output, ok);
+    free(prefix);
+    fclose(in);
+    if (!ok)
+        return 0;
+
+    if (c.dist)
+        c.dist->samples = (unsigned long long)imageSize * 3;
+    stats_add(STAT_PIXELS, requiredPixels);
+    stats_add(STAT_PAYLOAD, messageLen);
+    return 1;
+}
+
+/**
+ * @brief Извлекает сообщение подстановки цветов из BMP-файла окнами строк.
+ *
+ * Чтение прекращается на завершающем нулевом байте, как в extract_Message.
+ *
+ * @return Сообщение с завершающим нулем (необходимо освободить) или NULL при ошибке.
+ */
+char *stream_color_decode_file(const char *input, int startX, int startY, int messageLen)
+{
+    FILE *in = stream_open_input(input);
+    if (!in)
+        return NULL;
+
+    BMP_FORMAT format;
+    unsigned char *prefix = stream_header(in, &format);
+    int ok = prefix != NULL;
+    free(prefix);
+    STREAM_CURSOR c;
+    if (!ok || !stream_cursor_init(&c, &format, STREAM_COLOR, 1, STEGANO_DEFAULT_MASK))
+    {
+        fclose(in);
+        return NULL;
+    }
+
+    long long width = format.width, imageSize = width * format.height;
+    long long requiredPixels = ((messageLen + 1LL) * 8 + c.channelCount - 1) / c.channelCount;
+    if (startX < 0 || startY < 0 || messageLen < 0 || startY * width + startX + requiredPixels > imageSize)
+    {
+        fprintf(stderr, "Error: Key does not match the image\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        fclose(in);
+        return NULL;
+    }
+
+    c.start = startY * width + startX;
+    c.totalBits = (messageLen + 1LL) * 8;
+    c.decoded = calloc((size_t)messageLen + 2, 1); // завершающий нуль, даже если его нет в изображении
+    ok = c.decoded && stream_pixels(in, NULL, &format, &c) && c.bit >= c.totalBits;
+    fclose(in);
+    if (!ok)
+    {
+        if (!c.decoded)
+            stats_error(STAT_ERR_MEMORY);
+        else if (!c.failed)
+            fprintf(stderr, "Error: Reached end of image before decoding full message.\n");
+        free(c.decoded);
+        return NULL;
+    }
+
+    stats_alloc(messageLen + 1);
+    stats_add(STAT_PIXELS, requiredPixels);
+    stats_add(STAT_PAYLOAD, messageLen);
+    return c.decoded;
+}
+
+/**
+ * @brief Читает шаг, длину сообщения и маску каналов из ключа стеганографии.
+ *
+ * Ключи без строки MASK относятся к каналу R.
+ *
+ * @return 1 если ключ прочитан и корректен, иначе 0.
+ */
+static int stream_read_key(const char *keyFilename, int *step, int *mask, size_t *msgLen)
+{
+    FILE *keyfile = fopen(keyFilename, "r");
+    if (!keyfile)
+    {
+        fprintf(stderr, "Error: Cannot open key file %s\n", keyFilename);
+        stats_error(STAT_ERR_KEY_MISSING);
+        return 0;
+    }
+
+    *step = 0;
+    *mask = STEGANO_DEFAULT_MASK;
+    *msgLen = 0;
+    char line[100], name[8];
+    while (fgets(line, sizeof(line), keyfile))
+    {
+        if (sscanf(line, "STEP: %d", step) == 1)
+            continue;
+        if (sscanf(line, "LENGTH: %zu", msgLen) == 1)
+            continue;
+        if (sscanf(line, "MASK: %7s", name) == 1)
+            *mask = stegano_parse_mask(name);
+    }
+    fclose(keyfile);
+
+    if (*step <= 0 || *msgLen == 0 || !*mask)
+    {
+        fprintf(stderr, "Error: Invalid key file %s\n", keyFilename);
+        stats_error(STAT_ERR_KEY_INVALID);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Команда stream: шифрование и дешифрование BMP из стандартного ввода.
+ *
+ * Использование:
+ *   stream encode simple [--depth K] [--key файл] [--passphrase-file файл] [--] <текст>
+ *                 < вход.bmp > выход.bmp
+ *   stream encode stegano [--step N] [--mask BGR] [--key файл] [--passphrase-file файл] [--] <текст>
+ *                 < вход.bmp > выход.bmp
+ *   stream decode <simple|stegano> [--key файл] [--passphrase-file файл] < вход.bmp
+ *
+ * Параметры и текст идут в любом порядке, "--" завершает параметры (для текста,
+ * начинающегося с "--"). Неизвестный или неприменимый к методу параметр, недопустимое
+ * значение и лишнее слово завершают команду с подсказкой по использованию.
+ *
+ * Изображение с сообщением записывается в стандартный вывод, извлеченное сообщение
+ * выводится строкой; сообщения об ошибках выводятся в stderr. Стеганография
+ * сохраняет и читает ключ (по умолчанию stegano_key) вместе с маской каналов
+ * (--mask, по умолчанию R), метод прямого шифрования
+ * сохраняет ключ только при явном --key; глубину его встраивания (--depth) декодер
+ * читает из изображения. С --passphrase-file (или глобальным --passphrase-file)
+ * сообщение встраивается зашифрованным ChaCha20-Poly1305 в виде Base64 (aead_seal_text)
+ * с ключом из пароля в первой строке файла, как во всех командах и заданиях пакета;
+ * длина в ключе - длина этой строки.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int stream(int argc, char *argv[])
+{
+    int encode = argc > 0 && strcmp(argv[0], "encode") == 0;
+    int decode = argc > 0 && strcmp(argv[0], "decode") == 0;
+    int method = argc > 1 && strcmp(argv[1], "stegano") == 0 ? STREAM_STEGANO : STREAM_SIMPLE;
+    int known = argc > 1 && (strcmp(argv[1], "simple") == 0 || strcmp(argv[1], "stegano") == 0);
+
+    // параметры и текст - в любом порядке, "--" завершает параметры
+    int step = 1, depth = 1, mask = STEGANO_DEFAULT_MASK, valid = known && (encode || decode), options = 1;
+    const char *keyFilename = NULL, *passphraseFile = NULL, *text = NULL;
+    for (int i = 2; valid && i < argc; i++)
+    {
+        const char *arg = argv[i];
+        int hasValue = i + 1 < argc;
+        if (!options || strncmp(arg, "--", 2) != 0)
+        {
+            valid = encode && !text;
+            text = arg;
+        }
+        else if (strcmp(arg, "--") == 0)
+            options = 0;
+        else if (strcmp(arg, "--key") == 0 && hasValue)
+            keyFilename = argv[++i];
+        else if (strcmp(arg, "--passphrase-file") == 0 && hasValue)
+            passphraseFile = argv[++i];
+        else if (strcmp(arg, "--step") == 0 && hasValue && encode && method == STREAM_STEGANO)
+            valid = (step = atoi(argv[++i])) > 0;
+        else if (strcmp(arg, "--mask") == 0 && hasValue && encode && method == STREAM_STEGANO)
+            valid = (mask = stegano_parse_mask(argv[++i])) != 0;
+        else if (strcmp(arg, "--depth") == 0 && hasValue && encode && method == STREAM_SIMPLE)
+            valid = (depth = atoi(argv[++i])) >= 1 && depth <= SIMPLE_MAX_DEPTH;
+        else
+            valid = 0;
+        if (!valid)
+            fprintf(stderr, "Error: Unexpected or invalid argument %s\n", arg);
+    }
+
+    if (!valid || (encode && (!text || text[0] == '\0')))
+    {
+        fprintf(stderr, "Usage: stream encode simple [--depth K] [--key file] [--passphrase-file file] [--] <text>\n"
+                        "                       < input.bmp > output.bmp\n"
+                        "       stream encode stegano [--step N] [--mask BGR] [--key file] [--passphrase-file file]\n"
+                        "                       [--] <text> < input.bmp > output.bmp\n"
+                        "       stream decode <simple|stegano> [--key file] [--passphrase-file file] < input.bmp\n");
+        return 1;
+    }
+    if (method == STREAM_STEGANO && !keyFilename)
+        keyFilename = "stegano_key";
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    if (encode)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    // пароль команды или глобального --passphrase-file
+    char *passphrase = NULL;
+    if (passphraseFile && !(passphrase = aead_read_passphrase(passphraseFile)))
+        return 1;
+    const char *activePassphrase = passphrase ? passphrase : aead_passphrase();
+
+    if (decode)
+    {
+        size_t msgLen = 0;
+        if (method == STREAM_STEGANO && !stream_read_key(keyFilename, &step, &mask, &msgLen))
+        {
+            free(passphrase);
+            return 1;
+        }
+
+        char *text = aead_open_message(stream_decode(stdin, method, step, mask, &msgLen), activePassphrase);
+        free(passphrase);
+        if (!text)
+            return 1;
+        printf("%s\n", text);
+        free(text);
+        return 0;
+    }
+
+    char *sealed = NULL;
+    if (activePassphrase)
+    {
+        sealed = aead_seal_text(activePassphrase, text);
+        free(passphrase);
+        if (!sealed)
+            return 1;
+        text = sealed;
+    }
+    size_t msgLen = strlen(text);
+    int imageSize = stream_encode(stdin, stdout, method, text, msgLen, step, mask, depth);
+    free(sealed);
+    if (!imageSize)
+        return 1;
+
+    // ключ сохраняется только после того, как изображение записано целиком
+    if (method == STREAM_STEGANO)
+        return save_stegano_key(keyFilename, step, msgLen, mask) ? 0 : 1;
+    if (keyFilename)
+        return saveSimpleKey(keyFilename, (int)msgLen, imageSize) ? 0 : 1;
+    return 0;
+}
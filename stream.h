@@ -0,0 +1,31 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "bmpinfo.h"
+#include "metrics.h"
+
+// Методы, поддерживающие потоковую обработку: оба обходят пиксели только вперед
+#define STREAM_SIMPLE 0
+#define STREAM_STEGANO 1
+
+// Память помимо буфера строк при пределе --max-memory: заголовки и буферы stdio, байт
+#define STREAM_RESERVE (BMP_MAX_PREFIX + 4 * BUFSIZ)
+
+int stream_encode(FILE *in, FILE *out, int method, const char *text, size_t msgLen, int step, int mask, int depth);
+char *stream_decode(FILE *in, int method, int step, int mask, size_t *msgLen);
+void stream_set_max_memory(long long bytes);
+void stream_set_workers(int workers);
+long long stream_max_memory();
+long long stream_parse_size(const char *text);
+int stream_encode_file(const char *input, const char *output, int method, const char *text, size_t msgLen,
+                       int step, int mask, int depth, DISTORTION *dist);
+char *stream_decode_file(const char *input, int method, int step, int mask, size_t *msgLen);
+long long stream_simple_read(const char *input, int depth, unsigned int *lengthPrefix, unsigned char *out, size_t len);
+int stream_color_encode_file(const char *input, const char *output, const char *message, int *startX,
+                             int *startY, DISTORTION *dist);
+char *stream_color_decode_file(const char *input, int startX, int startY, int messageLen);
+int stream(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
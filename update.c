@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmpinfo.h"
+#include "simple.h"
+#include "simple_dec.h"
+#include "color.h"
+#include "color_dec.h"
+#include "stegano.h"
+#include "stegano_dec.h"
+#include "stats.h"
+#include "update.h"
+
+#define UPDATE_GAP 64 // изменения ближе этого расстояния записываются одним отрезком
+
+/**
+ * @brief BMP, открытый для изменения на месте, и загруженная часть его строк.
+ */
+typedef struct
+{
+    FILE *file;
+    const char *filename;
+    BMP_FORMAT format; // формат всего изображения
+    long long firstRow, rowCount;
+    unsigned char *data;     // загруженные строки в том виде, как в файле
+    unsigned char *original; // их копия до встраивания
+} UPDATE_IMAGE;
+
+static int update_open(UPDATE_IMAGE *u, const char *filename)
+{
+    memset(u, 0, sizeof(*u));
+    u->filename = filename;
+
+    long long t = stats_start();
+    u->file = fopen(filename, "r+b");
+    if (!u->file)
+    {
+        printf("Error: Cannot open image file %s for update\n", filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+
+    int bmp = bmp_read_format(u->file, filename, &u->format);
+    if (bmp < 0)
+    {
+        printf("Error: %s is a PNG file; only BMP images can be updated in place\n", filename);
+        stats_error(STAT_ERR_FORMAT);
+    }
+    if (bmp <= 0)
+        return 0;
+    stats_stop(STAT_HEADER, t);
+    return 1;
+}
+
+static void update_close(UPDATE_IMAGE *u)
+{
+    if (u->file)
+        fclose(u->file);
+    free(u->data);
+    free(u->original);
+}
+
+/**
+ * @brief Загружает строки, в которые попадают пиксели с номерами до lastPixel включительно.
+ *
+ * Номер пикселя делится на ширину, поэтому для методов, обходящих байты подряд без
+ * учета выравнивания (прямое шифрование, 8-битная стеганография), строк загружается
+ * не меньше, чем нужно.
+ *
+ * @param firstRow Первая строка.
+ * @param lastPixel Номер последнего пикселя, который затронет встраивание.
+ */
+static int update_rows(UPDATE_IMAGE *u, long long firstRow, long long lastPixel, UPDATE_RESULT *result)
+{
+    long long lastRow = lastPixel / u->format.width;
+    if (lastRow >= u->format.height)
+        lastRow = u->format.height - 1;
+
+    free(u->data);
+    free(u->original);
+    u->firstRow = firstRow;
+    u->rowCount = lastRow - firstRow + 1;
+    size_t size = (size_t)(u->rowCount * u->format.rowSize);
+    u->data = malloc(size);
+    u->original = malloc(size);
+    if (!u->data || !u->original)
+    {
+        printf("Error: Not enough memory for %s\n", u->filename);
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+
+    long long t = stats_start();
+    if (fseek(u->file, (long)(u->format.dataOffset + firstRow * u->format.rowSize), SEEK_SET) != 0 ||
+        fread(u->data, 1, size, u->file) != size)
+    {
+        printf("Error: Pixel data of %s is truncated\n", u->filename);
+        stats_error(STAT_ERR_FORMAT);
+        return 0;
+    }
+    memcpy(u->original, u->data, size);
+    stats_add(STAT_BYTES_READ, size);
+    stats_stop(STAT_READ, t);
+    result->bytesRead += size;
+    return 1;
+}
+
+/**
+ * @brief Представляет загруженные строки как изображение из rowCount строк.
+ */
+static void update_view(const UPDATE_IMAGE *u, BMP_FILE *view)
+{
+    memset(view, 0, sizeof(*view));
+    view->format = u->format;
+    view->format.height = (int)u->rowCount;
+    view->pixels = u->data;
+}
+
+/**
+ * @brief Записывает в файл только байты, изменившиеся после встраивания.
+ *
+ * Изменения, между которыми меньше UPDATE_GAP неизменных байтов, записываются
+ * одним отрезком вместе с этими байтами.
+ */
+static int update_commit(UPDATE_IMAGE *u, UPDATE_RESULT *result)
+{
+    long long t = stats_start();
+    size_t size = (size_t)(u->rowCount * u->format.rowSize);
+    long long base = u->format.dataOffset + u->firstRow * u->format.rowSize;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (u->data[i] == u->original[i])
+            continue;
+
+        size_t end = i + 1;
+        result->bytesChanged++;
+        for (size_t j = end; j < size && j < end + UPDATE_GAP; j++)
+        {
+            if (u->data[j] != u->original[j])
+            {
+                result->bytesChanged++;
+                end = j + 1;
+            }
+        }
+
+        if (fseek(u->file, (long)(base + i), SEEK_SET) != 0 || fwrite(u->data + i, 1, end - i, u->file) != end - i)
+        {
+            printf("Error: Cannot write to %s\n", u->filename);
+            stats_error(STAT_ERR_IO);
+            return 0;
+        }
+        result->bytesWritten += end - i;
+        result->runs++;
+        i = end - 1;
+    }
+
+    if (fflush(u->file) != 0)
+    {
+        printf("Error: Cannot write to %s\n", u->filename);
+        stats_error(STAT_ERR_IO);
+        return 0;
+    }
+    stats_add(STAT_BYTES_WRITTEN, result->bytesWritten);
+    stats_stop(STAT_SAVE, t);
+    return 1;
+}
+
+/**
+ * @brief Склеивает прежнее сообщение с добавляемым текстом.
+ */
+static char *update_join(const char *old, const char *text)
+{
+    size_t oldLen = strlen(old), len = strlen(text);
+    char *joined = malloc(oldLen + len + 1);
+    if (!joined)
+    {
+        stats_error(STAT_ERR_MEMORY);
+        return NULL;
+    }
+    memcpy(joined, old, oldLen);
+    memcpy(joined + oldLen, text, len + 1);
+    return joined;
+}
+
+/**
+ * @brief Номер пикселя, в который попадает sample-й байт каналов метода прямого шифрования.
+ */
+static long long simple_pixel(const BMP_FORMAT *format, long long sample)
+{
+    return sample / format->channels;
+}
+
+/**
+ * @brief Прямое шифрование: префикс и текст заменяются с начала пиксельных данных.
+ *
+ * Глубина встраивания depth 0 сохраняет прежнюю. Хвост прежнего текста, выходящий
+ * за новый, остается в изображении, но декодер его не читает.
+ */
+static int update_simple(UPDATE_IMAGE *u, const char *text, int append, int depth, UPDATE_RESULT *result)
+{
+    const BMP_FORMAT *format = &u->format;
+    long long imageSize = (long long)format->width * format->height * format->channels;
+    BMP_FILE view;
+
+    // префикс занимает первые 32 байта каналов
+    if (imageSize <= 32 || !update_rows(u, 0, simple_pixel(format, 31), result))
+    {
+        if (imageSize <= 32)
+        {
+            printf("Error: The image is too small for a message\n");
+            stats_error(STAT_ERR_CAPACITY);
+        }
+        return 0;
+    }
+
+    char *old = NULL;
+    int oldLen = 0, oldDepth = 1;
+    if (append || depth == 0)
+    {
+        // префикс читается напрямую: у изображения без сообщения глубина остается 1
+        unsigned int prefix = 0;
+        int lane[3] = {format->offset[2], format->offset[1], format->offset[0]};
+        for (int i = 0; i < 32; i++)
+        {
+            long long at = format->bytesPerPixel == 4 ? i / 3 * 4 + lane[i % 3] : i;
+            prefix = prefix << 1 | (u->data[at] & 1);
+        }
+        oldLen = prefix & SIMPLE_LEN_MASK;
+        oldDepth = (prefix >> SIMPLE_DEPTH_SHIFT) + 1;
+        if (oldDepth > SIMPLE_MAX_DEPTH || oldLen == 0 || simpleSamples(oldLen, oldDepth) > imageSize)
+        {
+            if (append)
+            {
+                printf("Error: %s has no simple message to append to\n", u->filename);
+                stats_error(STAT_ERR_PAYLOAD);
+                return 0;
+            }
+            oldDepth = 1;
+        }
+    }
+    if (depth == 0)
+        depth = oldDepth;
+
+    if (append)
+    {
+        if (!update_rows(u, 0, simple_pixel(format, simpleSamples(oldLen, oldDepth) - 1), result))
+            return 0;
+        update_view(u, &view);
+        char *oldText = decryptPixels(&view.format, view.pixels,
+                                      view.format.width * view.format.height * format->channels);
+        if (!oldText)
+        {
+            stats_error(STAT_ERR_PAYLOAD);
+            return 0;
+        }
+        old = update_join(oldText, text);
+        free(oldText);
+        if (!old)
+            return 0;
+        text = old;
+    }
+
+    int ok = 1;
+    int len = (int)strlen(text);
+    long long maxChars = (imageSize - 32) * depth / 8;
+    if (depth < 1 || depth > SIMPLE_MAX_DEPTH)
+    {
+        printf("Error: Bit depth must be between 1 and %d\n", SIMPLE_MAX_DEPTH);
+        stats_error(STAT_ERR_OTHER);
+        ok = 0;
+    }
+    else if (len > maxChars || len > SIMPLE_LEN_MASK)
+    {
+        printf("Error: Text too long! Maximum %lld characters allowed.\n", maxChars);
+        stats_error(STAT_ERR_CAPACITY);
+        ok = 0;
+    }
+
+    ok = ok && update_rows(u, 0, simple_pixel(format, simpleSamples(len, depth) - 1), result);
+    if (ok)
+    {
+        update_view(u, &view);
+        STATS_SPAN span;
+        stats_kernel_start(&span);
+        encryptPixels(&view.format, view.pixels, text, view.format.width * view.format.height * format->channels,
+                      depth);
+        stats_kernel_stop(STAT_EMBED, &span);
+        stats_add(STAT_PAYLOAD, len);
+        ok = update_commit(u, result);
+    }
+    free(old);
+    return ok;
+}
+
+/**
+ * @brief Стеганография: сообщение заменяется с тем же шагом и каналами, в ключе обновляется длина.
+ */
+static int update_stegano(UPDATE_IMAGE *u, const char *keyFilename, const char *text, int append,
+                          UPDATE_RESULT *result)
+{
+    const BMP_FORMAT *format = &u->format;
+    long long pixelCount = (long long)format->width * format->height;
+    BMP_FILE view;
+
+    int step, mask, ecc;
+    size_t oldLen;
+    if (!load_stegano_key(keyFilename, &step, &oldLen, &mask, &ecc))
+        return 0;
+    if (ecc)
+    {
+        printf("Error: Key %s belongs to an ECC-coded message, which update cannot change in place\n",
+               keyFilename);
+        stats_error(STAT_ERR_KEY_INVALID);
+        return 0;
+    }
+
+    int lanes[3];
+    int laneCount = stegano_lanes(format, mask, lanes);
+    char *old = NULL;
+    if (append)
+    {
+        long long visits = ((long long)oldLen * 8 + laneCount - 1) / laneCount;
+        if ((visits - 1) * step >= pixelCount)
+        {
+            printf("The message length exceeds the capacity of the image with the given step.\n");
+            stats_error(STAT_ERR_KEY_INVALID);
+            return 0;
+        }
+        char *oldText = calloc(oldLen + 1, 1);
+        if (!oldText || !update_rows(u, 0, (visits - 1) * step, result))
+        {
+            if (!oldText)
+                stats_error(STAT_ERR_MEMORY);
+            free(oldText);
+            return 0;
+        }
+        update_view(u, &view);
+        stegano_extract_format(&view.format, view.pixels, oldText, oldLen, step, mask);
+        old = update_join(oldText, text);
+        free(oldText);
+        if (!old)
+            return 0;
+        text = old;
+    }
+
+    size_t len = strlen(text);
+    long long visits = ((long long)len * 8 + laneCount - 1) / laneCount;
+    int ok = (visits - 1) * step < pixelCount;
+    if (!ok)
+    {
+        printf("Error: The message is too large for the given image and step.\n");
+        stats_error(STAT_ERR_CAPACITY);
+    }
+
+    ok = ok && update_rows(u, 0, (visits - 1) * step, result);
+    if (ok)
+    {
+        update_view(u, &view);
+        STATS_SPAN span;
+        stats_kernel_start(&span);
+        stegano_embed_format(&view.format, view.pixels, text, len, step, mask, NULL);
+        stats_kernel_stop(STAT_EMBED, &span);
+        stats_add(STAT_PIXELS, visits);
+        stats_add(STAT_PAYLOAD, len);
+        ok = update_commit(u, result) && (len == oldLen || save_stegano_key(keyFilename, step, len, mask));
+    }
+    free(old);
+    return ok;
+}
+
+/**
+ * @brief Подстановка цветов: сообщение заменяется с той же начальной точки, в ключе обновляется длина.
+ *
+ * Метод работает со строками без выравнивания, поэтому загруженные строки упаковываются
+ * перед встраиванием и распаковываются обратно перед записью.
+ */
+static int update_color(UPDATE_IMAGE *u, const char *keyFilename, const char *text, int append,
+                        UPDATE_RESULT *result)
+{
+    const BMP_FORMAT *format = &u->format;
+    long long width = format->width, pixelCount = width * format->height;
+    int channels = format->channels;
+
+    int startX, startY, oldLen;
+    if (!load_color_key(keyFilename, &startX, &startY, &oldLen))
+        return 0;
+
+    long long startIndex = startY * width + startX;
+    if (startX < 0 || startY < 0 || oldLen < 0 || startX >= width ||
+        startIndex + ((oldLen + 1) * 8LL + channels - 1) / channels > pixelCount)
+    {
+        printf("Error: Key does not match the image\n");
+        stats_error(STAT_ERR_KEY_INVALID);
+        return 0;
+    }
+
+    // строки загружаются с запасом под новое сообщение: прежнее при добавлении текста короче
+    long long len = (long long)oldLen * append + (long long)strlen(text);
+    long long lastPixel = startIndex + (len + 1) * 8 / channels;
+    if (lastPixel >= pixelCount)
+    {
+        printf("Error: Message too long for image starting at this position\n");
+        stats_error(STAT_ERR_CAPACITY);
+        return 0;
+    }
+    if (!update_rows(u, startY, lastPixel, result))
+        return 0;
+
+    long long rowBytes = width * format->bytesPerPixel;
+    BMP_FILE view;
+    update_view(u, &view);
+    view.packed = 1;
+    view.pixels = malloc((size_t)(rowBytes * u->rowCount));
+    if (!view.pixels)
+    {
+        stats_error(STAT_ERR_MEMORY);
+        return 0;
+    }
+    for (long long y = 0; y < u->rowCount; y++)
+        memcpy(view.pixels + y * rowBytes, u->data + y * format->rowSize, rowBytes);
+
+    char *old = NULL;
+    if (append)
+    {
+        char *oldText = extract_Message(&view, startX, 0, oldLen);
+        old = oldText ? update_join(oldText, text) : NULL;
+        free(oldText);
+        text = old;
+    }
+
+    int ok = text != NULL;
+    if (ok)
+    {
+        STATS_SPAN span;
+        stats_kernel_start(&span);
+        hideMessage(&view, text, startX, 0);
+        stats_kernel_stop(STAT_EMBED, &span);
+        stats_add(STAT_PIXELS, ((len + 1) * 8 + channels - 1) / channels);
+        stats_add(STAT_PAYLOAD, len);
+
+        for (long long y = 0; y < u->rowCount; y++)
+            memcpy(u->data + y * format->rowSize, view.pixels + y * rowBytes, rowBytes);
+        ok = update_commit(u, result) && (len == oldLen || saveColorKey(keyFilename, startX, startY, (int)len));
+    }
+    free(view.pixels);
+    free(old);
+    return ok;
+}
+
+/**
+ * @brief Заменяет сообщение в BMP на месте, записывая только изменившиеся байты.
+ *
+ * Читаются только строки, в которые попадают прежнее и новое сообщения. Новое
+ * сообщение встраивается теми же ядрами, что и при шифровании, поэтому затронутые
+ * байты совпадают с результатом повторного шифрования того же изображения; в файл
+ * записываются лишь байты, у которых изменились младшие биты.
+ *
+ * @param method UPDATE_SIMPLE, UPDATE_COLOR или UPDATE_STEGANO.
+ * @param filename Изображение BMP с сообщением.
+ * @param keyFilename Ключ подстановки цветов или стеганографии (длина в нем обновляется).
+ * @param text Новое сообщение или добавляемый текст.
+ * @param append 1 - добавить text к прежнему сообщению, 0 - заменить сообщение.
+ * @param depth Глубина встраивания прямого шифрования (0 - прежняя).
+ * @param result Указатель для статистики ввода-вывода.
+ * @return 1 при успехе, 0 при ошибке.
+ */
+int update_image(int method, const char *filename, const char *keyFilename, const char *text, int append, int depth,
+                 UPDATE_RESULT *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (text[0] == '\0' && !append)
+    {
+        printf("Error: The message is empty\n");
+        stats_error(STAT_ERR_OTHER);
+        return 0;
+    }
+
+    UPDATE_IMAGE u;
+    int ok = update_open(&u, filename);
+    if (ok)
+    {
+        if (method == UPDATE_STEGANO)
+            ok = update_stegano(&u, keyFilename, text, append, result);
+        else if (method == UPDATE_COLOR)
+            ok = update_color(&u, keyFilename, text, append, result);
+        else
+            ok = update_simple(&u, text, append, depth, result);
+    }
+    update_close(&u);
+    return ok;
+}
+
+/**
+ * @brief Команда update: замена или дополнение сообщения в BMP без перезаписи всего файла.
+ *
+ * Использование: update <simple|color|stegano> <изображение> [--key файл] [--depth K] [--append] <текст>
+ *
+ * Ключ по умолчанию - color_key или stegano_key, как в диалоговом режиме; методу
+ * прямого шифрования ключ не нужен.
+ *
+ * @param argc Количество аргументов команды.
+ * @param argv Аргументы команды.
+ * @return 0 при успешной работе или 1 при ошибках.
+ */
+int update(int argc, char *argv[])
+{
+    int method = -1;
+    if (argc > 0)
+        method = strcmp(argv[0], "simple") == 0    ? UPDATE_SIMPLE
+                 : strcmp(argv[0], "color") == 0   ? UPDATE_COLOR
+                 : strcmp(argv[0], "stegano") == 0 ? UPDATE_STEGANO
+                                                   : -1;
+
+    const char *keyFilename = method == UPDATE_COLOR ? "color_key" : "stegano_key";
+    const char *text = NULL;
+    int append = 0, depth = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--key") == 0 && i + 1 < argc)
+            keyFilename = argv[++i];
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--append") == 0)
+            append = 1;
+        else
+            text = argv[i];
+    }
+
+    if (method < 0 || argc < 3 || !text)
+    {
+        printf("Usage: update <simple|color|stegano> <image> [--key file] [--depth K] [--append] <text>\n");
+        return 1;
+    }
+
+    UPDATE_RESULT result;
+    if (!update_image(method, argv[1], keyFilename, text, append, depth, &result))
+        return 1;
+    printf("Updated %s: %lld bytes changed, %lld bytes written in %d runs, %lld bytes read\n", argv[1],
+           result.bytesChanged, result.bytesWritten, result.runs, result.bytesRead);
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef UPDATE_H
+#define UPDATE_H
+
+// Методы, сообщение которых можно заменить на месте
+#define UPDATE_SIMPLE 0
+#define UPDATE_COLOR 1
+#define UPDATE_STEGANO 2
+
+// Ввод-вывод пиксельных данных при обновлении
+typedef struct
+{
+    long long bytesRead;    // прочитанные строки пиксельных данных
+    long long bytesChanged; // байты, отличающиеся от прежних
+    long long bytesWritten; // записанные байты: изменения, объединенные в отрезки
+    int runs;               // количество записанных отрезков
+} UPDATE_RESULT;
+
+int update_image(int method, const char *filename, const char *keyFilename, const char *text, int append, int depth,
+                 UPDATE_RESULT *result);
+int update(int argc, char *argv[]);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "pool.h"
+#include "walk.h"
+
+/**
+ * @brief Проверяет, является ли файл изображением одного из форматов (по расширению).
+ *
+ * @param name Имя файла.
+ * @param formats Биты WALK_BMP и WALK_PNG.
+ * @return 1 если расширение ".bmp" (WALK_BMP) или ".png" (WALK_PNG) без учета регистра, иначе 0.
+ */
+static int is_image_name(const char *name, int formats)
+{
+    static const char *extensions[] = {"bmp", "png"}; // порядок битов WALK_*
+    const char *dot = strrchr(name, '.');
+    if (!dot || strlen(dot + 1) != 3)
+        return 0;
+
+    for (size_t e = 0; e < sizeof(extensions) / sizeof(extensions[0]); e++)
+    {
+        if (!(formats & (1 << e)))
+            continue;
+        int i = 0;
+        while (i < 3 && tolower((unsigned char)dot[1 + i]) == extensions[e][i])
+            i++;
+        if (i == 3)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Рекурсивно обходит каталог и ставит найденные изображения в очередь.
+ *
+ * @return Количество найденных файлов.
+ */
+static int walk_dir(POOL *pool, const char *dir, int formats)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        printf("Warning: Cannot open directory %s\n", dir);
+        return 0;
+    }
+
+    int found = 0;
+    size_t dirLen = strlen(dir);
+    struct dirent *entry;
+
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        char *path = malloc(dirLen + strlen(entry->d_name) + 2);
+        if (!path)
+            break;
+        sprintf(path, "%s/%s", dir, entry->d_name);
+
+        int isDir = 0, isFile = 0;
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (entry->d_type == DT_DIR)
+            isDir = 1;
+        else if (entry->d_type == DT_REG)
+            isFile = 1;
+        else if (entry->d_type == DT_UNKNOWN)
+#endif
+        {
+            struct stat st;
+            if (stat(path, &st) == 0)
+            {
+                isDir = S_ISDIR(st.st_mode);
+                isFile = S_ISREG(st.st_mode);
+            }
+        }
+
+        if (isDir)
+        {
+            found += walk_dir(pool, path, formats);
+            free(path);
+        }
+        else if (isFile && is_image_name(entry->d_name, formats))
+        {
+            pool_push(pool, path); // освобождается пулом после обработки
+            found++;
+        }
+        else
+        {
+            free(path);
+        }
+    }
+
+    closedir(d);
+    return found;
+}
+
+/**
+ * @brief Параллельно обрабатывает все изображения в дереве каталогов.
+ *
+ * Текущий поток обходит дерево и заполняет очередь пула путями,
+ * а рабочие потоки пула вызывают для каждого файла функцию visit. Обработчик
+ * вызывается одновременно из нескольких потоков и должен сам
+ * синхронизировать доступ к общим данным в ctx.
+ *
+ * @param root Каталог или отдельный файл.
+ * @param threads Количество рабочих потоков (0 - по числу процессоров).
+ * @param formats Форматы, файлы которых берутся из каталогов (WALK_BMP, WALK_PNG); отдельный
+ *                файл root передается обработчику независимо от расширения.
+ * @param visit Обработчик файла.
+ * @param ctx Пользовательские данные для обработчика.
+ * @return Количество обработанных файлов или -1 при ошибке.
+ */
+int walk_tree(const char *root, int threads, int formats, WALK_VISIT visit, void *ctx)
+{
+    struct stat st;
+    if (stat(root, &st) != 0)
+    {
+        printf("Error: Cannot access %s\n", root);
+        return -1;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        visit(root, ctx);
+        return 1;
+    }
+
+    POOL *pool = pool_start(threads, visit, ctx);
+    if (!pool)
+        return -1;
+
+    int found = walk_dir(pool, root, formats);
+    pool_finish(pool);
+
+    return found;
+}
@@ -0,0 +1,14 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include "pool.h"
+
+typedef POOL_TASK WALK_VISIT;
+
+// Форматы файлов, которые обход каталога передает обработчику (по расширению)
+#define WALK_BMP 1 // .bmp
+#define WALK_PNG 2 // .png
+
+int walk_tree(const char *root, int threads, int formats, WALK_VISIT visit, void *ctx);
+
+#endif
\ No newline at end of file